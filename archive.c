@@ -0,0 +1,1720 @@
+/***************************************************************************
+ * Archive writing and reading, with files named from templates.
+ *
+ * Records are written to files whose names are expanded from a path
+ * format using the source identifier and record start time, e.g. the
+ * SeisComP Data Structure (SDS).  A bounded set of files are kept open
+ * with buffered writers, the least recently used is closed when the
+ * limit is reached.
+ *
+ * Archives are read by walking the directory tree described by a path
+ * format, pruning directories and files that cannot contain selected
+ * data by the codes and times in their names, and reading the
+ * remaining files in parallel.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2024 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if !defined(LMP_WIN)
+#include <dirent.h>
+#endif
+
+#include "libmseed.h"
+#include "extraheaders.h"
+#include "internalstate.h"
+
+#if defined(LMP_WIN)
+#include <direct.h>
+#define lm_mkdir(PATH) _mkdir (PATH)
+#else
+#define lm_mkdir(PATH) mkdir (PATH, 0777)
+#endif
+
+/* Default write buffer size for each open file */
+#define LM_ARCHIVE_BUFFERSIZE 65536
+
+/* Nanoseconds per day */
+#define LM_NSDAY ((nstime_t)86400 * NSTMODULUS)
+
+/* An open archive file */
+typedef struct LM_ARCHIVEFILE
+{
+  char path[512];                  /* Expanded file path */
+  uint32_t hash;                   /* Hash of path */
+  MS3Writer *writer;               /* Buffered writer for file */
+  struct LM_ARCHIVEFILE *prev;     /* Previous in use order, more recently used */
+  struct LM_ARCHIVEFILE *next;     /* Next in use order, less recently used */
+  struct LM_ARCHIVEFILE *hashnext; /* Next in hash bucket */
+} LM_ARCHIVEFILE;
+
+/* Archive writer (opaque in public header) */
+struct MS3Archive
+{
+  char pathformat[512];     /* Path format */
+  int maxopen;              /* Maximum number of open files */
+  int openfiles;            /* Number of open files */
+  size_t buffersize;        /* Write buffer size per file */
+  LM_ARCHIVEFILE *files;    /* Array of maxopen file entries */
+  LM_ARCHIVEFILE *mru;      /* Most recently used open file */
+  LM_ARCHIVEFILE *lru;      /* Least recently used open file */
+  LM_ARCHIVEFILE *unused;   /* List of unused file entries */
+  LM_ARCHIVEFILE **buckets; /* Hash table of open files */
+  uint32_t bucketcount;     /* Number of hash buckets, a power of 2 */
+  MS3Record *msr;           /* Parsing container for records */
+  int64_t fileopens;        /* Count of files opened */
+  int8_t error;             /* Latched error */
+};
+
+/***************************************************************************
+ * FNV-1a hash of a string.
+ ***************************************************************************/
+static uint32_t
+path_hash (const char *path)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*path)
+  {
+    hash ^= (uint8_t)*path++;
+    hash *= 16777619u;
+  }
+
+  return hash;
+} /* End of path_hash() */
+
+/***************************************************************************
+ * Test if a path component is "." or "..".
+ ***************************************************************************/
+static int
+dot_component (const char *component, size_t length)
+{
+  return ((length == 1 || length == 2) && component[0] == '.' &&
+          (length == 1 || component[1] == '.'));
+} /* End of dot_component() */
+
+/** ************************************************************************
+ * @brief Expand an archive path format for a source identifier and time
+ *
+ * The following conversions are expanded in @p pathformat:
+ *
+ * | Code | Value                                                    |
+ * |------|----------------------------------------------------------|
+ * | \%n  | Network code                                             |
+ * | \%s  | Station code                                             |
+ * | \%l  | Location code                                            |
+ * | \%c  | Channel code, SEED channel if possible                   |
+ * | \%Y  | Year, 4 digits                                           |
+ * | \%y  | Year, 2 digits                                           |
+ * | \%j  | Day of year, 3 digits                                    |
+ * | \%m  | Month, 2 digits                                          |
+ * | \%d  | Day of month, 2 digits                                   |
+ * | \%H  | Hour, 2 digits                                           |
+ * | \%M  | Minute, 2 digits                                         |
+ * | \%S  | Second, 2 digits                                         |
+ * | \%v  | Publication version                                      |
+ * | \%q  | Data quality code mapped from publication version        |
+ * | \%t  | SDS data type, always 'D'                                |
+ * | \%\% | A literal percent sign                                   |
+ *
+ * The SeisComP Data Structure layout is available as ::MS_SDS_PATHFORMAT.
+ *
+ * Codes of @p sid that contain a path separator, or that would expand
+ * to a "." or ".." path component, are rejected so that a source
+ * identifier cannot select a path outside of the layout.
+ *
+ * @param[in] pathformat Path format to expand
+ * @param[in] sid Source identifier
+ * @param[in] pubversion Publication version
+ * @param[in] time Time for time conversions
+ * @param[out] path Destination for expanded path
+ * @param[in] pathsize Size of @p path buffer
+ *
+ * @returns Length of expanded path on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_archive_expandpath (const char *pathformat, const char *sid, uint8_t pubversion,
+                        nstime_t time, char *path, size_t pathsize)
+{
+  char net[11] = {0};
+  char sta[11] = {0};
+  char loc[11] = {0};
+  char chan[31] = {0};
+  char value[32];
+  const char *fmt;
+  const char *add;
+  size_t length = 0;
+  size_t component = 0;
+  size_t addlength;
+  int8_t codecomponent = 0;
+  uint16_t year = 0;
+  uint16_t yday = 0;
+  uint8_t hour = 0;
+  uint8_t min = 0;
+  uint8_t sec = 0;
+  uint32_t nsec = 0;
+  int month = 0;
+  int mday = 0;
+
+  if (!pathformat || !sid || !path || pathsize == 0)
+  {
+    ms_log (2, "%s(): Required input not defined: 'pathformat', 'sid' or 'path'\n", __func__);
+    return -1;
+  }
+
+  if (ms_sid2nslc_n (sid, net, sizeof (net), sta, sizeof (sta), loc, sizeof (loc), chan,
+                     sizeof (chan)))
+  {
+    ms_log (2, "%s(): Cannot parse source identifier: %s\n", __func__, sid);
+    return -1;
+  }
+
+  if (ms_nstime2time (time, &year, &yday, &hour, &min, &sec, &nsec) ||
+      ms_doy2md (year, yday, &month, &mday))
+  {
+    ms_log (2, "%s(): Cannot convert time for path\n", __func__);
+    return -1;
+  }
+
+  for (fmt = pathformat; *fmt; fmt++)
+  {
+    if (*fmt != '%')
+    {
+      value[0] = *fmt;
+      value[1] = '\0';
+      add = value;
+    }
+    else
+    {
+      add = value;
+
+      switch (*++fmt)
+      {
+      case 'n':
+        add = net;
+        break;
+      case 's':
+        add = sta;
+        break;
+      case 'l':
+        add = loc;
+        break;
+      case 'c':
+        add = chan;
+        break;
+      case 'Y':
+        snprintf (value, sizeof (value), "%04u", (unsigned int)year);
+        break;
+      case 'y':
+        snprintf (value, sizeof (value), "%02u", (unsigned int)(year % 100));
+        break;
+      case 'j':
+        snprintf (value, sizeof (value), "%03u", (unsigned int)yday);
+        break;
+      case 'm':
+        snprintf (value, sizeof (value), "%02d", month);
+        break;
+      case 'd':
+        snprintf (value, sizeof (value), "%02d", mday);
+        break;
+      case 'H':
+        snprintf (value, sizeof (value), "%02u", (unsigned int)hour);
+        break;
+      case 'M':
+        snprintf (value, sizeof (value), "%02u", (unsigned int)min);
+        break;
+      case 'S':
+        snprintf (value, sizeof (value), "%02u", (unsigned int)sec);
+        break;
+      case 'v':
+        snprintf (value, sizeof (value), "%u", (unsigned int)pubversion);
+        break;
+      case 'q':
+        value[0] = (pubversion == 1)   ? 'R'
+                   : (pubversion == 3) ? 'Q'
+                   : (pubversion == 4) ? 'M'
+                                       : 'D';
+        value[1] = '\0';
+        break;
+      case 't':
+        strcpy (value, "D");
+        break;
+      case '%':
+        strcpy (value, "%");
+        break;
+      default:
+        ms_log (2, "%s(): Unrecognized path format conversion: %%%c\n", __func__,
+                (*fmt) ? *fmt : ' ');
+        return -1;
+      }
+    }
+
+    if (add == net || add == sta || add == loc || add == chan)
+    {
+      if (strpbrk (add, "/\\"))
+      {
+        ms_log (2, "%s(): Source identifier code cannot be used in a path: '%s'\n", __func__, add);
+        return -1;
+      }
+
+      codecomponent = 1;
+    }
+    else if (*fmt == '/')
+    {
+      if (codecomponent && dot_component (path + component, length - component))
+      {
+        ms_log (2, "%s(): Source identifier codes expand to a relative path component: %s\n",
+                __func__, sid);
+        return -1;
+      }
+
+      component = length + 1;
+      codecomponent = 0;
+    }
+
+    addlength = strlen (add);
+
+    if (length + addlength >= pathsize)
+    {
+      ms_log (2, "%s(): Expanded path is too long for buffer (%" PRIsize_t " bytes)\n", __func__,
+              pathsize);
+      return -1;
+    }
+
+    memcpy (path + length, add, addlength);
+    length += addlength;
+  }
+
+  if (codecomponent && dot_component (path + component, length - component))
+  {
+    ms_log (2, "%s(): Source identifier codes expand to a relative path component: %s\n",
+            __func__, sid);
+    return -1;
+  }
+
+  path[length] = '\0';
+
+  return (int)length;
+} /* End of ms3_archive_expandpath() */
+
+/***************************************************************************
+ * Create all parent directories of a file path as needed.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+make_parents (const char *path)
+{
+  char dirpath[512];
+  struct stat st;
+  char *sep;
+
+  strncpy (dirpath, path, sizeof (dirpath) - 1);
+  dirpath[sizeof (dirpath) - 1] = '\0';
+
+  /* Nothing to do if no directory or the parent already exists */
+  if ((sep = strrchr (dirpath, '/')) == NULL || sep == dirpath)
+    return 0;
+
+  *sep = '\0';
+
+  if (stat (dirpath, &st) == 0)
+    return 0;
+
+  /* Create each directory in the path */
+  for (sep = dirpath + 1; *sep; sep++)
+  {
+    if (*sep != '/')
+      continue;
+
+    *sep = '\0';
+    if (lm_mkdir (dirpath) && errno != EEXIST)
+    {
+      ms_log (2, "Cannot create directory %s: %s\n", dirpath, strerror (errno));
+      return -1;
+    }
+    *sep = '/';
+  }
+
+  if (lm_mkdir (dirpath) && errno != EEXIST)
+  {
+    ms_log (2, "Cannot create directory %s: %s\n", dirpath, strerror (errno));
+    return -1;
+  }
+
+  return 0;
+} /* End of make_parents() */
+
+/***************************************************************************
+ * Remove an open file entry from the use order list.
+ ***************************************************************************/
+static void
+unlink_order (MS3Archive *archive, LM_ARCHIVEFILE *file)
+{
+  if (file->prev)
+    file->prev->next = file->next;
+  else
+    archive->mru = file->next;
+
+  if (file->next)
+    file->next->prev = file->prev;
+  else
+    archive->lru = file->prev;
+
+  file->prev = file->next = NULL;
+} /* End of unlink_order() */
+
+/***************************************************************************
+ * Insert an open file entry at the most recently used end.
+ ***************************************************************************/
+static void
+link_order (MS3Archive *archive, LM_ARCHIVEFILE *file)
+{
+  file->prev = NULL;
+  file->next = archive->mru;
+
+  if (archive->mru)
+    archive->mru->prev = file;
+  else
+    archive->lru = file;
+
+  archive->mru = file;
+} /* End of link_order() */
+
+/***************************************************************************
+ * Close an open file entry and remove it from the hash table.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+close_file (MS3Archive *archive, LM_ARCHIVEFILE *file)
+{
+  LM_ARCHIVEFILE **link = &archive->buckets[file->hash & (archive->bucketcount - 1)];
+
+  while (*link && *link != file)
+    link = &(*link)->hashnext;
+
+  if (*link)
+    *link = file->hashnext;
+
+  file->hashnext = NULL;
+
+  return ms3_writer_close (&file->writer);
+} /* End of close_file() */
+
+/***************************************************************************
+ * Find or open the file for a path, closing the least recently used
+ * file if the limit of open files has been reached.
+ *
+ * Returns the open file entry on success and NULL on error.
+ ***************************************************************************/
+static LM_ARCHIVEFILE *
+get_file (MS3Archive *archive, const char *path)
+{
+  LM_ARCHIVEFILE *file;
+  uint32_t hash = path_hash (path);
+  uint32_t bucket = hash & (archive->bucketcount - 1);
+
+  for (file = archive->buckets[bucket]; file; file = file->hashnext)
+  {
+    if (file->hash == hash && strcmp (file->path, path) == 0)
+    {
+      if (file != archive->mru)
+      {
+        unlink_order (archive, file);
+        link_order (archive, file);
+      }
+
+      return file;
+    }
+  }
+
+  /* Use an unused entry or close the least recently used file */
+  if (archive->unused)
+  {
+    file = archive->unused;
+    archive->unused = file->next;
+    file->next = NULL;
+  }
+  else
+  {
+    file = archive->lru;
+    unlink_order (archive, file);
+    archive->openfiles--;
+
+    if (close_file (archive, file))
+      archive->error = 1;
+  }
+
+  if (make_parents (path) ||
+      (file->writer = ms3_writer_open (path, 0, archive->buffersize)) == NULL)
+  {
+    file->next = archive->unused;
+    archive->unused = file;
+    return NULL;
+  }
+
+  strncpy (file->path, path, sizeof (file->path) - 1);
+  file->path[sizeof (file->path) - 1] = '\0';
+  file->hash = hash;
+  file->hashnext = archive->buckets[bucket];
+  archive->buckets[bucket] = file;
+  link_order (archive, file);
+  archive->openfiles++;
+  archive->fileopens++;
+
+  return file;
+} /* End of get_file() */
+
+/** ************************************************************************
+ * @brief Initialize an archive writer
+ *
+ * An archive writer routes miniSEED records to files with names
+ * expanded from @p pathformat using the source identifier and start
+ * time of the records, see ms3_archive_expandpath() for the
+ * conversions.  For example, a SeisComP Data Structure (SDS) archive
+ * rooted at \c /data/sds:
+ * @code
+ * archive = ms3_archive_init ("/data/sds/" MS_SDS_PATHFORMAT, 100, 0);
+ * @endcode
+ *
+ * Records are appended to existing files and missing directories are
+ * created.  Up to @p maxopen files are kept open, each with a buffered
+ * writer, and the least recently used file is closed when another file
+ * is needed.
+ *
+ * @param[in] pathformat Path format for archive files
+ * @param[in] maxopen Maximum number of files to keep open, at least 1
+ * @param[in] buffersize Write buffer size for each file, 0 for the default of 64 KiB
+ *
+ * @returns Allocated ::MS3Archive on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_archive_write()
+ * @see ms3_archive_writemsr()
+ * @see ms3_archive_close()
+ ***************************************************************************/
+MS3Archive *
+ms3_archive_init (const char *pathformat, int maxopen, size_t buffersize)
+{
+  MS3Archive *archive;
+  int idx;
+
+  if (!pathformat || maxopen < 1)
+  {
+    ms_log (2, "%s(): Required input not defined: 'pathformat' or 'maxopen'\n", __func__);
+    return NULL;
+  }
+
+  if (strlen (pathformat) >= sizeof (archive->pathformat))
+  {
+    ms_log (2, "%s(): Path format is too long\n", __func__);
+    return NULL;
+  }
+
+  if ((archive = (MS3Archive *)libmseed_memory.malloc (sizeof (MS3Archive))) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    return NULL;
+  }
+
+  memset (archive, 0, sizeof (MS3Archive));
+
+  strcpy (archive->pathformat, pathformat);
+  archive->maxopen = maxopen;
+  archive->buffersize = (buffersize) ? buffersize : LM_ARCHIVE_BUFFERSIZE;
+
+  /* Hash table with at least twice as many buckets as open files */
+  archive->bucketcount = 16;
+  while (archive->bucketcount < (uint32_t)maxopen * 2)
+    archive->bucketcount <<= 1;
+
+  archive->files = (LM_ARCHIVEFILE *)libmseed_memory.malloc (maxopen * sizeof (LM_ARCHIVEFILE));
+  archive->buckets = (LM_ARCHIVEFILE **)libmseed_memory.malloc (archive->bucketcount *
+                                                                sizeof (LM_ARCHIVEFILE *));
+
+  if (!archive->files || !archive->buckets)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    libmseed_memory.free (archive->files);
+    libmseed_memory.free (archive->buckets);
+    libmseed_memory.free (archive);
+    return NULL;
+  }
+
+  memset (archive->files, 0, maxopen * sizeof (LM_ARCHIVEFILE));
+  memset (archive->buckets, 0, archive->bucketcount * sizeof (LM_ARCHIVEFILE *));
+
+  for (idx = maxopen - 1; idx >= 0; idx--)
+  {
+    archive->files[idx].next = archive->unused;
+    archive->unused = &archive->files[idx];
+  }
+
+  return archive;
+} /* End of ms3_archive_init() */
+
+/** ************************************************************************
+ * @brief Write a miniSEED record to an archive
+ *
+ * The record header is parsed to determine the source identifier,
+ * publication version and start time used to expand the file path.
+ * Records are not split, a record spanning a day boundary is written
+ * to the file for its start time.
+ *
+ * @param[in] archive ::MS3Archive to write to
+ * @param[in] record miniSEED record
+ * @param[in] reclen Length of record in bytes
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_archive_write (MS3Archive *archive, const char *record, int32_t reclen, int8_t verbose)
+{
+  LM_ARCHIVEFILE *file;
+  char path[512];
+
+  if (!archive || !record)
+  {
+    ms_log (2, "%s(): Required input not defined: 'archive' or 'record'\n", __func__);
+    return -1;
+  }
+
+  if (msr3_parse (record, reclen, &archive->msr, 0, verbose) != MS_NOERROR)
+  {
+    ms_log (2, "%s(): Cannot parse record\n", __func__);
+    return -1;
+  }
+
+  if (ms3_archive_expandpath (archive->pathformat, archive->msr->sid, archive->msr->pubversion,
+                              archive->msr->starttime, path, sizeof (path)) < 0)
+    return -1;
+
+  if ((file = get_file (archive, path)) == NULL)
+    return -1;
+
+  if (verbose > 2)
+    ms_log (0, "Writing %d byte record for %s to %s\n", reclen, archive->msr->sid, path);
+
+  return ms3_writer_write (file->writer, record, reclen);
+} /* End of ms3_archive_write() */
+
+/***************************************************************************
+ * Determine the number of samples starting at a time that are before
+ * the next day boundary.
+ ***************************************************************************/
+static int64_t
+samples_in_day (nstime_t starttime, double samprate, int64_t maxsamples)
+{
+  nstime_t day = starttime / LM_NSDAY - ((starttime % LM_NSDAY < 0) ? 1 : 0);
+  nstime_t boundary = (day + 1) * LM_NSDAY;
+  double rate = (samprate < 0.0) ? -1.0 / samprate : samprate;
+  int64_t count;
+
+  count = (int64_t)((double)(boundary - starttime) / NSTMODULUS * rate);
+
+  if (count > maxsamples)
+    count = maxsamples;
+
+  /* Adjust for sample time rounding */
+  while (count > 0 && ms_sampletime (starttime, count - 1, samprate) >= boundary)
+    count--;
+  while (count < maxsamples && ms_sampletime (starttime, count, samprate) < boundary)
+    count++;
+
+  return count;
+} /* End of samples_in_day() */
+
+/** ************************************************************************
+ * @brief Pack an ::MS3Record into an archive, splitting at day boundaries
+ *
+ * The data samples of @p msr are divided at day boundaries and each
+ * part is packed with msr3_pack_next() directly into the archive file
+ * for that day, such that no record spans midnight.  Data without a
+ * sample rate are not split.
+ *
+ * All samples are packed, ::MSF_FLUSHDATA is implied.
+ *
+ * @param[in] archive ::MS3Archive to write to
+ * @param[in] msr ::MS3Record containing data to write
+ * @param[in] flags Flags controlling data packing, see msr3_pack()
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns the number of records written on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+ms3_archive_writemsr (MS3Archive *archive, const MS3Record *msr, uint32_t flags, int8_t verbose)
+{
+  MS3RecordPacker *packer;
+  LM_ARCHIVEFILE *file;
+  MS3Record part;
+  char path[512];
+  char *record = NULL;
+  int32_t reclen = 0;
+  int64_t packedrecords = 0;
+  int64_t offset = 0;
+  uint8_t samplesize;
+  int viewed;
+  int result = 0;
+
+  if (!archive || !msr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'archive' or 'msr'\n", __func__);
+    return -1;
+  }
+
+  /* Serialize pending changes in the extra header cache once, parts share the extra headers */
+  if ((viewed = mseh_cache_view (msr, &part)) < 0)
+  {
+    ms_log (2, "%s: Cannot serialize cached extra headers\n", msr->sid);
+    return -1;
+  }
+
+  if (!viewed)
+    part = *msr;
+
+  samplesize = ms_samplesize (msr->sampletype);
+  flags |= MSF_FLUSHDATA;
+
+  do
+  {
+    part.starttime = ms_sampletime (msr->starttime, offset, msr->samprate);
+    part.numsamples = msr->numsamples - offset;
+    part.datasamples = (msr->datasamples) ? (char *)msr->datasamples + offset * samplesize : NULL;
+
+    if (part.numsamples > 0 && msr->samprate != 0.0 && samplesize > 0)
+      part.numsamples = samples_in_day (part.starttime, msr->samprate, part.numsamples);
+
+    part.samplecnt = part.numsamples;
+
+    if (ms3_archive_expandpath (archive->pathformat, part.sid, part.pubversion, part.starttime,
+                                path, sizeof (path)) < 0 ||
+        (file = get_file (archive, path)) == NULL ||
+        (packer = msr3_pack_init (&part, flags, verbose)) == NULL)
+    {
+      result = -1;
+      break;
+    }
+
+    while ((result = msr3_pack_next (packer, &record, &reclen)) == 1)
+    {
+      if (ms3_writer_write (file->writer, record, reclen))
+      {
+        result = -1;
+        break;
+      }
+
+      packedrecords++;
+    }
+
+    msr3_pack_free (&packer, NULL);
+
+    if (result < 0)
+      break;
+
+    offset += part.numsamples;
+  } while (offset < msr->numsamples && part.numsamples > 0);
+
+  if (viewed)
+    libmseed_memory.free (part.extra);
+
+  return (result < 0) ? -1 : packedrecords;
+} /* End of ms3_archive_writemsr() */
+
+/** ************************************************************************
+ * @brief Pack an ::MS3TraceList into an archive, splitting at day boundaries
+ *
+ * Each segment is packed with ms3_archive_writemsr().  The trace list
+ * is not modified.
+ *
+ * @param[in] archive ::MS3Archive to write to
+ * @param[in] mstl ::MS3TraceList containing data to write
+ * @param[in] maxreclen The maximum record length to create
+ * @param[in] encoding Encoding for data samples, see msr3_pack()
+ * @param[in] flags Flags controlling data packing, see msr3_pack()
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns the number of records written on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+ms3_archive_writemstl (MS3Archive *archive, MS3TraceList *mstl, int maxreclen, int8_t encoding,
+                       uint32_t flags, int8_t verbose)
+{
+  MS3TraceID *id;
+  MS3TraceSeg *seg;
+  MS3Record msr;
+  int64_t packedrecords = 0;
+  int64_t records;
+
+  if (!archive || !mstl)
+  {
+    ms_log (2, "%s(): Required input not defined: 'archive' or 'mstl'\n", __func__);
+    return -1;
+  }
+
+  for (id = mstl->traces.next[0]; id; id = id->next[0])
+  {
+    for (seg = id->first; seg; seg = seg->next)
+    {
+      if (!seg->datasamples || seg->numsamples <= 0)
+        continue;
+
+      memset (&msr, 0, sizeof (MS3Record));
+      memcpy (msr.sid, id->sid, sizeof (msr.sid));
+      msr.reclen = maxreclen;
+      msr.encoding = encoding;
+      msr.pubversion = id->pubversion;
+      msr.starttime = seg->starttime;
+      msr.samprate = seg->samprate;
+      msr.sampletype = seg->sampletype;
+      msr.datasamples = seg->datasamples;
+      msr.numsamples = seg->numsamples;
+      msr.samplecnt = seg->numsamples;
+
+      if ((records = ms3_archive_writemsr (archive, &msr, flags, verbose)) < 0)
+        return -1;
+
+      packedrecords += records;
+    }
+  }
+
+  return packedrecords;
+} /* End of ms3_archive_writemstl() */
+
+/** ************************************************************************
+ * @brief Write all buffered records of all open archive files
+ *
+ * @param[in] archive ::MS3Archive to flush
+ *
+ * @returns 0 on success and -1 on error, including any earlier error
+ * closing a file.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_archive_flush (MS3Archive *archive)
+{
+  LM_ARCHIVEFILE *file;
+  int rv = 0;
+
+  if (!archive)
+    return -1;
+
+  for (file = archive->mru; file; file = file->next)
+  {
+    if (ms3_writer_flush (file->writer))
+      rv = -1;
+  }
+
+  return (archive->error) ? -1 : rv;
+} /* End of ms3_archive_flush() */
+
+/** ************************************************************************
+ * @brief Return the number of currently open files and total files opened
+ *
+ * @param[in] archive ::MS3Archive
+ * @param[out] openfiles Number of files currently open, may be NULL
+ * @param[out] fileopens Number of files opened since initialization, may be NULL
+ *
+ * @returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+ms3_archive_stats (const MS3Archive *archive, int *openfiles, int64_t *fileopens)
+{
+  if (!archive)
+    return -1;
+
+  if (openfiles)
+    *openfiles = archive->openfiles;
+  if (fileopens)
+    *fileopens = archive->fileopens;
+
+  return 0;
+} /* End of ms3_archive_stats() */
+
+/** ************************************************************************
+ * @brief Flush and close all archive files and free the archive writer
+ *
+ * @param[in,out] pparchive Pointer to ::MS3Archive to close, set to NULL
+ *
+ * @returns 0 on success and -1 on error, including any earlier error
+ * closing a file.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_archive_close (MS3Archive **pparchive)
+{
+  MS3Archive *archive;
+  LM_ARCHIVEFILE *file;
+  int rv;
+
+  if (!pparchive || !*pparchive)
+    return -1;
+
+  archive = *pparchive;
+  rv = (archive->error) ? -1 : 0;
+
+  for (file = archive->mru; file; file = file->next)
+  {
+    if (ms3_writer_close (&file->writer))
+      rv = -1;
+  }
+
+  msr3_free (&archive->msr);
+  libmseed_memory.free (archive->files);
+  libmseed_memory.free (archive->buckets);
+  libmseed_memory.free (archive);
+  *pparchive = NULL;
+
+  return rv;
+} /* End of ms3_archive_close() */
+
+/* Maximum number of components in a path format for reading */
+#define LM_ARCHIVE_MAXCOMPONENTS 32
+
+/* Bits for fields known while scanning */
+#define LM_FIELD_NET 0x01
+#define LM_FIELD_STA 0x02
+#define LM_FIELD_LOC 0x04
+#define LM_FIELD_CHAN 0x08
+
+/* Codes and times determined from archive path names */
+typedef struct LM_ARCHIVEFIELDS
+{
+  uint8_t known; /* Bits of known string fields */
+  char net[11];
+  char sta[11];
+  char loc[11];
+  char chan[31];
+  int year; /* -1 if unknown, as for all numeric fields */
+  int yday;
+  int month;
+  int mday;
+  int hour;
+  int min;
+  int sec;
+  int pubversion;
+} LM_ARCHIVEFIELDS;
+
+/* State for scanning an archive tree */
+typedef struct LM_ARCHIVESCAN
+{
+  const MS3Selections *selections;
+  char *components[LM_ARCHIVE_MAXCOMPONENTS];
+  int componentcount;
+  char path[1024];
+  char *names;      /* Consecutive file names */
+  size_t namessize; /* Used length of names */
+  size_t namesmax;  /* Allocated length of names */
+  int filecount;
+  int8_t verbose;
+  int error;
+} LM_ARCHIVESCAN;
+
+/* State for reading archive files, shared by reading threads */
+typedef struct LM_ARCHIVEREAD
+{
+  MS3TraceList *mstl;
+  const char **files;
+  int filecount;
+  int nextfile;
+  const MS3Tolerance *tolerance;
+  const MS3Selections *selections;
+  int8_t splitversion;
+  uint32_t flags;
+  int8_t verbose;
+  int retcode;
+#if !defined(LIBMSEED_NO_THREADING)
+  int threaded;
+  lm_mutex_t lock;
+#endif
+} LM_ARCHIVEREAD;
+
+/***************************************************************************
+ * Match a string conversion, up to the next literal character of the
+ * format or the end of the name, and check it against any earlier value.
+ *
+ * Returns the number of characters matched, or -1 for no match.
+ ***************************************************************************/
+static int
+match_string (const char *name, const char *format, char *value, size_t valuesize,
+              uint8_t *known, uint8_t bit)
+{
+  char terminator;
+  size_t length;
+
+  /* A string must be followed by a literal or the end of the component */
+  if (*format == '%' && *(format + 1) != '%')
+    return -1;
+
+  terminator = *format;
+
+  for (length = 0; name[length] && name[length] != terminator; length++)
+    ;
+
+  if (name[length] != terminator)
+    return -1;
+
+  if (length >= valuesize)
+    return -1;
+
+  if (*known & bit)
+  {
+    if (strncmp (value, name, length) || value[length] != '\0')
+      return -1;
+  }
+  else
+  {
+    memcpy (value, name, length);
+    value[length] = '\0';
+    *known |= bit;
+  }
+
+  return (int)length;
+} /* End of match_string() */
+
+/***************************************************************************
+ * Match a fixed number of digits, or 1 to 3 digits if width is 0, and
+ * check the value against any earlier value.
+ *
+ * Returns the number of characters matched, or -1 for no match.
+ ***************************************************************************/
+static int
+match_number (const char *name, int width, int *value)
+{
+  int number = 0;
+  int length = 0;
+
+  while (name[length] >= '0' && name[length] <= '9' && (width == 0 || length < width))
+  {
+    number = number * 10 + (name[length] - '0');
+    length++;
+
+    if (width == 0 && length == 3)
+      break;
+  }
+
+  if (length == 0 || (width && length != width))
+    return -1;
+
+  if (*value >= 0 && *value != number)
+    return -1;
+
+  *value = number;
+
+  return length;
+} /* End of match_number() */
+
+/***************************************************************************
+ * Match a name from a directory listing against a path format
+ * component, adding values of conversions to the fields.
+ *
+ * Returns 1 on match, otherwise 0.
+ ***************************************************************************/
+static int
+match_component (const char *name, const char *format, LM_ARCHIVEFIELDS *fields)
+{
+  int number;
+  int length;
+
+  while (*format)
+  {
+    if (*format != '%')
+    {
+      if (*name++ != *format++)
+        return 0;
+
+      continue;
+    }
+
+    format += 2;
+
+    switch (*(format - 1))
+    {
+    case 'n':
+      length = match_string (name, format, fields->net, sizeof (fields->net), &fields->known,
+                             LM_FIELD_NET);
+      break;
+    case 's':
+      length = match_string (name, format, fields->sta, sizeof (fields->sta), &fields->known,
+                             LM_FIELD_STA);
+      break;
+    case 'l':
+      length = match_string (name, format, fields->loc, sizeof (fields->loc), &fields->known,
+                             LM_FIELD_LOC);
+      break;
+    case 'c':
+      length = match_string (name, format, fields->chan, sizeof (fields->chan), &fields->known,
+                             LM_FIELD_CHAN);
+      break;
+    case 'Y':
+      length = match_number (name, 4, &fields->year);
+      break;
+    case 'y':
+      /* Two digit years are only matched, not used for time ranges */
+      number = -1;
+      length = match_number (name, 2, &number);
+      break;
+    case 'j':
+      length = match_number (name, 3, &fields->yday);
+      break;
+    case 'm':
+      length = match_number (name, 2, &fields->month);
+      break;
+    case 'd':
+      length = match_number (name, 2, &fields->mday);
+      break;
+    case 'H':
+      length = match_number (name, 2, &fields->hour);
+      break;
+    case 'M':
+      length = match_number (name, 2, &fields->min);
+      break;
+    case 'S':
+      length = match_number (name, 2, &fields->sec);
+      break;
+    case 'v':
+      length = match_number (name, 0, &fields->pubversion);
+      break;
+    case 'q':
+      number = (*name == 'R')   ? 1
+               : (*name == 'D') ? 2
+               : (*name == 'Q') ? 3
+               : (*name == 'M') ? 4
+                                : -1;
+      if (number < 0 || (fields->pubversion >= 0 && fields->pubversion != number))
+        return 0;
+      fields->pubversion = number;
+      length = 1;
+      break;
+    case 't':
+      length = (*name) ? 1 : -1;
+      break;
+    case '%':
+      length = (*name == '%') ? 1 : -1;
+      break;
+    default:
+      return 0;
+    }
+
+    if (length < 0)
+      return 0;
+
+    name += length;
+  }
+
+  return (*name == '\0');
+} /* End of match_component() */
+
+/***************************************************************************
+ * Test if data identified by known fields could match the selections.
+ *
+ * Files for a day are considered to contain data from the start of the
+ * day through the end of the following day, as records are commonly
+ * archived by start time and can extend past midnight.
+ *
+ * Returns 1 if data could match, otherwise 0.
+ ***************************************************************************/
+static int
+fields_match (const MS3Selections *selections, const LM_ARCHIVEFIELDS *fields)
+{
+  nstime_t starttime = NSTUNSET;
+  nstime_t endtime = NSTUNSET;
+  int yday = fields->yday;
+
+  if (!selections)
+    return 1;
+
+  if (fields->year >= 0)
+  {
+    if (yday < 0 && fields->month > 0 && fields->mday > 0 &&
+        ms_md2doy (fields->year, fields->month, fields->mday, &yday))
+      yday = -1;
+
+    if (yday > 0)
+    {
+      starttime = ms_time2nstime (fields->year, yday, 0, 0, 0, 0);
+      endtime = starttime + 2 * LM_NSDAY - 1;
+    }
+    else
+    {
+      starttime = ms_time2nstime (fields->year, 1, 0, 0, 0, 0);
+      endtime = ms_time2nstime (fields->year + 1, 1, 0, 0, 0, 0) + LM_NSDAY - 1;
+    }
+
+    if (starttime == NSTERROR || endtime == NSTERROR)
+      starttime = endtime = NSTUNSET;
+  }
+
+  return lm_matchselect_partial (selections, (fields->known & LM_FIELD_NET) ? fields->net : NULL,
+                                 (fields->known & LM_FIELD_STA) ? fields->sta : NULL,
+                                 (fields->known & LM_FIELD_LOC) ? fields->loc : NULL,
+                                 (fields->known & LM_FIELD_CHAN) ? fields->chan : NULL,
+                                 starttime, endtime, fields->pubversion);
+} /* End of fields_match() */
+
+/***************************************************************************
+ * Add a file path to the list of files to read.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+add_file (LM_ARCHIVESCAN *scan)
+{
+  size_t length = strlen (scan->path) + 1;
+  size_t newmax;
+  char *names;
+
+  if (scan->namessize + length > scan->namesmax)
+  {
+    newmax = (scan->namesmax) ? scan->namesmax * 2 : 4096;
+    while (newmax < scan->namessize + length)
+      newmax *= 2;
+
+    if ((names = (char *)libmseed_memory.realloc (scan->names, newmax)) == NULL)
+    {
+      ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+      return -1;
+    }
+
+    scan->names = names;
+    scan->namesmax = newmax;
+  }
+
+  memcpy (scan->names + scan->namessize, scan->path, length);
+  scan->namessize += length;
+  scan->filecount++;
+
+  return 0;
+} /* End of add_file() */
+
+static int scan_component (LM_ARCHIVESCAN *scan, size_t pathlength, int component,
+                           const LM_ARCHIVEFIELDS *fields);
+
+/***************************************************************************
+ * Append a name to the current path and continue scanning with the
+ * next component, or add the path as a file if it is the last.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+scan_entry (LM_ARCHIVESCAN *scan, size_t pathlength, int component, const char *name,
+            const LM_ARCHIVEFIELDS *fields)
+{
+  struct stat st;
+  size_t length = pathlength;
+  size_t namelength = strlen (name);
+
+  if (length > 0 && scan->path[length - 1] != '/')
+    scan->path[length++] = '/';
+
+  if (length + namelength >= sizeof (scan->path))
+  {
+    ms_log (1, "Skipping path that is too long in %s\n", scan->path);
+    return 0;
+  }
+
+  memcpy (scan->path + length, name, namelength + 1);
+  length += namelength;
+
+  if (component + 1 < scan->componentcount)
+    return scan_component (scan, length, component + 1, fields);
+
+  if (stat (scan->path, &st) || !S_ISREG (st.st_mode))
+    return 0;
+
+  if (scan->verbose > 1)
+    ms_log (0, "Selected archive file: %s\n", scan->path);
+
+  return add_file (scan);
+} /* End of scan_entry() */
+
+/***************************************************************************
+ * Scan the directory at the current path for entries matching a path
+ * format component, pruning entries that cannot contain selected data.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+scan_component (LM_ARCHIVESCAN *scan, size_t pathlength, int component,
+                const LM_ARCHIVEFIELDS *fields)
+{
+  const char *format = scan->components[component];
+  LM_ARCHIVEFIELDS entryfields;
+  const char *name;
+  int rv = 0;
+#if defined(LMP_WIN)
+  char dirpath[sizeof (scan->path)];
+  WIN32_FIND_DATAA finddata;
+  HANDLE find;
+#else
+  struct dirent *entry;
+  DIR *dir;
+#endif
+
+  scan->path[pathlength] = '\0';
+
+  /* Literal components are not listed */
+  if (!strchr (format, '%'))
+    return scan_entry (scan, pathlength, component, format, fields);
+
+#if defined(LMP_WIN)
+  memcpy (dirpath, scan->path, pathlength + 1);
+
+  if (snprintf (dirpath + pathlength, sizeof (dirpath) - pathlength, "%s*",
+                (pathlength) ? "/" : "") >= (int)(sizeof (dirpath) - pathlength))
+    return 0;
+
+  if ((find = FindFirstFileA (dirpath, &finddata)) == INVALID_HANDLE_VALUE)
+    return 0;
+
+  do
+  {
+    name = finddata.cFileName;
+#else
+  if ((dir = opendir ((pathlength) ? scan->path : ".")) == NULL)
+    return 0;
+
+  while ((entry = readdir (dir)) != NULL)
+  {
+    name = entry->d_name;
+#endif
+
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+      continue;
+
+    entryfields = *fields;
+
+    if (!match_component (name, format, &entryfields) ||
+        !fields_match (scan->selections, &entryfields))
+      continue;
+
+    if ((rv = scan_entry (scan, pathlength, component, name, &entryfields)) != 0)
+      break;
+
+    scan->path[pathlength] = '\0';
+#if defined(LMP_WIN)
+  } while (FindNextFileA (find, &finddata));
+
+  FindClose (find);
+#else
+  }
+
+  closedir (dir);
+#endif
+
+  return rv;
+} /* End of scan_component() */
+
+/***************************************************************************
+ * Compare strings for qsort().
+ ***************************************************************************/
+static int
+compare_names (const void *a, const void *b)
+{
+  return strcmp (*(const char *const *)a, *(const char *const *)b);
+} /* End of compare_names() */
+
+/***************************************************************************
+ * Lock and unlock shared reading state when reading with threads.
+ ***************************************************************************/
+static void
+read_lock (LM_ARCHIVEREAD *read)
+{
+#if !defined(LIBMSEED_NO_THREADING)
+  if (read->threaded)
+    lm_mutex_lock (&read->lock);
+#else
+  (void)read;
+#endif
+}
+
+static void
+read_unlock (LM_ARCHIVEREAD *read)
+{
+#if !defined(LIBMSEED_NO_THREADING)
+  if (read->threaded)
+    lm_mutex_unlock (&read->lock);
+#else
+  (void)read;
+#endif
+}
+
+/***************************************************************************
+ * Read archive files, taking the next unread file from the shared
+ * state until all files are read or an error occurs.  Records are
+ * parsed and decoded concurrently and added to the trace list while
+ * holding the lock.
+ ***************************************************************************/
+static void
+read_files (void *data)
+{
+  LM_ARCHIVEREAD *read = (LM_ARCHIVEREAD *)data;
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3RecordPtr *recordptr = NULL;
+  const char *path;
+  uint32_t previous_crc;
+  uint32_t dataoffset;
+  uint32_t datasize;
+  uint32_t crc;
+  int duplicate;
+  int retcode;
+
+  for (;;)
+  {
+    read_lock (read);
+    path = (read->retcode == MS_NOERROR && read->nextfile < read->filecount)
+               ? read->files[read->nextfile++]
+               : NULL;
+    read_unlock (read);
+
+    if (!path)
+      break;
+
+    previous_crc = 0;
+
+    while ((retcode = ms3_readmsr_selection (&msfp, &msr, path, read->flags, read->selections,
+                                             read->verbose)) == MS_NOERROR)
+    {
+      if (read->flags & MSF_SKIPADJACENTDUPLICATES)
+      {
+        /* Use the CRC stored in version 3 records, otherwise calculate it */
+        crc = (msr->formatversion == 3 && msr->crc)
+                  ? msr->crc
+                  : ms_crc32c ((const uint8_t *)msr->record, msr->reclen, 0);
+
+        if (crc == previous_crc)
+          continue;
+
+        previous_crc = crc;
+      }
+
+      read_lock (read);
+
+      /* Skip records already added from any file */
+      if (read->flags & MSF_SKIPDUPLICATES)
+      {
+        duplicate = lm_skip_duplicate (read->mstl, msr, read->splitversion, read->flags);
+
+        if (duplicate)
+        {
+          read_unlock (read);
+
+          if (duplicate > 0)
+            continue;
+
+          retcode = MS_GENERROR;
+          break;
+        }
+      }
+
+      seg = mstl3_addmsr_recordptr (read->mstl, msr,
+                                    (read->flags & MSF_RECORDLIST) ? &recordptr : NULL,
+                                    read->splitversion, 1, read->flags, read->tolerance);
+
+      /* Populate remaining fields of record pointer */
+      if (seg && recordptr)
+      {
+        if (msr3_data_bounds (msr, &dataoffset, &datasize))
+        {
+          seg = NULL;
+        }
+        else
+        {
+          recordptr->bufferptr = NULL;
+          recordptr->fileptr = NULL;
+          recordptr->filename = path;
+          recordptr->fileoffset = msfp->streampos - msr->reclen;
+          recordptr->dataoffset = dataoffset;
+          recordptr->prvtptr = NULL;
+        }
+      }
+
+      read_unlock (read);
+
+      if (seg == NULL)
+      {
+        ms_log (2, "%s: Cannot add record to trace list\n", msr->sid);
+        retcode = MS_GENERROR;
+        break;
+      }
+    }
+
+    if (retcode == MS_ENDOFFILE)
+      retcode = MS_NOERROR;
+
+    /* Close file and release resources */
+    ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+    if (retcode != MS_NOERROR)
+    {
+      read_lock (read);
+      if (read->retcode == MS_NOERROR)
+        read->retcode = retcode;
+      read_unlock (read);
+    }
+  }
+} /* End of read_files() */
+
+/** ************************************************************************
+ * @brief Read selected data from an archive tree into a trace list
+ *
+ * The directory tree under @p root is walked following the layout
+ * described by @p pathformat, see ms3_archive_expandpath() for the
+ * conversions, e.g. ::MS_SDS_PATHFORMAT for a SeisComP Data
+ * Structure (SDS) archive.  Each directory and file name is matched
+ * against its path format component and the network, station,
+ * location, channel, year, day and version codes in the names are
+ * tested against @p selections.  Directories and files that cannot
+ * contain selected data are pruned without being opened.
+ *
+ * When reading, string conversions (\%n, \%s, \%l and \%c) must be
+ * followed by a literal character or the end of a path component.
+ * Files for a day are considered to contain data through the end of
+ * the following day, as records are commonly archived by start time.
+ *
+ * The remaining files are read with up to @p threads threads, parsing
+ * and decoding concurrently, into a single ::MS3TraceList.  Records are
+ * filtered by @p selections as with ms3_readtracelist_selection().  As
+ * files are read concurrently, segments are built out of order and
+ * healed as the gaps between them are filled.
+ *
+ * If ::MSF_RECORDLIST is set in @p flags the file names referenced by
+ * the record lists are owned by the trace list and freed by
+ * mstl3_free().
+ *
+ * @param[out] ppmstl Pointer-to-pointer to a ::MS3TraceList to populate
+ * @param[in] root Root directory of archive, or NULL if @p pathformat is complete
+ * @param[in] pathformat Path format of archive files relative to @p root
+ * @param[in] tolerance Tolerance function pointers as ::MS3Tolerance
+ * @param[in] selections Pointer to ::MS3Selections for limiting data
+ * @param[in] splitversion Flag to control splitting of version/quality
+ * @param[in] flags Flags as for ms3_readtracelist_selection()
+ * @param[in] threads Number of reading threads, 0 for the number of processors
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns ::MS_NOERROR and populates an ::MS3TraceList struct at *ppmstl
+ * on success, otherwise returns a (negative) libmseed error code.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see @ref trace-list
+ * @see @ref data-selections
+ ***************************************************************************/
+int
+ms3_readarchive_selection (MS3TraceList **ppmstl, const char *root, const char *pathformat,
+                           const MS3Tolerance *tolerance, const MS3Selections *selections,
+                           int8_t splitversion, uint32_t flags, int threads, int8_t verbose)
+{
+  LM_ARCHIVESCAN scan;
+  LM_ARCHIVEREAD read;
+  LM_ARCHIVEFIELDS fields;
+  struct LM_FILENAMES_s *filenames = NULL;
+  const char **files = NULL;
+  char format[512];
+  char *component;
+  char *separator;
+  size_t pathlength;
+  int idx;
+#if !defined(LIBMSEED_NO_THREADING)
+  lm_thread_t *workers = NULL;
+  int started = 0;
+#endif
+
+  if (!ppmstl || !pathformat)
+  {
+    ms_log (2, "%s(): Required input not defined: 'ppmstl' or 'pathformat'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  memset (&scan, 0, sizeof (scan));
+  scan.selections = selections;
+  scan.verbose = verbose;
+
+  memset (&fields, 0, sizeof (fields));
+  fields.year = fields.yday = fields.month = fields.mday = -1;
+  fields.hour = fields.min = fields.sec = fields.pubversion = -1;
+
+  if (strlen (pathformat) >= sizeof (format) ||
+      (root && strlen (root) >= sizeof (scan.path) - sizeof (format)))
+  {
+    ms_log (2, "%s(): Root or path format is too long\n", __func__);
+    return MS_GENERROR;
+  }
+
+  /* Start at root, the file system root for an absolute format, or the current directory */
+  if (root && *root)
+    strcpy (scan.path, root);
+  else if (*pathformat == '/')
+    strcpy (scan.path, "/");
+  pathlength = strlen (scan.path);
+
+  /* Split path format into components */
+  strcpy (format, pathformat);
+  for (component = format; component; component = separator)
+  {
+    if ((separator = strchr (component, '/')) != NULL)
+      *separator++ = '\0';
+
+    /* Skip empty components from leading or repeated separators */
+    if (*component == '\0')
+      continue;
+
+    if (scan.componentcount >= LM_ARCHIVE_MAXCOMPONENTS)
+    {
+      ms_log (2, "%s(): Too many path format components\n", __func__);
+      return MS_GENERROR;
+    }
+
+    scan.components[scan.componentcount++] = component;
+  }
+
+  if (scan.componentcount == 0)
+  {
+    ms_log (2, "%s(): Path format has no components\n", __func__);
+    return MS_GENERROR;
+  }
+
+  /* Initialize MS3TraceList if needed */
+  if (!*ppmstl)
+  {
+    *ppmstl = mstl3_init (*ppmstl);
+
+    if (!*ppmstl)
+    {
+      ms_log (2, "Cannot allocate memory\n");
+      return MS_GENERROR;
+    }
+  }
+
+  if (scan_component (&scan, pathlength, 0, &fields))
+  {
+    libmseed_memory.free (scan.names);
+    return MS_GENERROR;
+  }
+
+  if (verbose)
+    ms_log (0, "Reading %d archive file(s) after pruning\n", scan.filecount);
+
+  if (scan.filecount == 0)
+    return MS_NOERROR;
+
+  /* Move file names into a block that can be owned by the trace list */
+  filenames = (struct LM_FILENAMES_s *)libmseed_memory.malloc (sizeof (struct LM_FILENAMES_s) +
+                                                                scan.namessize);
+  files = (const char **)libmseed_memory.malloc (scan.filecount * sizeof (char *));
+
+  if (!filenames || !files)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    libmseed_memory.free (filenames);
+    libmseed_memory.free (files);
+    libmseed_memory.free (scan.names);
+    return MS_GENERROR;
+  }
+
+  memcpy (filenames->names, scan.names, scan.namessize);
+  libmseed_memory.free (scan.names);
+
+  files[0] = filenames->names;
+  for (idx = 1; idx < scan.filecount; idx++)
+    files[idx] = files[idx - 1] + strlen (files[idx - 1]) + 1;
+
+  /* Read files in name order */
+  qsort (files, scan.filecount, sizeof (char *), compare_names);
+
+  memset (&read, 0, sizeof (read));
+  read.mstl = *ppmstl;
+  read.files = files;
+  read.filecount = scan.filecount;
+  read.tolerance = tolerance;
+  read.selections = selections;
+  read.splitversion = splitversion;
+  read.flags = flags;
+  read.verbose = verbose;
+  read.retcode = MS_NOERROR;
+
+#if !defined(LIBMSEED_NO_THREADING)
+  if (threads <= 0)
+    threads = lm_cpucount ();
+  if (threads > scan.filecount)
+    threads = scan.filecount;
+
+  /* Start additional threads, the calling thread also reads */
+  if (threads > 1 && lm_mutex_init (&read.lock) == 0)
+  {
+    read.threaded = 1;
+
+    if ((workers = (lm_thread_t *)libmseed_memory.malloc ((threads - 1) *
+                                                          sizeof (lm_thread_t))) != NULL)
+    {
+      for (started = 0; started < threads - 1; started++)
+      {
+        if (lm_thread_create (&workers[started], read_files, &read))
+          break;
+      }
+    }
+  }
+
+  read_files (&read);
+
+  for (idx = 0; idx < started; idx++)
+    lm_thread_join (workers[idx]);
+
+  if (read.threaded)
+    lm_mutex_destroy (&read.lock);
+
+  libmseed_memory.free (workers);
+#else
+  (void)threads;
+  read_files (&read);
+#endif
+
+  /* Retain file names referenced by record lists */
+  if (flags & MSF_RECORDLIST)
+  {
+    filenames->next = (*ppmstl)->filenames;
+    (*ppmstl)->filenames = filenames;
+  }
+  else
+  {
+    libmseed_memory.free (filenames);
+  }
+
+  libmseed_memory.free (files);
+
+  return read.retcode;
+} /* End of ms3_readarchive_selection() */
@@ -0,0 +1,752 @@
+/***************************************************************************
+ * A benchmark suite for libmseed.
+ *
+ * Synthetic miniSEED 2 and 3 corpora with varied encodings, record
+ * lengths, channel counts and gap patterns are generated in memory and
+ * the core library paths are timed against each corpus:
+ *
+ *   msr3_parse, msr3_unpack_data, msr3_pack, ms_crc32c, mstl3_addmsr,
+ *   ms3_matchselect and mstl3_pack
+ *
+ * Results are written to stdout as JSON Lines, one object per
+ * benchmark and corpus, for comparison across builds and commits.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2024 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libmseed.h>
+
+#define VERSION "[libmseed " LIBMSEED_VERSION " benchmark]"
+#define PACKAGE "lm_bench"
+
+static double mintime        = 0.5;
+static int64_t samplecount   = 100000;
+static const char *benchmatch  = NULL;
+static const char *corpusmatch = NULL;
+static flag verbose          = 0;
+
+/* Definition of a synthetic corpus */
+typedef struct BenchCorpus
+{
+  const char *name;
+  uint8_t formatversion;
+  int8_t encoding;
+  int reclen;
+  int channels;
+  int gaps;          /* Number of gaps per channel */
+} BenchCorpus;
+
+static const BenchCorpus corpora[] = {
+    {"v2-steim2-4096-3ch", 2, DE_STEIM2, 4096, 3, 0},
+    {"v3-steim2-4096-3ch", 3, DE_STEIM2, 4096, 3, 0},
+    {"v2-steim1-512-24ch-gaps", 2, DE_STEIM1, 512, 24, 20},
+    {"v3-steim1-512-24ch-gaps", 3, DE_STEIM1, 512, 24, 20},
+    {"v2-int32-4096-1ch", 2, DE_INT32, 4096, 1, 0},
+    {"v3-int16-4096-1ch", 3, DE_INT16, 4096, 1, 0},
+    {"v3-int32-1024-12ch-gaps", 3, DE_INT32, 1024, 12, 5},
+    {"v3-float32-4096-3ch", 3, DE_FLOAT32, 4096, 3, 0},
+    {"v3-float64-8192-3ch-gaps", 3, DE_FLOAT64, 8192, 3, 5},
+};
+#define CORPUS_COUNT (int)(sizeof (corpora) / sizeof (corpora[0]))
+
+/* Generated corpus state */
+typedef struct CorpusData
+{
+  const BenchCorpus *def;
+  char *buffer;          /* All records, channels interleaved */
+  uint64_t bufferlength;
+  uint64_t buffersize;
+  uint64_t *offsets;     /* Offset of each record in buffer */
+  int *lengths;          /* Length of each record */
+  int64_t recordcount;
+  MS3Record **records;   /* Parsed headers of each record */
+  int32_t *isamples;     /* Source samples for integer encodings */
+  float *fsamples;       /* Source samples for float32 encoding */
+  double *dsamples;      /* Source samples for float64 encoding */
+  MS3TraceList *mstl;    /* Trace list with decoded samples */
+  MS3Selections *selections;
+} CorpusData;
+
+/* Accumulator for generated records */
+typedef struct RecordCollector
+{
+  char *buffer;
+  uint64_t length;
+  uint64_t size;
+  int64_t count;
+  uint64_t *offsets;
+  int *lengths;
+  int64_t offsetsize;
+} RecordCollector;
+
+/* Benchmark function, returns records processed and sets bytes processed */
+typedef int64_t (*BenchFunction) (CorpusData *corpus, uint64_t *bytes);
+
+static int parameter_proc (int argcount, char **argvec);
+static void usage (void);
+
+/***************************************************************************
+ * Return a monotonic time in seconds.
+ ***************************************************************************/
+static double
+bench_now (void)
+{
+#if defined(LMP_WIN)
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+
+  QueryPerformanceFrequency (&frequency);
+  QueryPerformanceCounter (&counter);
+
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+/***************************************************************************
+ * Record handler that appends records to a RecordCollector.
+ ***************************************************************************/
+static void
+collect_record (char *record, int reclen, void *handlerdata)
+{
+  RecordCollector *collector = (RecordCollector *)handlerdata;
+
+  if (collector->length + reclen > collector->size)
+  {
+    collector->size = (collector->size + reclen) * 2;
+    if ((collector->buffer = realloc (collector->buffer, collector->size)) == NULL)
+    {
+      ms_log (2, "Cannot allocate record buffer\n");
+      exit (1);
+    }
+  }
+
+  if (collector->count >= collector->offsetsize)
+  {
+    collector->offsetsize = (collector->offsetsize + 64) * 2;
+    collector->offsets = realloc (collector->offsets, collector->offsetsize * sizeof (uint64_t));
+    collector->lengths = realloc (collector->lengths, collector->offsetsize * sizeof (int));
+
+    if (!collector->offsets || !collector->lengths)
+    {
+      ms_log (2, "Cannot allocate record index\n");
+      exit (1);
+    }
+  }
+
+  memcpy (collector->buffer + collector->length, record, reclen);
+  collector->offsets[collector->count] = collector->length;
+  collector->lengths[collector->count] = reclen;
+  collector->length += reclen;
+  collector->count++;
+}
+
+/***************************************************************************
+ * Record handler that only counts records and bytes.
+ ***************************************************************************/
+static void
+count_record (char *record, int reclen, void *handlerdata)
+{
+  uint64_t *counts = (uint64_t *)handlerdata;
+
+  (void)record;
+  counts[0] += 1;
+  counts[1] += reclen;
+}
+
+/***************************************************************************
+ * Populate a record template for a channel and segment of a corpus.
+ ***************************************************************************/
+static void
+init_record (MS3Record *msr, const CorpusData *corpus, int channel, int segment)
+{
+  const BenchCorpus *def = corpus->def;
+  int64_t segsamples     = samplecount / (def->gaps + 1);
+
+  snprintf (msr->sid, sizeof (msr->sid), "FDSN:XX_B%03d_00_H_H_%c", channel / 3,
+            "ZNE"[channel % 3]);
+  msr->formatversion = def->formatversion;
+  msr->reclen        = def->reclen;
+  msr->encoding      = def->encoding;
+  msr->samprate      = 100.0;
+  msr->pubversion    = 1;
+
+  /* Each segment is followed by a 10 second gap */
+  msr->starttime = MS_EPOCH2NSTIME (1735689600) +
+                   (nstime_t)segment * (segsamples * (NSTMODULUS / 100) + MS_EPOCH2NSTIME (10));
+
+  switch (def->encoding)
+  {
+  case DE_FLOAT32:
+    msr->datasamples = corpus->fsamples + (segment * segsamples);
+    msr->sampletype  = 'f';
+    break;
+  case DE_FLOAT64:
+    msr->datasamples = corpus->dsamples + (segment * segsamples);
+    msr->sampletype  = 'd';
+    break;
+  default:
+    msr->datasamples = corpus->isamples + (segment * segsamples);
+    msr->sampletype  = 'i';
+    break;
+  }
+
+  msr->numsamples = (segment == def->gaps) ? samplecount - segment * segsamples : segsamples;
+  msr->samplecnt  = msr->numsamples;
+}
+
+/***************************************************************************
+ * Generate a corpus: synthetic samples packed into records for each
+ * channel, interleaved round-robin by channel, and parsed headers.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+generate_corpus (CorpusData *corpus, const BenchCorpus *def)
+{
+  RecordCollector *channels;
+  MS3Record *msr = NULL;
+  uint32_t flags;
+  int64_t idx;
+  int64_t packed;
+  int64_t position;
+  int channel;
+  int segment;
+  int remaining;
+
+  memset (corpus, 0, sizeof (CorpusData));
+  corpus->def = def;
+
+  /* Generate a noisy sinusoid, bounded to 16-bit range for all encodings */
+  corpus->isamples = malloc (samplecount * sizeof (int32_t));
+  corpus->fsamples = malloc (samplecount * sizeof (float));
+  corpus->dsamples = malloc (samplecount * sizeof (double));
+
+  if (!corpus->isamples || !corpus->fsamples || !corpus->dsamples)
+    return -1;
+
+  srand (42);
+  for (idx = 0; idx < samplecount; idx++)
+  {
+    corpus->dsamples[idx] = 8000.0 * sin (idx / 50.0) + 2000.0 * sin (idx / 7.3) +
+                            (rand () % 2001 - 1000);
+    corpus->isamples[idx] = (int32_t)corpus->dsamples[idx];
+    corpus->fsamples[idx] = (float)corpus->dsamples[idx];
+  }
+
+  if ((channels = calloc (def->channels, sizeof (RecordCollector))) == NULL)
+    return -1;
+
+  flags = MSF_FLUSHDATA;
+  if (def->formatversion == 2)
+    flags |= MSF_PACKVER2;
+
+  /* Pack each channel */
+  for (channel = 0; channel < def->channels; channel++)
+  {
+    for (segment = 0; segment <= def->gaps; segment++)
+    {
+      if ((msr = msr3_init (msr)) == NULL)
+        return -1;
+
+      init_record (msr, corpus, channel, segment);
+
+      if (msr3_pack (msr, collect_record, &channels[channel], &packed, flags, verbose) < 0)
+      {
+        ms_log (2, "%s: Cannot pack records\n", def->name);
+        return -1;
+      }
+
+      msr->datasamples = NULL;
+    }
+  }
+
+  msr3_free (&msr);
+
+  /* Interleave records from each channel */
+  for (channel = 0; channel < def->channels; channel++)
+  {
+    corpus->recordcount += channels[channel].count;
+    corpus->buffersize += channels[channel].length;
+  }
+
+  corpus->buffer  = malloc (corpus->buffersize);
+  corpus->offsets = malloc (corpus->recordcount * sizeof (uint64_t));
+  corpus->lengths = malloc (corpus->recordcount * sizeof (int));
+  corpus->records = calloc (corpus->recordcount, sizeof (MS3Record *));
+
+  if (!corpus->buffer || !corpus->offsets || !corpus->lengths || !corpus->records)
+    return -1;
+
+  for (position = 0, idx = 0; idx < corpus->recordcount; position++)
+  {
+    for (remaining = 0, channel = 0; channel < def->channels; channel++)
+    {
+      RecordCollector *collector = &channels[channel];
+
+      if (position >= collector->count)
+        continue;
+
+      memcpy (corpus->buffer + corpus->bufferlength,
+              collector->buffer + collector->offsets[position], collector->lengths[position]);
+      corpus->offsets[idx] = corpus->bufferlength;
+      corpus->lengths[idx] = collector->lengths[position];
+      corpus->bufferlength += collector->lengths[position];
+      idx++;
+      remaining++;
+    }
+
+    if (!remaining)
+      break;
+  }
+
+  for (channel = 0; channel < def->channels; channel++)
+  {
+    free (channels[channel].buffer);
+    free (channels[channel].offsets);
+    free (channels[channel].lengths);
+  }
+  free (channels);
+
+  /* Parse record headers, referencing the corpus buffer */
+  for (idx = 0; idx < corpus->recordcount; idx++)
+  {
+    if (msr3_parse (corpus->buffer + corpus->offsets[idx], corpus->lengths[idx],
+                    &corpus->records[idx], 0, verbose) != MS_NOERROR)
+    {
+      ms_log (2, "%s: Cannot parse generated record %" PRId64 "\n", def->name, idx);
+      return -1;
+    }
+  }
+
+  /* Trace list with decoded samples for packing */
+  if (mstl3_readbuffer (&corpus->mstl, corpus->buffer, corpus->bufferlength, 0, MSF_UNPACKDATA,
+                        NULL, verbose) != corpus->recordcount)
+  {
+    ms_log (2, "%s: Cannot read generated records into a trace list\n", def->name);
+    return -1;
+  }
+
+  /* Selections matching a quarter of the stations with a time window */
+  for (channel = 0; channel < def->channels; channel += 12)
+  {
+    char pattern[64];
+
+    snprintf (pattern, sizeof (pattern), "FDSN:XX_B%03d_*", channel / 3);
+
+    if (ms3_addselect (&corpus->selections, pattern, MS_EPOCH2NSTIME (1735689600 + 60),
+                       MS_EPOCH2NSTIME (1735689600 + 600), 0))
+      return -1;
+  }
+
+  if (ms3_addselect (&corpus->selections, "FDSN:YY_*_H_H_Z", NSTUNSET, NSTUNSET, 0))
+    return -1;
+
+  return 0;
+}
+
+/***************************************************************************
+ * Free all memory associated with a corpus.
+ ***************************************************************************/
+static void
+free_corpus (CorpusData *corpus)
+{
+  int64_t idx;
+
+  if (corpus->records)
+  {
+    for (idx = 0; idx < corpus->recordcount; idx++)
+      msr3_free (&corpus->records[idx]);
+  }
+
+  mstl3_free (&corpus->mstl, 0);
+  ms3_freeselections (corpus->selections);
+
+  free (corpus->records);
+  free (corpus->buffer);
+  free (corpus->offsets);
+  free (corpus->lengths);
+  free (corpus->isamples);
+  free (corpus->fsamples);
+  free (corpus->dsamples);
+
+  memset (corpus, 0, sizeof (CorpusData));
+}
+
+/***************************************************************************
+ * Benchmarks, each a single pass over a corpus.
+ ***************************************************************************/
+static int64_t
+bench_parse (CorpusData *corpus, uint64_t *bytes)
+{
+  MS3Record *msr = NULL;
+  int64_t idx;
+
+  for (idx = 0; idx < corpus->recordcount; idx++)
+  {
+    if (msr3_parse (corpus->buffer + corpus->offsets[idx], corpus->lengths[idx], &msr, 0, 0))
+      return -1;
+  }
+
+  msr3_free (&msr);
+
+  *bytes = corpus->bufferlength;
+  return corpus->recordcount;
+}
+
+static int64_t
+bench_unpack_data (CorpusData *corpus, uint64_t *bytes)
+{
+  int64_t idx;
+
+  for (idx = 0; idx < corpus->recordcount; idx++)
+  {
+    if (msr3_unpack_data (corpus->records[idx], 0) < 0)
+      return -1;
+  }
+
+  /* Release decoded samples, leaving headers as parsed */
+  for (idx = 0; idx < corpus->recordcount; idx++)
+  {
+    libmseed_memory.free (corpus->records[idx]->datasamples);
+    corpus->records[idx]->datasamples = NULL;
+    corpus->records[idx]->datasize    = 0;
+    corpus->records[idx]->numsamples  = 0;
+  }
+
+  *bytes = corpus->bufferlength;
+  return corpus->recordcount;
+}
+
+static int64_t
+bench_pack (CorpusData *corpus, uint64_t *bytes)
+{
+  MS3Record *msr    = NULL;
+  uint64_t counts[2] = {0, 0};
+  uint32_t flags    = MSF_FLUSHDATA;
+  int64_t packed;
+  int channel;
+  int segment;
+
+  if (corpus->def->formatversion == 2)
+    flags |= MSF_PACKVER2;
+
+  for (channel = 0; channel < corpus->def->channels; channel++)
+  {
+    for (segment = 0; segment <= corpus->def->gaps; segment++)
+    {
+      if ((msr = msr3_init (msr)) == NULL)
+        return -1;
+
+      init_record (msr, corpus, channel, segment);
+
+      if (msr3_pack (msr, count_record, counts, &packed, flags, 0) < 0)
+        return -1;
+
+      msr->datasamples = NULL;
+    }
+  }
+
+  msr3_free (&msr);
+
+  *bytes = counts[1];
+  return (int64_t)counts[0];
+}
+
+static int64_t
+bench_crc32c (CorpusData *corpus, uint64_t *bytes)
+{
+  volatile uint32_t crc = 0;
+  int64_t idx;
+
+  for (idx = 0; idx < corpus->recordcount; idx++)
+    crc ^= ms_crc32c ((uint8_t *)corpus->buffer + corpus->offsets[idx], corpus->lengths[idx], 0);
+
+  *bytes = corpus->bufferlength;
+  return corpus->recordcount;
+}
+
+static int64_t
+bench_addmsr (CorpusData *corpus, uint64_t *bytes)
+{
+  MS3TraceList *mstl;
+  int64_t idx;
+
+  if ((mstl = mstl3_init (NULL)) == NULL)
+    return -1;
+
+  for (idx = 0; idx < corpus->recordcount; idx++)
+  {
+    if (mstl3_addmsr (mstl, corpus->records[idx], 0, 1, 0, NULL) == NULL)
+      return -1;
+  }
+
+  mstl3_free (&mstl, 0);
+
+  *bytes = corpus->bufferlength;
+  return corpus->recordcount;
+}
+
+static int64_t
+bench_matchselect (CorpusData *corpus, uint64_t *bytes)
+{
+  volatile int64_t matches = 0;
+  MS3Record *msr;
+  int64_t idx;
+
+  for (idx = 0; idx < corpus->recordcount; idx++)
+  {
+    msr = corpus->records[idx];
+
+    if (ms3_matchselect (corpus->selections, msr->sid, msr->starttime, msr3_endtime (msr),
+                         msr->pubversion, NULL))
+      matches++;
+  }
+
+  *bytes = corpus->bufferlength;
+  return corpus->recordcount;
+}
+
+static int64_t
+bench_mstl3_pack (CorpusData *corpus, uint64_t *bytes)
+{
+  uint64_t counts[2] = {0, 0};
+  uint32_t flags    = MSF_FLUSHDATA | MSF_MAINTAINMSTL;
+  int64_t packed;
+
+  if (corpus->def->formatversion == 2)
+    flags |= MSF_PACKVER2;
+
+  if (mstl3_pack (corpus->mstl, count_record, counts, corpus->def->reclen, corpus->def->encoding,
+                  &packed, flags, 0, NULL) < 0)
+    return -1;
+
+  *bytes = counts[1];
+  return (int64_t)counts[0];
+}
+
+static const struct
+{
+  const char *name;
+  BenchFunction function;
+} benchmarks[] = {
+    {"msr3_parse", bench_parse},
+    {"msr3_unpack_data", bench_unpack_data},
+    {"msr3_pack", bench_pack},
+    {"ms_crc32c", bench_crc32c},
+    {"mstl3_addmsr", bench_addmsr},
+    {"ms3_matchselect", bench_matchselect},
+    {"mstl3_pack", bench_mstl3_pack},
+};
+#define BENCHMARK_COUNT (int)(sizeof (benchmarks) / sizeof (benchmarks[0]))
+
+/***************************************************************************
+ * Run a benchmark repeatedly for at least the minimum time and print
+ * the result as a JSON object, rates are derived from the fastest pass.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+run_benchmark (CorpusData *corpus, int bench)
+{
+  const BenchCorpus *def = corpus->def;
+  double start;
+  double elapsed;
+  double total   = 0.0;
+  double fastest = 0.0;
+  uint64_t bytes = 0;
+  int64_t records = 0;
+  int64_t iterations = 0;
+
+  /* Warm up */
+  if (benchmarks[bench].function (corpus, &bytes) < 0)
+  {
+    ms_log (2, "%s: %s failed\n", def->name, benchmarks[bench].name);
+    return -1;
+  }
+
+  while (total < mintime || iterations < 3)
+  {
+    start   = bench_now ();
+    records = benchmarks[bench].function (corpus, &bytes);
+    elapsed = bench_now () - start;
+
+    if (records < 0)
+    {
+      ms_log (2, "%s: %s failed\n", def->name, benchmarks[bench].name);
+      return -1;
+    }
+
+    if (iterations == 0 || elapsed < fastest)
+      fastest = elapsed;
+
+    total += elapsed;
+    iterations++;
+  }
+
+  if (fastest <= 0.0)
+    fastest = 1e-9;
+
+  printf ("{\"benchmark\":\"%s\",\"corpus\":\"%s\",\"format\":%d,\"encoding\":%d,"
+          "\"reclen\":%d,\"channels\":%d,\"gaps\":%d,\"iterations\":%" PRId64
+          ",\"records\":%" PRId64 ",\"bytes\":%" PRIu64 ",\"seconds\":%.9f,"
+          "\"mean_seconds\":%.9f,\"records_per_sec\":%.1f,\"mb_per_sec\":%.3f}\n",
+          benchmarks[bench].name, def->name, def->formatversion, def->encoding, def->reclen,
+          def->channels, def->gaps, iterations, records, bytes, fastest, total / iterations,
+          records / fastest, bytes / fastest / 1e6);
+  fflush (stdout);
+
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  CorpusData corpus;
+  int idx;
+  int bench;
+  int rv = 0;
+
+  /* Process command line arguments */
+  if (parameter_proc (argc, argv) < 0)
+    return -1;
+
+  printf ("{\"library\":\"%s\",\"release\":\"%s\",\"samples\":%" PRId64 ",\"mintime\":%g}\n",
+          LIBMSEED_VERSION, LIBMSEED_RELEASE, samplecount, mintime);
+
+  for (idx = 0; idx < CORPUS_COUNT && rv == 0; idx++)
+  {
+    if (corpusmatch && !strstr (corpora[idx].name, corpusmatch))
+      continue;
+
+    if (verbose)
+      ms_log (0, "Generating corpus %s\n", corpora[idx].name);
+
+    if (generate_corpus (&corpus, &corpora[idx]))
+    {
+      ms_log (2, "Cannot generate corpus %s\n", corpora[idx].name);
+      free_corpus (&corpus);
+      return 1;
+    }
+
+    for (bench = 0; bench < BENCHMARK_COUNT && rv == 0; bench++)
+    {
+      if (benchmatch && !strstr (benchmarks[bench].name, benchmatch))
+        continue;
+
+      rv = run_benchmark (&corpus, bench);
+    }
+
+    free_corpus (&corpus);
+  }
+
+  return (rv) ? 1 : 0;
+}
+
+/***************************************************************************
+ * parameter_proc():
+ * Process the command line parameters.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+parameter_proc (int argcount, char **argvec)
+{
+  int optind;
+
+  /* Process all command line arguments */
+  for (optind = 1; optind < argcount; optind++)
+  {
+    if (strcmp (argvec[optind], "-V") == 0)
+    {
+      ms_log (1, "%s version: %s\n", PACKAGE, VERSION);
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-h") == 0)
+    {
+      usage ();
+      exit (0);
+    }
+    else if (strncmp (argvec[optind], "-v", 2) == 0)
+    {
+      verbose += strspn (&argvec[optind][1], "v");
+    }
+    else if (strcmp (argvec[optind], "-t") == 0 && optind + 1 < argcount)
+    {
+      mintime = strtod (argvec[++optind], NULL);
+    }
+    else if (strcmp (argvec[optind], "-n") == 0 && optind + 1 < argcount)
+    {
+      samplecount = strtoll (argvec[++optind], NULL, 10);
+    }
+    else if (strcmp (argvec[optind], "-b") == 0 && optind + 1 < argcount)
+    {
+      benchmatch = argvec[++optind];
+    }
+    else if (strcmp (argvec[optind], "-c") == 0 && optind + 1 < argcount)
+    {
+      corpusmatch = argvec[++optind];
+    }
+    else
+    {
+      ms_log (2, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+  }
+
+  if (mintime < 0.0 || samplecount < 1000)
+  {
+    ms_log (2, "Minimum time must be positive and sample count at least 1000\n");
+    return -1;
+  }
+
+  return 0;
+} /* End of parameter_proc() */
+
+/***************************************************************************
+ * usage():
+ * Print the usage message.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s - %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Usage: %s [options]\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -V             Report program version\n"
+           " -h             Show this usage message\n"
+           " -v             Be more verbose, multiple flags can be used\n"
+           " -t seconds     Minimum run time per benchmark, default 0.5\n"
+           " -n samples     Samples per channel in each corpus, default 100000\n"
+           " -b match       Only run benchmarks with names containing match\n"
+           " -c match       Only use corpora with names containing match\n"
+           "\n"
+           "Results are printed as JSON Lines: a header object followed by one\n"
+           "object per benchmark and corpus.  Rates are from the fastest pass.\n");
+} /* End of usage() */
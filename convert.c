@@ -0,0 +1,733 @@
+/***************************************************************************
+ * Conversion of miniSEED 2 records to miniSEED 3 without decoding data.
+ *
+ * Records of an input buffer are located from their lengths and divided
+ * into contiguous slices converted by a pool of threads.  The fixed
+ * header and blockettes of each version 2 record are translated to a
+ * version 3 header and extra headers and the encoded data payload is
+ * copied unchanged, so no samples are decoded or encoded.  Converted
+ * records are returned in input order.
+ *
+ * Converted records are placed at aligned offsets of the output buffer
+ * of a slice, as header fields are stored directly in the records.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2024 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmseed.h"
+#include "mseedformat.h"
+#include "internalstate.h"
+
+/* Minimum count of records converted by each thread */
+#define LM_CONVERT_MINRECORDS 16
+
+/* Size of input chunks read by ms3_convert_file(), at least MAXRECLEN */
+#define LM_CONVERT_CHUNKSIZE (16 * 1024 * 1024)
+
+/* Offset of converted records in slice output, aligned for header fields */
+#define LM_CONVERT_ALIGN(OFFSET) (((OFFSET) + 7) & ~(size_t)7)
+
+/* Records of an input buffer converted by one thread */
+typedef struct LM_CONVERTSLICE
+{
+  const char *input;
+  const uint64_t *offsets; /* Input record offsets, shared by all slices */
+  const int32_t *lengths;  /* Input record lengths, shared by all slices */
+  int32_t *outlengths;     /* Converted record lengths, shared by all slices */
+  int64_t first;           /* Index of first record of slice */
+  int64_t count;           /* Count of records in slice */
+  char *output;            /* Converted records */
+  size_t outputlength;
+  size_t outputmax;
+  uint32_t flags;
+  int8_t verbose;
+  int retcode;
+} LM_CONVERTSLICE;
+
+/* State for writing converted records to a file */
+typedef struct LM_CONVERTFILE
+{
+  FILE *output;
+  int error;
+} LM_CONVERTFILE;
+
+/***************************************************************************
+ * Align the output length of a slice for the next record and grow the
+ * output buffer of the slice to hold at least 'needed' more bytes.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+grow_output (LM_CONVERTSLICE *slice, size_t needed)
+{
+  char *output;
+  size_t outputmax;
+
+  slice->outputlength = LM_CONVERT_ALIGN (slice->outputlength);
+
+  if (slice->outputlength + needed <= slice->outputmax)
+    return 0;
+
+  outputmax = slice->outputmax * 2;
+  if (outputmax < slice->outputlength + needed)
+    outputmax = slice->outputlength + needed;
+
+  if ((output = (char *)libmseed_memory.realloc (slice->output, outputmax)) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    return -1;
+  }
+
+  slice->output = output;
+  slice->outputmax = outputmax;
+
+  return 0;
+} /* End of grow_output() */
+
+/***************************************************************************
+ * Reorder the payload of a repacked miniSEED 3 record to the byte order
+ * of the version 3 format, Steim frames are big-endian and all other
+ * encodings little-endian, if the original payload is in the other order,
+ * and update the CRC.  Version 2 payloads may be in either order.  Words
+ * of Steim frames are swapped according to the sizes of their differences.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+swap_payload (const MS3Record *msr, char *record, int reclen)
+{
+  uint32_t dataoffset;
+  uint32_t crc;
+  int wordsize;
+  int bigendian;
+  int bigendianv3 = 0;
+  int8_t swapflag;
+  uint32_t nibbles = 0;
+  uint32_t nibble;
+  char *word;
+  char byte;
+
+  switch (msr->encoding)
+  {
+  case DE_STEIM1:
+  case DE_STEIM2:
+    wordsize = 4;
+    bigendianv3 = 1;
+    break;
+  case DE_INT16:
+  case DE_GEOSCOPE163:
+  case DE_GEOSCOPE164:
+  case DE_CDSN:
+  case DE_SRO:
+  case DE_DWWSSN:
+    wordsize = 2;
+    break;
+  case DE_GEOSCOPE24:
+    wordsize = 3;
+    break;
+  case DE_INT32:
+  case DE_FLOAT32:
+    wordsize = 4;
+    break;
+  case DE_FLOAT64:
+    wordsize = 8;
+    break;
+  default:
+    return 0;
+  }
+
+  /* Original payload order is that of the host unless it needs swapping */
+  bigendian = (ms_bigendianhost ()) ? !(msr->swapflag & MSSWAP_PAYLOAD)
+                                    : (msr->swapflag & MSSWAP_PAYLOAD) != 0;
+
+  if (bigendian == bigendianv3)
+    return 0;
+
+  dataoffset = MS3FSDH_LENGTH + (uint32_t)strlen (msr->sid) + msr->extralength;
+
+  if (dataoffset > (uint32_t)reclen)
+  {
+    ms_log (2, "%s: Data offset value is not valid: %u\n", msr->sid, dataoffset);
+    return -1;
+  }
+
+  for (word = record + dataoffset; word + wordsize <= record + reclen; word += wordsize)
+  {
+    /* Steim frames: nibbles determine the difference sizes of each word */
+    if (bigendianv3)
+    {
+      if ((word - (record + dataoffset)) % 64 == 0)
+      {
+        ms_gswap4 (word);
+        nibbles = ((uint32_t)(uint8_t)word[0] << 24) | ((uint32_t)(uint8_t)word[1] << 16) |
+                  ((uint32_t)(uint8_t)word[2] << 8) | (uint32_t)(uint8_t)word[3];
+        continue;
+      }
+
+      nibble = (nibbles >> (30 - 2 * (((word - (record + dataoffset)) % 64) / 4))) & 0x3;
+
+      /* 4 x 8-bit differences are in byte order */
+      if (nibble == 1)
+        continue;
+
+      /* 2 x 16-bit differences of Steim-1 */
+      if (nibble == 2 && msr->encoding == DE_STEIM1)
+      {
+        ms_gswap2 (word);
+        ms_gswap2 (word + 2);
+        continue;
+      }
+    }
+
+    if (wordsize == 2)
+      ms_gswap2 (word);
+    else if (wordsize == 4)
+      ms_gswap4 (word);
+    else if (wordsize == 8)
+      ms_gswap8 (word);
+    else
+    {
+      byte = word[0];
+      word[0] = word[2];
+      word[2] = byte;
+    }
+  }
+
+  swapflag = (ms_bigendianhost ()) ? 1 : 0;
+
+  memset (pMS3FSDH_CRC (record), 0, sizeof (uint32_t));
+  crc = ms_crc32c ((const uint8_t *)record, reclen, 0);
+  *pMS3FSDH_CRC (record) = HO4u (crc, swapflag);
+
+  return 0;
+} /* End of swap_payload() */
+
+/***************************************************************************
+ * Convert the records of a slice to miniSEED 3 in the output buffer of
+ * the slice.  Version 2 records are parsed, without decoding samples,
+ * and repacked with the encoded payload.  Version 3 records are copied.
+ ***************************************************************************/
+static void
+convert_slice (void *data)
+{
+  LM_CONVERTSLICE *slice = (LM_CONVERTSLICE *)data;
+  MS3Record *msr = NULL;
+  const char *record;
+  int64_t idx;
+  int32_t reclen;
+  int rv;
+
+  for (idx = slice->first; idx < slice->first + slice->count; idx++)
+  {
+    record = slice->input + slice->offsets[idx];
+    reclen = slice->lengths[idx];
+
+    if (MS3_ISVALIDHEADER (record))
+    {
+      if ((slice->flags & MSF_VALIDATECRC) &&
+          (rv = msr3_parse (record, reclen, &msr, MSF_VALIDATECRC, slice->verbose)) != MS_NOERROR)
+      {
+        ms_log (2, "Cannot validate record at byte offset %" PRIu64 ": %s\n",
+                slice->offsets[idx], ms_errorstr (rv));
+        slice->retcode = MS_GENERROR;
+        break;
+      }
+
+      if (grow_output (slice, reclen))
+      {
+        slice->retcode = MS_GENERROR;
+        break;
+      }
+
+      memcpy (slice->output + slice->outputlength, record, reclen);
+      slice->outlengths[idx] = reclen;
+      slice->outputlength += reclen;
+      continue;
+    }
+
+    /* The record length is known, as if at the end of a file */
+    if (msr3_parse (record, reclen, &msr, MSF_ATENDOFFILE, slice->verbose) != MS_NOERROR)
+    {
+      ms_log (2, "Cannot parse record at byte offset %" PRIu64 "\n", slice->offsets[idx]);
+      slice->retcode = MS_GENERROR;
+      break;
+    }
+
+    /* Fallback encoding when decoding records without a 1000 blockette */
+    if (msr->encoding < 0)
+      msr->encoding = DE_STEIM1;
+
+    /* Header, extra headers and payload, the payload is within the input record */
+    if (grow_output (slice, MS3FSDH_LENGTH + strlen (msr->sid) + msr->extralength + reclen))
+    {
+      slice->retcode = MS_GENERROR;
+      break;
+    }
+
+    rv = msr3_repack_mseed3 (msr, slice->output + slice->outputlength,
+                             (uint32_t)(slice->outputmax - slice->outputlength), slice->verbose);
+
+    if (rv < 0)
+    {
+      slice->retcode = MS_GENERROR;
+      break;
+    }
+
+    /* Byte order of the payload is fixed in miniSEED 3 */
+    if (swap_payload (msr, slice->output + slice->outputlength, rv))
+    {
+      slice->retcode = MS_GENERROR;
+      break;
+    }
+
+    slice->outlengths[idx] = rv;
+    slice->outputlength += rv;
+  }
+
+  msr3_free (&msr);
+} /* End of convert_slice() */
+
+/** ************************************************************************
+ * @brief Convert a buffer of miniSEED 2 records to miniSEED 3
+ *
+ * Convert the records in @p input to miniSEED 3 without decoding the
+ * data samples.  The fixed header and blockettes of each version 2
+ * record are translated to a version 3 header and extra headers, as
+ * for msr3_repack_mseed3(), and the encoded data payload is copied
+ * unchanged.  Version 3 records are passed through.
+ *
+ * The records are divided among up to @p threads threads, each
+ * converting a contiguous range of records.  Converted records are
+ * passed to @p record_handler() in input order after all records of
+ * the buffer are converted.  The handler is called with 1) a @c char*
+ * to the record, 2) the length of the record and 3) @p handlerdata.
+ *
+ * The buffer may end with an incomplete record, allowing a stream to
+ * be converted in arbitrary pieces: the number of bytes of complete
+ * records is returned at @p consumed and the remainder should be
+ * included at the start of the next buffer.  When ::MSF_ATENDOFFILE is
+ * set in @p flags the buffer is the end of the input and a trailing
+ * incomplete record is an error.  A version 2 record without a 1000
+ * blockette is only converted if followed by another record or at the
+ * end of the input.
+ *
+ * @param[in] input Buffer of miniSEED records
+ * @param[in] inputsize Length of @p input in bytes
+ * @param[in] record_handler() Callback function called for each converted record
+ * @param[in] handlerdata A pointer that will be provided to the @p record_handler()
+ * @param[out] consumed Bytes of @p input converted, can be NULL
+ * @param[in] flags Flags to control conversion:
+ * @parblock
+ *  - @c ::MSF_SKIPNOTDATA : Skip input that cannot be identified as miniSEED
+ *  - @c ::MSF_VALIDATECRC : Validate CRC of version 3 input records
+ *  - @c ::MSF_ATENDOFFILE : Buffer is the end of the input
+ * @endparblock
+ * @param[in] threads Number of converting threads, 0 for the number of processors
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns the number of records converted on success, otherwise a
+ * (negative) libmseed error code.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_convert_file()
+ * @see msr3_repack_mseed3()
+ ***************************************************************************/
+int64_t
+ms3_convert_buffer (const char *input, uint64_t inputsize,
+                    void (*record_handler) (char *, int, void *), void *handlerdata,
+                    uint64_t *consumed, uint32_t flags, int threads, int8_t verbose)
+{
+  LM_CONVERTSLICE *slices = NULL;
+  uint64_t *offsets = NULL;
+  uint64_t *newoffsets;
+  int32_t *lengths = NULL;
+  int32_t *newlengths;
+  int32_t *outlengths = NULL;
+  int64_t recordcount = 0;
+  int64_t recordmax = 0;
+  int64_t idx;
+  int64_t reclen;
+  uint64_t offset = 0;
+  uint64_t remaining;
+  size_t position;
+  uint8_t formatversion;
+  int retcode = MS_NOERROR;
+  int slicecount;
+  int slice;
+#if !defined(LIBMSEED_NO_THREADING)
+  lm_thread_t *workers = NULL;
+  int started = 0;
+#endif
+
+  if (consumed)
+    *consumed = 0;
+
+  if (!input || !record_handler)
+  {
+    ms_log (2, "%s(): Required input not defined: 'input' or 'record_handler'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  /* Locate complete records */
+  while (offset < inputsize)
+  {
+    remaining = inputsize - offset;
+    reclen = ms3_detect (input + offset, remaining, &formatversion);
+
+    /* Length of a version 2 record without a 1000 blockette is determined by
+     * the next record, or it extends to the end of the input */
+    if (reclen == 0)
+    {
+      if (flags & MSF_ATENDOFFILE)
+      {
+        reclen = (int64_t)remaining;
+      }
+      else if (remaining >= MAXRECLENv2)
+      {
+        ms_log (2, "Cannot determine record length at byte offset %" PRIu64 "\n", offset);
+        retcode = MS_GENERROR;
+        break;
+      }
+    }
+
+    /* Incomplete record at end of buffer */
+    if (reclen > (int64_t)remaining || reclen == 0 || (reclen < 0 && remaining < MINRECLEN))
+    {
+      if (!(flags & MSF_ATENDOFFILE))
+        break;
+
+      if (flags & MSF_SKIPNOTDATA)
+      {
+        offset = inputsize;
+        break;
+      }
+
+      ms_log (2, "Truncated record at byte offset %" PRIu64 "\n", offset);
+      retcode = MS_GENERROR;
+      break;
+    }
+
+    if (reclen < MINRECLEN || reclen > MAXRECLEN)
+    {
+      if (flags & MSF_SKIPNOTDATA)
+      {
+        offset++;
+        continue;
+      }
+
+      ms_log (2, "Cannot identify miniSEED record at byte offset %" PRIu64 "\n", offset);
+      retcode = MS_NOTSEED;
+      break;
+    }
+
+    if (recordcount >= recordmax)
+    {
+      recordmax = (recordmax) ? recordmax * 2 : 1024;
+
+      /* Keep the current arrays, freed below, if either cannot be grown */
+      if ((newoffsets = (uint64_t *)libmseed_memory.realloc (offsets, recordmax *
+                                                             sizeof (uint64_t))) != NULL)
+        offsets = newoffsets;
+
+      if (newoffsets == NULL ||
+          (newlengths = (int32_t *)libmseed_memory.realloc (lengths, recordmax *
+                                                            sizeof (int32_t))) == NULL)
+      {
+        ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+        retcode = MS_GENERROR;
+        break;
+      }
+
+      lengths = newlengths;
+    }
+
+    offsets[recordcount] = offset;
+    lengths[recordcount] = (int32_t)reclen;
+    recordcount++;
+    offset += reclen;
+  }
+
+  if (retcode != MS_NOERROR || recordcount == 0)
+  {
+    libmseed_memory.free (offsets);
+    libmseed_memory.free (lengths);
+
+    if (retcode == MS_NOERROR && consumed)
+      *consumed = offset;
+
+    return (retcode == MS_NOERROR) ? 0 : retcode;
+  }
+
+  /* Divide records into slices of at least LM_CONVERT_MINRECORDS */
+#if !defined(LIBMSEED_NO_THREADING)
+  if (threads <= 0)
+    threads = lm_cpucount ();
+#else
+  threads = 1;
+#endif
+  slicecount = (int)((recordcount + LM_CONVERT_MINRECORDS - 1) / LM_CONVERT_MINRECORDS);
+  if (slicecount > threads)
+    slicecount = threads;
+  if (slicecount < 1)
+    slicecount = 1;
+
+  outlengths = (int32_t *)libmseed_memory.malloc (recordcount * sizeof (int32_t));
+  slices = (LM_CONVERTSLICE *)libmseed_memory.malloc (slicecount * sizeof (LM_CONVERTSLICE));
+
+  if (!outlengths || !slices)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    libmseed_memory.free (outlengths);
+    libmseed_memory.free (slices);
+    libmseed_memory.free (offsets);
+    libmseed_memory.free (lengths);
+    return MS_GENERROR;
+  }
+
+  memset (slices, 0, slicecount * sizeof (LM_CONVERTSLICE));
+
+  for (slice = 0; slice < slicecount; slice++)
+  {
+    slices[slice].input = input;
+    slices[slice].offsets = offsets;
+    slices[slice].lengths = lengths;
+    slices[slice].outlengths = outlengths;
+    slices[slice].first = recordcount * slice / slicecount;
+    slices[slice].count = recordcount * (slice + 1) / slicecount - slices[slice].first;
+    slices[slice].flags = flags;
+    slices[slice].verbose = verbose;
+    slices[slice].retcode = MS_NOERROR;
+  }
+
+#if !defined(LIBMSEED_NO_THREADING)
+  /* Start threads for all but the first slice, the calling thread converts it */
+  if (slicecount > 1 &&
+      (workers = (lm_thread_t *)libmseed_memory.malloc ((slicecount - 1) *
+                                                        sizeof (lm_thread_t))) != NULL)
+  {
+    for (started = 0; started < slicecount - 1; started++)
+    {
+      if (lm_thread_create (&workers[started], convert_slice, &slices[started + 1]))
+        break;
+    }
+  }
+
+  convert_slice (&slices[0]);
+
+  /* Convert slices for which no thread was started */
+  for (slice = started + 1; slice < slicecount; slice++)
+    convert_slice (&slices[slice]);
+
+  for (slice = 0; slice < started; slice++)
+    lm_thread_join (workers[slice]);
+
+  libmseed_memory.free (workers);
+#else
+  for (slice = 0; slice < slicecount; slice++)
+    convert_slice (&slices[slice]);
+#endif
+
+  for (slice = 0; slice < slicecount; slice++)
+  {
+    if (slices[slice].retcode != MS_NOERROR)
+      retcode = slices[slice].retcode;
+  }
+
+  /* Pass converted records to handler in input order */
+  for (slice = 0; slice < slicecount && retcode == MS_NOERROR; slice++)
+  {
+    position = 0;
+
+    for (idx = slices[slice].first; idx < slices[slice].first + slices[slice].count; idx++)
+    {
+      position = LM_CONVERT_ALIGN (position);
+      record_handler (slices[slice].output + position, outlengths[idx], handlerdata);
+      position += outlengths[idx];
+    }
+  }
+
+  for (slice = 0; slice < slicecount; slice++)
+    libmseed_memory.free (slices[slice].output);
+
+  libmseed_memory.free (slices);
+  libmseed_memory.free (outlengths);
+  libmseed_memory.free (offsets);
+  libmseed_memory.free (lengths);
+
+  if (retcode != MS_NOERROR)
+    return retcode;
+
+  if (verbose)
+    ms_log (0, "Converted %" PRId64 " records of %" PRIu64 " bytes\n", recordcount, offset);
+
+  if (consumed)
+    *consumed = offset;
+
+  return recordcount;
+} /* End of ms3_convert_buffer() */
+
+/***************************************************************************
+ * Write a converted record to the output file of the conversion.
+ ***************************************************************************/
+static void
+write_record (char *record, int reclen, void *data)
+{
+  LM_CONVERTFILE *file = (LM_CONVERTFILE *)data;
+
+  if (!file->error && fwrite (record, 1, (size_t)reclen, file->output) != (size_t)reclen)
+    file->error = 1;
+} /* End of write_record() */
+
+/** ************************************************************************
+ * @brief Convert a file of miniSEED 2 records to miniSEED 3
+ *
+ * Read @p inputfile in large chunks, convert the records of each chunk
+ * with ms3_convert_buffer() using up to @p threads threads and write
+ * the miniSEED 3 records to @p outputfile in input order.  Data samples
+ * are not decoded, the encoded payloads are copied unchanged.
+ *
+ * If @p inputfile is "-" input is read from stdin, and if @p outputfile
+ * is "-" output is written to stdout.
+ *
+ * @param[in] inputfile File of miniSEED records to convert
+ * @param[in] outputfile File to write miniSEED 3 records to, created or truncated
+ * @param[in] flags Flags as for ms3_convert_buffer(), ::MSF_ATENDOFFILE is set internally
+ * @param[in] threads Number of converting threads, 0 for the number of processors
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns the number of records converted on success, otherwise a
+ * (negative) libmseed error code.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_convert_buffer()
+ ***************************************************************************/
+int64_t
+ms3_convert_file (const char *inputfile, const char *outputfile, uint32_t flags, int threads,
+                  int8_t verbose)
+{
+  LM_CONVERTFILE file = {NULL, 0};
+  FILE *input = NULL;
+  char *buffer = NULL;
+  size_t bufferlength = 0;
+  size_t readcount;
+  uint64_t consumed;
+  int64_t records;
+  int64_t total = 0;
+  int atend = 0;
+
+  if (!inputfile || !outputfile)
+  {
+    ms_log (2, "%s(): Required input not defined: 'inputfile' or 'outputfile'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  if (strcmp (inputfile, "-") == 0)
+    input = stdin;
+  else if ((input = fopen (inputfile, "rb")) == NULL)
+  {
+    ms_log (2, "Cannot open input file %s: %s\n", inputfile, strerror (errno));
+    return MS_GENERROR;
+  }
+
+  if (strcmp (outputfile, "-") == 0)
+    file.output = stdout;
+  else if ((file.output = fopen (outputfile, "wb")) == NULL)
+  {
+    ms_log (2, "Cannot open output file %s: %s\n", outputfile, strerror (errno));
+    if (input != stdin)
+      fclose (input);
+    return MS_GENERROR;
+  }
+
+  if ((buffer = (char *)libmseed_memory.malloc (LM_CONVERT_CHUNKSIZE)) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    total = MS_GENERROR;
+  }
+
+  while (buffer && !atend)
+  {
+    /* Fill buffer after any incomplete record carried over */
+    readcount = fread (buffer + bufferlength, 1, LM_CONVERT_CHUNKSIZE - bufferlength, input);
+    bufferlength += readcount;
+
+    if (ferror (input))
+    {
+      ms_log (2, "Cannot read input file %s: %s\n", inputfile, strerror (errno));
+      total = MS_GENERROR;
+      break;
+    }
+
+    atend = (bufferlength < LM_CONVERT_CHUNKSIZE) ? 1 : 0;
+
+    records = ms3_convert_buffer (buffer, bufferlength, write_record, &file, &consumed,
+                                  (atend) ? flags | MSF_ATENDOFFILE : flags, threads, verbose);
+
+    if (records < 0)
+    {
+      total = records;
+      break;
+    }
+
+    if (file.error)
+    {
+      ms_log (2, "Cannot write output file %s: %s\n", outputfile, strerror (errno));
+      total = MS_GENERROR;
+      break;
+    }
+
+    if (!atend && consumed == 0)
+    {
+      ms_log (2, "Cannot find a complete record in %d bytes of %s\n", LM_CONVERT_CHUNKSIZE,
+              inputfile);
+      total = MS_GENERROR;
+      break;
+    }
+
+    total += records;
+
+    memmove (buffer, buffer + consumed, bufferlength - consumed);
+    bufferlength -= consumed;
+  }
+
+  libmseed_memory.free (buffer);
+
+  if (input != stdin)
+    fclose (input);
+
+  if (file.output != stdout)
+  {
+    if (fclose (file.output) && total >= 0)
+    {
+      ms_log (2, "Cannot close output file %s: %s\n", outputfile, strerror (errno));
+      total = MS_GENERROR;
+    }
+  }
+  else if (fflush (stdout) && total >= 0)
+  {
+    total = MS_GENERROR;
+  }
+
+  return total;
+} /* End of ms3_convert_file() */
@@ -22,6 +22,7 @@
 */
 
 #include "libmseed.h"
+#include "internalstate.h"
 
 /* The Castagnoli, iSCSI CRC32c polynomial (reverse of 0x1EDC6F41) */
 #define CRC32C_POLYNOMIAL 0x82F63B78
@@ -400,11 +401,19 @@ static uint32_t s_crc32c_sb8(const uint8_t *input, int length, uint32_t previous
 uint32_t
 ms_crc32c (const uint8_t* input, int length, uint32_t previousCRC32C)
 {
+  uint32_t crc;
+
   if (!input || length <= 0)
     return 0;
 
+  LM_METRIC_START (metricstart);
+
   if (ms_bigendianhost())
-    return s_crc32c_no_slice(input, length, previousCRC32C);
+    crc = s_crc32c_no_slice(input, length, previousCRC32C);
   else
-    return s_crc32c_sb8(input, length, previousCRC32C);
+    crc = s_crc32c_sb8(input, length, previousCRC32C);
+
+  LM_METRIC_STOP (lm_metrics.crc, metricstart);
+
+  return crc;
 } /* End of ms_crc32c() */
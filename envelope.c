@@ -0,0 +1,978 @@
+/***************************************************************************
+ * Multi-resolution min/max envelopes of continuous data samples.
+ *
+ * An envelope holds the minimum and maximum sample value of fixed size
+ * buckets of samples at a base level, and of buckets twice the size of
+ * the previous level at each following level, up to a single bucket
+ * covering all samples.  Samples may be appended incrementally, only
+ * the buckets covering new samples are updated.  A plot of any time
+ * window is then produced in time proportional to the number of pixels
+ * instead of the number of samples.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2024 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmseed.h"
+#include "internalstate.h"
+
+/* Default samples per bucket at the base level */
+#define LM_ENVELOPE_BUCKET 64
+
+/* Maximum number of levels, more than enough for any sample count */
+#define LM_ENVELOPE_MAXLEVELS 64
+
+/* Maximum samples decoded at once from a record list */
+#define LM_ENVELOPE_CHUNK 65536
+
+/* Envelope file signature, format version and header length */
+#define LM_ENVELOPE_MAGIC "MSEV"
+#define LM_ENVELOPE_FORMAT 1
+#define LM_ENVELOPE_HEADERLEN 40
+
+/* Buckets of one level */
+typedef struct LM_ENVLEVEL
+{
+  int64_t bucketcnt; /* Number of buckets */
+  int64_t allocated; /* Number of buckets allocated */
+  double *min;       /* Minimum sample value of each bucket */
+  double *max;       /* Maximum sample value of each bucket */
+} LM_ENVLEVEL;
+
+struct MS3Envelope
+{
+  nstime_t starttime;     /* Time of first sample */
+  double samprate;        /* Sample rate in Hz */
+  char sampletype;        /* Sample type of the source samples */
+  uint32_t bucketsamples; /* Samples per bucket at level 0, a power of 2 */
+  int bucketshift;        /* Base 2 logarithm of bucketsamples */
+  int64_t samplecnt;      /* Number of samples included */
+  int levelcnt;           /* Number of levels populated */
+  LM_ENVLEVEL levels[LM_ENVELOPE_MAXLEVELS];
+};
+
+static void lm_envelope_minmax (const void *samples, int64_t offset, int64_t count,
+                                char sampletype, double *min, double *max);
+static int lm_envelope_grow (LM_ENVLEVEL *level, int64_t bucketcnt);
+static int64_t lm_envelope_index (const MS3Envelope *env, nstime_t time, int8_t roundup);
+
+/** ************************************************************************
+ * @brief Initialize a multi-resolution min/max envelope
+ *
+ * Samples are added with ms3_envelope_append() or from a trace segment
+ * with mstl3_envelope_update().  The minimum and maximum of each bucket
+ * of @p bucketsamples samples are kept at level 0, and of buckets of
+ * twice as many samples at each following level, until a level has a
+ * single bucket.
+ *
+ * The envelope should be freed with ms3_envelope_free() when done.
+ *
+ * @param[in] starttime Time of the first sample
+ * @param[in] samprate Sample rate in Hz
+ * @param[in] sampletype Sample type, one of @c 'i', @c 'f' or @c 'd', see @ref sample-types
+ * @param[in] bucketsamples Samples per bucket at level 0, a power of 2, or 0 for the default of 64
+ *
+ * @returns An allocated ::MS3Envelope on success or NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+MS3Envelope *
+ms3_envelope_init (nstime_t starttime, double samprate, char sampletype, uint32_t bucketsamples)
+{
+  MS3Envelope *env = NULL;
+
+  if (samprate <= 0.0)
+  {
+    ms_log (2, "%s(): Sample rate must be positive: %g\n", __func__, samprate);
+    return NULL;
+  }
+
+  if (sampletype != 'i' && sampletype != 'f' && sampletype != 'd')
+  {
+    ms_log (2, "%s(): Unsupported sample type: '%c'\n", __func__, sampletype);
+    return NULL;
+  }
+
+  if (bucketsamples == 0)
+    bucketsamples = LM_ENVELOPE_BUCKET;
+
+  if (bucketsamples & (bucketsamples - 1))
+  {
+    ms_log (2, "%s(): Bucket samples must be a power of 2: %u\n", __func__, bucketsamples);
+    return NULL;
+  }
+
+  if ((env = (MS3Envelope *)libmseed_memory.malloc (sizeof (MS3Envelope))) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    return NULL;
+  }
+
+  memset (env, 0, sizeof (MS3Envelope));
+  env->starttime = starttime;
+  env->samprate = samprate;
+  env->sampletype = sampletype;
+  env->bucketsamples = bucketsamples;
+
+  while ((1U << env->bucketshift) < bucketsamples)
+    env->bucketshift++;
+
+  return env;
+} /* End of ms3_envelope_init() */
+
+/** ************************************************************************
+ * @brief Append data samples to an envelope
+ *
+ * The samples must follow the samples already in the envelope without a
+ * gap.  Only the buckets at each level that cover the new samples are
+ * updated.
+ *
+ * @param[in] env ::MS3Envelope to update
+ * @param[in] samples Array of data samples
+ * @param[in] numsamples Number of samples in @p samples
+ * @param[in] sampletype Sample type of @p samples, must match the envelope
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_envelope_append (MS3Envelope *env, const void *samples, int64_t numsamples, char sampletype)
+{
+  LM_ENVLEVEL *level;
+  LM_ENVLEVEL *child;
+  int64_t oldsamplecnt;
+  int64_t sampleidx;
+  int64_t bucket;
+  int64_t offset;
+  int64_t count;
+  int64_t idx;
+  double min;
+  double max;
+  int levelidx;
+
+  if (!env || (!samples && numsamples > 0))
+  {
+    ms_log (2, "%s(): Required input not defined: 'env' or 'samples'\n", __func__);
+    return -1;
+  }
+
+  if (sampletype != env->sampletype)
+  {
+    ms_log (2, "%s(): Sample type (%c) does not match envelope sample type (%c)\n", __func__,
+            sampletype, env->sampletype);
+    return -1;
+  }
+
+  if (numsamples <= 0)
+    return 0;
+
+  oldsamplecnt = env->samplecnt;
+  level = &env->levels[0];
+
+  if (lm_envelope_grow (level, ((oldsamplecnt + numsamples - 1) >> env->bucketshift) + 1))
+    return -1;
+
+  /* Update base level buckets, one bucket at a time */
+  for (sampleidx = 0; sampleidx < numsamples; sampleidx += count)
+  {
+    bucket = env->samplecnt >> env->bucketshift;
+    offset = env->samplecnt & (env->bucketsamples - 1);
+    count = env->bucketsamples - offset;
+
+    if (count > numsamples - sampleidx)
+      count = numsamples - sampleidx;
+
+    lm_envelope_minmax (samples, sampleidx, count, sampletype, &min, &max);
+
+    if (offset == 0)
+    {
+      level->min[bucket] = min;
+      level->max[bucket] = max;
+      level->bucketcnt = bucket + 1;
+    }
+    else
+    {
+      if (min < level->min[bucket])
+        level->min[bucket] = min;
+      if (max > level->max[bucket])
+        level->max[bucket] = max;
+    }
+
+    env->samplecnt += count;
+  }
+
+  /* Update buckets of following levels covering new samples, adding levels as needed */
+  for (levelidx = 1; levelidx < LM_ENVELOPE_MAXLEVELS && env->levels[levelidx - 1].bucketcnt > 1;
+       levelidx++)
+  {
+    child = &env->levels[levelidx - 1];
+    level = &env->levels[levelidx];
+
+    if (lm_envelope_grow (level, (child->bucketcnt + 1) / 2))
+      return -1;
+
+    for (idx = oldsamplecnt >> (env->bucketshift + levelidx); idx < (child->bucketcnt + 1) / 2;
+         idx++)
+    {
+      level->min[idx] = child->min[idx * 2];
+      level->max[idx] = child->max[idx * 2];
+
+      if (idx * 2 + 1 < child->bucketcnt)
+      {
+        if (child->min[idx * 2 + 1] < level->min[idx])
+          level->min[idx] = child->min[idx * 2 + 1];
+        if (child->max[idx * 2 + 1] > level->max[idx])
+          level->max[idx] = child->max[idx * 2 + 1];
+      }
+    }
+
+    level->bucketcnt = (child->bucketcnt + 1) / 2;
+  }
+
+  env->levelcnt = levelidx;
+
+  return 0;
+} /* End of ms3_envelope_append() */
+
+/** ************************************************************************
+ * @brief Create or update an envelope from the samples of a trace segment
+ *
+ * If @p *ppenv is NULL a new envelope starting at the segment start
+ * time is allocated, otherwise the samples of the segment that follow
+ * those already in the envelope are appended.  This allows an envelope
+ * to be maintained incrementally as data are added to the end of a
+ * segment, including segments of a rolling buffer whose earliest samples
+ * are removed when packed.
+ *
+ * The data samples of the segment are used if present, otherwise the
+ * records of the segment's ::MS3RecordList are decoded, at most
+ * 65,536 samples at a time, see mstl3_unpack_recordlist().
+ *
+ * @param[in,out] ppenv Pointer-to-pointer to an ::MS3Envelope, allocated if NULL
+ * @param[in] id ::MS3TraceID of the segment
+ * @param[in] seg ::MS3TraceSeg with data samples or a record list
+ * @param[in] bucketsamples Samples per level 0 bucket of a new envelope, see ms3_envelope_init()
+ * @param[in] verbose Controls logging verbosity, 0 is no diagnostic output
+ *
+ * @returns The number of samples appended on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+mstl3_envelope_update (MS3Envelope **ppenv, MS3TraceID *id, MS3TraceSeg *seg,
+                       uint32_t bucketsamples, int8_t verbose)
+{
+  MS3Envelope *env = NULL;
+  MS3TraceSeg chunkseg;
+  MS3RecordList chunklist;
+  MS3RecordPtr *recordptr = NULL;
+  MS3RecordPtr *lastptr = NULL;
+  MS3RecordPtr *nextptr = NULL;
+  void *buffer = NULL;
+  uint64_t buffersize = 0;
+  int64_t appended = 0;
+  int64_t segindex;
+  int64_t chunksamples;
+  int64_t unpacked;
+  int64_t first;
+  int64_t skip;
+  uint8_t samplesize = 0;
+  char sampletype = 0;
+
+  if (!ppenv || !id || !seg)
+  {
+    ms_log (2, "%s(): Required input not defined: 'ppenv', 'id' or 'seg'\n", __func__);
+    return -1;
+  }
+
+  /* Determine sample type of data samples or records */
+  if (seg->datasamples && seg->numsamples > 0)
+  {
+    sampletype = seg->sampletype;
+  }
+  else if (seg->recordlist && seg->recordlist->first)
+  {
+    if (ms_encoding_sizetype ((uint8_t)seg->recordlist->first->msr->encoding, NULL, &sampletype))
+    {
+      ms_log (2, "%s: Cannot determine sample type for encoding: %u\n", id->sid,
+              seg->recordlist->first->msr->encoding);
+      return -1;
+    }
+  }
+  else
+  {
+    return 0;
+  }
+
+  if (*ppenv == NULL)
+  {
+    if ((*ppenv = ms3_envelope_init (seg->starttime, seg->samprate, sampletype, bucketsamples)) ==
+        NULL)
+      return -1;
+  }
+
+  env = *ppenv;
+
+  /* Index in the segment of the first sample not yet in the envelope */
+  first = lm_envelope_index (env, seg->starttime, 0);
+  first = env->samplecnt - first;
+
+  if (first < 0)
+  {
+    ms_log (2, "%s: Segment starts after the end of the envelope, cannot append\n", id->sid);
+    return -1;
+  }
+
+  /* Append from data samples */
+  if (seg->datasamples && seg->numsamples > 0)
+  {
+    if (first >= seg->numsamples)
+      return 0;
+
+    if (ms3_envelope_append (env,
+                             (char *)seg->datasamples + (first * ms_samplesize (seg->sampletype)),
+                             seg->numsamples - first, seg->sampletype))
+      return -1;
+
+    return seg->numsamples - first;
+  }
+
+  /* Otherwise decode chunks of records from the record list */
+  ms_encoding_sizetype ((uint8_t)seg->recordlist->first->msr->encoding, &samplesize, NULL);
+
+  segindex = 0;
+  recordptr = seg->recordlist->first;
+  while (recordptr)
+  {
+    /* Skip records already included in the envelope */
+    if (segindex + recordptr->msr->samplecnt <= first)
+    {
+      segindex += recordptr->msr->samplecnt;
+      recordptr = recordptr->next;
+      continue;
+    }
+
+    /* Collect records for a chunk, at least one */
+    chunklist.first = recordptr;
+    chunklist.recordcnt = 1;
+    chunksamples = recordptr->msr->samplecnt;
+
+    for (lastptr = recordptr;
+         lastptr->next && chunksamples + lastptr->next->msr->samplecnt <= LM_ENVELOPE_CHUNK;
+         lastptr = lastptr->next)
+    {
+      chunksamples += lastptr->next->msr->samplecnt;
+      chunklist.recordcnt++;
+    }
+
+    chunklist.last = lastptr;
+
+    if ((uint64_t)chunksamples * samplesize > buffersize)
+    {
+      buffersize = (uint64_t)chunksamples * samplesize;
+
+      if ((buffer = libmseed_memory.realloc (buffer, (size_t)buffersize)) == NULL)
+      {
+        ms_log (2, "%s: Cannot allocate memory for decoded samples\n", id->sid);
+        appended = -1;
+        break;
+      }
+    }
+
+    /* Decode the chunk as a segment with a partial record list */
+    memset (&chunkseg, 0, sizeof (MS3TraceSeg));
+    chunkseg.samplecnt = chunksamples;
+    chunkseg.recordlist = &chunklist;
+
+    nextptr = lastptr->next;
+    lastptr->next = NULL;
+    unpacked = mstl3_unpack_recordlist (id, &chunkseg, buffer, buffersize, verbose);
+    lastptr->next = nextptr;
+
+    if (unpacked < 0)
+    {
+      appended = -1;
+      break;
+    }
+
+    skip = (first > segindex) ? first - segindex : 0;
+
+    if (unpacked > skip)
+    {
+      if (ms3_envelope_append (env, (char *)buffer + (skip * samplesize), unpacked - skip,
+                               chunkseg.sampletype))
+      {
+        appended = -1;
+        break;
+      }
+
+      appended += unpacked - skip;
+    }
+
+    segindex += chunksamples;
+    recordptr = nextptr;
+  }
+
+  libmseed_memory.free (buffer);
+
+  return appended;
+} /* End of mstl3_envelope_update() */
+
+/** ************************************************************************
+ * @brief Return the buckets of one level of an envelope
+ *
+ * Bucket @c n of a level covers samples from @c n * @p bucketsamples up
+ * to, but not including, (@c n + 1) * @p bucketsamples, the last bucket
+ * may cover fewer samples.  The arrays are owned by the envelope and are
+ * valid until the envelope is updated or freed.
+ *
+ * @param[in] env ::MS3Envelope to inspect
+ * @param[in] level Level to return, 0 is the highest resolution
+ * @param[out] bucketsamples Number of samples per bucket, optional
+ * @param[out] min Pointer to minimum sample value of each bucket, optional
+ * @param[out] max Pointer to maximum sample value of each bucket, optional
+ *
+ * @returns The number of buckets, or -1 if @p level is not populated.
+ ***************************************************************************/
+int64_t
+ms3_envelope_level (const MS3Envelope *env, int level, int64_t *bucketsamples, const double **min,
+                    const double **max)
+{
+  if (!env || level < 0 || level >= env->levelcnt)
+    return -1;
+
+  if (bucketsamples)
+    *bucketsamples = (int64_t)env->bucketsamples << level;
+  if (min)
+    *min = env->levels[level].min;
+  if (max)
+    *max = env->levels[level].max;
+
+  return env->levels[level].bucketcnt;
+} /* End of ms3_envelope_level() */
+
+/** ************************************************************************
+ * @brief Calculate the min/max envelope of a time window for plotting
+ *
+ * The time window from @p starttime up to @p endtime is divided into @p
+ * pixels columns of equal duration.  The minimum and maximum values of
+ * the samples in each column are determined from the coarsest level
+ * with buckets no larger than a column, combining at most a few
+ * buckets per column.  The work is therefore proportional to @p pixels
+ * regardless of the number of samples.
+ *
+ * When a column is shorter than a base level bucket, the values of the
+ * bucket containing the column are returned.
+ *
+ * Columns without samples are set to @c NAN.
+ *
+ * @param[in] env ::MS3Envelope to query
+ * @param[in] starttime Start of the time window
+ * @param[in] endtime End of the time window, must be after @p starttime
+ * @param[in] pixels Number of columns
+ * @param[out] min Array of @p pixels minimum values
+ * @param[out] max Array of @p pixels maximum values
+ *
+ * @returns The number of columns with samples on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_envelope_query (const MS3Envelope *env, nstime_t starttime, nstime_t endtime, int pixels,
+                    double *min, double *max)
+{
+  const LM_ENVLEVEL *level;
+  nstime_t columnstart;
+  nstime_t columnend;
+  double columnsamples;
+  int64_t firstsample;
+  int64_t lastsample;
+  int64_t bucket;
+  int64_t lastbucket;
+  int levelidx;
+  int shift;
+  int filled = 0;
+  int pixel;
+
+  if (!env || !min || !max)
+  {
+    ms_log (2, "%s(): Required input not defined: 'env', 'min' or 'max'\n", __func__);
+    return -1;
+  }
+
+  if (endtime <= starttime || pixels <= 0)
+  {
+    ms_log (2, "%s(): Time window and pixel count must be positive\n", __func__);
+    return -1;
+  }
+
+  /* Select the coarsest level with buckets no larger than a column */
+  columnsamples = (double)(endtime - starttime) / NSTMODULUS * env->samprate / pixels;
+
+  for (levelidx = 0; levelidx + 1 < env->levelcnt &&
+                     (double)((int64_t)env->bucketsamples << (levelidx + 1)) <= columnsamples;
+       levelidx++)
+    ;
+
+  level = &env->levels[levelidx];
+  shift = env->bucketshift + levelidx;
+
+  for (pixel = 0; pixel < pixels; pixel++)
+  {
+    columnstart = starttime + (nstime_t)((double)(endtime - starttime) * pixel / pixels);
+    columnend = starttime + (nstime_t)((double)(endtime - starttime) * (pixel + 1) / pixels);
+
+    /* Samples whose sample period intersects the column */
+    firstsample = lm_envelope_index (env, columnstart, 0);
+    lastsample = lm_envelope_index (env, columnend, 1) - 1;
+
+    if (firstsample < 0)
+      firstsample = 0;
+    if (lastsample >= env->samplecnt)
+      lastsample = env->samplecnt - 1;
+
+    if (env->levelcnt == 0 || firstsample > lastsample)
+    {
+      min[pixel] = NAN;
+      max[pixel] = NAN;
+      continue;
+    }
+
+    lastbucket = lastsample >> shift;
+    bucket = firstsample >> shift;
+
+    min[pixel] = level->min[bucket];
+    max[pixel] = level->max[bucket];
+
+    for (bucket++; bucket <= lastbucket; bucket++)
+    {
+      if (level->min[bucket] < min[pixel])
+        min[pixel] = level->min[bucket];
+      if (level->max[bucket] > max[pixel])
+        max[pixel] = level->max[bucket];
+    }
+
+    filled++;
+  }
+
+  return filled;
+} /* End of ms3_envelope_query() */
+
+/** ************************************************************************
+ * @brief Write an envelope to a file
+ *
+ * The file contains a 40-byte header followed by the minimum and
+ * maximum values of each bucket of each level, in order of level and
+ * bucket.  Values are stored in little-endian byte order as 32-bit
+ * integers, 32-bit floats or 64-bit floats according to the sample
+ * type of the envelope, i.e. without loss relative to the samples.
+ * The total size is about 4 times the number of samples divided by the
+ * number of samples per base level bucket, times the sample size.
+ *
+ * @param[in] env ::MS3Envelope to write
+ * @param[in] path File to create or overwrite
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_envelope_read()
+ ***************************************************************************/
+int
+ms3_envelope_write (const MS3Envelope *env, const char *path)
+{
+  uint8_t header[LM_ENVELOPE_HEADERLEN] = {0};
+  uint8_t *buffer = NULL;
+  uint8_t *value;
+  uint8_t samplesize;
+  int64_t idx;
+  int levelidx;
+  int swap = ms_bigendianhost ();
+  int rv = 0;
+  FILE *fp;
+
+  if (!env || !path)
+  {
+    ms_log (2, "%s(): Required input not defined: 'env' or 'path'\n", __func__);
+    return -1;
+  }
+
+  samplesize = ms_samplesize (env->sampletype);
+
+  memcpy (header, LM_ENVELOPE_MAGIC, 4);
+  header[4] = LM_ENVELOPE_FORMAT;
+  header[5] = (uint8_t)env->sampletype;
+  header[6] = (uint8_t)env->levelcnt;
+  memcpy (header + 8, &env->bucketsamples, 4);
+  memcpy (header + 16, &env->starttime, 8);
+  memcpy (header + 24, &env->samprate, 8);
+  memcpy (header + 32, &env->samplecnt, 8);
+
+  if (swap)
+  {
+    ms_gswap4 (header + 8);
+    ms_gswap8 (header + 16);
+    ms_gswap8 (header + 24);
+    ms_gswap8 (header + 32);
+  }
+
+  if ((fp = fopen (path, "wb")) == NULL)
+  {
+    ms_log (2, "Cannot open envelope file %s: %s\n", path, strerror (errno));
+    return -1;
+  }
+
+  if (fwrite (header, LM_ENVELOPE_HEADERLEN, 1, fp) != 1)
+    rv = -1;
+
+  for (levelidx = 0; rv == 0 && levelidx < env->levelcnt; levelidx++)
+  {
+    const LM_ENVLEVEL *level = &env->levels[levelidx];
+
+    if ((buffer = (uint8_t *)libmseed_memory.realloc (
+             buffer, (size_t)level->bucketcnt * 2 * samplesize)) == NULL)
+    {
+      ms_log (2, "Cannot allocate memory\n");
+      rv = -1;
+      break;
+    }
+
+    /* Store values as the sample type, in little-endian byte order */
+    for (idx = 0, value = buffer; idx < level->bucketcnt * 2; idx++, value += samplesize)
+    {
+      double dvalue = (idx & 1) ? level->max[idx / 2] : level->min[idx / 2];
+
+      if (env->sampletype == 'i')
+      {
+        int32_t ivalue = (int32_t)dvalue;
+        memcpy (value, &ivalue, 4);
+      }
+      else if (env->sampletype == 'f')
+      {
+        float fvalue = (float)dvalue;
+        memcpy (value, &fvalue, 4);
+      }
+      else
+      {
+        memcpy (value, &dvalue, 8);
+      }
+
+      if (swap && samplesize == 4)
+        ms_gswap4 (value);
+      else if (swap)
+        ms_gswap8 (value);
+    }
+
+    if (fwrite (buffer, samplesize, (size_t)level->bucketcnt * 2, fp) !=
+        (size_t)level->bucketcnt * 2)
+      rv = -1;
+  }
+
+  libmseed_memory.free (buffer);
+
+  if (fclose (fp))
+    rv = -1;
+
+  if (rv)
+    ms_log (2, "Error writing envelope file %s: %s\n", path, strerror (errno));
+
+  return rv;
+} /* End of ms3_envelope_write() */
+
+/** ************************************************************************
+ * @brief Read an envelope from a file written by ms3_envelope_write()
+ *
+ * The returned envelope may be queried and updated further, it should
+ * be freed with ms3_envelope_free() when done.
+ *
+ * @param[in] path File to read
+ *
+ * @returns An allocated ::MS3Envelope on success or NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+MS3Envelope *
+ms3_envelope_read (const char *path)
+{
+  MS3Envelope *env = NULL;
+  uint8_t header[LM_ENVELOPE_HEADERLEN];
+  uint8_t *buffer = NULL;
+  uint8_t *value;
+  uint8_t samplesize;
+  uint32_t bucketsamples;
+  nstime_t starttime;
+  double samprate;
+  int64_t samplecnt;
+  int64_t bucketcnt;
+  int64_t idx;
+  int levelcnt;
+  int levelidx;
+  int swap = ms_bigendianhost ();
+  FILE *fp;
+
+  if (!path)
+  {
+    ms_log (2, "%s(): Required input not defined: 'path'\n", __func__);
+    return NULL;
+  }
+
+  if ((fp = fopen (path, "rb")) == NULL)
+  {
+    ms_log (2, "Cannot open envelope file %s: %s\n", path, strerror (errno));
+    return NULL;
+  }
+
+  if (fread (header, LM_ENVELOPE_HEADERLEN, 1, fp) != 1 ||
+      memcmp (header, LM_ENVELOPE_MAGIC, 4) || header[4] != LM_ENVELOPE_FORMAT)
+  {
+    ms_log (2, "%s: Not a supported envelope file\n", path);
+    fclose (fp);
+    return NULL;
+  }
+
+  if (swap)
+  {
+    ms_gswap4 (header + 8);
+    ms_gswap8 (header + 16);
+    ms_gswap8 (header + 24);
+    ms_gswap8 (header + 32);
+  }
+
+  memcpy (&bucketsamples, header + 8, 4);
+  memcpy (&starttime, header + 16, 8);
+  memcpy (&samprate, header + 24, 8);
+  memcpy (&samplecnt, header + 32, 8);
+  levelcnt = header[6];
+
+  if ((env = ms3_envelope_init (starttime, samprate, (char)header[5], bucketsamples)) == NULL ||
+      samplecnt < 0 || levelcnt > LM_ENVELOPE_MAXLEVELS)
+  {
+    ms_log (2, "%s: Invalid envelope file header\n", path);
+    ms3_envelope_free (&env);
+    fclose (fp);
+    return NULL;
+  }
+
+  samplesize = ms_samplesize (env->sampletype);
+  env->samplecnt = samplecnt;
+  env->levelcnt = levelcnt;
+
+  for (levelidx = 0; levelidx < levelcnt; levelidx++)
+  {
+    LM_ENVLEVEL *level = &env->levels[levelidx];
+
+    /* Number of buckets is determined by the sample count and level */
+    bucketcnt = ((samplecnt - 1) >> (env->bucketshift + levelidx)) + 1;
+
+    if (samplecnt == 0 || (levelidx + 1 == levelcnt) != (bucketcnt == 1) ||
+        lm_envelope_grow (level, bucketcnt) ||
+        (buffer = (uint8_t *)libmseed_memory.realloc (buffer, (size_t)bucketcnt * 2 *
+                                                                  samplesize)) == NULL ||
+        fread (buffer, samplesize, (size_t)bucketcnt * 2, fp) != (size_t)bucketcnt * 2)
+    {
+      ms_log (2, "%s: Invalid or truncated envelope file\n", path);
+      ms3_envelope_free (&env);
+      break;
+    }
+
+    for (idx = 0, value = buffer; idx < bucketcnt * 2; idx++, value += samplesize)
+    {
+      double dvalue;
+
+      if (swap && samplesize == 4)
+        ms_gswap4 (value);
+      else if (swap)
+        ms_gswap8 (value);
+
+      if (env->sampletype == 'i')
+      {
+        int32_t ivalue;
+        memcpy (&ivalue, value, 4);
+        dvalue = ivalue;
+      }
+      else if (env->sampletype == 'f')
+      {
+        float fvalue;
+        memcpy (&fvalue, value, 4);
+        dvalue = fvalue;
+      }
+      else
+      {
+        memcpy (&dvalue, value, 8);
+      }
+
+      if (idx & 1)
+        level->max[idx / 2] = dvalue;
+      else
+        level->min[idx / 2] = dvalue;
+    }
+
+    level->bucketcnt = bucketcnt;
+  }
+
+  if (env && samplecnt > 0 && levelcnt == 0)
+  {
+    ms_log (2, "%s: Invalid envelope file header\n", path);
+    ms3_envelope_free (&env);
+  }
+
+  libmseed_memory.free (buffer);
+  fclose (fp);
+
+  return env;
+} /* End of ms3_envelope_read() */
+
+/** ************************************************************************
+ * @brief Free all memory associated with an envelope
+ *
+ * @param[in,out] ppenv Pointer-to-pointer to the ::MS3Envelope to free, set to NULL
+ ***************************************************************************/
+void
+ms3_envelope_free (MS3Envelope **ppenv)
+{
+  int levelidx;
+
+  if (!ppenv || !*ppenv)
+    return;
+
+  for (levelidx = 0; levelidx < LM_ENVELOPE_MAXLEVELS; levelidx++)
+  {
+    libmseed_memory.free ((*ppenv)->levels[levelidx].min);
+    libmseed_memory.free ((*ppenv)->levels[levelidx].max);
+  }
+
+  libmseed_memory.free (*ppenv);
+  *ppenv = NULL;
+} /* End of ms3_envelope_free() */
+
+/***************************************************************************
+ * Determine the minimum and maximum of a range of samples.
+ ***************************************************************************/
+static void
+lm_envelope_minmax (const void *samples, int64_t offset, int64_t count, char sampletype,
+                    double *min, double *max)
+{
+  int64_t idx;
+
+  if (sampletype == 'i')
+  {
+    const int32_t *data = (const int32_t *)samples + offset;
+    int32_t imin = data[0];
+    int32_t imax = data[0];
+
+    for (idx = 1; idx < count; idx++)
+    {
+      imin = (data[idx] < imin) ? data[idx] : imin;
+      imax = (data[idx] > imax) ? data[idx] : imax;
+    }
+
+    *min = imin;
+    *max = imax;
+  }
+  else if (sampletype == 'f')
+  {
+    const float *data = (const float *)samples + offset;
+    float fmin = data[0];
+    float fmax = data[0];
+
+    for (idx = 1; idx < count; idx++)
+    {
+      fmin = (data[idx] < fmin) ? data[idx] : fmin;
+      fmax = (data[idx] > fmax) ? data[idx] : fmax;
+    }
+
+    *min = fmin;
+    *max = fmax;
+  }
+  else
+  {
+    const double *data = (const double *)samples + offset;
+
+    *min = *max = data[0];
+
+    for (idx = 1; idx < count; idx++)
+    {
+      *min = (data[idx] < *min) ? data[idx] : *min;
+      *max = (data[idx] > *max) ? data[idx] : *max;
+    }
+  }
+} /* End of lm_envelope_minmax() */
+
+/***************************************************************************
+ * Grow the bucket arrays of a level to hold at least bucketcnt buckets.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_envelope_grow (LM_ENVLEVEL *level, int64_t bucketcnt)
+{
+  int64_t allocated = (level->allocated) ? level->allocated : 64;
+  double *min;
+  double *max;
+
+  if (bucketcnt <= level->allocated)
+    return 0;
+
+  while (allocated < bucketcnt)
+    allocated *= 2;
+
+  if ((min = (double *)libmseed_memory.realloc (level->min, (size_t)allocated * sizeof (double))) ==
+      NULL)
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    return -1;
+  }
+  level->min = min;
+
+  if ((max = (double *)libmseed_memory.realloc (level->max, (size_t)allocated * sizeof (double))) ==
+      NULL)
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    return -1;
+  }
+  level->max = max;
+
+  level->allocated = allocated;
+
+  return 0;
+} /* End of lm_envelope_grow() */
+
+/***************************************************************************
+ * Determine the index of the sample at or before (or, if roundup is
+ * true, at or after) a time, relative to the first sample of an
+ * envelope.  The index may be negative or beyond the sample count.
+ ***************************************************************************/
+static int64_t
+lm_envelope_index (const MS3Envelope *env, nstime_t time, int8_t roundup)
+{
+  double position = (double)(time - env->starttime) / NSTMODULUS * env->samprate;
+  int64_t index;
+
+  /* Positions within 1/1000 of a sample of a sample time match the sample */
+  index = (int64_t)((position < 0.0) ? position - 0.999 : position + 0.001);
+
+  if (roundup && (double)index < position - 0.001)
+    index++;
+
+  return index;
+} /* End of lm_envelope_index() */
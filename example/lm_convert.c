@@ -0,0 +1,186 @@
+/***************************************************************************
+ * A program for converting miniSEED 2 files to miniSEED 3.
+ *
+ * Records are converted without decoding the data samples, the encoded
+ * payload of each record is copied unchanged and records are converted
+ * by multiple threads.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2024 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libmseed.h>
+
+#define PACKAGE "lm_convert"
+#define VERSION "[libmseed " LIBMSEED_VERSION " " PACKAGE " ]"
+
+static flag verbose     = 0;
+static flag validatecrc = 0;
+static flag skipnotdata = 0;
+static int threads      = 0;
+static char *inputfile  = NULL;
+static char *outputfile = NULL;
+
+static int parameter_proc (int argcount, char **argvec);
+static void usage (void);
+
+/* Binary I/O for Windows platforms */
+#ifdef LMP_WIN
+  #include <fcntl.h>
+  unsigned int _CRT_fmode = _O_BINARY;
+#endif
+
+int
+main (int argc, char **argv)
+{
+  uint32_t flags = 0;
+  int64_t records;
+  clock_t start;
+
+  /* Process command line arguments */
+  if (parameter_proc (argc, argv) < 0)
+    return -1;
+
+  if (validatecrc)
+    flags |= MSF_VALIDATECRC;
+
+  if (skipnotdata)
+    flags |= MSF_SKIPNOTDATA;
+
+  start = clock ();
+
+  /* Per-record diagnostics only with multiple verbose flags */
+  records = ms3_convert_file (inputfile, outputfile, flags, threads,
+                              (verbose > 1) ? verbose - 1 : 0);
+
+  if (records < 0)
+  {
+    ms_log (2, "Cannot convert %s: %s\n", inputfile, ms_errorstr ((int)records));
+    return 1;
+  }
+
+  if (verbose)
+    ms_log (1, "Converted %" PRId64 " records in %.3f CPU seconds\n", records,
+            (double)(clock () - start) / CLOCKS_PER_SEC);
+
+  return 0;
+} /* End of main() */
+
+/***************************************************************************
+ * parameter_proc():
+ * Process the command line arguments.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+parameter_proc (int argcount, char **argvec)
+{
+  int optind;
+
+  /* Process all command line arguments */
+  for (optind = 1; optind < argcount; optind++)
+  {
+    if (strcmp (argvec[optind], "-V") == 0)
+    {
+      ms_log (1, "%s version: %s\n", PACKAGE, VERSION);
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-h") == 0)
+    {
+      usage ();
+      exit (0);
+    }
+    else if (strncmp (argvec[optind], "-v", 2) == 0)
+    {
+      verbose += strspn (&argvec[optind][1], "v");
+    }
+    else if (strcmp (argvec[optind], "-C") == 0)
+    {
+      validatecrc = 1;
+    }
+    else if (strcmp (argvec[optind], "-s") == 0)
+    {
+      skipnotdata = 1;
+    }
+    else if (strcmp (argvec[optind], "-t") == 0 && optind + 1 < argcount)
+    {
+      threads = atoi (argvec[++optind]);
+    }
+    else if (strncmp (argvec[optind], "-", 1) == 0 &&
+             strlen (argvec[optind]) > 1)
+    {
+      ms_log (2, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+    else if (inputfile == NULL)
+    {
+      inputfile = argvec[optind];
+    }
+    else if (outputfile == NULL)
+    {
+      outputfile = argvec[optind];
+    }
+    else
+    {
+      ms_log (2, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+  }
+
+  /* Make sure input and output files were specified */
+  if (!inputfile || !outputfile)
+  {
+    ms_log (2, "Input and output files must be specified\n\n");
+    ms_log (1, "%s version %s\n\n", PACKAGE, VERSION);
+    ms_log (1, "Try %s -h for usage\n", PACKAGE);
+    exit (1);
+  }
+
+  /* Report the program version */
+  if (verbose)
+    ms_log (1, "%s version: %s\n", PACKAGE, VERSION);
+
+  return 0;
+} /* End of parameter_proc() */
+
+/***************************************************************************
+ * usage():
+ * Print the usage message and exit.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Convert miniSEED 2 records to miniSEED 3 without decoding data\n\n");
+  fprintf (stderr, "Usage: %s [options] input output\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -V             Report program version\n"
+           " -h             Show this usage message\n"
+           " -v             Be more verbose, multiple flags can be used\n"
+           " -t threads     Number of converting threads, default is number of processors\n"
+           " -C             Validate CRC of miniSEED 3 input records\n"
+           " -s             Skip input that is not miniSEED\n"
+           "\n"
+           " input          File of miniSEED records, '-' for stdin\n"
+           " output         File to write miniSEED 3 records to, '-' for stdout\n"
+           "\n");
+} /* End of usage() */
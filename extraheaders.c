@@ -77,6 +77,7 @@ parse_json (char *jsonstring, size_t length, LM_PARSED_JSON *parsed)
     {
       parsed->doc = NULL;
       parsed->mut_doc = NULL;
+      parsed->modified = 0;
     }
   }
 
@@ -111,6 +112,26 @@ parse_json (char *jsonstring, size_t length, LM_PARSED_JSON *parsed)
   return parsed;
 }
 
+/***************************************************************************
+ * Internal routine to test for extra headers in a record or parse state.
+ *
+ * A parsed state, e.g. the cache attached to a record, may contain
+ * headers that have not yet been serialized to msr->extra.
+ *
+ * @returns 1 if extra headers are present, otherwise 0
+ ***************************************************************************/
+static int
+has_extra (const MS3Record *msr, const LM_PARSED_JSON *parsed)
+{
+  if (msr->extralength > 0)
+    return 1;
+
+  if (parsed && (parsed->doc || parsed->mut_doc))
+    return 1;
+
+  return 0;
+}
+
 /** ************************************************************************
  * @brief Search for and return the type of an extra header value.
  *
@@ -145,6 +166,7 @@ int
 mseh_get_ptr_type (const MS3Record *msr, const char *ptr, LM_PARSED_JSON **parsestate)
 {
   LM_PARSED_JSON *parsed = (parsestate) ? *parsestate : NULL;
+  LM_PARSED_JSON *cachestate = NULL;
   yyjson_val *extravalue = NULL;
   yyjson_alc alc = {_priv_malloc, _priv_realloc, _priv_free, NULL};
   char rettype = 0;
@@ -155,13 +177,21 @@ mseh_get_ptr_type (const MS3Record *msr, const char *ptr, LM_PARSED_JSON **parse
     return MS_GENERROR;
   }
 
+  /* Use the record's parsed document cache if enabled and no state is supplied */
+  if (parsestate == NULL && msr->extracache != NULL)
+  {
+    cachestate = msr->extracache;
+    parsestate = &cachestate;
+    parsed = cachestate;
+  }
+
   /* Nothing can be found in no headers */
-  if (!msr->extralength)
+  if (!has_extra (msr, parsed))
   {
     return 0;
   }
 
-  if (!msr->extra)
+  if (msr->extralength && !msr->extra)
   {
     ms_log (2, "%s() Expected extra headers (msr->extra) are not present\n", __func__);
     return MS_GENERROR;
@@ -175,7 +205,7 @@ mseh_get_ptr_type (const MS3Record *msr, const char *ptr, LM_PARSED_JSON **parse
   }
 
   /* Parse JSON extra headers if not available in state */
-  if (parsed == NULL)
+  if (parsed == NULL || (parsed->doc == NULL && parsed->mut_doc == NULL))
   {
     /* Parse to immutable state */
     parsed = parse_json (msr->extra, msr->extralength, parsed);
@@ -301,6 +331,7 @@ mseh_get_ptr_r (const MS3Record *msr, const char *ptr, void *value, char type, u
                 LM_PARSED_JSON **parsestate)
 {
   LM_PARSED_JSON *parsed = NULL;
+  LM_PARSED_JSON *cachestate = NULL;
   yyjson_val *extravalue = NULL;
   const char *stringvalue = NULL;
 
@@ -313,13 +344,20 @@ mseh_get_ptr_r (const MS3Record *msr, const char *ptr, void *value, char type, u
     return MS_GENERROR;
   }
 
+  /* Use the record's parsed document cache if enabled and no state is supplied */
+  if (parsestate == NULL && msr->extracache != NULL)
+  {
+    cachestate = msr->extracache;
+    parsestate = &cachestate;
+  }
+
   /* Nothing can be found in no headers */
-  if (!msr->extralength)
+  if (!has_extra (msr, (parsestate) ? *parsestate : NULL))
   {
     return 1;
   }
 
-  if (!msr->extra)
+  if (msr->extralength && !msr->extra)
   {
     ms_log (2, "%s() Expected extra headers (msr->extra) are not present\n", __func__);
     return MS_GENERROR;
@@ -447,6 +485,7 @@ mseh_set_ptr_r (MS3Record *msr, const char *ptr, void *value, char type,
                 LM_PARSED_JSON **parsestate)
 {
   LM_PARSED_JSON *parsed = (parsestate) ? *parsestate : NULL;
+  LM_PARSED_JSON *cachestate = NULL;
   yyjson_alc alc = {_priv_malloc, _priv_realloc, _priv_free, NULL};
   yyjson_doc *patch_idoc = NULL;
   yyjson_mut_doc *patch_doc = NULL;
@@ -468,8 +507,16 @@ mseh_set_ptr_r (MS3Record *msr, const char *ptr, void *value, char type,
     return MS_GENERROR;
   }
 
+  /* Use the record's parsed document cache if enabled and no state is supplied */
+  if (parsestate == NULL && msr->extracache != NULL)
+  {
+    cachestate = msr->extracache;
+    parsestate = &cachestate;
+    parsed = cachestate;
+  }
+
   /* Parse JSON extra headers if not available in state */
-  if (parsed == NULL)
+  if (parsed == NULL || (parsed->doc == NULL && parsed->mut_doc == NULL))
   {
     /* Allocate state container and parse to immutable form */
     parsed = parse_json (msr->extra, msr->extralength, parsed);
@@ -613,10 +660,15 @@ mseh_set_ptr_r (MS3Record *msr, const char *ptr, void *value, char type,
     mseh_free_parsestate (&parsed);
   }
   /* If changes were applied, the immutable form of the document is now invalid */
-  else if (rv == true && parsed->doc != NULL)
+  else if (rv == true)
   {
-    yyjson_doc_free (parsed->doc);
-    parsed->doc = NULL;
+    parsed->modified = 1;
+
+    if (parsed->doc != NULL)
+    {
+      yyjson_doc_free (parsed->doc);
+      parsed->doc = NULL;
+    }
   }
 
   return (rv == true) ? 0 : MS_GENERROR;
@@ -1134,46 +1186,29 @@ mseh_add_recenter_r (MS3Record *msr, const char *ptr, MSEHRecenter *recenter,
   return 0;
 } /* End of mseh_add_recenter_r() */
 
-/** ************************************************************************
- * @brief Generate extra headers string (serialize) from internal state
- *
- * Generate the extra headers JSON string from the internal parse state
- * created by mseh_set_ptr_r().
- *
- * @param[in] msr ::MS3Record to generate extra headers for
- * @param[in] parsestate Internal parsed state associated with @p msr
+/***************************************************************************
+ * Internal routine to serialize a mutable JSON document to a newly
+ * allocated extra headers string, which the caller must free.  The
+ * document is not modified.
  *
  * @returns Length of extra headers on success, otherwise a (negative) libmseed error code
- *
- * @see mseh_set_ptr_r()
  ***************************************************************************/
-int
-mseh_serialize (MS3Record *msr, LM_PARSED_JSON **parsestate)
+static int
+serialize_mut_doc (yyjson_mut_doc *mut_doc, char **serialized)
 {
   yyjson_write_flag flg;
   yyjson_write_err err;
   yyjson_alc alc = {_priv_malloc, _priv_realloc, _priv_free, NULL};
-
-  LM_PARSED_JSON *parsed = NULL;
-  char *serialized = NULL;
   size_t serialsize = 0;
 
-  if (!msr || !parsestate)
-    return MS_GENERROR;
-
-  parsed = *parsestate;
-
-  if (!parsed || !parsed->mut_doc)
-    return 0;
-
   /* Limit float point values to single precision to avoid unrealistically
    * high precision values in the output. */
   flg = YYJSON_WRITE_FP_TO_FLOAT;
 
   /* Serialize new JSON string */
-  serialized = yyjson_mut_write_opts (parsed->mut_doc, flg, &alc, &serialsize, &err);
+  *serialized = yyjson_mut_write_opts (mut_doc, flg, &alc, &serialsize, &err);
 
-  if (serialized == NULL)
+  if (*serialized == NULL)
   {
     ms_log (2, "%s() Cannot write extra header JSON: %s\n", __func__,
             (err.msg) ? err.msg : "Unknown error");
@@ -1184,16 +1219,53 @@ mseh_serialize (MS3Record *msr, LM_PARSED_JSON **parsestate)
   {
     ms_log (2, "%s() New serialization size exceeds limit of %d bytes: %" PRIu64 "\n", __func__,
             UINT16_MAX, (uint64_t)serialsize);
-    libmseed_memory.free (serialized);
+    libmseed_memory.free (*serialized);
+    *serialized = NULL;
     return MS_GENERROR;
   }
 
+  return (int)serialsize;
+}
+
+/** ************************************************************************
+ * @brief Generate extra headers string (serialize) from internal state
+ *
+ * Generate the extra headers JSON string from the internal parse state
+ * created by mseh_set_ptr_r().
+ *
+ * @param[in] msr ::MS3Record to generate extra headers for
+ * @param[in] parsestate Internal parsed state associated with @p msr
+ *
+ * @returns Length of extra headers on success, otherwise a (negative) libmseed error code
+ *
+ * @see mseh_set_ptr_r()
+ ***************************************************************************/
+int
+mseh_serialize (MS3Record *msr, LM_PARSED_JSON **parsestate)
+{
+  LM_PARSED_JSON *parsed = NULL;
+  char *serialized = NULL;
+  int serialsize;
+
+  if (!msr || !parsestate)
+    return MS_GENERROR;
+
+  parsed = *parsestate;
+
+  if (!parsed || !parsed->mut_doc)
+    return 0;
+
+  if ((serialsize = serialize_mut_doc (parsed->mut_doc, &serialized)) < 0)
+    return serialsize;
+
   /* Set new extra headers, replacing existing headers */
   if (msr->extra)
     libmseed_memory.free (msr->extra);
   msr->extra = serialized;
   msr->extralength = (uint16_t)serialsize;
 
+  parsed->modified = 0;
+
   return msr->extralength;
 }
 
@@ -1302,9 +1374,177 @@ mseh_replace (MS3Record *msr, char *jsonstring)
   msr->extra = serialized;
   msr->extralength = (uint16_t)serialsize;
 
+  /* Invalidate cached documents, the cache will be re-populated on next use */
+  if (msr->extracache)
+  {
+    if (msr->extracache->doc)
+      yyjson_doc_free (msr->extracache->doc);
+    if (msr->extracache->mut_doc)
+      yyjson_mut_doc_free (msr->extracache->mut_doc);
+
+    msr->extracache->doc = NULL;
+    msr->extracache->mut_doc = NULL;
+    msr->extracache->modified = 0;
+  }
+
   return msr->extralength;
 }
 
+/** ************************************************************************
+ * @brief Enable a parsed extra header document cache for a record
+ *
+ * By default each call to mseh_get_ptr_r() and mseh_set_ptr_r() that
+ * is not supplied a parse state will parse the extra headers of @p msr,
+ * and each set operation will re-serialize them.  When the cache is
+ * enabled, the parsed document is retained with the record and re-used
+ * by all extra header routines that are not supplied a parse state.
+ *
+ * Changes made with mseh_set_ptr_r() (and the derived mseh_set_*() and
+ * mseh_add_*() routines) are applied to the cached document and the
+ * serialization to @ref MS3Record.extra is deferred until
+ * mseh_cache_flush() or mseh_cache_disable().  The record packing
+ * routines, msr3_duplicate(), msr3_print() and mseh_print() use a
+ * serialization of pending changes without modifying the record.
+ * Callers that access @ref MS3Record.extra directly must call
+ * mseh_cache_flush() first.
+ *
+ * The cache is invalidated by mseh_replace() and when the record is
+ * re-initialized with msr3_init(), e.g. when reading the next record
+ * into the same ::MS3Record.  The cache remains enabled in both cases.
+ * The cache is released by mseh_cache_disable() and msr3_free().
+ *
+ * @warning If @ref MS3Record.extra is modified directly while the
+ * cache is enabled, use mseh_replace() or disable and re-enable the
+ * cache to avoid using a stale document.
+ *
+ * @param[in] msr ::MS3Record to enable cache for
+ *
+ * @returns 0 on success, otherwise a (negative) libmseed error code
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see mseh_cache_flush()
+ * @see mseh_cache_disable()
+ ***************************************************************************/
+int
+mseh_cache_enable (MS3Record *msr)
+{
+  if (!msr)
+  {
+    ms_log (2, "%s() Required input not defined: 'msr'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  if (msr->extracache)
+    return 0;
+
+  /* Allocate an empty state container, populated on first use */
+  if ((msr->extracache = parse_json (NULL, 0, NULL)) == NULL)
+    return MS_GENERROR;
+
+  return 0;
+} /* End of mseh_cache_enable() */
+
+/** ************************************************************************
+ * @brief Serialize pending changes in a record's extra header cache
+ *
+ * If the parsed extra header document cache of @p msr contains
+ * changes that have not been serialized, generate the extra header
+ * JSON and replace @ref MS3Record.extra.  The cached document is
+ * retained.
+ *
+ * @param[in] msr ::MS3Record to flush cached extra headers for
+ *
+ * @returns Length of extra headers on success, otherwise a (negative) libmseed error code
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see mseh_cache_enable()
+ ***************************************************************************/
+int
+mseh_cache_flush (MS3Record *msr)
+{
+  LM_PARSED_JSON *cachestate = NULL;
+
+  if (!msr)
+  {
+    ms_log (2, "%s() Required input not defined: 'msr'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  if (!msr->extracache || !msr->extracache->modified)
+    return msr->extralength;
+
+  cachestate = msr->extracache;
+
+  return mseh_serialize (msr, &cachestate);
+} /* End of mseh_cache_flush() */
+
+/** ************************************************************************
+ * @brief Disable and free a record's extra header cache
+ *
+ * Any pending changes are serialized to @ref MS3Record.extra before
+ * the cache is released.  On error the cache is retained.
+ *
+ * @param[in] msr ::MS3Record to disable cache for
+ *
+ * @returns 0 on success, otherwise a (negative) libmseed error code
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see mseh_cache_enable()
+ ***************************************************************************/
+int
+mseh_cache_disable (MS3Record *msr)
+{
+  if (!msr)
+  {
+    ms_log (2, "%s() Required input not defined: 'msr'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  if (mseh_cache_flush (msr) < 0)
+    return MS_GENERROR;
+
+  mseh_free_parsestate (&msr->extracache);
+
+  return 0;
+} /* End of mseh_cache_disable() */
+
+/***************************************************************************
+ * Internal routine to provide a record with the pending changes in its
+ * parsed extra header cache serialized, without modifying the record.
+ *
+ * If the cache of @p msr has no pending changes 0 is returned and @p
+ * view is not modified, the caller should use @p msr.  Otherwise @p view
+ * is set to a shallow copy of @p msr with newly allocated extra headers
+ * and no cache, and 1 is returned.  The caller must free view->extra.
+ *
+ * @returns 0 or 1 on success, otherwise a (negative) libmseed error code
+ ***************************************************************************/
+int
+mseh_cache_view (const MS3Record *msr, MS3Record *view)
+{
+  char *serialized = NULL;
+  int serialsize;
+
+  if (!msr || !view)
+    return MS_GENERROR;
+
+  if (!msr->extracache || !msr->extracache->modified || !msr->extracache->mut_doc)
+    return 0;
+
+  if ((serialsize = serialize_mut_doc (msr->extracache->mut_doc, &serialized)) < 0)
+    return serialsize;
+
+  *view = *msr;
+  view->extra = serialized;
+  view->extralength = (uint16_t)serialsize;
+  view->extracache = NULL;
+
+  return 1;
+} /* End of mseh_cache_view() */
+
 /** ************************************************************************
  * @brief Print the extra header structure for the specified MS3Record.
  *
@@ -1319,6 +1559,7 @@ mseh_replace (MS3Record *msr, char *jsonstring)
 int
 mseh_print (const MS3Record *msr, int indent)
 {
+  MS3Record view;
   char *extra;
   int idx;
   int instring = 0;
@@ -1326,6 +1567,17 @@ mseh_print (const MS3Record *msr, int indent)
   if (!msr)
     return MS_GENERROR;
 
+  /* Print pending changes in the extra header cache */
+  if ((idx = mseh_cache_view (msr, &view)) != 0)
+  {
+    if (idx < 0)
+      return MS_GENERROR;
+
+    idx = mseh_print (&view, indent);
+    libmseed_memory.free (view.extra);
+    return idx;
+  }
+
   if (!msr->extra || !msr->extralength)
     return MS_NOERROR;
 
@@ -1390,3 +1642,859 @@ mseh_print (const MS3Record *msr, int indent)
 
   return MS_NOERROR;
 } /* End of mseh_print() */
+
+/* Maximum number of JSON Pointers in a scanner, limited by match bitmasks */
+#define MSEH_SCAN_MAXPOINTERS 64
+
+/* Maximum length of a number token that can be decoded */
+#define MSEH_SCAN_MAXNUMBER 128
+
+/* A JSON Pointer compiled into unescaped reference tokens */
+typedef struct MSEHScanPointer
+{
+  int ntokens;          /* Number of reference tokens */
+  char **tokens;        /* Unescaped reference tokens */
+  size_t *tokenlengths; /* Length of each reference token */
+  int64_t *indexes;     /* Array index of each token, -1 if not an index */
+} MSEHScanPointer;
+
+struct MSEHScanner
+{
+  int count;                 /* Number of JSON Pointers */
+  uint64_t allmask;          /* Bitmask with a bit set for each pointer */
+  MSEHScanPointer *pointers; /* Compiled JSON Pointers */
+};
+
+/* State for a single scan pass over extra headers */
+typedef struct MSEHScanState
+{
+  const char *start;          /* Start of JSON */
+  const char *cur;            /* Current scan position */
+  const char *end;            /* End of JSON */
+  const MSEHScanner *scanner; /* Compiled JSON Pointers */
+  MSEHScanValue *values;      /* Output values, one per pointer */
+  uint64_t foundmask;         /* Bitmask of pointers found */
+} MSEHScanState;
+
+/***************************************************************************
+ * Internal routine to free a compiled JSON Pointer.
+ ***************************************************************************/
+static void
+scan_free_pointer (MSEHScanPointer *pointer)
+{
+  int idx;
+
+  if (pointer->tokens)
+  {
+    for (idx = 0; idx < pointer->ntokens; idx++)
+      libmseed_memory.free (pointer->tokens[idx]);
+
+    libmseed_memory.free (pointer->tokens);
+  }
+
+  if (pointer->tokenlengths)
+    libmseed_memory.free (pointer->tokenlengths);
+
+  if (pointer->indexes)
+    libmseed_memory.free (pointer->indexes);
+}
+
+/***************************************************************************
+ * Internal routine to compile a JSON Pointer (RFC 6901) into unescaped
+ * reference tokens.
+ *
+ * @returns 0 on success and -1 on error
+ ***************************************************************************/
+static int
+scan_compile_pointer (const char *ptr, MSEHScanPointer *pointer)
+{
+  const char *cp;
+  char *token;
+  size_t length;
+  int idx;
+
+  memset (pointer, 0, sizeof (MSEHScanPointer));
+
+  /* Count tokens, one per '/' */
+  for (cp = ptr; *cp; cp++)
+  {
+    if (*cp == '/')
+      pointer->ntokens++;
+  }
+
+  if (pointer->ntokens == 0)
+    return 0;
+
+  pointer->tokens = (char **)libmseed_memory.malloc (sizeof (char *) * pointer->ntokens);
+  pointer->tokenlengths = (size_t *)libmseed_memory.malloc (sizeof (size_t) * pointer->ntokens);
+  pointer->indexes = (int64_t *)libmseed_memory.malloc (sizeof (int64_t) * pointer->ntokens);
+
+  if (!pointer->tokens || !pointer->tokenlengths || !pointer->indexes)
+  {
+    ms_log (2, "%s() Cannot allocate memory for JSON Pointer tokens\n", __func__);
+    pointer->ntokens = 0;
+    scan_free_pointer (pointer);
+    return -1;
+  }
+
+  memset (pointer->tokens, 0, sizeof (char *) * pointer->ntokens);
+
+  cp = ptr + 1;
+  for (idx = 0; idx < pointer->ntokens; idx++)
+  {
+    /* Unescaped token is never longer than escaped */
+    length = strcspn (cp, "/");
+
+    if ((token = (char *)libmseed_memory.malloc (length + 1)) == NULL)
+    {
+      ms_log (2, "%s() Cannot allocate memory for JSON Pointer token\n", __func__);
+      scan_free_pointer (pointer);
+      return -1;
+    }
+
+    pointer->tokens[idx] = token;
+    pointer->tokenlengths[idx] = 0;
+
+    /* Unescape '~1' to '/' and '~0' to '~' */
+    for (; *cp && *cp != '/'; cp++)
+    {
+      if (*cp == '~' && (cp[1] == '0' || cp[1] == '1'))
+      {
+        token[pointer->tokenlengths[idx]++] = (cp[1] == '0') ? '~' : '/';
+        cp++;
+      }
+      else
+      {
+        token[pointer->tokenlengths[idx]++] = *cp;
+      }
+    }
+    token[pointer->tokenlengths[idx]] = '\0';
+
+    /* Determine array index, digits with no leading zeros */
+    pointer->indexes[idx] = -1;
+    length = pointer->tokenlengths[idx];
+    if (length > 0 && length < 19 && strspn (token, "0123456789") == length &&
+        (token[0] != '0' || length == 1))
+    {
+      pointer->indexes[idx] = strtoll (token, NULL, 10);
+    }
+
+    /* Skip separator */
+    if (*cp == '/')
+      cp++;
+  }
+
+  return 0;
+}
+
+/** ************************************************************************
+ * @brief Compile a set of JSON Pointers for fast extra header extraction
+ *
+ * Create an ::MSEHScanner for use with mseh_scan() to extract the
+ * values at each of the specified JSON Pointers (RFC 6901) from the
+ * extra headers of a record in a single pass.
+ *
+ * A scanner is not modified by mseh_scan() and may be shared between
+ * threads.
+ *
+ * @param[in] pointers Array of JSON Pointers, e.g. "/FDSN/Time/Quality"
+ * @param[in] count Number of JSON Pointers in @p pointers, maximum of 64
+ *
+ * @returns pointer to ::MSEHScanner on success and NULL on error
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see mseh_scan()
+ * @see mseh_scanner_free()
+ ***************************************************************************/
+MSEHScanner *
+mseh_scanner_init (const char *pointers[], int count)
+{
+  MSEHScanner *scanner = NULL;
+  int idx;
+
+  if (!pointers || count <= 0)
+  {
+    ms_log (2, "%s() Required input not defined: 'pointers' or 'count'\n", __func__);
+    return NULL;
+  }
+
+  if (count > MSEH_SCAN_MAXPOINTERS)
+  {
+    ms_log (2, "%s() Too many JSON Pointers (%d), maximum is %d\n", __func__, count,
+            MSEH_SCAN_MAXPOINTERS);
+    return NULL;
+  }
+
+  for (idx = 0; idx < count; idx++)
+  {
+    /* Detect invalid JSON Pointer, i.e. with no root '/' designation and not "" (root object) */
+    if (!pointers[idx] || (pointers[idx][0] != '/' && pointers[idx][0] != '\0'))
+    {
+      ms_log (2, "%s() Unsupported JSON Pointer notation: %s\n", __func__,
+              (pointers[idx]) ? pointers[idx] : "NULL");
+      return NULL;
+    }
+  }
+
+  if ((scanner = (MSEHScanner *)libmseed_memory.malloc (sizeof (MSEHScanner))) == NULL)
+  {
+    ms_log (2, "%s() Cannot allocate memory for scanner\n", __func__);
+    return NULL;
+  }
+
+  scanner->count = 0;
+  scanner->allmask = 0;
+  scanner->pointers =
+      (MSEHScanPointer *)libmseed_memory.malloc (sizeof (MSEHScanPointer) * count);
+
+  if (!scanner->pointers)
+  {
+    ms_log (2, "%s() Cannot allocate memory for scanner\n", __func__);
+    libmseed_memory.free (scanner);
+    return NULL;
+  }
+
+  for (idx = 0; idx < count; idx++)
+  {
+    if (scan_compile_pointer (pointers[idx], &scanner->pointers[idx]))
+    {
+      mseh_scanner_free (&scanner);
+      return NULL;
+    }
+
+    scanner->count++;
+    scanner->allmask |= ((uint64_t)1 << idx);
+  }
+
+  return scanner;
+} /* End of mseh_scanner_init() */
+
+/** ************************************************************************
+ * @brief Free a scanner created by mseh_scanner_init()
+ *
+ * @param[in] scanner Pointer to ::MSEHScanner to free, set to NULL on return
+ *
+ * @see mseh_scanner_init()
+ ***************************************************************************/
+void
+mseh_scanner_free (MSEHScanner **scanner)
+{
+  int idx;
+
+  if (!scanner || !*scanner)
+    return;
+
+  if ((*scanner)->pointers)
+  {
+    for (idx = 0; idx < (*scanner)->count; idx++)
+      scan_free_pointer (&(*scanner)->pointers[idx]);
+
+    libmseed_memory.free ((*scanner)->pointers);
+  }
+
+  libmseed_memory.free (*scanner);
+  *scanner = NULL;
+} /* End of mseh_scanner_free() */
+
+/***************************************************************************
+ * Internal routine to skip JSON whitespace.
+ ***************************************************************************/
+static inline void
+scan_skip_ws (MSEHScanState *st)
+{
+  while (st->cur < st->end &&
+         (*st->cur == ' ' || *st->cur == '\t' || *st->cur == '\n' || *st->cur == '\r'))
+    st->cur++;
+}
+
+/***************************************************************************
+ * Internal routine to scan a JSON string starting at the opening quote.
+ *
+ * The content (without quotes, escapes not decoded) is returned via
+ * @p content and @p length.
+ *
+ * @returns 0 on success and -1 on error
+ ***************************************************************************/
+static int
+scan_string (MSEHScanState *st, const char **content, size_t *length)
+{
+  const char *cp = st->cur + 1;
+
+  while (cp < st->end && *cp != '"')
+  {
+    if (*cp == '\\')
+      cp++;
+    cp++;
+  }
+
+  if (cp >= st->end)
+    return -1;
+
+  if (content)
+    *content = st->cur + 1;
+  if (length)
+    *length = cp - (st->cur + 1);
+
+  st->cur = cp + 1;
+
+  return 0;
+}
+
+/***************************************************************************
+ * Internal routine to skip a JSON value without decoding it.
+ *
+ * Containers are skipped by tracking nesting depth, no validation of
+ * the contents is performed.
+ *
+ * @returns 0 on success and -1 on error
+ ***************************************************************************/
+static int
+scan_skip_value (MSEHScanState *st)
+{
+  int depth = 0;
+
+  if (st->cur >= st->end)
+    return -1;
+
+  if (*st->cur == '"')
+    return scan_string (st, NULL, NULL);
+
+  if (*st->cur != '{' && *st->cur != '[')
+  {
+    /* Literal or number, ends at a delimiter */
+    while (st->cur < st->end && *st->cur != ',' && *st->cur != '}' && *st->cur != ']' &&
+           *st->cur != ' ' && *st->cur != '\t' && *st->cur != '\n' && *st->cur != '\r')
+      st->cur++;
+
+    return 0;
+  }
+
+  while (st->cur < st->end)
+  {
+    if (*st->cur == '"')
+    {
+      if (scan_string (st, NULL, NULL))
+        return -1;
+      continue;
+    }
+
+    if (*st->cur == '{' || *st->cur == '[')
+    {
+      depth++;
+    }
+    else if (*st->cur == '}' || *st->cur == ']')
+    {
+      if (--depth == 0)
+      {
+        st->cur++;
+        return 0;
+      }
+    }
+
+    st->cur++;
+  }
+
+  return -1;
+}
+
+/***************************************************************************
+ * Internal routine to decode 4 hexadecimal digits.
+ *
+ * @returns the decoded value or -1 on error
+ ***************************************************************************/
+static int32_t
+scan_hex4 (const char *cp)
+{
+  int32_t value = 0;
+  int idx;
+
+  for (idx = 0; idx < 4; idx++)
+  {
+    value <<= 4;
+
+    if (cp[idx] >= '0' && cp[idx] <= '9')
+      value |= cp[idx] - '0';
+    else if (cp[idx] >= 'a' && cp[idx] <= 'f')
+      value |= cp[idx] - 'a' + 10;
+    else if (cp[idx] >= 'A' && cp[idx] <= 'F')
+      value |= cp[idx] - 'A' + 10;
+    else
+      return -1;
+  }
+
+  return value;
+}
+
+/***************************************************************************
+ * Internal routine to compare raw (escaped) JSON string content with
+ * an unescaped token.
+ *
+ * @returns 1 if equal and 0 otherwise
+ ***************************************************************************/
+static int
+scan_key_matches (const char *raw, size_t rawlength, const char *token, size_t tokenlength)
+{
+  unsigned char utf8[4];
+  int32_t codepoint;
+  int32_t low;
+  size_t utf8length;
+  size_t ridx = 0;
+  size_t tidx = 0;
+
+  /* Common case, no escapes */
+  if (!memchr (raw, '\\', rawlength))
+    return (rawlength == tokenlength && !memcmp (raw, token, rawlength));
+
+  while (ridx < rawlength)
+  {
+    if (raw[ridx] != '\\')
+    {
+      if (tidx >= tokenlength || raw[ridx] != token[tidx])
+        return 0;
+
+      ridx++;
+      tidx++;
+      continue;
+    }
+
+    if (ridx + 1 >= rawlength)
+      return 0;
+
+    switch (raw[ridx + 1])
+    {
+    case '"':
+    case '\\':
+    case '/':
+      utf8[0] = raw[ridx + 1];
+      break;
+    case 'b':
+      utf8[0] = '\b';
+      break;
+    case 'f':
+      utf8[0] = '\f';
+      break;
+    case 'n':
+      utf8[0] = '\n';
+      break;
+    case 'r':
+      utf8[0] = '\r';
+      break;
+    case 't':
+      utf8[0] = '\t';
+      break;
+    case 'u':
+      break;
+    default:
+      return 0;
+    }
+
+    if (raw[ridx + 1] != 'u')
+    {
+      utf8length = 1;
+      ridx += 2;
+    }
+    else
+    {
+      if (ridx + 6 > rawlength || (codepoint = scan_hex4 (raw + ridx + 2)) < 0)
+        return 0;
+      ridx += 6;
+
+      /* Combine UTF-16 surrogate pair */
+      if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+      {
+        if (ridx + 6 > rawlength || raw[ridx] != '\\' || raw[ridx + 1] != 'u' ||
+            (low = scan_hex4 (raw + ridx + 2)) < 0xDC00 || low > 0xDFFF)
+          return 0;
+        ridx += 6;
+
+        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+      }
+
+      /* Encode code point as UTF-8 */
+      if (codepoint < 0x80)
+      {
+        utf8[0] = (unsigned char)codepoint;
+        utf8length = 1;
+      }
+      else if (codepoint < 0x800)
+      {
+        utf8[0] = (unsigned char)(0xC0 | (codepoint >> 6));
+        utf8[1] = (unsigned char)(0x80 | (codepoint & 0x3F));
+        utf8length = 2;
+      }
+      else if (codepoint < 0x10000)
+      {
+        utf8[0] = (unsigned char)(0xE0 | (codepoint >> 12));
+        utf8[1] = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+        utf8[2] = (unsigned char)(0x80 | (codepoint & 0x3F));
+        utf8length = 3;
+      }
+      else
+      {
+        utf8[0] = (unsigned char)(0xF0 | (codepoint >> 18));
+        utf8[1] = (unsigned char)(0x80 | ((codepoint >> 12) & 0x3F));
+        utf8[2] = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+        utf8[3] = (unsigned char)(0x80 | (codepoint & 0x3F));
+        utf8length = 4;
+      }
+    }
+
+    if (tidx + utf8length > tokenlength || memcmp (utf8, token + tidx, utf8length))
+      return 0;
+
+    tidx += utf8length;
+  }
+
+  return (tidx == tokenlength);
+}
+
+/***************************************************************************
+ * Internal routine to decode a scalar JSON value at the current position
+ * into an output value.
+ *
+ * @returns 0 on success and -1 on error
+ ***************************************************************************/
+static int
+scan_scalar (MSEHScanState *st, MSEHScanValue *value)
+{
+  yyjson_alc alc = {_priv_malloc, _priv_realloc, _priv_free, NULL};
+  yyjson_val numval;
+  char number[MSEH_SCAN_MAXNUMBER];
+  const char *content;
+  const char *numend;
+  size_t length;
+
+  if (*st->cur == '"')
+  {
+    if (scan_string (st, &content, &length))
+      return -1;
+
+    value->type = 's';
+    value->string = content;
+    value->stringlength = (uint32_t)length;
+  }
+  else if ((st->end - st->cur) >= 4 && !memcmp (st->cur, "true", 4))
+  {
+    value->type = 'b';
+    value->booleanvalue = 1;
+    st->cur += 4;
+  }
+  else if ((st->end - st->cur) >= 5 && !memcmp (st->cur, "false", 5))
+  {
+    value->type = 'b';
+    value->booleanvalue = 0;
+    st->cur += 5;
+  }
+  else if ((st->end - st->cur) >= 4 && !memcmp (st->cur, "null", 4))
+  {
+    /* A null value is reported as not found, same as mseh_get_ptr_type() */
+    st->cur += 4;
+  }
+  else
+  {
+    /* Copy number token to a terminated buffer for the yyjson number reader */
+    length = 0;
+    while (st->cur + length < st->end && st->cur[length] != '\0' &&
+           strchr ("0123456789+-.eE", st->cur[length]))
+      length++;
+
+    if (length == 0 || length >= sizeof (number))
+      return -1;
+
+    memcpy (number, st->cur, length);
+    number[length] = '\0';
+
+    numend = yyjson_read_number (number, &numval, YYJSON_READ_NOFLAG, &alc, NULL);
+    if (numend != number + length)
+      return -1;
+
+    if (yyjson_is_uint (&numval))
+    {
+      value->type = 'u';
+      value->uintvalue = unsafe_yyjson_get_uint (&numval);
+      value->intvalue = (value->uintvalue <= INT64_MAX) ? (int64_t)value->uintvalue : 0;
+    }
+    else if (yyjson_is_int (&numval))
+    {
+      value->type = 'i';
+      value->intvalue = unsafe_yyjson_get_int (&numval);
+    }
+    else
+    {
+      value->type = 'n';
+    }
+
+    value->numbervalue = unsafe_yyjson_get_num (&numval);
+    st->cur += length;
+  }
+
+  return 0;
+}
+
+/***************************************************************************
+ * Internal routine to scan a JSON value at the current position.
+ *
+ * The @p mask identifies the pointers whose first @p depth reference
+ * tokens match the path to this value.  Pointers with exactly @p depth
+ * tokens refer to this value, others continue matching in containers.
+ *
+ * @returns 1 when all pointers are found, 0 on success, -1 on error
+ ***************************************************************************/
+static int
+scan_value (MSEHScanState *st, int depth, uint64_t mask)
+{
+  const MSEHScanPointer *pointer;
+  uint64_t targetmask = 0;
+  uint64_t descendmask = 0;
+  uint64_t childmask;
+  const char *valuestart;
+  const char *key = NULL;
+  size_t keylength = 0;
+  int64_t index = 0;
+  char container;
+  char close;
+  int retval;
+  int idx;
+
+  scan_skip_ws (st);
+
+  if (st->cur >= st->end)
+    return -1;
+
+  valuestart = st->cur;
+
+  /* Separate pointers that refer to this value from those that descend */
+  for (idx = 0; idx < st->scanner->count; idx++)
+  {
+    if (!(mask & ((uint64_t)1 << idx)))
+      continue;
+
+    if (st->scanner->pointers[idx].ntokens == depth)
+    {
+      /* First occurrence wins */
+      if (!(st->foundmask & ((uint64_t)1 << idx)))
+        targetmask |= ((uint64_t)1 << idx);
+    }
+    else
+    {
+      descendmask |= ((uint64_t)1 << idx);
+    }
+  }
+
+  container = *st->cur;
+
+  /* Scalar values */
+  if (container != '{' && container != '[')
+  {
+    if (!targetmask)
+      return scan_skip_value (st);
+
+    for (idx = 0; idx < st->scanner->count; idx++)
+    {
+      if (!(targetmask & ((uint64_t)1 << idx)))
+        continue;
+
+      st->cur = valuestart;
+      if (scan_scalar (st, &st->values[idx]))
+        return -1;
+
+      st->values[idx].raw = valuestart;
+      st->values[idx].rawlength = (uint32_t)(st->cur - valuestart);
+      st->foundmask |= ((uint64_t)1 << idx);
+    }
+
+    return (st->foundmask == st->scanner->allmask) ? 1 : 0;
+  }
+
+  /* Containers not on any pointer path are skipped */
+  if (!targetmask && !descendmask)
+    return scan_skip_value (st);
+
+  close = (container == '{') ? '}' : ']';
+  st->cur++;
+  scan_skip_ws (st);
+
+  if (st->cur < st->end && *st->cur == close)
+  {
+    st->cur++;
+  }
+  else
+  {
+    for (;;)
+    {
+      if (container == '{')
+      {
+        scan_skip_ws (st);
+        if (st->cur >= st->end || *st->cur != '"' || scan_string (st, &key, &keylength))
+          return -1;
+
+        scan_skip_ws (st);
+        if (st->cur >= st->end || *st->cur != ':')
+          return -1;
+        st->cur++;
+      }
+
+      /* Determine pointers matching this member or element */
+      childmask = 0;
+      for (idx = 0; descendmask && idx < st->scanner->count; idx++)
+      {
+        if (!(descendmask & ((uint64_t)1 << idx)) || (st->foundmask & ((uint64_t)1 << idx)))
+          continue;
+
+        pointer = &st->scanner->pointers[idx];
+
+        if ((container == '{' && scan_key_matches (key, keylength, pointer->tokens[depth],
+                                                   pointer->tokenlengths[depth])) ||
+            (container == '[' && pointer->indexes[depth] == index))
+        {
+          childmask |= ((uint64_t)1 << idx);
+        }
+      }
+
+      if (childmask)
+      {
+        if ((retval = scan_value (st, depth + 1, childmask)) < 0)
+          return -1;
+
+        /* Stop early if all pointers are found and no container is pending */
+        if (retval == 1 && !targetmask)
+          return 1;
+      }
+      else
+      {
+        scan_skip_ws (st);
+        if (scan_skip_value (st))
+          return -1;
+      }
+
+      index++;
+
+      scan_skip_ws (st);
+      if (st->cur >= st->end)
+        return -1;
+
+      if (*st->cur == ',')
+      {
+        st->cur++;
+        continue;
+      }
+
+      if (*st->cur == close)
+      {
+        st->cur++;
+        break;
+      }
+
+      return -1;
+    }
+  }
+
+  /* Set container values, the extent is known after scanning */
+  for (idx = 0; idx < st->scanner->count; idx++)
+  {
+    if (!(targetmask & ((uint64_t)1 << idx)))
+      continue;
+
+    st->values[idx].type = (container == '{') ? 'o' : 'a';
+    st->values[idx].raw = valuestart;
+    st->values[idx].rawlength = (uint32_t)(st->cur - valuestart);
+    st->foundmask |= ((uint64_t)1 << idx);
+  }
+
+  return (st->foundmask == st->scanner->allmask) ? 1 : 0;
+}
+
+/** ************************************************************************
+ * @brief Extract the values of a set of JSON Pointers from extra headers
+ *
+ * Scan the extra headers of @p msr once, extracting the values at the
+ * JSON Pointers compiled into @p scanner with mseh_scanner_init().  No
+ * JSON document is constructed and no memory is allocated, subtrees
+ * that do not contain a target are skipped without decoding and the
+ * scan ends as soon as all values are found.
+ *
+ * The @p values array must contain an entry for each pointer in the
+ * order supplied to mseh_scanner_init().  For each value the type is
+ * set as returned by mseh_get_ptr_type(), with 0 indicating the pointer
+ * was not found (or refers to a null value).  Number values are
+ * provided in @ref MSEHScanValue.numbervalue and, if integers, in
+ * @ref MSEHScanValue.intvalue and @ref MSEHScanValue.uintvalue as
+ * appropriate.
+ *
+ * String values are referenced in place in @ref MS3Record.extra and
+ * are not terminated, escape sequences are not decoded.  All references
+ * are valid until the extra headers of @p msr are modified or freed.
+ *
+ * The extra headers are not validated beyond what is needed to locate
+ * the values, use mseh_get_ptr_r() for complete validation.  Pending
+ * changes in an extra header cache must be serialized with
+ * mseh_cache_flush() before scanning.
+ *
+ * @param[in] scanner ::MSEHScanner with compiled JSON Pointers
+ * @param[in] msr ::MS3Record with extra headers to scan
+ * @param[out] values Array of ::MSEHScanValue, one for each pointer
+ *
+ * @returns the number of values found on success, otherwise a (negative)
+ * libmseed error code.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see mseh_scanner_init()
+ * @see mseh_get_ptr_r()
+ ***************************************************************************/
+int
+mseh_scan (const MSEHScanner *scanner, const MS3Record *msr, MSEHScanValue *values)
+{
+  MSEHScanState st;
+  int found = 0;
+  int idx;
+
+  if (!scanner || !msr || !values)
+  {
+    ms_log (2, "%s() Required input not defined: 'scanner', 'msr', or 'values'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  memset (values, 0, sizeof (MSEHScanValue) * scanner->count);
+
+  /* Values are referenced in place, the record is not modified */
+  if (msr->extracache && msr->extracache->modified)
+  {
+    ms_log (2, "%s() Extra headers have cached changes, call mseh_cache_flush() first\n",
+            __func__);
+    return MS_GENERROR;
+  }
+
+  /* Nothing can be found in no headers */
+  if (!msr->extralength)
+    return 0;
+
+  if (!msr->extra)
+  {
+    ms_log (2, "%s() Expected extra headers (msr->extra) are not present\n", __func__);
+    return MS_GENERROR;
+  }
+
+  st.start = msr->extra;
+  st.cur = msr->extra;
+  st.end = msr->extra + msr->extralength;
+  st.scanner = scanner;
+  st.values = values;
+  st.foundmask = 0;
+
+  if (scan_value (&st, 0, scanner->allmask) < 0)
+  {
+    ms_log (2, "%s: Cannot scan extra header JSON at byte offset %d\n", msr->sid,
+            (int)(st.cur - st.start));
+    return MS_GENERROR;
+  }
+
+  for (idx = 0; idx < scanner->count; idx++)
+  {
+    if (values[idx].type)
+      found++;
+  }
+
+  return found;
+} /* End of mseh_scan() */
@@ -41,8 +41,12 @@ struct LM_PARSED_JSON_s
 {
   yyjson_doc *doc;
   yyjson_mut_doc *mut_doc;
+  int8_t modified; /* Mutable document has changes not yet serialized */
 };
 
+/* Provide a copy of a record with pending extra header cache changes serialized */
+int mseh_cache_view (const MS3Record *msr, MS3Record *view);
+
 #ifdef __cplusplus
 }
 #endif
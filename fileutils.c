@@ -27,7 +27,9 @@
 #include <time.h>
 
 #include "libmseed.h"
+#include "internalstate.h"
 #include "msio.h"
+#include "unpack.h"
 
 /* Skip length in bytes when skipping non-data */
 #define SKIPLEN 1
@@ -55,6 +57,20 @@ libmseed_url_support (void)
 #endif
 } /* End of libmseed_url_support() */
 
+/** ************************************************************************
+ * @brief Run-time test for asynchronous read-ahead support in libmseed.
+ *
+ * Read-ahead requires building with \b LIBMSEED_IOURING on Linux and
+ * a kernel that permits io_uring.
+ *
+ * @returns 0 when files are read with stdio, non-zero when read-ahead is used.
+ ***************************************************************************/
+int
+libmseed_readahead_support (void)
+{
+  return msio_readahead_support ();
+} /* End of libmseed_readahead_support() */
+
 /** ************************************************************************
  * @brief Initialize ::MS3FileParam parameters for a file descriptor
  *
@@ -204,6 +220,188 @@ ms3_shift_msfp (MS3FileParam *msfp, int shift)
 /* Macro to return current reading position */
 #define MSFPREADPTR(MSFP) (MSFP->readbuffer + MSFP->readoffset)
 
+/* Number of records probed to detect a time-ordered file layout */
+#define SEEKPROBES 8
+
+/***************************************************************************
+ * Read the header summary of the record at a specified index in a file
+ * of fixed length records.  If @p sid is not NULL the record must have
+ * the same source identifier.
+ *
+ * Returns 0 on success and -1 when a record of the expected length (and
+ * source identifier) could not be read at the index.
+ ***************************************************************************/
+static int
+lm_probe_record (FILE *fp, char *buffer, int64_t reclen, int64_t index, const char *sid,
+                 nstime_t *starttime, nstime_t *endtime)
+{
+  char probesid[LM_SIDLEN];
+  uint8_t formatversion;
+  uint8_t pubversion;
+
+  if (lmp_fseek64 (fp, index * reclen, SEEK_SET) ||
+      fread (buffer, 1, (size_t)reclen, fp) != (size_t)reclen)
+    return -1;
+
+  if (ms3_detect (buffer, (uint64_t)reclen, &formatversion) != reclen ||
+      ms3_header_summary (buffer, (int)reclen, formatversion, probesid, starttime, endtime,
+                          &pubversion))
+    return -1;
+
+  if (sid && strcmp (sid, probesid))
+    return -1;
+
+  return 0;
+} /* End of lm_probe_record() */
+
+/***************************************************************************
+ * Determine the start and end offsets of the range of records in a
+ * file that may intersect the time windows of the selections.
+ *
+ * This is only possible for files that contain records of a fixed
+ * length for a single source identifier in time order.  The layout is
+ * tested by probing a few records spread across the file, after which
+ * the first record ending at or after the earliest selection start time
+ * and the first record starting after the latest selection end time are
+ * found with binary searches of the record headers.
+ *
+ * The @p buffer must be at least MAXRECLEN bytes.  The file position
+ * of @p fp is left undefined.
+ *
+ * Returns 0 when the offsets are set and -1 when seeking is not possible
+ * for the file or selections.
+ ***************************************************************************/
+static int
+lm_selection_range (FILE *fp, char *buffer, const MS3Selections *selections,
+                    int64_t *startoffset, int64_t *endoffset)
+{
+  const MS3Selections *select;
+  const MS3SelectTime *selecttime;
+  nstime_t earliest = NSTUNSET;
+  nstime_t latest = NSTUNSET;
+  int8_t openstart = 0;
+  int8_t openend = 0;
+  char sid[LM_SIDLEN];
+  nstime_t starttime;
+  nstime_t endtime;
+  nstime_t prevstart;
+  uint8_t formatversion;
+  uint8_t pubversion;
+  int64_t filesize;
+  int64_t reclen;
+  int64_t nrecords;
+  int64_t readsize;
+  int64_t lo, hi, mid;
+  int64_t first;
+  int64_t last;
+  int idx;
+
+  /* Determine the earliest start and latest end of all selection time windows */
+  for (select = selections; select && !(openstart && openend); select = select->next)
+  {
+    if (!select->timewindows)
+      openstart = openend = 1;
+
+    for (selecttime = select->timewindows; selecttime; selecttime = selecttime->next)
+    {
+      if (selecttime->starttime == NSTUNSET || selecttime->starttime == NSTERROR)
+        openstart = 1;
+      else if (earliest == NSTUNSET || selecttime->starttime < earliest)
+        earliest = selecttime->starttime;
+
+      if (selecttime->endtime == NSTUNSET || selecttime->endtime == NSTERROR)
+        openend = 1;
+      else if (latest == NSTUNSET || selecttime->endtime > latest)
+        latest = selecttime->endtime;
+    }
+  }
+
+  if (openstart && openend)
+    return -1;
+
+  /* Determine file size and record length from the first record */
+  if (lmp_fseek64 (fp, 0, SEEK_END) || (filesize = lmp_ftell64 (fp)) < 0)
+    return -1;
+
+  readsize = (filesize < MAXRECLEN) ? filesize : MAXRECLEN;
+
+  if (lmp_fseek64 (fp, 0, SEEK_SET) ||
+      fread (buffer, 1, (size_t)readsize, fp) != (size_t)readsize)
+    return -1;
+
+  reclen = ms3_detect (buffer, (uint64_t)readsize, &formatversion);
+
+  if (reclen < MINRECLEN || reclen > readsize || (filesize % reclen) != 0 ||
+      ms3_header_summary (buffer, (int)reclen, formatversion, sid, &starttime, &endtime,
+                          &pubversion))
+    return -1;
+
+  nrecords = filesize / reclen;
+
+  /* Not worth seeking in small files */
+  if (nrecords < SEEKPROBES)
+    return -1;
+
+  /* Probe records across the file for identical SID and increasing start times */
+  prevstart = starttime;
+  for (idx = 1; idx < SEEKPROBES; idx++)
+  {
+    if (lm_probe_record (fp, buffer, reclen, (nrecords - 1) * idx / (SEEKPROBES - 1), sid,
+                         &starttime, &endtime) ||
+        starttime < prevstart)
+      return -1;
+
+    prevstart = starttime;
+  }
+
+  /* Search for first record ending at or after the earliest selection start */
+  lo = 0;
+  hi = nrecords;
+  while (!openstart && lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+
+    if (lm_probe_record (fp, buffer, reclen, mid, sid, &starttime, &endtime))
+      return -1;
+
+    if (endtime < earliest)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  first = lo;
+
+  /* Search for first record starting after the latest selection end */
+  hi = nrecords;
+  while (!openend && lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+
+    if (lm_probe_record (fp, buffer, reclen, mid, sid, &starttime, &endtime))
+      return -1;
+
+    if (starttime <= latest)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  last = (openend) ? nrecords : lo;
+
+  /* No records in range, position stream at the end */
+  if (first >= last)
+  {
+    *startoffset = filesize - 1;
+    *endoffset = filesize - 1;
+  }
+  else
+  {
+    *startoffset = first * reclen;
+    *endoffset = (last < nrecords) ? last * reclen - 1 : 0;
+  }
+
+  return 0;
+} /* End of lm_selection_range() */
+
 /***************************************************************************
  * Implementation of MS3Record reading functions
  *
@@ -223,6 +421,8 @@ _ms3_readmsr_impl (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath,
   int readsize = 0;
   int readcount = 0;
   int retcode = MS_NOERROR;
+  int64_t detectlen;
+  uint8_t formatversion;
 
   if (!ppmsr || !ppmsfp)
   {
@@ -328,12 +528,34 @@ _ms3_readmsr_impl (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath,
     }
     else
     {
-      if (msio_fopen (&msfp->input, msfp->path, "rb", &msfp->startoffset, &msfp->endoffset))
+      /* Read-ahead is not used when seeking to selected records */
+      if (msio_fopen (&msfp->input, msfp->path, "rb", &msfp->startoffset, &msfp->endoffset,
+                      ((flags & MSF_SEEKSELECTION) && selections) ? 0 : MSIO_READAHEAD))
       {
         msr3_free (ppmsr);
         return MS_GENERROR;
       }
 
+      /* Seek to the range of records selected by time when requested and possible */
+      if ((flags & MSF_SEEKSELECTION) && selections && msfp->input.type == LMIO_FILE &&
+          msfp->startoffset == 0 && msfp->endoffset == 0)
+      {
+        if (lm_selection_range ((FILE *)msfp->input.handle, msfp->readbuffer, selections,
+                                &msfp->startoffset, &msfp->endoffset) == 0 &&
+            verbose > 1)
+        {
+          ms_log (0, "Seeking to selected byte range %" PRId64 "-%" PRId64 " in %s\n",
+                  msfp->startoffset, msfp->endoffset, msfp->path);
+        }
+
+        if (lmp_fseek64 ((FILE *)msfp->input.handle, msfp->startoffset, SEEK_SET))
+        {
+          ms_log (2, "Cannot seek in %s to offset %" PRId64 "\n", msfp->path, msfp->startoffset);
+          msr3_free (ppmsr);
+          return MS_GENERROR;
+        }
+      }
+
       /* Set stream position to start offset */
       if (msfp->startoffset > 0)
       {
@@ -387,6 +609,7 @@ _ms3_readmsr_impl (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath,
 
       /* Update read buffer length */
       msfp->readlength += readcount;
+      LM_METRIC_ADD (bytesread, (readcount > 0) ? readcount : 0);
     }
 
     /* Attempt to parse record from buffer */
@@ -396,6 +619,26 @@ _ms3_readmsr_impl (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath,
       if (msio_feof (&msfp->input))
         pflags |= MSF_ATENDOFFILE;
 
+      /* Test selections against the raw header, skipping non-matching records without parsing */
+      if (selections &&
+          (detectlen = ms3_detect (MSFPREADPTR (msfp), MSFPBUFLEN (msfp), &formatversion)) >=
+              MINRECLEN &&
+          detectlen <= MAXRECLEN && detectlen <= MSFPBUFLEN (msfp) &&
+          !ms3_matchselect_header (selections, MSFPREADPTR (msfp), (int)detectlen, formatversion))
+      {
+        if (verbose > 1)
+        {
+          ms_log (0, "Skipping (selection) record of %" PRId64 " bytes starting at offset %" PRId64 "\n",
+                  detectlen, msfp->streampos);
+        }
+
+        /* Skip record length bytes, update reading offset and file position */
+        msfp->readoffset += detectlen;
+        msfp->streampos += detectlen;
+        parseval = 0;
+        continue;
+      }
+
       parseval = msr3_parse (MSFPREADPTR (msfp), MSFPBUFLEN (msfp), ppmsr, pflags, verbose);
 
       /* Record detected and parsed */
@@ -448,11 +691,15 @@ _ms3_readmsr_impl (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath,
         /* Skip non-data if requested */
         if (flags & MSF_SKIPNOTDATA)
         {
-          if (verbose > 1)
-          {
-            ms_log (0, "Skipped %d bytes of non-data record at byte offset %" PRId64 "\n", SKIPLEN,
-                    msfp->streampos);
-          }
+          MSDiagEvent event = {.code = MSDIAG_SKIPPED_NOTDATA,
+                               .level = 0,
+                               .errorcode = parseval,
+                               .function = __func__,
+                               .sid = NULL,
+                               .offset = msfp->streampos,
+                               .value = {SKIPLEN, 0}};
+
+          lm_diag_event (&event, (verbose > 1));
 
           /* Skip SKIPLEN bytes, update reading offset and file position */
           msfp->readoffset += SKIPLEN;
@@ -635,6 +882,15 @@ ms3_readmsr_r (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath, uin
  *
  * @param[in] selections Specify limits to which data should be
  * returned, see @ref data-selections
+ *
+ * If ::MSF_SEEKSELECTION is set in @p flags and @p selections include
+ * time windows, a local file is probed for a layout of fixed length
+ * records for a single source ID in time order.  If detected, the range
+ * of records that may intersect the selection time windows is located
+ * using a binary search of record headers and ::MS3FileParam.startoffset
+ * and ::MS3FileParam.endoffset are set to read only that range.  Files
+ * with any other layout are read in full.  This flag is ignored if a
+ * start or end offset is already set.
  ***************************************************************************/
 int
 ms3_readmsr_selection (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath, uint32_t flags,
@@ -736,7 +992,10 @@ ms3_readtracelist_timewin (MS3TraceList **ppmstl, const char *mspath, const MS3T
  * @param[in] flags
  * @parblock
  *  - @c ::MSF_RECORDLIST : Build a ::MS3RecordList for each ::MS3TraceSeg
+ *  - @c ::MSF_INTERNEXTRA : Share identical extra headers of ::MS3RecordList entries
  *  - @c ::MSF_SKIPADJACENTDUPLICATES : Skip adjacent duplicate records
+ *  - @c ::MSF_SKIPDUPLICATES : Skip records duplicating any already in the trace list
+ *  - @c ::MSF_SEEKSELECTION : Seek to selected time range, see ms3_readmsr_selection()
  *  - Flags supported by msr3_parse()
  *  - Flags supported by mstl3_addmsr()
  * @endparblock
@@ -788,7 +1047,10 @@ ms3_readtracelist_selection (MS3TraceList **ppmstl, const char *mspath,
   {
     if (flags & MSF_SKIPADJACENTDUPLICATES)
     {
-      uint32_t crc = ms_crc32c ((const uint8_t *)msr->record, msr->reclen, 0);
+      /* Use the CRC stored in version 3 records, otherwise calculate it */
+      uint32_t crc = (msr->formatversion == 3 && msr->crc)
+                         ? msr->crc
+                         : ms_crc32c ((const uint8_t *)msr->record, msr->reclen, 0);
 
       if (crc == previous_crc)
       {
@@ -798,6 +1060,21 @@ ms3_readtracelist_selection (MS3TraceList **ppmstl, const char *mspath,
       previous_crc = crc;
     }
 
+    if (flags & MSF_SKIPDUPLICATES)
+    {
+      if ((retcode = lm_skip_duplicate (*ppmstl, msr, splitversion, flags)) < 0)
+      {
+        retcode = MS_GENERROR;
+        break;
+      }
+
+      if (retcode)
+      {
+        retcode = MS_NOERROR;
+        continue;
+      }
+    }
+
     seg = mstl3_addmsr_recordptr (*ppmstl, msr, (flags & MSF_RECORDLIST) ? &recordptr : NULL,
                                   splitversion, 1, flags, tolerance);
 
@@ -972,19 +1249,14 @@ ms3_url_freeheaders (void)
  * @ref MessageOnError - this function logs a message on error
  *
  * @see msr3_pack()
+ * @see ms3_writer_open()
  ***************************************************************************/
 int64_t
 msr3_writemseed (MS3Record *msr, const char *mspath, int8_t overwrite, uint32_t flags,
                  int8_t verbose)
 {
-  FILE *ofp;
-  const char *perms = (overwrite) ? "wb" : "ab";
-  int64_t packedrecords = 0;
-
-  MS3RecordPacker *packer;
-  char *record = NULL;
-  int32_t reclen = 0;
-  int result;
+  MS3Writer *writer;
+  int64_t packedrecords;
 
   if (!msr || !mspath)
   {
@@ -993,58 +1265,18 @@ msr3_writemseed (MS3Record *msr, const char *mspath, int8_t overwrite, uint32_t
   }
 
   /* Open output file or use stdout */
-  if (strcmp (mspath, "-") == 0)
-  {
-    ofp = stdout;
-  }
-  else if ((ofp = fopen (mspath, perms)) == NULL)
-  {
-    ms_log (2, "Cannot open output file %s: %s\n", mspath, strerror (errno));
+  if ((writer = ms3_writer_open (mspath, overwrite, 0)) == NULL)
     return -1;
-  }
 
-  /* Initialize packer */
-  packer = msr3_pack_init (msr, flags, verbose);
-  if (!packer)
-    return -1;
+  packedrecords = ms3_writer_writemsr (writer, msr, flags, verbose);
 
-  /* Pack the MS3Record */
-  while ((result = msr3_pack_next (packer, &record, &reclen)) == 1)
-  {
-    if (fwrite (record, reclen, 1, (FILE *)ofp) != 1)
-    {
-      ms_log (2, "Error writing to output file\n");
-      break;
-    }
-
-    packedrecords++;
-  }
-
-  /* Free packer and get total packed samples */
-  msr3_pack_free (&packer, NULL);
-
-  /* Close file and return record count */
-  if (ofp != stdout)
-    fclose (ofp);
+  /* Flush and close file and return record count */
+  if (ms3_writer_close (&writer))
+    return -1;
 
   return packedrecords;
 } /* End of msr3_writemseed() */
 
-/***************************************************************************
- *
- * Internal record handler.  The handler data should be a pointer to
- * an open file descriptor to which records will be written.
- *
- ***************************************************************************/
-static void
-ms_record_handler_int (char *record, int reclen, void *ofp)
-{
-  if (fwrite (record, reclen, 1, (FILE *)ofp) != 1)
-  {
-    ms_log (2, "Error writing to output file\n");
-  }
-} /* End of ms_record_handler_int() */
-
 /** ************************************************************************
  * @brief Write miniSEED from an ::MS3TraceList container to a file
  *
@@ -1071,14 +1303,14 @@ ms_record_handler_int (char *record, int reclen, void *ofp)
  *
  * @see mstl3_pack()
  * @see msr3_pack()
+ * @see ms3_writer_open()
  ***************************************************************************/
 int64_t
 mstl3_writemseed (MS3TraceList *mstl, const char *mspath, int8_t overwrite, int maxreclen,
                   int8_t encoding, uint32_t flags, int8_t verbose)
 {
-  FILE *ofp;
-  const char *perms = (overwrite) ? "wb" : "ab";
-  int64_t packedrecords = 0;
+  MS3Writer *writer;
+  int64_t packedrecords;
 
   if (!mstl || !mspath)
   {
@@ -1087,28 +1319,15 @@ mstl3_writemseed (MS3TraceList *mstl, const char *mspath, int8_t overwrite, int
   }
 
   /* Open output file or use stdout */
-  if (strcmp (mspath, "-") == 0)
-  {
-    ofp = stdout;
-  }
-  else if ((ofp = fopen (mspath, perms)) == NULL)
-  {
-    ms_log (2, "Cannot open output file %s: %s\n", mspath, strerror (errno));
+  if ((writer = ms3_writer_open (mspath, overwrite, 0)) == NULL)
     return -1;
-  }
-
-  /* Do not modify the trace list during packing */
-  flags |= MSF_MAINTAINMSTL;
 
-  /* Pack all data */
-  flags |= MSF_FLUSHDATA;
+  /* Pack all data without modifying the trace list */
+  packedrecords = ms3_writer_writemstl (writer, mstl, maxreclen, encoding, flags, verbose);
 
-  packedrecords = mstl3_pack (mstl, &ms_record_handler_int, ofp, maxreclen, encoding, NULL, flags,
-                              verbose, NULL);
-
-  /* Close file and return record count */
-  if (ofp != stdout)
-    fclose (ofp);
+  /* Flush and close file and return record count */
+  if (ms3_writer_close (&writer))
+    return -1;
 
   return packedrecords;
 } /* End of mstl3_writemseed() */
@@ -24,15 +24,27 @@
 #include <string.h>
 #include <time.h>
 
-#include "gmtime64.h"
 #include "libmseed.h"
+#include "internalstate.h"
+
+/* SSE2 is part of every x86-64 target */
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LM_SAMPLESTATS_SSE2 1
+#endif
 
 static nstime_t ms_time2nstime_int (int year, int day, int hour, int min, int sec, uint32_t nsec);
+static int lm_isotime2nstime (const char *timestr, nstime_t *nstime);
 
 /** @cond UNDOCUMENTED */
 
 /* Global set of allocation functions, defaulting to system malloc(), realloc() and free() */
+#if defined(LIBMSEED_METRICS)
+LIBMSEED_MEMORY libmseed_memory = {
+    .malloc = lm_metrics_malloc, .realloc = lm_metrics_realloc, .free = free};
+#else
 LIBMSEED_MEMORY libmseed_memory = {.malloc = malloc, .realloc = realloc, .free = free};
+#endif
 
 /* Global pre-allocation block size, default 1 MiB on Windows, disabled otherwise */
 #if defined(LMP_WIN)
@@ -163,6 +175,16 @@ static LeapSecond embedded_leapsecondlist[] = {
 /* Global variable to hold a leap second list */
 LeapSecond *leapsecondlist = &embedded_leapsecondlist[0];
 
+/* Sorted array view of the leap second list for searching.  When the global
+ * list is an array owned by the library (embedded or loaded from a file),
+ * 'base' is the same as leapsecondlist and the entries are contiguous. */
+static struct
+{
+  LeapSecond *base; /* First entry, same as leapsecondlist when current */
+  int count;        /* Number of entries */
+} leapsecondtable = {&embedded_leapsecondlist[0],
+                     sizeof (embedded_leapsecondlist) / sizeof (embedded_leapsecondlist[0])};
+
 /* Days in each month, for non-leap and leap years */
 static const int monthdays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
 static const int monthdays_leap[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
@@ -195,6 +217,40 @@ static const int monthdays_leap[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30,
 /* Check that a nanosecond is in a valid range */
 #define VALIDNANOSEC(nanosec) (nanosec <= 999999999)
 
+/* Day-of-year before the first of each month, for non-leap years */
+static const int monthstartdays[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+/* Two-character decimal representations of 00 through 99 */
+static const char digitpairs[] = "00010203040506070809"
+                                 "10111213141516171819"
+                                 "20212223242526272829"
+                                 "30313233343536373839"
+                                 "40414243444546474849"
+                                 "50515253545556575859"
+                                 "60616263646566676869"
+                                 "70717273747576777879"
+                                 "80818283848586878889"
+                                 "90919293949596979899";
+
+/* Civil date of a day since the epoch, with pre-rendered date strings */
+typedef struct LM_CIVILDAY_s
+{
+  int64_t day;    /* Days since the Unix/POSIX epoch */
+  int year;       /* Year with century */
+  int month;      /* Month, 1 - 12 */
+  int mday;       /* Day-of-month, 1 - 31 */
+  int yday;       /* Day-of-year, 1 - 366 */
+  char mdstr[10]; /* "YYYY-MM-DD", not terminated */
+  char ordstr[8]; /* "YYYY,DDD", not terminated */
+} LM_CIVILDAY;
+
+/* Most recently converted day, consecutive time values nearly always share the day */
+#if !defined(LIBMSEED_NO_THREADING)
+static lm_thread_local LM_CIVILDAY civildaycache = {.day = INT64_MIN};
+#else
+static LM_CIVILDAY civildaycache = {.day = INT64_MIN};
+#endif
+
 /** @endcond */
 
 /** ************************************************************************
@@ -956,6 +1012,131 @@ ms_md2doy (int year, int month, int mday, int *yday)
   return 0;
 } /* End of ms_md2doy() */
 
+/***************************************************************************
+ * INTERNAL Write a value in the range 0-99 as two decimal digits.
+ ***************************************************************************/
+static inline char *
+lm_put2digits (char *cp, int value)
+{
+  memcpy (cp, &digitpairs[value * 2], 2);
+  return cp + 2;
+} /* End of lm_put2digits() */
+
+/***************************************************************************
+ * INTERNAL Write a non-negative value as a fixed number of decimal
+ * digits with leading zeros, equivalent to printf("%0*d").
+ ***************************************************************************/
+static inline char *
+lm_putfixeddigits (char *cp, uint32_t value, int digits)
+{
+  char *end = cp + digits;
+  char *dp = end;
+
+  while (dp > cp)
+  {
+    *--dp = (char)('0' + (value % 10));
+    value /= 10;
+  }
+
+  return end;
+} /* End of lm_putfixeddigits() */
+
+/***************************************************************************
+ * INTERNAL Write a signed 64-bit value as decimal digits, equivalent to
+ * printf("%" PRId64).
+ ***************************************************************************/
+static char *
+lm_putint64 (char *cp, int64_t value)
+{
+  char digits[20];
+  uint64_t magnitude;
+  int count = 0;
+
+  if (value < 0)
+  {
+    *cp++ = '-';
+    magnitude = (uint64_t)0 - (uint64_t)value;
+  }
+  else
+  {
+    magnitude = (uint64_t)value;
+  }
+
+  do
+  {
+    digits[count++] = (char)('0' + (magnitude % 10));
+    magnitude /= 10;
+  } while (magnitude);
+
+  while (count > 0)
+    *cp++ = digits[--count];
+
+  return cp;
+} /* End of lm_putint64() */
+
+/***************************************************************************
+ * INTERNAL Determine the civil date for a day relative to the Unix/POSIX
+ * epoch (1970-01-01 is day 0) in the proleptic Gregorian calendar.
+ * The day must be derived from an ::nstime_t value.
+ *
+ * The conversion maps days to 400-year eras of a calendar starting on
+ * March 1st, which places the leap day at the end of the year, a
+ * method described by Howard Hinnant in "chrono-Compatible Low-Level
+ * Date Algorithms".
+ *
+ * The result for the most recent day is cached per thread along with
+ * rendered date strings, as sequences of time values nearly always
+ * fall in the same day.
+ *
+ * Returns a pointer to the cached day.
+ ***************************************************************************/
+static const LM_CIVILDAY *
+lm_civilday (int64_t day)
+{
+  LM_CIVILDAY *cd = &civildaycache;
+  int64_t era;
+  int64_t dayofera;
+  int64_t yearofera;
+  int64_t marchyday;
+  int64_t monthindex;
+  char *cp;
+
+  if (cd->day == day)
+    return cd;
+
+  day += 719468; /* Shift epoch to 0000-03-01 */
+  era = ((day >= 0) ? day : day - 146096) / 146097;
+  dayofera = day - era * 146097;
+  yearofera = (dayofera - dayofera / 1460 + dayofera / 36524 - dayofera / 146096) / 365;
+  marchyday = dayofera - (365 * yearofera + yearofera / 4 - yearofera / 100);
+  monthindex = (5 * marchyday + 2) / 153;
+
+  cd->day = day - 719468;
+  cd->mday = (int)(marchyday - (153 * monthindex + 2) / 5 + 1);
+  cd->month = (int)((monthindex < 10) ? monthindex + 3 : monthindex - 9);
+  cd->year = (int)(yearofera + era * 400 + (cd->month <= 2));
+
+  /* Day-of-year, March 1st is day 60 in a non-leap year */
+  if (cd->month <= 2)
+    cd->yday = (int)(marchyday - 306 + 1);
+  else
+    cd->yday = (int)(marchyday + 59 + (LEAPYEAR (cd->year) ? 1 : 0) + 1);
+
+  /* Render date strings, the range of nstime_t limits years to 1677 - 2262 */
+  cp = lm_put2digits (cd->mdstr, cd->year / 100);
+  cp = lm_put2digits (cp, cd->year % 100);
+  *cp++ = '-';
+  cp = lm_put2digits (cp, cd->month);
+  *cp++ = '-';
+  lm_put2digits (cp, cd->mday);
+
+  memcpy (cd->ordstr, cd->mdstr, 4);
+  cd->ordstr[4] = ',';
+  lm_putfixeddigits (&cd->ordstr[5], (uint32_t)cd->yday, 3);
+
+  return cd;
+} /* End of lm_civilday() */
+
 /** ************************************************************************
  * @brief Convert an ::nstime_t to individual date-time components
  *
@@ -977,8 +1158,10 @@ int
 ms_nstime2time (nstime_t nstime, uint16_t *year, uint16_t *yday, uint8_t *hour, uint8_t *min,
                 uint8_t *sec, uint32_t *nsec)
 {
-  struct tm tms;
+  const LM_CIVILDAY *cd;
   int64_t isec;
+  int64_t day;
+  int secofday;
   int32_t ifract;
 
   /* Reduce to Unix/POSIX epoch time and fractional seconds */
@@ -992,24 +1175,35 @@ ms_nstime2time (nstime_t nstime, uint16_t *year, uint16_t *yday, uint8_t *hour,
     ifract = NSTMODULUS - (-ifract);
   }
 
-  if (year || yday || hour || min || sec)
-    if (!(ms_gmtime64_r (&isec, &tms)))
-      return -1;
+  /* Split into days since the epoch and seconds of the day */
+  day = isec / 86400;
+  secofday = (int)(isec - day * 86400);
 
-  if (year)
-    *year = tms.tm_year + 1900;
+  if (secofday < 0)
+  {
+    day -= 1;
+    secofday += 86400;
+  }
 
-  if (yday)
-    *yday = tms.tm_yday + 1;
+  if (year || yday)
+  {
+    cd = lm_civilday (day);
+
+    if (year)
+      *year = (uint16_t)cd->year;
+
+    if (yday)
+      *yday = (uint16_t)cd->yday;
+  }
 
   if (hour)
-    *hour = tms.tm_hour;
+    *hour = (uint8_t)(secofday / 3600);
 
   if (min)
-    *min = tms.tm_min;
+    *min = (uint8_t)((secofday / 60) % 60);
 
   if (sec)
-    *sec = tms.tm_sec;
+    *sec = (uint8_t)(secofday % 60);
 
   if (nsec)
     *nsec = ifract;
@@ -1046,15 +1240,19 @@ char *
 ms_nstime2timestr_n (nstime_t nstime, char *timestr, size_t timestrsize, ms_timeformat_t timeformat,
                      ms_subseconds_t subseconds)
 {
-  struct tm tms = {0};
+  const LM_CIVILDAY *cd = NULL;
+  char buffer[48];
+  char *cp = buffer;
   int64_t rawisec;
   int rawnanosec;
   int64_t isec;
+  int64_t day;
+  int secofday;
   int nanosec;
   int microsec;
   int submicro;
-  int printed = 0;
-  int expected = 0;
+  int digits;
+  size_t length;
 
   if (!timestr)
   {
@@ -1090,141 +1288,22 @@ ms_nstime2timestr_n (nstime_t nstime, char *timestr, size_t timestrsize, ms_time
   microsec = nanosec / 1000;
   submicro = nanosec - (microsec * 1000);
 
-  /* Calculate date-time parts if needed by format */
-  if (timeformat == ISOMONTHDAY || timeformat == ISOMONTHDAY_Z || timeformat == ISOMONTHDAY_DOY ||
-      timeformat == ISOMONTHDAY_DOY_Z || timeformat == ISOMONTHDAY_SPACE ||
-      timeformat == ISOMONTHDAY_SPACE_Z || timeformat == SEEDORDINAL)
-  {
-    if (!(ms_gmtime64_r (&isec, &tms)))
-    {
-      ms_log (2, "Error converting epoch-time of (%" PRId64 ") to date-time components\n", isec);
-      return NULL;
-    }
-  }
-
-  /* Print no subseconds */
+  /* Determine subsecond digits: none, microseconds or nanoseconds */
   if (subseconds == NONE || (subseconds == MICRO_NONE && microsec == 0) ||
       (subseconds == NANO_NONE && nanosec == 0) || (subseconds == NANO_MICRO_NONE && nanosec == 0))
   {
-    switch (timeformat)
-    {
-    case ISOMONTHDAY:
-    case ISOMONTHDAY_Z:
-    case ISOMONTHDAY_SPACE:
-    case ISOMONTHDAY_SPACE_Z:
-      expected = (timeformat == ISOMONTHDAY_Z || timeformat == ISOMONTHDAY_SPACE_Z) ? 20 : 19;
-      printed = snprintf (
-          timestr, timestrsize, "%4d-%02d-%02d%c%02d:%02d:%02d%s", tms.tm_year + 1900,
-          tms.tm_mon + 1, tms.tm_mday,
-          (timeformat == ISOMONTHDAY_SPACE || timeformat == ISOMONTHDAY_SPACE_Z) ? ' ' : 'T',
-          tms.tm_hour, tms.tm_min, tms.tm_sec,
-          (timeformat == ISOMONTHDAY_Z || timeformat == ISOMONTHDAY_SPACE_Z) ? "Z" : "");
-      break;
-    case ISOMONTHDAY_DOY:
-    case ISOMONTHDAY_DOY_Z:
-      expected = (timeformat == ISOMONTHDAY_DOY_Z) ? 26 : 25;
-      printed =
-          snprintf (timestr, timestrsize, "%4d-%02d-%02dT%02d:%02d:%02d%s (%03d)",
-                    tms.tm_year + 1900, tms.tm_mon + 1, tms.tm_mday, tms.tm_hour, tms.tm_min,
-                    tms.tm_sec, (timeformat == ISOMONTHDAY_DOY_Z) ? "Z" : "", tms.tm_yday + 1);
-      break;
-    case SEEDORDINAL:
-      expected = 17;
-      printed = snprintf (timestr, timestrsize, "%4d,%03d,%02d:%02d:%02d", tms.tm_year + 1900,
-                          tms.tm_yday + 1, tms.tm_hour, tms.tm_min, tms.tm_sec);
-      break;
-    case UNIXEPOCH:
-      expected = -1;
-      printed = snprintf (timestr, timestrsize, "%" PRId64, rawisec);
-      break;
-    case NANOSECONDEPOCH:
-      expected = -1;
-      printed = snprintf (timestr, timestrsize, "%" PRId64, nstime);
-      break;
-    }
+    digits = 0;
   }
-  /* Print microseconds */
   else if (subseconds == MICRO || (subseconds == MICRO_NONE && microsec) ||
            (subseconds == NANO_MICRO && submicro == 0) ||
            (subseconds == NANO_MICRO_NONE && submicro == 0))
   {
-    switch (timeformat)
-    {
-    case ISOMONTHDAY:
-    case ISOMONTHDAY_Z:
-    case ISOMONTHDAY_SPACE:
-    case ISOMONTHDAY_SPACE_Z:
-      expected = (timeformat == ISOMONTHDAY_Z || timeformat == ISOMONTHDAY_SPACE_Z) ? 27 : 26;
-      printed = snprintf (
-          timestr, timestrsize, "%4d-%02d-%02d%c%02d:%02d:%02d.%06d%s", tms.tm_year + 1900,
-          tms.tm_mon + 1, tms.tm_mday,
-          (timeformat == ISOMONTHDAY_SPACE || timeformat == ISOMONTHDAY_SPACE_Z) ? ' ' : 'T',
-          tms.tm_hour, tms.tm_min, tms.tm_sec, microsec,
-          (timeformat == ISOMONTHDAY_Z || timeformat == ISOMONTHDAY_SPACE_Z) ? "Z" : "");
-      break;
-    case ISOMONTHDAY_DOY:
-    case ISOMONTHDAY_DOY_Z:
-      expected = (timeformat == ISOMONTHDAY_DOY_Z) ? 33 : 32;
-      printed = snprintf (timestr, timestrsize, "%4d-%02d-%02dT%02d:%02d:%02d.%06d%s (%03d)",
-                          tms.tm_year + 1900, tms.tm_mon + 1, tms.tm_mday, tms.tm_hour, tms.tm_min,
-                          tms.tm_sec, microsec, (timeformat == ISOMONTHDAY_DOY_Z) ? "Z" : "",
-                          tms.tm_yday + 1);
-      break;
-    case SEEDORDINAL:
-      expected = 24;
-      printed = snprintf (timestr, timestrsize, "%4d,%03d,%02d:%02d:%02d.%06d", tms.tm_year + 1900,
-                          tms.tm_yday + 1, tms.tm_hour, tms.tm_min, tms.tm_sec, microsec);
-      break;
-    case UNIXEPOCH:
-      expected = -1;
-      printed = snprintf (timestr, timestrsize, "%" PRId64 ".%06d", rawisec, rawnanosec / 1000);
-      break;
-    case NANOSECONDEPOCH:
-      expected = -1;
-      printed = snprintf (timestr, timestrsize, "%" PRId64, nstime);
-      break;
-    }
+    digits = 6;
   }
-  /* Print nanoseconds */
   else if (subseconds == NANO || (subseconds == NANO_NONE && nanosec) ||
            (subseconds == NANO_MICRO && submicro) || (subseconds == NANO_MICRO_NONE && submicro))
   {
-    switch (timeformat)
-    {
-    case ISOMONTHDAY:
-    case ISOMONTHDAY_Z:
-    case ISOMONTHDAY_SPACE:
-    case ISOMONTHDAY_SPACE_Z:
-      expected = (timeformat == ISOMONTHDAY_Z || timeformat == ISOMONTHDAY_SPACE_Z) ? 30 : 29;
-      printed = snprintf (
-          timestr, timestrsize, "%4d-%02d-%02d%c%02d:%02d:%02d.%09d%s", tms.tm_year + 1900,
-          tms.tm_mon + 1, tms.tm_mday,
-          (timeformat == ISOMONTHDAY_SPACE || timeformat == ISOMONTHDAY_SPACE_Z) ? ' ' : 'T',
-          tms.tm_hour, tms.tm_min, tms.tm_sec, nanosec,
-          (timeformat == ISOMONTHDAY_Z || timeformat == ISOMONTHDAY_SPACE_Z) ? "Z" : "");
-      break;
-    case ISOMONTHDAY_DOY:
-    case ISOMONTHDAY_DOY_Z:
-      expected = (timeformat == ISOMONTHDAY_DOY_Z) ? 36 : 35;
-      printed = snprintf (timestr, timestrsize, "%4d-%02d-%02dT%02d:%02d:%02d.%09d%s (%03d)",
-                          tms.tm_year + 1900, tms.tm_mon + 1, tms.tm_mday, tms.tm_hour, tms.tm_min,
-                          tms.tm_sec, nanosec, (timeformat == ISOMONTHDAY_DOY_Z) ? "Z" : "",
-                          tms.tm_yday + 1);
-      break;
-    case SEEDORDINAL:
-      expected = 27;
-      printed = snprintf (timestr, timestrsize, "%4d,%03d,%02d:%02d:%02d.%09d", tms.tm_year + 1900,
-                          tms.tm_yday + 1, tms.tm_hour, tms.tm_min, tms.tm_sec, nanosec);
-      break;
-    case UNIXEPOCH:
-      expected = -1;
-      printed = snprintf (timestr, timestrsize, "%" PRId64 ".%09d", rawisec, rawnanosec);
-      break;
-    case NANOSECONDEPOCH:
-      expected = -1;
-      printed = snprintf (timestr, timestrsize, "%" PRId64, nstime);
-      break;
-    }
+    digits = 9;
   }
   /* Otherwise this is a unhandled combination of values, timeformat and subseconds */
   else
@@ -1237,12 +1316,94 @@ ms_nstime2timestr_n (nstime_t nstime, char *timestr, size_t timestrsize, ms_time
     return NULL;
   }
 
-  if (expected == 0 || (expected > 0 && printed != expected))
+  /* Calculate date-time parts if needed by format */
+  if (timeformat == ISOMONTHDAY || timeformat == ISOMONTHDAY_Z || timeformat == ISOMONTHDAY_DOY ||
+      timeformat == ISOMONTHDAY_DOY_Z || timeformat == ISOMONTHDAY_SPACE ||
+      timeformat == ISOMONTHDAY_SPACE_Z || timeformat == SEEDORDINAL)
+  {
+    day = isec / 86400;
+    secofday = (int)(isec - day * 86400);
+
+    if (secofday < 0)
+    {
+      day -= 1;
+      secofday += 86400;
+    }
+
+    cd = lm_civilday (day);
+
+    /* Date portion */
+    if (timeformat == SEEDORDINAL)
+    {
+      memcpy (cp, cd->ordstr, sizeof (cd->ordstr));
+      cp += sizeof (cd->ordstr);
+      *cp++ = ',';
+    }
+    else
+    {
+      memcpy (cp, cd->mdstr, sizeof (cd->mdstr));
+      cp += sizeof (cd->mdstr);
+      *cp++ = (timeformat == ISOMONTHDAY_SPACE || timeformat == ISOMONTHDAY_SPACE_Z) ? ' ' : 'T';
+    }
+
+    /* Time portion */
+    cp = lm_put2digits (cp, secofday / 3600);
+    *cp++ = ':';
+    cp = lm_put2digits (cp, (secofday / 60) % 60);
+    *cp++ = ':';
+    cp = lm_put2digits (cp, secofday % 60);
+
+    if (digits)
+    {
+      *cp++ = '.';
+      cp = lm_putfixeddigits (cp, (digits == 6) ? (uint32_t)microsec : (uint32_t)nanosec, digits);
+    }
+
+    if (timeformat == ISOMONTHDAY_Z || timeformat == ISOMONTHDAY_SPACE_Z ||
+        timeformat == ISOMONTHDAY_DOY_Z)
+      *cp++ = 'Z';
+
+    if (timeformat == ISOMONTHDAY_DOY || timeformat == ISOMONTHDAY_DOY_Z)
+    {
+      *cp++ = ' ';
+      *cp++ = '(';
+      cp = lm_putfixeddigits (cp, (uint32_t)cd->yday, 3);
+      *cp++ = ')';
+    }
+  }
+  else if (timeformat == UNIXEPOCH)
+  {
+    cp = lm_putint64 (cp, rawisec);
+
+    if (digits)
+    {
+      *cp++ = '.';
+      cp = lm_putfixeddigits (cp, (uint32_t)((digits == 6) ? rawnanosec / 1000 : rawnanosec),
+                              digits);
+    }
+  }
+  else if (timeformat == NANOSECONDEPOCH)
+  {
+    cp = lm_putint64 (cp, nstime);
+  }
+  else
   {
     ms_log (2, "Time string not generated with the expected length\n");
     return NULL;
   }
 
+  /* Copy to destination, truncating to the buffer size like snprintf() */
+  if (timestrsize > 0)
+  {
+    length = (size_t)(cp - buffer);
+
+    if (length >= timestrsize)
+      length = timestrsize - 1;
+
+    memcpy (timestr, buffer, length);
+    timestr[length] = '\0';
+  }
+
   return timestr;
 } /* End of ms_nstime2timestr_n() */
 
@@ -1313,6 +1474,94 @@ ms_time2nstime_int (int year, int yday, int hour, int min, int sec, uint32_t nse
   return nstime;
 } /* End of ms_time2nstime_int() */
 
+/***************************************************************************
+ * INTERNAL Convert a strict ISO month-day time string to a high
+ * precision epoch time.
+ *
+ * This is a fast path for the most common time string layout:
+ * "YYYY-MM-DD[(T| )HH:MM:SS[.F...]][Z|z]", with exactly 2-digit
+ * fields and 1 to 9 fractional second digits.  The string must
+ * contain nothing else.  The result is the same as returned by
+ * ms_mdtimestr2nstime().
+ *
+ * No messages are logged, strings that do not match the layout or
+ * contain out of range values are left to the generic parsers, which
+ * report errors.
+ *
+ * Returns 0 and sets nstime on success, -1 if not converted.
+ ***************************************************************************/
+static int
+lm_isotime2nstime (const char *timestr, nstime_t *nstime)
+{
+  const char *cp = timestr;
+  int year;
+  int mon;
+  int mday;
+  int yday;
+  int hour = 0;
+  int min = 0;
+  int sec = 0;
+  uint32_t nsec = 0;
+  int digits;
+
+#define LM_DIGIT(c) ((unsigned char)((c) - '0') <= 9)
+#define LM_2DIGITS(p) (((p)[0] - '0') * 10 + ((p)[1] - '0'))
+
+  if (!LM_DIGIT (cp[0]) || !LM_DIGIT (cp[1]) || !LM_DIGIT (cp[2]) || !LM_DIGIT (cp[3]) ||
+      cp[4] != '-' || !LM_DIGIT (cp[5]) || !LM_DIGIT (cp[6]) || cp[7] != '-' ||
+      !LM_DIGIT (cp[8]) || !LM_DIGIT (cp[9]))
+    return -1;
+
+  year = LM_2DIGITS (cp) * 100 + LM_2DIGITS (cp + 2);
+  mon = LM_2DIGITS (cp + 5);
+  mday = LM_2DIGITS (cp + 8);
+  cp += 10;
+
+  if (*cp == 'T' || *cp == ' ')
+  {
+    if (!LM_DIGIT (cp[1]) || !LM_DIGIT (cp[2]) || cp[3] != ':' || !LM_DIGIT (cp[4]) ||
+        !LM_DIGIT (cp[5]) || cp[6] != ':' || !LM_DIGIT (cp[7]) || !LM_DIGIT (cp[8]))
+      return -1;
+
+    hour = LM_2DIGITS (cp + 1);
+    min = LM_2DIGITS (cp + 4);
+    sec = LM_2DIGITS (cp + 7);
+    cp += 9;
+
+    if (*cp == '.')
+    {
+      for (cp++, digits = 0; LM_DIGIT (*cp) && digits < 9; cp++, digits++)
+        nsec = nsec * 10 + (uint32_t)(*cp - '0');
+
+      /* Require 1 to 9 digits */
+      if (digits == 0 || LM_DIGIT (*cp))
+        return -1;
+
+      for (; digits < 9; digits++)
+        nsec *= 10;
+    }
+
+    if (*cp == 'Z' || *cp == 'z')
+      cp++;
+  }
+
+#undef LM_DIGIT
+#undef LM_2DIGITS
+
+  if (*cp != '\0')
+    return -1;
+
+  if (!VALIDYEAR (year) || !VALIDMONTH (mon) || mday < 1 || !VALIDMONTHDAY (year, mon, mday) ||
+      !VALIDHOUR (hour) || !VALIDMIN (min) || !VALIDSEC (sec))
+    return -1;
+
+  yday = monthstartdays[mon - 1] + mday + ((mon > 2 && LEAPYEAR (year)) ? 1 : 0);
+
+  *nstime = ms_time2nstime_int (year, yday, hour, min, sec, nsec);
+
+  return 0;
+} /* End of lm_isotime2nstime() */
+
 /** ************************************************************************
  * @brief Convert specified date-time values to a high precision epoch time.
  *
@@ -1421,6 +1670,10 @@ ms_timestr2nstime (const char *timestr)
     return NSTERROR;
   }
 
+  /* Fast path for the common, strict ISO month-day format */
+  if (lm_isotime2nstime (timestr, &nstime) == 0)
+    return nstime;
+
   /* Determine first delimiter,
    * delimiter count before date-time separator,
    * number-like character count,
@@ -1566,6 +1819,7 @@ ms_mdtimestr2nstime (const char *timestr)
   int sec = 0;
   double fsec = 0.0;
   uint32_t nsec = 0;
+  nstime_t nstime;
 
   if (!timestr)
   {
@@ -1573,6 +1827,10 @@ ms_mdtimestr2nstime (const char *timestr)
     return NSTERROR;
   }
 
+  /* Fast path for the common, strict ISO month-day format */
+  if (lm_isotime2nstime (timestr, &nstime) == 0)
+    return nstime;
+
   fields = sscanf (timestr, "%d%*[-,/:.]%d%*[-,/:.]%d%*[-,/:.Tt ]%d%*[-,/:.]%d%*[-,/:.]%d%lf",
                    &year, &mon, &mday, &hour, &min, &sec, &fsec);
 
@@ -1732,6 +1990,42 @@ ms_seedtimestr2nstime (const char *seedtimestr)
   return ms_time2nstime_int (year, yday, hour, min, sec, nsec);
 } /* End of ms_seedtimestr2nstime() */
 
+/***************************************************************************
+ * INTERNAL Determine if a leap second occurs in a time range, exclusive of
+ * the start and inclusive of the end: start < leap second <= end.
+ *
+ * The leap second table is searched with a binary search after checking
+ * if the range is entirely outside the span of the table.
+ *
+ * Returns 1 if a leap second is in the range, otherwise 0.
+ ***************************************************************************/
+static int
+lm_leapsecond_in_range (nstime_t start, nstime_t end)
+{
+  const LeapSecond *base = leapsecondtable.base;
+  int low = 0;
+  int high = leapsecondtable.count;
+  int middle;
+
+  /* Fast check for an empty range or a range outside of the table span */
+  if (high == 0 || end <= start || base[0].leapsecond > end ||
+      base[high - 1].leapsecond <= start)
+    return 0;
+
+  /* Search for the first leap second after the start */
+  while (low < high)
+  {
+    middle = low + (high - low) / 2;
+
+    if (base[middle].leapsecond > start)
+      high = middle;
+    else
+      low = middle + 1;
+  }
+
+  return (low < leapsecondtable.count && base[low].leapsecond <= end) ? 1 : 0;
+} /* End of lm_leapsecond_in_range() */
+
 /** ************************************************************************
  * @brief Calculate the time of a sample in an array
  *
@@ -1775,7 +2069,13 @@ ms_sampletime (nstime_t time, int64_t offset, double samprate)
   }
 
   /* Check if the time range contains a leap second, if list is available */
-  if (lslist)
+  if (lslist && lslist == leapsecondtable.base)
+  {
+    if (lm_leapsecond_in_range (time, time + span - NSTMODULUS))
+      span -= NSTMODULUS;
+  }
+  /* Otherwise search a list not loaded by the library */
+  else if (lslist)
   {
     while (lslist)
     {
@@ -1792,6 +2092,267 @@ ms_sampletime (nstime_t time, int64_t offset, double samprate)
   return (time + span);
 } /* End of ms_sampletime() */
 
+#if defined(LM_SAMPLESTATS_SSE2)
+/***************************************************************************
+ * Four lanes of minimum, maximum, sum and sum of squares accumulators
+ * for ms_samplestats(), held in pairs of SSE2 vectors of doubles.
+ *
+ * Each lane accumulates every fourth sample independently of the
+ * others, so the reductions do not form a single dependency chain.
+ ***************************************************************************/
+typedef struct LM_STATLANES_s
+{
+  __m128d min[2];
+  __m128d max[2];
+  __m128d sum[2];
+  __m128d sumsquares[2];
+} LM_STATLANES;
+
+static void
+lm_statlanes_init (LM_STATLANES *lanes, double first)
+{
+  int vec;
+
+  for (vec = 0; vec < 2; vec++)
+  {
+    lanes->min[vec] = _mm_set1_pd (first);
+    lanes->max[vec] = _mm_set1_pd (first);
+    lanes->sum[vec] = _mm_setzero_pd ();
+    lanes->sumsquares[vec] = _mm_setzero_pd ();
+  }
+} /* End of lm_statlanes_init() */
+
+/***************************************************************************
+ * Add four samples, as two vectors of two doubles, to the lanes.
+ *
+ * The sample is the first operand of the minimum and maximum so that,
+ * as in the scalar loops, NaN samples do not replace a lane's value.
+ ***************************************************************************/
+static inline void
+lm_statlanes_add (LM_STATLANES *lanes, __m128d low, __m128d high)
+{
+  lanes->min[0] = _mm_min_pd (low, lanes->min[0]);
+  lanes->min[1] = _mm_min_pd (high, lanes->min[1]);
+  lanes->max[0] = _mm_max_pd (low, lanes->max[0]);
+  lanes->max[1] = _mm_max_pd (high, lanes->max[1]);
+  lanes->sum[0] = _mm_add_pd (lanes->sum[0], low);
+  lanes->sum[1] = _mm_add_pd (lanes->sum[1], high);
+  lanes->sumsquares[0] = _mm_add_pd (lanes->sumsquares[0], _mm_mul_pd (low, low));
+  lanes->sumsquares[1] = _mm_add_pd (lanes->sumsquares[1], _mm_mul_pd (high, high));
+} /* End of lm_statlanes_add() */
+
+/***************************************************************************
+ * Combine the lanes into scalar values.
+ ***************************************************************************/
+static void
+lm_statlanes_reduce (const LM_STATLANES *lanes, double *min, double *max, double *sum,
+                     double *sumsquares)
+{
+  double lane[4];
+  int idx;
+
+  _mm_storeu_pd (lane, lanes->min[0]);
+  _mm_storeu_pd (lane + 2, lanes->min[1]);
+  *min = lane[0];
+  for (idx = 1; idx < 4; idx++)
+    *min = (lane[idx] < *min) ? lane[idx] : *min;
+
+  _mm_storeu_pd (lane, lanes->max[0]);
+  _mm_storeu_pd (lane + 2, lanes->max[1]);
+  *max = lane[0];
+  for (idx = 1; idx < 4; idx++)
+    *max = (lane[idx] > *max) ? lane[idx] : *max;
+
+  _mm_storeu_pd (lane, _mm_add_pd (lanes->sum[0], lanes->sum[1]));
+  *sum = lane[0] + lane[1];
+
+  _mm_storeu_pd (lane, _mm_add_pd (lanes->sumsquares[0], lanes->sumsquares[1]));
+  *sumsquares = lane[0] + lane[1];
+} /* End of lm_statlanes_reduce() */
+#endif /* LM_SAMPLESTATS_SSE2 */
+
+/** ************************************************************************
+ * @brief Accumulate running statistics of data samples
+ *
+ * The count, minimum, maximum, sum and sum of squares of the samples are
+ * combined with the values already in @p stats and the mean is updated,
+ * allowing statistics to be maintained incrementally as samples are
+ * added.  The structure must be zeroed before the first call.
+ *
+ * Only integer, float and double sample types are supported.
+ *
+ * Where SSE2 is available, sums of squares and the sums of float and
+ * double samples are accumulated in four interleaved lanes.  They may
+ * differ in the last bits from sums accumulated in sample order.  The
+ * sum of integer samples is exact.
+ *
+ * @param[in,out] stats ::MS3SampleStats to update
+ * @param[in] samples Array of data samples
+ * @param[in] numsamples Number of samples in @p samples
+ * @param[in] sampletype Sample type of @p samples, see @ref sample-types
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms_samplestats (MS3SampleStats *stats, const void *samples, int64_t numsamples, char sampletype)
+{
+  double min;
+  double max;
+  double sum = 0.0;
+  double sumsquares = 0.0;
+  int64_t idx = 0;
+#if defined(LM_SAMPLESTATS_SSE2)
+  LM_STATLANES lanes;
+#endif
+
+  if (!stats || (!samples && numsamples > 0))
+  {
+    ms_log (2, "%s(): Required input not defined: 'stats' or 'samples'\n", __func__);
+    return -1;
+  }
+
+  if (numsamples <= 0)
+    return 0;
+
+  /* Where SSE2 is available, groups of four samples are accumulated in
+   * vector lanes that are combined at the end.  Remaining samples, or
+   * all samples otherwise, are accumulated by the scalar loops. */
+  if (sampletype == 'i')
+  {
+    const int32_t *data = (const int32_t *)samples;
+    int32_t imin = data[0];
+    int32_t imax = data[0];
+    int64_t isum = 0;
+
+#if defined(LM_SAMPLESTATS_SSE2)
+    if (numsamples >= 4)
+    {
+      __m128i isums = _mm_setzero_si128 ();
+      __m128i values;
+      __m128i signs;
+      int64_t lanesum[2];
+
+      lm_statlanes_init (&lanes, data[0]);
+
+      for (; idx + 4 <= numsamples; idx += 4)
+      {
+        values = _mm_loadu_si128 ((const __m128i *)(data + idx));
+
+        lm_statlanes_add (&lanes, _mm_cvtepi32_pd (values),
+                          _mm_cvtepi32_pd (_mm_shuffle_epi32 (values, _MM_SHUFFLE (1, 0, 3, 2))));
+
+        /* Sign extend to 64-bit integers to keep the sum exact */
+        signs = _mm_srai_epi32 (values, 31);
+        isums = _mm_add_epi64 (isums, _mm_unpacklo_epi32 (values, signs));
+        isums = _mm_add_epi64 (isums, _mm_unpackhi_epi32 (values, signs));
+      }
+
+      lm_statlanes_reduce (&lanes, &min, &max, &sum, &sumsquares);
+      _mm_storeu_si128 ((__m128i *)lanesum, isums);
+
+      imin = (int32_t)min;
+      imax = (int32_t)max;
+      isum = lanesum[0] + lanesum[1];
+    }
+#endif
+
+    for (; idx < numsamples; idx++)
+    {
+      imin = (data[idx] < imin) ? data[idx] : imin;
+      imax = (data[idx] > imax) ? data[idx] : imax;
+      isum += data[idx];
+      sumsquares += (double)data[idx] * data[idx];
+    }
+
+    min = imin;
+    max = imax;
+    sum = (double)isum;
+  }
+  else if (sampletype == 'f')
+  {
+    const float *data = (const float *)samples;
+    float fmin = data[0];
+    float fmax = data[0];
+
+#if defined(LM_SAMPLESTATS_SSE2)
+    if (numsamples >= 4)
+    {
+      __m128 values;
+
+      lm_statlanes_init (&lanes, data[0]);
+
+      for (; idx + 4 <= numsamples; idx += 4)
+      {
+        values = _mm_loadu_ps (data + idx);
+        lm_statlanes_add (&lanes, _mm_cvtps_pd (values),
+                          _mm_cvtps_pd (_mm_movehl_ps (values, values)));
+      }
+
+      lm_statlanes_reduce (&lanes, &min, &max, &sum, &sumsquares);
+
+      fmin = (float)min;
+      fmax = (float)max;
+    }
+#endif
+
+    for (; idx < numsamples; idx++)
+    {
+      fmin = (data[idx] < fmin) ? data[idx] : fmin;
+      fmax = (data[idx] > fmax) ? data[idx] : fmax;
+      sum += data[idx];
+      sumsquares += (double)data[idx] * data[idx];
+    }
+
+    min = fmin;
+    max = fmax;
+  }
+  else if (sampletype == 'd')
+  {
+    const double *data = (const double *)samples;
+
+    min = max = data[0];
+
+#if defined(LM_SAMPLESTATS_SSE2)
+    if (numsamples >= 4)
+    {
+      lm_statlanes_init (&lanes, data[0]);
+
+      for (; idx + 4 <= numsamples; idx += 4)
+        lm_statlanes_add (&lanes, _mm_loadu_pd (data + idx), _mm_loadu_pd (data + idx + 2));
+
+      lm_statlanes_reduce (&lanes, &min, &max, &sum, &sumsquares);
+    }
+#endif
+
+    for (; idx < numsamples; idx++)
+    {
+      min = (data[idx] < min) ? data[idx] : min;
+      max = (data[idx] > max) ? data[idx] : max;
+      sum += data[idx];
+      sumsquares += data[idx] * data[idx];
+    }
+  }
+  else
+  {
+    ms_log (2, "%s(): Unsupported sample type: '%c'\n", __func__, sampletype);
+    return -1;
+  }
+
+  if (stats->count == 0 || min < stats->min)
+    stats->min = min;
+  if (stats->count == 0 || max > stats->max)
+    stats->max = max;
+
+  stats->count += numsamples;
+  stats->sum += sum;
+  stats->sumsquares += sumsquares;
+  stats->mean = stats->sum / (double)stats->count;
+
+  return 0;
+} /* End of ms_samplestats() */
+
 /** ************************************************************************
  * @brief Runtime test for host endianess
  * @returns 1 if the host is big endian, 0 otherwise.
@@ -1833,6 +2394,23 @@ ms_readleapseconds (const char *envvarname)
   return -2;
 } /* End of ms_readleapseconds() */
 
+/***************************************************************************
+ * INTERNAL qsort() comparison of LeapSecond entries by time.
+ ***************************************************************************/
+static int
+lm_leapsecond_cmp (const void *a, const void *b)
+{
+  const LeapSecond *lsa = (const LeapSecond *)a;
+  const LeapSecond *lsb = (const LeapSecond *)b;
+
+  if (lsa->leapsecond < lsb->leapsecond)
+    return -1;
+  if (lsa->leapsecond > lsb->leapsecond)
+    return 1;
+
+  return 0;
+} /* End of lm_leapsecond_cmp() */
+
 /** ************************************************************************
  * @brief Read leap second from the specified file
  *
@@ -1842,6 +2420,11 @@ ms_readleapseconds (const char *envvarname)
  * where this file can be obtained are indicated in RFC 8633 section 3.7:
  * https://www.rfc-editor.org/rfc/rfc8633.html#section-3.7
  *
+ * The loaded list is sorted by time and allocated as a single
+ * array, linked in order through LeapSecond.next.  The list should
+ * be treated as read-only, it is searched directly by
+ * ms_sampletime().
+ *
  * @param[in] filename File containing leap second list
  *
  * @returns positive number of leap seconds read on success
@@ -1853,8 +2436,8 @@ int
 ms_readleapsecondfile (const char *filename)
 {
   FILE *fp = NULL;
-  LeapSecond *ls = NULL;
-  LeapSecond *lastls = NULL;
+  LeapSecond *lsarray = NULL;
+  LeapSecond *newarray = NULL;
   int64_t expires;
   char readline[200];
   char *cp;
@@ -1862,6 +2445,8 @@ ms_readleapsecondfile (const char *filename)
   int TAIdelta;
   int fields;
   int count = 0;
+  int allocated = 0;
+  int idx;
 
   if (!filename)
   {
@@ -1881,7 +2466,13 @@ ms_readleapsecondfile (const char *filename)
     leapsecondlist = NULL;
   }
 
-  /* Free existing leapsecondlist */
+  /* Free existing leapsecondlist, a single array if previously loaded */
+  if (leapsecondlist != NULL && leapsecondlist == leapsecondtable.base)
+  {
+    libmseed_memory.free (leapsecondlist);
+    leapsecondlist = NULL;
+  }
+
   while (leapsecondlist != NULL)
   {
     LeapSecond *next = leapsecondlist->next;
@@ -1889,6 +2480,9 @@ ms_readleapsecondfile (const char *filename)
     leapsecondlist = next;
   }
 
+  leapsecondtable.base = NULL;
+  leapsecondtable.count = 0;
+
   while (fgets (readline, sizeof (readline) - 1, fp))
   {
     /* Guarantee termination */
@@ -1933,29 +2527,27 @@ ms_readleapsecondfile (const char *filename)
 
     if (fields == 2)
     {
-      if ((ls = (LeapSecond *)libmseed_memory.malloc (sizeof (LeapSecond))) == NULL)
+      if (count >= allocated)
       {
-        ms_log (2, "Cannot allocate LeapSecond entry, out of memory?\n");
-        return -1;
+        allocated = (allocated) ? allocated * 2 : 32;
+
+        newarray = (LeapSecond *)libmseed_memory.realloc (lsarray, allocated * sizeof (LeapSecond));
+
+        if (newarray == NULL)
+        {
+          ms_log (2, "Cannot allocate LeapSecond entry, out of memory?\n");
+          libmseed_memory.free (lsarray);
+          fclose (fp);
+          return -1;
+        }
+
+        lsarray = newarray;
       }
 
       /* Convert NTP epoch time to Unix epoch time and then to nttime_t */
-      ls->leapsecond = MS_EPOCH2NSTIME (leapsecond - NTPPOSIXEPOCHDELTA);
-      ls->TAIdelta = TAIdelta;
-      ls->next = NULL;
+      lsarray[count].leapsecond = MS_EPOCH2NSTIME (leapsecond - NTPPOSIXEPOCHDELTA);
+      lsarray[count].TAIdelta = TAIdelta;
       count++;
-
-      /* Add leap second to global list */
-      if (!leapsecondlist)
-      {
-        leapsecondlist = ls;
-        lastls = ls;
-      }
-      else
-      {
-        lastls->next = ls;
-        lastls = ls;
-      }
     }
     else
     {
@@ -1963,9 +2555,23 @@ ms_readleapsecondfile (const char *filename)
     }
   }
 
+  /* Sort by time, link entries in order and set as the global list */
+  if (count > 0)
+  {
+    qsort (lsarray, count, sizeof (LeapSecond), lm_leapsecond_cmp);
+
+    for (idx = 0; idx < count; idx++)
+      lsarray[idx].next = (idx + 1 < count) ? &lsarray[idx + 1] : NULL;
+
+    leapsecondlist = lsarray;
+    leapsecondtable.base = lsarray;
+    leapsecondtable.count = count;
+  }
+
   if (ferror (fp))
   {
     ms_log (2, "Error reading leap second file (%s): %s\n", filename, strerror (errno));
+    fclose (fp);
     return -1;
   }
 
@@ -2121,3 +2727,209 @@ lmp_strncasecmp (const char *s1, const char *s2, size_t n)
   }
   return 0;
 } /* End of lmp_strncasecmp() */
+
+#if !defined(LIBMSEED_NO_THREADING)
+/***************************************************************************
+ * Minimal mutex, condition variable and thread wrappers for internal
+ * parallel work, using Windows threads or POSIX threads.
+ *
+ * lm_mutex_init(), lm_cond_init() and lm_thread_create() return 0 on
+ * success and -1 on error.
+ ***************************************************************************/
+int
+lm_mutex_init (lm_mutex_t *mutex)
+{
+#if defined(LMP_WIN)
+  InitializeCriticalSection (mutex);
+  return 0;
+#else
+  return (pthread_mutex_init (mutex, NULL)) ? -1 : 0;
+#endif
+} /* End of lm_mutex_init() */
+
+void
+lm_mutex_destroy (lm_mutex_t *mutex)
+{
+#if defined(LMP_WIN)
+  DeleteCriticalSection (mutex);
+#else
+  pthread_mutex_destroy (mutex);
+#endif
+} /* End of lm_mutex_destroy() */
+
+void
+lm_mutex_lock (lm_mutex_t *mutex)
+{
+#if defined(LMP_WIN)
+  EnterCriticalSection (mutex);
+#else
+  pthread_mutex_lock (mutex);
+#endif
+} /* End of lm_mutex_lock() */
+
+void
+lm_mutex_unlock (lm_mutex_t *mutex)
+{
+#if defined(LMP_WIN)
+  LeaveCriticalSection (mutex);
+#else
+  pthread_mutex_unlock (mutex);
+#endif
+} /* End of lm_mutex_unlock() */
+
+int
+lm_cond_init (lm_cond_t *cond)
+{
+#if defined(LMP_WIN)
+  InitializeConditionVariable (cond);
+  return 0;
+#else
+  return (pthread_cond_init (cond, NULL)) ? -1 : 0;
+#endif
+} /* End of lm_cond_init() */
+
+void
+lm_cond_destroy (lm_cond_t *cond)
+{
+#if defined(LMP_WIN)
+  (void)cond;
+#else
+  pthread_cond_destroy (cond);
+#endif
+} /* End of lm_cond_destroy() */
+
+void
+lm_cond_wait (lm_cond_t *cond, lm_mutex_t *mutex)
+{
+#if defined(LMP_WIN)
+  SleepConditionVariableCS (cond, mutex, INFINITE);
+#else
+  pthread_cond_wait (cond, mutex);
+#endif
+} /* End of lm_cond_wait() */
+
+void
+lm_cond_broadcast (lm_cond_t *cond)
+{
+#if defined(LMP_WIN)
+  WakeAllConditionVariable (cond);
+#else
+  pthread_cond_broadcast (cond);
+#endif
+} /* End of lm_cond_broadcast() */
+
+/* Thread start parameters, retained until the thread is joined */
+struct LM_THREADSTART
+{
+  void (*func) (void *);
+  void *arg;
+  MSLogParam logparam; /* Logging parameters from the creating thread, then the worker's */
+#if defined(LIBMSEED_METRICS)
+  MSMetrics metrics; /* Metrics accumulated by the worker */
+#endif
+};
+
+#if defined(LMP_WIN)
+static DWORD WINAPI
+lm_thread_start (LPVOID param)
+#else
+static void *
+lm_thread_start (void *param)
+#endif
+{
+  struct LM_THREADSTART *start = (struct LM_THREADSTART *)param;
+
+  lm_log_thread_install (&start->logparam);
+
+  start->func (start->arg);
+
+  lm_log_thread_collect (&start->logparam);
+#if defined(LIBMSEED_METRICS)
+  start->metrics = lm_metrics;
+#endif
+
+  return 0;
+} /* End of lm_thread_start() */
+
+/***************************************************************************
+ * Start a thread running func(arg).
+ *
+ * The thread logs with a copy of the logging parameters of the calling
+ * thread, see lm_log_thread_init().  When joined with lm_thread_join()
+ * by the creating thread, its registered messages and metrics are
+ * merged into those of the creating thread.
+ ***************************************************************************/
+int
+lm_thread_create (lm_thread_t *thread, void (*func) (void *), void *arg)
+{
+  struct LM_THREADSTART *start;
+
+  if ((start = (struct LM_THREADSTART *)libmseed_memory.malloc (sizeof (*start))) == NULL)
+    return -1;
+
+  memset (start, 0, sizeof (*start));
+  start->func = func;
+  start->arg = arg;
+
+  if (lm_log_thread_init (&start->logparam))
+  {
+    lm_log_thread_merge (&start->logparam);
+    libmseed_memory.free (start);
+    return -1;
+  }
+
+#if defined(LMP_WIN)
+  if ((thread->handle = CreateThread (NULL, 0, lm_thread_start, start, 0, NULL)) == NULL)
+#else
+  if (pthread_create (&thread->handle, NULL, lm_thread_start, start))
+#endif
+  {
+    lm_log_thread_merge (&start->logparam);
+    libmseed_memory.free (start);
+    return -1;
+  }
+
+  thread->start = start;
+
+  return 0;
+} /* End of lm_thread_create() */
+
+void
+lm_thread_join (lm_thread_t thread)
+{
+#if defined(LMP_WIN)
+  WaitForSingleObject (thread.handle, INFINITE);
+  CloseHandle (thread.handle);
+#else
+  pthread_join (thread.handle, NULL);
+#endif
+
+  lm_log_thread_merge (&thread.start->logparam);
+#if defined(LIBMSEED_METRICS)
+  lm_metrics_merge (&thread.start->metrics);
+#endif
+
+  libmseed_memory.free (thread.start);
+} /* End of lm_thread_join() */
+#endif /* !LIBMSEED_NO_THREADING */
+
+/***************************************************************************
+ * Return the number of online processors, or 1 if it cannot be determined.
+ ***************************************************************************/
+int
+lm_cpucount (void)
+{
+#if defined(LMP_WIN)
+  SYSTEM_INFO info;
+
+  GetSystemInfo (&info);
+
+  return (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  long count = sysconf (_SC_NPROCESSORS_ONLN);
+
+  return (count > 0) ? (int)count : 1;
+#else
+  return 1;
+#endif
+} /* End of lm_cpucount() */
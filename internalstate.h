@@ -27,10 +27,142 @@ extern "C" {
 
 #include "libmseed.h"
 
+/* Thread-local storage-class for internal per-thread state
+ *
+ * Not defined when LIBMSEED_NO_THREADING is defined, users must test.
+ * Windows has its own designation for TLS.
+ * Otherwise, C11 defines the standardized _Thread_local storage-class.
+ * Otherwise fallback to the commonly supported __thread keyword.
+ */
+#if !defined(LIBMSEED_NO_THREADING)
+#if defined(LMP_WIN)
+#define lm_thread_local __declspec (thread)
+#elif __STDC_VERSION__ >= 201112L
+#define lm_thread_local _Thread_local
+#else
+#define lm_thread_local __thread
+#endif
+#endif
+
+/* Mutexes, condition variables and threads for internal parallel work
+ *
+ * Not defined when LIBMSEED_NO_THREADING is defined, users must test.
+ * Implemented with Windows threads or POSIX threads.
+ */
+#if !defined(LIBMSEED_NO_THREADING)
+#if defined(LMP_WIN)
+typedef CRITICAL_SECTION lm_mutex_t;
+typedef CONDITION_VARIABLE lm_cond_t;
+#else
+#include <pthread.h>
+typedef pthread_mutex_t lm_mutex_t;
+typedef pthread_cond_t lm_cond_t;
+#endif
+
+/* Thread handle and start parameters, retained until joined */
+typedef struct lm_thread_t
+{
+#if defined(LMP_WIN)
+  HANDLE handle;
+#else
+  pthread_t handle;
+#endif
+  struct LM_THREADSTART *start;
+} lm_thread_t;
+
+extern int lm_mutex_init (lm_mutex_t *mutex);
+extern void lm_mutex_destroy (lm_mutex_t *mutex);
+extern void lm_mutex_lock (lm_mutex_t *mutex);
+extern void lm_mutex_unlock (lm_mutex_t *mutex);
+extern int lm_cond_init (lm_cond_t *cond);
+extern void lm_cond_destroy (lm_cond_t *cond);
+extern void lm_cond_wait (lm_cond_t *cond, lm_mutex_t *mutex);
+extern void lm_cond_broadcast (lm_cond_t *cond);
+extern int lm_thread_create (lm_thread_t *thread, void (*func) (void *), void *arg);
+extern void lm_thread_join (lm_thread_t thread);
+
+/* Logging parameters of internal worker threads, see lm_thread_create() */
+extern int lm_log_thread_init (MSLogParam *worker);
+extern void lm_log_thread_install (const MSLogParam *worker);
+extern void lm_log_thread_collect (MSLogParam *worker);
+extern void lm_log_thread_merge (MSLogParam *worker);
+#endif
+
+/* Return the number of online processors */
+extern int lm_cpucount (void);
+
+/* Report a diagnostic event to the sink, or log it if print is non-zero */
+extern void lm_diag_event (const MSDiagEvent *event, int print);
+
+/* Test if any selection could match data with the known SID fields (NULL
+ * if unknown) and time range (NSTUNSET if unknown), for pruning */
+extern int lm_matchselect_partial (const MS3Selections *selections, const char *net,
+                                   const char *sta, const char *loc, const char *chan,
+                                   nstime_t starttime, nstime_t endtime, int pubversion);
+
+/* Link a trace ID into a trace list, prev from mstl3_findID() or NULL */
+extern MS3TraceID *mstl3_addID (MS3TraceList *mstl, MS3TraceID *id, MS3TraceID **prev);
+
+/* Test if a record duplicates one added to a trace list, otherwise remember it */
+extern int lm_skip_duplicate (MS3TraceList *mstl, const MS3Record *msr, int8_t splitversion,
+                              uint32_t flags);
+
+/* Remove a segment from a trace ID, and the ID from the list if it was the last */
+extern int lm_remove_segment (MS3TraceList *mstl, MS3TraceID *id, MS3TraceSeg *seg,
+                              int8_t freeprvtptr);
+
+/* Performance metrics instrumentation
+ *
+ * When LIBMSEED_METRICS is not defined all of these macros expand to
+ * nothing and no metrics state exists.
+ *
+ * LM_METRIC_START(VAR) declares VAR and records the current time.
+ * LM_METRIC_STOP(TIMER, VAR) adds the elapsed time since VAR to TIMER.
+ * LM_METRIC_ADD(FIELD, VALUE) adds VALUE to an lm_metrics counter.
+ * LM_METRIC_ENCODING(E) maps an encoding to a decode/encode timer index,
+ * values beyond the table are accumulated in the last slot.
+ */
+#if defined(LIBMSEED_METRICS)
+#if !defined(LIBMSEED_NO_THREADING)
+extern lm_thread_local MSMetrics lm_metrics;
+#else
+extern MSMetrics lm_metrics;
+#endif
+extern uint64_t lm_metrics_now (void);
+extern void *lm_metrics_malloc (size_t size);
+extern void *lm_metrics_realloc (void *ptr, size_t size);
+extern void lm_metrics_merge (const MSMetrics *metrics);
+
+#define LM_METRIC_START(VAR) uint64_t VAR = lm_metrics_now ()
+#define LM_METRIC_STOP(TIMER, VAR)                      \
+  do                                                    \
+  {                                                     \
+    (TIMER).count++;                                    \
+    (TIMER).nanoseconds += lm_metrics_now () - (VAR);   \
+  } while (0)
+#define LM_METRIC_ADD(FIELD, VALUE) (lm_metrics.FIELD += (uint64_t)(VALUE))
+#define LM_METRIC_ENCODING(E) \
+  (((unsigned int)(E) < MS_METRICS_ENCODINGS) ? (unsigned int)(E) : (MS_METRICS_ENCODINGS - 1))
+#else
+#define LM_METRIC_START(VAR)
+#define LM_METRIC_STOP(TIMER, VAR)
+#define LM_METRIC_ADD(FIELD, VALUE)
+#define LM_METRIC_ENCODING(E)
+#endif
+
+/* File names owned by a trace list and referenced by record list entries,
+ * a block of consecutive NUL-terminated names */
+struct LM_FILENAMES_s
+{
+  struct LM_FILENAMES_s *next;
+  char names[];
+};
+
 /* Generator-style packing context for MS3Record (opaque in public header) */
 struct MS3RecordPacker
 {
   const MS3Record *msr;        /* Source/template record (not owned) */
+  MS3Record view;              /* Copy of source with cached extra headers serialized */
   uint32_t flags;              /* Packing flags */
   int8_t verbose;              /* Logging level */
 
@@ -49,6 +181,9 @@ struct MS3RecordPacker
   nstime_t nextstarttime;      /* Start time for next record */
   uint16_t blockette_1000_offset; /* Offset to B1000 (miniSEED 2) */
   uint16_t blockette_1001_offset; /* Offset to B1001 (miniSEED 2) */
+  MS3Record *summary;          /* Extra headers with sample range, MSF_PACKMINMAX */
+  LM_PARSED_JSON *summarystate; /* Parsed state of summary extra headers */
+  uint16_t summaryreserve;     /* Extra header bytes reserved for sample range */
   uint8_t finished;            /* Packing complete flag */
 };
 
@@ -29,8 +29,8 @@ extern "C"
 {
 #endif
 
-#define LIBMSEED_VERSION "3.4.0"    //!< Library version
-#define LIBMSEED_RELEASE "2026.094" //!< Library release date
+#define LIBMSEED_VERSION "3.5.0"    //!< Library version
+#define LIBMSEED_RELEASE "2026.291" //!< Library release date
 
 /** @defgroup io-functions File and URL I/O */
 /** @defgroup miniseed-record Record Handling */
@@ -43,6 +43,7 @@ extern "C"
 /** @defgroup logging Central Logging */
 /** @defgroup utility-functions General Utility Functions */
 /** @defgroup leapsecond Leap Second Handling */
+/** @defgroup metrics Performance Metrics */
 
 /** @defgroup low-level Low level definitions
     @brief The low-down, the nitty gritty, the basics */
@@ -392,6 +393,9 @@ typedef struct MS3Record
   uint64_t datasize;  //!< Size of datasamples buffer in bytes
   int64_t numsamples; //!< Number of data samples in datasamples
   char sampletype;    //!< Sample type code: t, i, f, d @ref sample-types
+
+  /* Internal state */
+  struct LM_PARSED_JSON_s *extracache; //!< Parsed extra headers cache, see mseh_cache_enable()
 } MS3Record;
 
 /** @def MS3Record_INITIALIZER
@@ -416,7 +420,8 @@ typedef struct MS3Record
    .datasamples = NULL,                                                                            \
    .datasize = 0,                                                                                  \
    .numsamples = 0,                                                                                \
-   .sampletype = 0}
+   .sampletype = 0,                                                                                \
+   .extracache = NULL}
 
 extern int msr3_parse (const char *record, uint64_t recbuflen, MS3Record **ppmsr, uint32_t flags,
                        int8_t verbose);
@@ -437,6 +442,13 @@ extern int msr3_repack_mseed3 (const MS3Record *msr, char *record, uint32_t recb
 extern int msr3_repack_mseed2 (const MS3Record *msr, char *record, uint32_t recbuflen,
                                int8_t verbose);
 
+extern int64_t ms3_convert_buffer (const char *input, uint64_t inputsize,
+                                   void (*record_handler) (char *, int, void *), void *handlerdata,
+                                   uint64_t *consumed, uint32_t flags, int threads, int8_t verbose);
+
+extern int64_t ms3_convert_file (const char *inputfile, const char *outputfile, uint32_t flags,
+                                 int threads, int8_t verbose);
+
 extern int msr3_pack_header3 (const MS3Record *msr, char *record, uint32_t recbuflen,
                               int8_t verbose);
 
@@ -530,6 +542,13 @@ extern void ms3_printselections (const MS3Selections *selections);
  * A ::MS3Record is stored with and contains the bit flags, extra
  * headers, etc. for the record.
  *
+ * If the ::MSF_INTERNEXTRA flag is used when building the list,
+ * byte-identical extra headers of entries are stored once for the
+ * trace list and shared, such that entries with equal extra headers
+ * have the same @ref MS3Record.extra pointer.  Shared extra headers
+ * must be treated as read-only, use msr3_duplicate() to create a
+ * record that can be modified.
+ *
  * The \a dataoffset to the encoded data is stored to enable direct
  * decoding of data samples without re-parsing the header, used by
  * mstl3_unpack_recordlist().
@@ -600,6 +619,19 @@ typedef struct MS3RecordList
 /** @brief Maximum skip list height for MSTraceIDs */
 #define MSTRACEID_SKIPLIST_HEIGHT 8
 
+/** @brief Running statistics of data samples, see ms_samplestats()
+ *
+ * The root-mean-square of the samples is \c sqrt(sumsquares / count). */
+typedef struct MS3SampleStats
+{
+  int64_t count;     //!< Number of samples included in the statistics
+  double min;        //!< Minimum sample value
+  double max;        //!< Maximum sample value
+  double mean;       //!< Mean sample value
+  double sum;        //!< Sum of sample values
+  double sumsquares; //!< Sum of squared sample values
+} MS3SampleStats;
+
 /** @brief Container for a continuous trace segment, linkable */
 typedef struct MS3TraceSeg
 {
@@ -616,6 +648,7 @@ typedef struct MS3TraceSeg
   struct MS3RecordList *recordlist; //!< List of pointers to records that contributed
   struct MS3TraceSeg *prev;         //!< Pointer to previous segment
   struct MS3TraceSeg *next;         //!< Pointer to next segment, NULL if the last
+  MS3SampleStats *stats;            //!< Sample statistics, only with ::MSF_SEGMENTSTATS
 } MS3TraceSeg;
 
 /** @brief Container for a trace ID, linkable */
@@ -640,6 +673,10 @@ typedef struct MS3TraceList
   uint32_t numtraceids;     //!< Number of traces IDs in list
   struct MS3TraceID traces; //!< Head node of trace skip list, first entry at \a traces.next[0]
   uint64_t prngstate;       //!< INTERNAL: State for Pseudo RNG
+
+  struct LM_EXTRAPOOL_s *extrapool; //!< INTERNAL: Shared extra headers, see ::MSF_INTERNEXTRA
+  struct LM_FILENAMES_s *filenames; //!< INTERNAL: File names referenced by record lists
+  struct LM_DUPSET_s *dupset;       //!< INTERNAL: Records added, see ::MSF_SKIPDUPLICATES
 } MS3TraceList;
 
 /** @brief Callback functions that return time and sample rate tolerances
@@ -689,6 +726,8 @@ extern MS3TraceSeg *mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record
                                             MS3RecordPtr **pprecptr, int8_t splitversion,
                                             int8_t autoheal, uint32_t flags,
                                             const MS3Tolerance *tolerance);
+extern int mstl3_merge (MS3TraceList *mstl, MS3TraceList **ppsrc, int8_t splitversion,
+                        int8_t autoheal, const MS3Tolerance *tolerance, int8_t freeprvtptr);
 extern int64_t mstl3_readbuffer (MS3TraceList **ppmstl, const char *buffer, uint64_t bufferlength,
                                  int8_t splitversion, uint32_t flags, const MS3Tolerance *tolerance,
                                  int8_t verbose);
@@ -727,6 +766,54 @@ extern int64_t mstl3_pack_segment (MS3TraceList *mstl, MS3TraceID *id, MS3TraceS
 DEPRECATED extern int64_t mstraceseg3_pack (MS3TraceID *, MS3TraceSeg *,
                                             void (*) (char *, int, void *), void *, int, int8_t,
                                             int64_t *, uint32_t, int8_t, char *);
+
+/** @brief Opaque real-time, multi-stream packing engine, see ms3_streampack_init() */
+typedef struct MS3StreamPacker MS3StreamPacker;
+
+extern MS3StreamPacker *ms3_streampack_init (int reclen, int8_t encoding, uint32_t flags,
+                                             int8_t verbose, char *extra,
+                                             uint32_t flush_idle_seconds,
+                                             uint32_t max_latency_seconds);
+extern int ms3_streampack_add (MS3StreamPacker *packer, const MS3Record *msr,
+                               const MS3Tolerance *tolerance, nstime_t now);
+extern int64_t ms3_streampack_pack (MS3StreamPacker *packer,
+                                    void (*record_handler) (char *, int, void *),
+                                    void *handlerdata, int64_t *packedsamples, uint32_t flags,
+                                    nstime_t now);
+extern int ms3_streampack_stats (const MS3StreamPacker *packer, int64_t *segments,
+                                 int64_t *bufferedsamples, int64_t *segmentspacked);
+extern void ms3_streampack_free (MS3StreamPacker **ppacker, int64_t *packedsamples);
+
+/** @brief Opaque trace list for concurrent use by multiple threads, see mstl3_shared_init() */
+typedef struct MS3SharedTraceList MS3SharedTraceList;
+
+extern MS3SharedTraceList *mstl3_shared_init (int shards);
+extern int mstl3_shared_addmsr (MS3SharedTraceList *shared, const MS3Record *msr,
+                                int8_t splitversion, int8_t autoheal, uint32_t flags,
+                                const MS3Tolerance *tolerance);
+extern int64_t mstl3_shared_pack (MS3SharedTraceList *shared,
+                                  void (*record_handler) (char *, int, void *), void *handlerdata,
+                                  int reclen, int8_t encoding, int64_t *packedsamples,
+                                  uint32_t flags, int8_t verbose, char *extra);
+extern MS3TraceList *mstl3_shared_take (MS3SharedTraceList *shared);
+extern void mstl3_shared_free (MS3SharedTraceList **ppshared, int8_t freeprvtptr);
+
+/** @brief Opaque multi-resolution min/max envelope, see ms3_envelope_init() */
+typedef struct MS3Envelope MS3Envelope;
+
+extern MS3Envelope *ms3_envelope_init (nstime_t starttime, double samprate, char sampletype,
+                                       uint32_t bucketsamples);
+extern int ms3_envelope_append (MS3Envelope *env, const void *samples, int64_t numsamples,
+                                char sampletype);
+extern int64_t mstl3_envelope_update (MS3Envelope **ppenv, MS3TraceID *id, MS3TraceSeg *seg,
+                                      uint32_t bucketsamples, int8_t verbose);
+extern int64_t ms3_envelope_level (const MS3Envelope *env, int level, int64_t *bucketsamples,
+                                   const double **min, const double **max);
+extern int ms3_envelope_query (const MS3Envelope *env, nstime_t starttime, nstime_t endtime,
+                               int pixels, double *min, double *max);
+extern int ms3_envelope_write (const MS3Envelope *env, const char *path);
+extern MS3Envelope *ms3_envelope_read (const char *path);
+extern void ms3_envelope_free (MS3Envelope **ppenv);
 extern void mstl3_printtracelist (const MS3TraceList *mstl, ms_timeformat_t timeformat,
                                   int8_t details, int8_t gaps, int8_t versions);
 extern void mstl3_printsynclist (const MS3TraceList *mstl, const char *dccid,
@@ -760,12 +847,39 @@ extern void mstl3_printgaplist (const MS3TraceList *mstl, ms_timeformat_t timefo
     Diagnostics: Setting environment variable \b LIBMSEED_URL_DEBUG enables detailed verbosity of
    URL protocol exchanges.
 
+    On Linux, building the library with the \b LIBMSEED_IOURING variable
+    defined enables asynchronous read-ahead of files with io_uring, keeping
+    multiple block reads in flight for each file while records are parsed.
+    When io_uring is not usable at run-time, e.g. an older kernel or a
+    restricted container, or if the \b LIBMSEED_IOURING_DISABLE environment
+    variable is set, files are read with stdio.  The function
+    @ref libmseed_readahead_support() is a run-time test for availability.
+
+    For writing many records to the same file, a persistent, buffered
+    writer can be opened with ms3_writer_open().  Records are accumulated
+    in a large, aligned buffer and written in blocks, avoiding a file open
+    and close per call and a write per record.
+
+    Records may also be routed to an archive of files named by source
+    identifier and time, e.g. the SeisComP Data Structure (SDS), with an
+    archive writer that keeps a bounded set of files open, and selected
+    data read from such an archive, pruning the directory tree by the
+    codes and times in path names, with ms3_readarchive_selection().
+
+    Records of multiple inputs, each in time order, can be read as a
+    single stream in time order with a merge reader, which reads ahead
+    a bounded number of records of each input with threads.
+
     \sa ms3_readmsr()
     \sa ms3_readmsr_selection()
     \sa ms3_readtracelist()
     \sa ms3_readtracelist_selection()
     \sa msr3_writemseed()
     \sa mstl3_writemseed()
+    \sa ms3_writer_open()
+    \sa ms3_archive_init()
+    \sa ms3_readarchive_selection()
+    \sa ms3_mergereader_init()
     @{ */
 
 /** @brief Type definition for data source I/O: file-system versus URL */
@@ -776,7 +890,8 @@ typedef struct LMIO
     LMIO_NULL = 0,   //!< IO handle type is undefined
     LMIO_FILE = 1,   //!< IO handle is FILE-type
     LMIO_URL = 2,    //!< IO handle is URL-type
-    LMIO_FD = 3      //!< IO handle is a provided file descriptor
+    LMIO_FD = 3,     //!< IO handle is a provided file descriptor
+    LMIO_URING = 4   //!< IO handle is an io_uring read-ahead stream
   } type;            //!< IO handle type
   void *handle;      //!< Primary IO handle, either file or URL
   void *handle2;     //!< Secondary IO handle for URL
@@ -847,7 +962,62 @@ extern int64_t msr3_writemseed (MS3Record *msr, const char *mspath, int8_t overw
                                 uint32_t flags, int8_t verbose);
 extern int64_t mstl3_writemseed (MS3TraceList *mstl, const char *mspath, int8_t overwrite,
                                  int maxreclen, int8_t encoding, uint32_t flags, int8_t verbose);
+
+/** @brief Opaque buffered record writer, see ms3_writer_open() */
+typedef struct MS3Writer MS3Writer;
+
+/** @brief Storage synchronization policies for ms3_writer_syncpolicy() */
+#define MSW_SYNC_NONE 0  //!< Never synchronize explicitly, leave it to the OS
+#define MSW_SYNC_CLOSE 1 //!< Synchronize when the writer is closed
+#define MSW_SYNC_FLUSH 2 //!< Synchronize after every buffer flush
+#define MSW_SYNC_BYTES 3 //!< Synchronize after an interval of bytes written
+
+extern MS3Writer *ms3_writer_open (const char *mspath, int8_t overwrite, size_t buffersize);
+extern MS3Writer *ms3_writer_open_fd (int fd, size_t buffersize);
+extern int ms3_writer_syncpolicy (MS3Writer *writer, int policy, uint64_t interval);
+extern int ms3_writer_write (MS3Writer *writer, const char *record, int32_t reclen);
+extern void ms3_writer_handler (char *record, int reclen, void *writer);
+extern int64_t ms3_writer_writemsr (MS3Writer *writer, const MS3Record *msr, uint32_t flags,
+                                    int8_t verbose);
+extern int64_t ms3_writer_writemstl (MS3Writer *writer, MS3TraceList *mstl, int maxreclen,
+                                     int8_t encoding, uint32_t flags, int8_t verbose);
+extern int ms3_writer_flush (MS3Writer *writer);
+extern int ms3_writer_stats (const MS3Writer *writer, int64_t *records, int64_t *bytes);
+extern int ms3_writer_close (MS3Writer **ppwriter);
+
+/** @brief Opaque archive writer, see ms3_archive_init() */
+typedef struct MS3Archive MS3Archive;
+
+/** @brief Path format for the SeisComP Data Structure (SDS), relative to the archive root */
+#define MS_SDS_PATHFORMAT "%Y/%n/%s/%c.%t/%n.%s.%l.%c.%t.%Y.%j"
+
+extern int ms3_archive_expandpath (const char *pathformat, const char *sid, uint8_t pubversion,
+                                   nstime_t time, char *path, size_t pathsize);
+extern MS3Archive *ms3_archive_init (const char *pathformat, int maxopen, size_t buffersize);
+extern int ms3_archive_write (MS3Archive *archive, const char *record, int32_t reclen,
+                              int8_t verbose);
+extern int64_t ms3_archive_writemsr (MS3Archive *archive, const MS3Record *msr, uint32_t flags,
+                                     int8_t verbose);
+extern int64_t ms3_archive_writemstl (MS3Archive *archive, MS3TraceList *mstl, int maxreclen,
+                                      int8_t encoding, uint32_t flags, int8_t verbose);
+extern int ms3_archive_flush (MS3Archive *archive);
+extern int ms3_archive_stats (const MS3Archive *archive, int *openfiles, int64_t *fileopens);
+extern int ms3_archive_close (MS3Archive **pparchive);
+extern int ms3_readarchive_selection (MS3TraceList **ppmstl, const char *root,
+                                      const char *pathformat, const MS3Tolerance *tolerance,
+                                      const MS3Selections *selections, int8_t splitversion,
+                                      uint32_t flags, int threads, int8_t verbose);
+
+/** @brief Opaque time-ordered reader of multiple inputs, see ms3_mergereader_init() */
+typedef struct MS3MergeReader MS3MergeReader;
+
+extern MS3MergeReader *ms3_mergereader_init (const char **paths, int pathcount,
+                                             const MS3Selections *selections, uint32_t flags,
+                                             int depth, int threads, int8_t verbose);
+extern int ms3_mergereader_next (MS3MergeReader *reader, MS3Record **ppmsr, int *pathindex);
+extern void ms3_mergereader_free (MS3MergeReader **ppreader);
 extern int libmseed_url_support (void);
+extern int libmseed_readahead_support (void);
 extern MS3FileParam *ms3_msfp_init (int64_t startoffset, int64_t endoffset, int fd);
 extern MS3FileParam *ms3_msfp_init_fd (int fd);
 /* Backwards compatibility alias for misnamed ms3_msfp_init_fd() */
@@ -902,6 +1072,11 @@ extern int ms_strncpopen (char *dest, const char *source, int length);
        }
     }
     \endcode
+
+    When many headers are read or set for the same record, a parsed
+    document cache can be attached to the record with
+    mseh_cache_enable() to avoid parsing the headers for each access
+    and serializing them for each change.
     @{ */
 
 /**
@@ -1087,7 +1262,39 @@ extern int mseh_serialize (MS3Record *msr, LM_PARSED_JSON **parsestate);
 extern void mseh_free_parsestate (LM_PARSED_JSON **parsestate);
 extern int mseh_replace (MS3Record *msr, char *jsonstring);
 
+extern int mseh_cache_enable (MS3Record *msr);
+extern int mseh_cache_flush (MS3Record *msr);
+extern int mseh_cache_disable (MS3Record *msr);
+
 extern int mseh_print (const MS3Record *msr, int indent);
+
+/**
+ * @brief Value extracted from extra headers by mseh_scan()
+ *
+ * References into the extra headers are not terminated and are valid
+ * until the extra headers of the record are modified or freed.
+ *
+ * @see mseh_scan()
+ */
+typedef struct MSEHScanValue
+{
+  char type;             /**< Value type as returned by mseh_get_ptr_type(), 0 = not found */
+  uint64_t uintvalue;    /**< Unsigned integer value for type 'u' */
+  int64_t intvalue;      /**< Signed integer value for type 'i', and 'u' if representable */
+  double numbervalue;    /**< Number value for types 'u', 'i' and 'n' */
+  int booleanvalue;      /**< Boolean value for type 'b' */
+  const char *string;    /**< String content for type 's', escapes are not decoded */
+  uint32_t stringlength; /**< Length of string content in bytes */
+  const char *raw;       /**< Raw JSON text of the value in extra headers */
+  uint32_t rawlength;    /**< Length of raw JSON text in bytes */
+} MSEHScanValue;
+
+/** @brief Opaque set of compiled JSON Pointers for mseh_scan() */
+typedef struct MSEHScanner MSEHScanner;
+
+extern MSEHScanner *mseh_scanner_init (const char *pointers[], int count);
+extern int mseh_scan (const MSEHScanner *scanner, const MS3Record *msr, MSEHScanValue *values);
+extern void mseh_scanner_free (MSEHScanner **scanner);
 /** @} */
 
 /** @addtogroup record-list
@@ -1168,6 +1375,35 @@ extern int mseh_print (const MS3Record *msr, int indent);
     See \ref example-mseedview for a simple example of error and
     warning message registry usage.
 
+    @anchor log-filtering
+    Log Filtering and Rate Limiting
+    -------------------------------
+
+    Messages below a minimum level can be discarded, before any
+    formatting is done, using ms_rlog_minlevel().  Callers may use
+    ms_rlog_enabled() to skip preparing message arguments when a
+    level would be discarded.
+
+    A repeating warning or error, such as from a corrupted data
+    stream, can be limited per call site (identified by the message
+    format) using ms_rlog_ratelimit().  Messages over the limit are
+    discarded without formatting and counted, the count is reported
+    in a message when the call site logs again in a later interval and
+    is available from ms_rlog_suppressed().
+
+    @anchor log-diagnostics
+    Structured Diagnostics
+    ----------------------
+
+    Some frequent diagnostics, such as Steim decompression integrity
+    failures and skipped non-data while reading, are reported as
+    ::MSDiagEvent structures containing a code, level, source
+    identifier and byte offset.  By default these are formatted and
+    logged like other messages.  When a sink is set with
+    ms_rlog_diagsink() the events are passed to it instead, with no
+    message formatting, and text may be generated later with
+    ms_diagevent_format().  Other messages are not affected.
+
     @anchor log-threading
     Logging in Threads
     ------------------
@@ -1178,6 +1414,14 @@ extern int mseh_print (const MS3Record *msr, int indent);
     functions, message prefixes, or enable the log registry, this must
     be done per-thread.__
 
+    Functions that use internal threads, e.g. ms3_readarchive_selection(),
+    ms3_convert_buffer() and the merge reader, start each thread with a
+    copy of the calling thread's printing functions, prefixes, minimum
+    level and diagnostic sink, which may therefore be called from those
+    threads.  Each thread has its own registry and rate limiting state;
+    registered messages and suppressed counts are added to those of the
+    calling thread when the threads finish.
+
     The library can be built with the \b LIBMSEED_NO_THREADING
     variable defined, resulting in a mode where there are global
     parameters for all threads.  In general this should not be used
@@ -1210,18 +1454,56 @@ typedef struct MSLogEntry
 } MSLogEntry;
 
 /** @brief Log message registry.
+
+    Entries are stored in a fixed-capacity ring of ::MSLogEntry
+    allocated when the first message is added, no allocation is
+    done per message.  The \c messages pointer is the most recent
+    entry, linked to earlier entries through \c next.
+
     \sa ms_rlog()
     \sa ms_rlog_l() */
 typedef struct MSLogRegistry
 {
-  int maxmessages;
-  int messagecnt;
-  MSLogEntry *messages;
+  int maxmessages;      //!< Maximum number of messages retained
+  int messagecnt;       //!< Number of messages in registry
+  MSLogEntry *messages; //!< Most recent message, NULL if none
+
+  MSLogEntry *ring; //!< Entry storage, capacity of @c ringsize
+  int ringsize;     //!< Number of entries allocated in @c ring
+  int head;         //!< Index of most recent entry in @c ring
 } MSLogRegistry;
 
 /** @def MSLogRegistry_INITIALIZER
     @brief Initialializer for ::MSLogRegistry */
-#define MSLogRegistry_INITIALIZER {.maxmessages = 0, .messagecnt = 0, .messages = NULL}
+#define MSLogRegistry_INITIALIZER                                                                  \
+  {.maxmessages = 0, .messagecnt = 0, .messages = NULL, .ring = NULL, .ringsize = 0, .head = 0}
+
+/** @defgroup diagnostic-codes Diagnostic event codes
+    @brief Codes identifying ::MSDiagEvent diagnostics
+    @{ */
+#define MSDIAG_STEIM1_INTEGRITY 1 //!< Steim1 last sample != Xn, @c value: last sample, Xn
+#define MSDIAG_STEIM2_INTEGRITY 2 //!< Steim2 last sample != Xn, @c value: last sample, Xn
+#define MSDIAG_SKIPPED_NOTDATA 3  //!< Non-data skipped while reading, @c value: bytes skipped
+/** @} */
+
+/** @brief Structured diagnostic event.
+
+    Reported to a diagnostic sink set with ms_rlog_diagsink() instead
+    of a formatted message.  Text may be generated on demand with
+    ms_diagevent_format().  The strings are only valid during the
+    call to the sink.
+
+    \sa ms_rlog_diagsink() */
+typedef struct MSDiagEvent
+{
+  int code;             //!< Event code, see @ref diagnostic-codes
+  int level;            //!< Message level, see @ref logging-levels
+  int errorcode;        //!< Library error code related to the event, e.g. ::MS_NOTSEED
+  const char *function; //!< Name of function reporting the event
+  const char *sid;      //!< Source identifier, NULL if not known
+  int64_t offset;       //!< Byte offset in the input stream, -1 if not known
+  int64_t value[2];     //!< Event specific values, see @ref diagnostic-codes
+} MSDiagEvent;
 
 /** @brief Logging parameters.
     __Callers should not modify these values directly and generally
@@ -1235,6 +1517,12 @@ typedef struct MSLogParam
   void (*diag_print) (const char *); //!< Function to call for diagnostic and error messages
   const char *errprefix;             //!< Message prefix for error messages
   MSLogRegistry registry;            //!< Message registry
+
+  int minlevel;                    //!< Minimum level of messages, see ms_rlog_minlevel()
+  struct LM_LOGLIMIT_s *ratelimit; //!< Rate limiting state, see ms_rlog_ratelimit()
+
+  void (*diag_sink) (const MSDiagEvent *, void *); //!< Diagnostic sink, see ms_rlog_diagsink()
+  void *diag_data;                                 //!< Caller data for diagnostic sink
 } MSLogParam;
 
 /** @def MSLogParam_INITIALIZER
@@ -1244,7 +1532,11 @@ typedef struct MSLogParam
    .logprefix = NULL,                                                                              \
    .diag_print = NULL,                                                                             \
    .errprefix = NULL,                                                                              \
-   .registry = MSLogRegistry_INITIALIZER}
+   .registry = MSLogRegistry_INITIALIZER,                                                          \
+   .minlevel = 0,                                                                                  \
+   .ratelimit = NULL,                                                                              \
+   .diag_sink = NULL,                                                                              \
+   .diag_data = NULL}
 
 /** @def ms_log
     @brief Wrapper for ms_rlog(), call as __ms_log (level, format, ...)__
@@ -1285,6 +1577,13 @@ extern MSLogParam *ms_rloginit_l (MSLogParam *logp, void (*log_print) (const cha
 extern int ms_rlog_emit (MSLogParam *logp, int count, int context);
 extern int ms_rlog_pop (MSLogParam *logp, char *message, size_t size, int context);
 extern int ms_rlog_free (MSLogParam *logp);
+extern int ms_rlog_minlevel (MSLogParam *logp, int minlevel);
+extern int ms_rlog_enabled (MSLogParam *logp, int level);
+extern int ms_rlog_ratelimit (MSLogParam *logp, int limit, int interval);
+extern int64_t ms_rlog_suppressed (MSLogParam *logp, int reset);
+extern void ms_rlog_diagsink (MSLogParam *logp, void (*sink) (const MSDiagEvent *, void *),
+                              void *data);
+extern int ms_diagevent_format (const MSDiagEvent *event, char *message, size_t size);
 
 /** @} */
 
@@ -1327,12 +1626,64 @@ typedef struct LeapSecond
   struct LeapSecond *next; //!< Pointer to next entry, NULL if the last
 } LeapSecond;
 
-/** Global leap second list */
+/** Global leap second list, sorted by time when loaded by the library, treat as read-only */
 extern LeapSecond *leapsecondlist;
 extern int ms_readleapseconds (const char *envvarname);
 extern int ms_readleapsecondfile (const char *filename);
 /** @} */
 
+/** @addtogroup metrics
+    @brief Optional performance counters and timers
+
+    When the library is compiled with \b LIBMSEED_METRICS defined, a
+    set of per-thread counters and cumulative timers are maintained
+    for the primary processing stages: record parsing, CRC
+    calculation, data decoding and encoding (by encoding), trace list
+    insertion, ID lookup and segment search, bytes read and memory
+    allocations through the default allocators.
+
+    Metrics are accumulated for the calling thread only, including work
+    done by internal threads on its behalf once they finish, and are
+    retrieved with ms_metrics_snapshot().  When the library is compiled
+    without metrics the instrumentation is removed entirely and these
+    functions return an error.
+
+    @note Allocations are only counted when the default system
+    allocators in \b libmseed_memory are in use.
+
+  @{ */
+
+/** @brief Number of encoding slots tracked for decode and encode timers */
+#define MS_METRICS_ENCODINGS 64
+
+/** @brief Cumulative timer, a count of operations and total duration */
+typedef struct MSMetricTimer
+{
+  uint64_t count;       //!< Number of timed operations
+  uint64_t nanoseconds; //!< Cumulative duration in nanoseconds
+} MSMetricTimer;
+
+/** @brief Performance metrics for a thread */
+typedef struct MSMetrics
+{
+  MSMetricTimer parse;                          //!< Record parsing, msr3_parse(), all stages
+  MSMetricTimer crc;                            //!< CRC-32C calculation, ms_crc32c()
+  MSMetricTimer decode[MS_METRICS_ENCODINGS];   //!< Data sample decoding by encoding
+  MSMetricTimer encode[MS_METRICS_ENCODINGS];   //!< Data sample encoding by encoding
+  MSMetricTimer tracelistinsert;                //!< Record insertion, mstl3_addmsr()
+  MSMetricTimer idlookup;                       //!< Trace list ID lookup
+  MSMetricTimer segmentsearch;                  //!< Trace list full segment search
+  uint64_t bytesread;                           //!< Bytes read from files and URLs
+  uint64_t allocations;                         //!< Count of allocations and reallocations
+  uint64_t allocatedbytes;                      //!< Bytes requested by allocations
+} MSMetrics;
+
+extern int ms_metrics_enabled (void);
+extern int ms_metrics_snapshot (MSMetrics *metrics, int reset);
+extern void ms_metrics_reset (void);
+extern char *ms_metrics_json (const MSMetrics *metrics, size_t *length);
+/** @} */
+
 /** @addtogroup utility-functions
   @brief General utilities
   @{ */
@@ -1342,6 +1693,9 @@ extern int ms_encoding_sizetype (uint8_t encoding, uint8_t *samplesize, char *sa
 extern const char *ms_encodingstr (uint8_t encoding);
 extern const char *ms_errorstr (int errorcode);
 
+extern int ms_samplestats (MS3SampleStats *stats, const void *samples, int64_t numsamples,
+                           char sampletype);
+
 extern nstime_t ms_sampletime (nstime_t time, int64_t offset, double samprate);
 extern int ms_bigendianhost (void);
 
@@ -1600,6 +1954,18 @@ extern void *libmseed_memory_prealloc (void *ptr, size_t size, size_t *currentsi
 #define MSF_SPLITISVERSION \
   0x0800 //!< [TraceList] Use the splitversion value as version instead of record version
 #define MSF_SKIPADJACENTDUPLICATES 0x1000 //!< [TraceList] Skip adjacent duplicate records
+#define MSF_SEEKSELECTION \
+  0x2000 //!< [Parsing] Seek to selected time range in time-ordered files of fixed record length
+#define MSF_INTERNEXTRA \
+  0x4000 //!< [TraceList] Share identical extra headers of ::MS3RecordList entries
+#define MSF_SKIPDUPLICATES \
+  0x8000 //!< [TraceList] Skip records that duplicate any record already in a trace list
+#define MSF_BESTVERSION \
+  0x10000 //!< [TraceList] Keep the highest version of overlapping data, not with ::MSF_RECORDLIST
+#define MSF_SEGMENTSTATS \
+  0x20000 //!< [TraceList] Maintain running sample statistics at ::MS3TraceSeg.stats
+#define MSF_PACKMINMAX \
+  0x40000 //!< [Packing] Add the sample range of each record to extra headers (version 3)
 /** @} */
 
 #ifdef __cplusplus
@@ -22,8 +22,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "libmseed.h"
+#include "internalstate.h"
 
 void rloginit_int (MSLogParam *logp, void (*log_print) (const char *), const char *logprefix,
                    void (*diag_print) (const char *), const char *errprefix, int maxmessages);
@@ -32,6 +34,8 @@ int rlog_int (MSLogParam *logp, const char *function, int level, const char *for
               va_list *varlist);
 
 int add_message_int (MSLogRegistry *logreg, const char *function, int level, const char *message);
+static int resize_registry_int (MSLogRegistry *logreg);
+static int check_ratelimit_int (struct LM_LOGLIMIT_s *ratelimit, const char *format);
 void print_message_int (MSLogParam *logp, int level, const char *message, char *terminator);
 
 /* Initialize the global logging parameters
@@ -41,23 +45,45 @@ void print_message_int (MSLogParam *logp, int level, const char *message, char *
  * it's own "global" logging parameters initialized to the library
  * default settings.
  *
- * Windows has its own designation for TLS.
- * Otherwise, C11 defines the standardized _Thread_local storage-class.
- * Otherwise fallback to the commonly supported __thread keyword.
+ * The lm_thread_local storage-class is defined in internalstate.h.
  */
 #if !defined(LIBMSEED_NO_THREADING)
-#if defined(LMP_WIN)
-#define lm_thread_local __declspec (thread)
-#elif __STDC_VERSION__ >= 201112L
-#define lm_thread_local _Thread_local
-#else
-#define lm_thread_local __thread
-#endif
 lm_thread_local MSLogParam gMSLogParam = MSLogParam_INITIALIZER;
 #else
 MSLogParam gMSLogParam = MSLogParam_INITIALIZER;
 #endif
 
+/* Message formats for diagnostic events, indexed by code */
+static const char *diagformats[] = {
+    NULL,
+    /* MSDIAG_STEIM1_INTEGRITY */
+    "%s: Warning: Data integrity check for Steim1 failed, Last sample=%d, Xn=%d\n",
+    /* MSDIAG_STEIM2_INTEGRITY */
+    "%s: Warning: Data integrity check for Steim2 failed, Last sample=%d, Xn=%d\n",
+    /* MSDIAG_SKIPPED_NOTDATA */
+    "Skipped %d bytes of non-data record at byte offset %" PRId64 "\n"};
+
+/* Number of call sites tracked for rate limiting, a power of 2 */
+#define LM_LOGSITES 128
+
+/* Rate limiting state for a single call site, identified by message format */
+typedef struct LM_LOGSITE_s
+{
+  const char *format;  /* Message format of call site, NULL if slot unused */
+  int64_t windowstart; /* Start of current interval, seconds since the epoch */
+  int count;           /* Messages logged in current interval */
+  int suppressed;      /* Messages suppressed in current interval */
+} LM_LOGSITE;
+
+/* Call site rate limiting state */
+struct LM_LOGLIMIT_s
+{
+  int limit;                     /* Maximum messages per call site per interval */
+  int interval;                  /* Interval in seconds */
+  int64_t suppressed;            /* Total messages suppressed */
+  LM_LOGSITE sites[LM_LOGSITES]; /* Open addressing table of call sites */
+};
+
 /** ************************************************************************
  * @brief Initialize the global logging parameters.
  *
@@ -147,6 +173,13 @@ ms_rloginit_l (MSLogParam *logp, void (*log_print) (const char *), const char *l
     llog->registry.maxmessages = 0;
     llog->registry.messagecnt = 0;
     llog->registry.messages = NULL;
+    llog->registry.ring = NULL;
+    llog->registry.ringsize = 0;
+    llog->registry.head = 0;
+    llog->minlevel = 0;
+    llog->ratelimit = NULL;
+    llog->diag_sink = NULL;
+    llog->diag_data = NULL;
   }
   else
   {
@@ -331,6 +364,7 @@ int
 rlog_int (MSLogParam *logp, const char *function, int level, const char *format, va_list *varlist)
 {
   char message[MAX_LOG_MSG_LENGTH];
+  int suppressed;
   int presize = 0;
   int printed = 0;
 
@@ -340,6 +374,22 @@ rlog_int (MSLogParam *logp, const char *function, int level, const char *format,
     return -1;
   }
 
+  /* Discard messages below the minimum level before any formatting */
+  if (level < logp->minlevel)
+    return 0;
+
+  /* Limit warning and error messages per call site, discarding before formatting */
+  if (level >= 1 && logp->ratelimit)
+  {
+    suppressed = check_ratelimit_int (logp->ratelimit, format);
+
+    if (suppressed < 0)
+      return 0;
+
+    if (suppressed > 0)
+      ms_rlog_l (logp, function, level, "%d similar messages suppressed\n", suppressed);
+  }
+
   message[0] = '\0';
 
   if (level >= 2) /* Error message */
@@ -411,8 +461,11 @@ rlog_int (MSLogParam *logp, const char *function, int level, const char *format,
 /** ************************************************************************
  * @brief Add message to registry
  *
- * Add a message to the specified log registry.  Earliest entries are
- * removed to remain within the specified maximum number of messages.
+ * Add a message to the specified log registry.  Messages are stored
+ * in a fixed-capacity ring, when full the earliest entry is
+ * overwritten.  The ring is allocated when first needed or when the
+ * maximum number of messages changes, not per message, and released
+ * when the registry is emptied.
  *
  * @param[in] logreg Pointer to ::MSLogRegistry to use for this message
  * @param[in] function Name of function generating the message
@@ -425,20 +478,20 @@ int
 add_message_int (MSLogRegistry *logreg, const char *function, int level, const char *message)
 {
   MSLogEntry *logentry = NULL;
-  MSLogEntry *lognext = NULL;
-  int count;
+  int newhead;
 
   if (!logreg || !message)
     return -1;
 
-  /* Allocate new entry */
-  logentry = (MSLogEntry *)libmseed_memory.malloc (sizeof (MSLogEntry));
+  if (logreg->ringsize != logreg->maxmessages && resize_registry_int (logreg))
+    return -1;
 
-  if (logentry == NULL)
-  {
-    fprintf (stderr, "%s(): Cannot allocate memory for log message\n", __func__);
+  if (logreg->ringsize <= 0)
     return -1;
-  }
+
+  /* Claim the slot after the head, the earliest entry when the ring is full */
+  newhead = (logreg->messagecnt == 0) ? 0 : (logreg->head + 1) % logreg->ringsize;
+  logentry = &logreg->ring[newhead];
 
   /* Populate new entry */
   logentry->level = level;
@@ -454,36 +507,143 @@ add_message_int (MSLogRegistry *logreg, const char *function, int level, const c
   strncpy (logentry->message, message, sizeof (logentry->message));
   logentry->message[sizeof (logentry->message) - 1] = '\0';
 
-  /* Add entry to registry at the head of the list */
-  logentry->next = logreg->messages;
+  /* Link new entry to the previous head, and terminate the list at the earliest entry */
+  if (logreg->messagecnt == 0 || logreg->ringsize == 1)
+  {
+    logentry->next = NULL;
+    logreg->messagecnt = 1;
+  }
+  else
+  {
+    logentry->next = &logreg->ring[logreg->head];
+
+    if (logreg->messagecnt < logreg->ringsize)
+      logreg->messagecnt += 1;
+    else
+      logreg->ring[(newhead + 1) % logreg->ringsize].next = NULL;
+  }
+
+  logreg->head = newhead;
   logreg->messages = logentry;
-  logreg->messagecnt += 1;
 
-  /* Remove earliest messages if more than maximum allowed */
-  if (logreg->messagecnt > logreg->maxmessages)
+  return 0;
+} /* End of add_message_int() */
+
+/***************************************************************************
+ * Resize the ring of a log registry to the maximum number of messages.
+ *
+ * The most recent messages that fit are retained in order.
+ *
+ * Returns zero on success and non-zero on error.
+ ***************************************************************************/
+static int
+resize_registry_int (MSLogRegistry *logreg)
+{
+  MSLogEntry *ring = NULL;
+  MSLogEntry *logentry;
+  int count;
+  int idx;
+
+  if (logreg->maxmessages > 0)
   {
-    count = 0;
-    logentry = logreg->messages;
-    while (logentry)
+    ring = (MSLogEntry *)libmseed_memory.malloc (sizeof (MSLogEntry) * logreg->maxmessages);
+
+    if (ring == NULL)
     {
-      lognext = logentry->next;
-      count++;
+      fprintf (stderr, "%s(): Cannot allocate memory for log registry\n", __func__);
+      return -1;
+    }
+  }
 
-      if (count == logreg->maxmessages)
-        logentry->next = NULL;
+  /* Copy retained messages, earliest first, and link each to the previous */
+  count = (logreg->messagecnt < logreg->maxmessages) ? logreg->messagecnt : logreg->maxmessages;
 
-      if (count > logreg->maxmessages)
-      {
-        free (logentry);
-        logreg->messagecnt -= 1;
-      }
+  for (idx = 0; idx < count; idx++)
+  {
+    logentry = &logreg->ring[(logreg->head - (count - 1 - idx) + logreg->ringsize) %
+                             logreg->ringsize];
 
-      logentry = lognext;
-    }
+    ring[idx] = *logentry;
+    ring[idx].next = (idx > 0) ? &ring[idx - 1] : NULL;
   }
 
+  if (logreg->ring)
+    libmseed_memory.free (logreg->ring);
+
+  logreg->ring = ring;
+  logreg->ringsize = logreg->maxmessages;
+  logreg->messagecnt = count;
+  logreg->head = (count > 0) ? count - 1 : 0;
+  logreg->messages = (count > 0) ? &ring[count - 1] : NULL;
+
   return 0;
-} /* End of add_message_int() */
+} /* End of resize_registry_int() */
+
+/***************************************************************************
+ * Check a message against the call site rate limit.
+ *
+ * The call site is identified by the message format pointer, which is
+ * unique for each ms_log() call with a literal format.  When all call
+ * site slots are in use, messages from new call sites are not limited.
+ *
+ * Returns -1 if the message should be suppressed, otherwise the number
+ * of messages suppressed in the previous interval of the call site.
+ ***************************************************************************/
+static int
+check_ratelimit_int (struct LM_LOGLIMIT_s *ratelimit, const char *format)
+{
+  LM_LOGSITE *site = NULL;
+  int64_t now;
+  uintptr_t slot;
+  int probe;
+  int suppressed = 0;
+
+  slot = ((uintptr_t)format >> 3) & (LM_LOGSITES - 1);
+
+  for (probe = 0; probe < LM_LOGSITES; probe++)
+  {
+    site = &ratelimit->sites[(slot + probe) & (LM_LOGSITES - 1)];
+
+    if (site->format == format)
+      break;
+
+    if (site->format == NULL)
+    {
+      site->format = format;
+      site->windowstart = 0;
+      site->count = 0;
+      site->suppressed = 0;
+      break;
+    }
+
+    site = NULL;
+  }
+
+  if (!site)
+    return 0;
+
+  now = (int64_t)time (NULL);
+
+  /* Start a new interval, returning the count suppressed in the previous */
+  if (now - site->windowstart >= ratelimit->interval)
+  {
+    suppressed = site->suppressed;
+    site->windowstart = now;
+    site->count = 0;
+    site->suppressed = 0;
+  }
+
+  if (site->count >= ratelimit->limit)
+  {
+    site->suppressed++;
+    ratelimit->suppressed++;
+    return -1;
+  }
+
+  site->count++;
+
+  return suppressed;
+} /* End of check_ratelimit_int() */
 
 /** ************************************************************************
  * @brief Send message to print functions
@@ -530,7 +690,7 @@ print_message_int (MSLogParam *logp, int level, const char *message, char *termi
  * Emit error and warning messages from the log registry, using the printing
  * functions identified by the ::MSLogParam.
  *
- * Messages are printed in order from latest to earliest.
+ * Messages are printed in order from earliest to latest.
  *
  * The maximum number messages to emit, from most recent to earliest,
  * can be limited using @p count.  If the value is 0 all messages are
@@ -553,35 +713,26 @@ print_message_int (MSLogParam *logp, int level, const char *message, char *termi
 int
 ms_rlog_emit (MSLogParam *logp, int count, int context)
 {
-  MSLogEntry *logentry = NULL;
+  MSLogRegistry *logreg;
   MSLogEntry *logprint = NULL;
   char local_message[MAX_LOG_MSG_LENGTH];
   char *message = NULL;
-  int emit = (count > 0) ? count : -1;
-  int emitted = 0;
+  int emit;
+  int idx;
 
   if (!logp)
     logp = &gMSLogParam;
 
-  /* Pop off count entries (or all if count <= 0), and invert into print list */
-  logentry = logp->registry.messages;
-  while (logentry && emit)
-  {
-    logp->registry.messages = logentry->next;
-
-    logentry->next = logprint;
-    logprint = logentry;
+  logreg = &logp->registry;
 
-    if (emit > 0)
-      emit--;
-
-    logentry = logp->registry.messages;
-  }
+  /* Emit count entries (or all if count <= 0) */
+  emit = (count > 0 && count < logreg->messagecnt) ? count : logreg->messagecnt;
 
-  /* Print and free entries */
-  logentry = logprint;
-  while (logprint)
+  /* Print entries from earliest to latest */
+  for (idx = emit - 1; idx >= 0; idx--)
   {
+    logprint = &logreg->ring[(logreg->head - idx + logreg->ringsize) % logreg->ringsize];
+
     /* Add function name to message if requested and present */
     if (context && logprint->function[0] != '\0')
     {
@@ -595,16 +746,17 @@ ms_rlog_emit (MSLogParam *logp, int count, int context)
     }
 
     print_message_int (logp, logprint->level, message, "\n");
-
-    logentry = logprint->next;
-    free (logprint);
-    logprint = logentry;
-    emitted++;
   }
 
-  logp->registry.messagecnt -= emitted;
+  /* Remove emitted entries, the ring is retained for new messages */
+  if (emit > 0)
+  {
+    logreg->messagecnt -= emit;
+    logreg->head = (logreg->head - emit + logreg->ringsize) % logreg->ringsize;
+    logreg->messages = (logreg->messagecnt > 0) ? &logreg->ring[logreg->head] : NULL;
+  }
 
-  return emitted;
+  return emit;
 } /* End of ms_rlog_emit() */
 
 /** ************************************************************************
@@ -630,6 +782,7 @@ ms_rlog_emit (MSLogParam *logp, int count, int context)
 int
 ms_rlog_pop (MSLogParam *logp, char *message, size_t size, int context)
 {
+  MSLogRegistry *logreg;
   MSLogEntry *logprint = NULL;
   char local_message[MAX_LOG_MSG_LENGTH];
   char *message_ptr = NULL;
@@ -641,9 +794,10 @@ ms_rlog_pop (MSLogParam *logp, char *message, size_t size, int context)
   if (!logp)
     logp = &gMSLogParam;
 
-  logprint = logp->registry.messages;
+  logreg = &logp->registry;
+  logprint = logreg->messages;
 
-  /* Copy and free message */
+  /* Copy and remove message */
   if (logprint)
   {
     /* Add function name to message if requested and present */
@@ -664,9 +818,9 @@ ms_rlog_pop (MSLogParam *logp, char *message, size_t size, int context)
     length = strlen (message);
 
     /* Remove message from registry */
-    logp->registry.messages = logprint->next;
-    logp->registry.messagecnt -= 1;
-    free (logprint);
+    logreg->messages = logprint->next;
+    logreg->messagecnt -= 1;
+    logreg->head = (logreg->head - 1 + logreg->ringsize) % logreg->ringsize;
   }
 
   return (int)length;
@@ -675,6 +829,11 @@ ms_rlog_pop (MSLogParam *logp, char *message, size_t size, int context)
 /** ************************************************************************
  * @brief Free, without emitting, all messages from log registry
  *
+ * The registry storage is also released and will be allocated again if
+ * more messages are added.  Storage is otherwise retained when messages
+ * are removed by ms_rlog_emit() or ms_rlog_pop(), and only re-allocated
+ * when the maximum number of messages is changed.
+ *
  * @param[in] logp ::MSLogParam for this message or NULL for global parameters
  *
  * @returns The number of messages freed.
@@ -682,24 +841,373 @@ ms_rlog_pop (MSLogParam *logp, char *message, size_t size, int context)
 int
 ms_rlog_free (MSLogParam *logp)
 {
-  MSLogEntry *logentry = NULL;
-  int freed = 0;
+  int freed;
 
   if (!logp)
     logp = &gMSLogParam;
 
-  logentry = logp->registry.messages;
-
-  while (logentry)
-  {
-    freed++;
+  freed = logp->registry.messagecnt;
 
-    logp->registry.messages = logentry->next;
-    free (logentry);
-    logentry = logp->registry.messages;
-  }
+  if (logp->registry.ring)
+    libmseed_memory.free (logp->registry.ring);
 
+  logp->registry.ring = NULL;
+  logp->registry.ringsize = 0;
+  logp->registry.head = 0;
+  logp->registry.messages = NULL;
   logp->registry.messagecnt = 0;
 
   return freed;
 } /* End of ms_rlog_free() */
+
+/** ************************************************************************
+ * @brief Set the minimum level of messages to log
+ *
+ * Messages with a level lower than @p minlevel are discarded without
+ * being formatted, printed or added to the registry.  For example, a
+ * @p minlevel of 1 discards normal log messages (level 0) while
+ * retaining warnings and errors.  The default is 0, all messages.
+ *
+ * @param[in] logp ::MSLogParam to configure or NULL for global parameters
+ * @param[in] minlevel Minimum level of messages to log
+ *
+ * @returns The previous minimum level.
+ *
+ * @see ms_rlog_enabled()
+ ***************************************************************************/
+int
+ms_rlog_minlevel (MSLogParam *logp, int minlevel)
+{
+  int previous;
+
+  if (!logp)
+    logp = &gMSLogParam;
+
+  previous = logp->minlevel;
+  logp->minlevel = minlevel;
+
+  return previous;
+} /* End of ms_rlog_minlevel() */
+
+/** ************************************************************************
+ * @brief Determine if messages at a level would be logged
+ *
+ * A cheap check that callers can use to skip preparing values that
+ * are only needed for a log message.
+ *
+ * @param[in] logp ::MSLogParam to check or NULL for global parameters
+ * @param[in] level Message level
+ *
+ * @returns Non-zero if messages at @p level are logged, otherwise 0.
+ *
+ * @see ms_rlog_minlevel()
+ ***************************************************************************/
+int
+ms_rlog_enabled (MSLogParam *logp, int level)
+{
+  if (!logp)
+    logp = &gMSLogParam;
+
+  return (level >= logp->minlevel);
+} /* End of ms_rlog_enabled() */
+
+/** ************************************************************************
+ * @brief Limit the rate of warning and error messages per call site
+ *
+ * When enabled, each call site, identified by the message format,
+ * may log at most @p limit warning or error messages (level >= 1)
+ * per @p interval seconds.  Additional messages are discarded without
+ * formatting and counted.  When the call site next logs a message in
+ * a later interval, a message reporting the number suppressed is
+ * logged first.  Normal log messages (level 0) are not limited.
+ *
+ * Up to 128 call sites are tracked, messages from call sites beyond
+ * that are not limited.
+ *
+ * Rate limiting state is allocated when enabled and released when
+ * disabled by setting @p limit to 0, which also resets the count of
+ * suppressed messages.
+ *
+ * @param[in] logp ::MSLogParam to configure or NULL for global parameters
+ * @param[in] limit Maximum messages per call site per interval, 0 to disable
+ * @param[in] interval Interval in seconds
+ *
+ * @returns Zero on success and -1 on error.
+ *
+ * @see ms_rlog_suppressed()
+ ***************************************************************************/
+int
+ms_rlog_ratelimit (MSLogParam *logp, int limit, int interval)
+{
+  if (!logp)
+    logp = &gMSLogParam;
+
+  if (limit <= 0)
+  {
+    if (logp->ratelimit)
+      libmseed_memory.free (logp->ratelimit);
+
+    logp->ratelimit = NULL;
+    return 0;
+  }
+
+  if (interval <= 0)
+  {
+    ms_log_l (logp, 2, "%s(): Interval must be positive: %d\n", __func__, interval);
+    return -1;
+  }
+
+  if (!logp->ratelimit)
+  {
+    logp->ratelimit = (struct LM_LOGLIMIT_s *)libmseed_memory.malloc (sizeof (*logp->ratelimit));
+
+    if (!logp->ratelimit)
+    {
+      ms_log_l (logp, 2, "%s(): Cannot allocate memory\n", __func__);
+      return -1;
+    }
+
+    memset (logp->ratelimit, 0, sizeof (*logp->ratelimit));
+  }
+
+  logp->ratelimit->limit = limit;
+  logp->ratelimit->interval = interval;
+
+  return 0;
+} /* End of ms_rlog_ratelimit() */
+
+/** ************************************************************************
+ * @brief Return the number of messages suppressed by rate limiting
+ *
+ * @param[in] logp ::MSLogParam to query or NULL for global parameters
+ * @param[in] reset If non-zero reset the count to zero
+ *
+ * @returns The total number of messages suppressed since rate limiting
+ * was enabled or the count was last reset.
+ *
+ * @see ms_rlog_ratelimit()
+ ***************************************************************************/
+int64_t
+ms_rlog_suppressed (MSLogParam *logp, int reset)
+{
+  int64_t suppressed;
+
+  if (!logp)
+    logp = &gMSLogParam;
+
+  if (!logp->ratelimit)
+    return 0;
+
+  suppressed = logp->ratelimit->suppressed;
+
+  if (reset)
+    logp->ratelimit->suppressed = 0;
+
+  return suppressed;
+} /* End of ms_rlog_suppressed() */
+
+/** ************************************************************************
+ * @brief Set a sink for structured diagnostic events
+ *
+ * When a sink is set, diagnostics that are reported as ::MSDiagEvent
+ * structures are passed to @p sink along with @p data, instead of
+ * being formatted and logged.  See @ref log-diagnostics.
+ *
+ * The event and the strings it references are only valid during the
+ * call to @p sink, use ms_diagevent_format() to generate a message.
+ *
+ * @param[in] logp ::MSLogParam to configure or NULL for global parameters
+ * @param[in] sink Function to receive events, NULL to restore logging
+ * @param[in] data Caller data passed to @p sink
+ *
+ * @see ms_diagevent_format()
+ ***************************************************************************/
+void
+ms_rlog_diagsink (MSLogParam *logp, void (*sink) (const MSDiagEvent *, void *), void *data)
+{
+  if (!logp)
+    logp = &gMSLogParam;
+
+  logp->diag_sink = sink;
+  logp->diag_data = data;
+} /* End of ms_rlog_diagsink() */
+
+/** ************************************************************************
+ * @brief Format the message for a diagnostic event
+ *
+ * The message is the same as logged when no diagnostic sink is set,
+ * without a prefix or trailing newline.
+ *
+ * @param[in] event Diagnostic event to format
+ * @param[out] message Buffer for message
+ * @param[in] size Size of @p message buffer
+ *
+ * @returns The length of the message, which is truncated to fit in
+ * the buffer, or -1 on error or unknown event code.
+ *
+ * @see ms_rlog_diagsink()
+ ***************************************************************************/
+int
+ms_diagevent_format (const MSDiagEvent *event, char *message, size_t size)
+{
+  int length;
+
+  if (!event || !message || size == 0)
+    return -1;
+
+  switch (event->code)
+  {
+  case MSDIAG_STEIM1_INTEGRITY:
+  case MSDIAG_STEIM2_INTEGRITY:
+    length = snprintf (message, size, diagformats[event->code], (event->sid) ? event->sid : "",
+                       (int)event->value[0], (int)event->value[1]);
+    break;
+  case MSDIAG_SKIPPED_NOTDATA:
+    length = snprintf (message, size, diagformats[event->code], (int)event->value[0],
+                       event->offset);
+    break;
+  default:
+    message[0] = '\0';
+    return -1;
+  }
+
+  if (length < 0)
+    return -1;
+
+  if ((size_t)length >= size)
+    length = (int)size - 1;
+
+  /* Remove trailing newline */
+  if (length > 0 && message[length - 1] == '\n')
+    message[--length] = '\0';
+
+  return length;
+} /* End of ms_diagevent_format() */
+
+/***************************************************************************
+ * Report a diagnostic event using the global logging parameters.
+ *
+ * The event is passed to the diagnostic sink if set, otherwise if
+ * @p print is non-zero it is formatted and logged.  Each event code
+ * logs with its own format, so rate limiting applies per code.
+ ***************************************************************************/
+void
+lm_diag_event (const MSDiagEvent *event, int print)
+{
+  MSLogParam *logp = &gMSLogParam;
+
+  if (logp->diag_sink)
+  {
+    logp->diag_sink (event, logp->diag_data);
+    return;
+  }
+
+  if (!print)
+    return;
+
+  switch (event->code)
+  {
+  case MSDIAG_STEIM1_INTEGRITY:
+  case MSDIAG_STEIM2_INTEGRITY:
+    ms_rlog (event->function, event->level, diagformats[event->code],
+             (event->sid) ? event->sid : "", (int)event->value[0], (int)event->value[1]);
+    break;
+  case MSDIAG_SKIPPED_NOTDATA:
+    ms_rlog (event->function, event->level, diagformats[event->code], (int)event->value[0],
+             event->offset);
+    break;
+  }
+} /* End of lm_diag_event() */
+
+#if !defined(LIBMSEED_NO_THREADING)
+/***************************************************************************
+ * Prepare logging parameters for an internal worker thread from those
+ * of the calling thread.
+ *
+ * Print functions, prefixes, minimum level and diagnostic sink are
+ * copied.  The worker gets its own, empty message registry of the same
+ * size and its own rate limiting state with the same limits, as the
+ * state of the calling thread is not safe to update from other threads.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+lm_log_thread_init (MSLogParam *worker)
+{
+  *worker = gMSLogParam;
+
+  worker->registry = (MSLogRegistry)MSLogRegistry_INITIALIZER;
+  worker->registry.maxmessages = gMSLogParam.registry.maxmessages;
+  worker->ratelimit = NULL;
+
+  if (gMSLogParam.ratelimit)
+  {
+    worker->ratelimit = (struct LM_LOGLIMIT_s *)libmseed_memory.malloc (sizeof (*worker->ratelimit));
+
+    if (!worker->ratelimit)
+      return -1;
+
+    memset (worker->ratelimit, 0, sizeof (*worker->ratelimit));
+    worker->ratelimit->limit = gMSLogParam.ratelimit->limit;
+    worker->ratelimit->interval = gMSLogParam.ratelimit->interval;
+  }
+
+  return 0;
+} /* End of lm_log_thread_init() */
+
+/***************************************************************************
+ * Install logging parameters from lm_log_thread_init() in a worker
+ * thread, and collect them back when the worker is done.
+ ***************************************************************************/
+void
+lm_log_thread_install (const MSLogParam *worker)
+{
+  gMSLogParam = *worker;
+} /* End of lm_log_thread_install() */
+
+void
+lm_log_thread_collect (MSLogParam *worker)
+{
+  *worker = gMSLogParam;
+  gMSLogParam = (MSLogParam)MSLogParam_INITIALIZER;
+} /* End of lm_log_thread_collect() */
+
+/***************************************************************************
+ * Merge the logging state of a finished worker thread into the calling
+ * thread and free it.
+ *
+ * Messages in the worker registry are added to the registry of the
+ * calling thread, earliest first, and suppressed message counts are
+ * added to those of the calling thread.
+ ***************************************************************************/
+void
+lm_log_thread_merge (MSLogParam *worker)
+{
+  MSLogRegistry *logreg = &worker->registry;
+  MSLogEntry *logentry;
+  int idx;
+
+  if (gMSLogParam.registry.maxmessages > 0)
+  {
+    for (idx = logreg->messagecnt - 1; idx >= 0; idx--)
+    {
+      logentry = &logreg->ring[(logreg->head - idx + logreg->ringsize) % logreg->ringsize];
+      add_message_int (&gMSLogParam.registry, logentry->function, logentry->level,
+                       logentry->message);
+    }
+  }
+
+  if (logreg->ring)
+    libmseed_memory.free (logreg->ring);
+
+  if (worker->ratelimit)
+  {
+    if (gMSLogParam.ratelimit)
+      gMSLogParam.ratelimit->suppressed += worker->ratelimit->suppressed;
+
+    libmseed_memory.free (worker->ratelimit);
+  }
+
+  *worker = (MSLogParam)MSLogParam_INITIALIZER;
+} /* End of lm_log_thread_merge() */
+#endif /* !LIBMSEED_NO_THREADING */
@@ -0,0 +1,703 @@
+/***************************************************************************
+ * Time-ordered reading of records from multiple inputs.
+ *
+ * Records are read from any number of files or URLs, each expected to
+ * be in time order, and returned as a single stream in start time
+ * order with a k-way merge: the next record of each input is kept in a
+ * binary heap ordered by start time.
+ *
+ * The records of each input are read ahead into a small, fixed ring of
+ * reusable records by a pool of threads, so that reading, parsing and
+ * decoding overlap the consumer and memory is bounded by the number of
+ * inputs and the read-ahead depth regardless of the size of the inputs.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2024 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmseed.h"
+#include "internalstate.h"
+
+/* Default count of records read ahead for each input */
+#define LM_MERGE_DEFAULTDEPTH 4
+
+/* Read state for an input */
+typedef struct LM_MERGESTREAM
+{
+  char *path;            /* Input path name */
+  int index;             /* Index of input in list given to reader */
+  MS3FileParam *msfp;    /* Reading state */
+  MS3Record **ring;      /* Ring of records read ahead, reused */
+  char **records;        /* Raw record copies of ring entries, reused */
+  int32_t *recordsizes;  /* Allocated sizes of raw record copies */
+  int head;              /* Ring index of next record to return */
+  int count;             /* Count of records ready in ring */
+  int retcode;           /* Reading result after last ready record */
+  uint8_t busy;          /* Being read by a thread */
+  uint8_t queued;        /* In queue of inputs to read */
+  struct LM_MERGESTREAM *nextqueued;
+} LM_MERGESTREAM;
+
+struct MS3MergeReader
+{
+  LM_MERGESTREAM *streams;          /* Inputs */
+  int streamcount;                  /* Number of inputs */
+  int depth;                        /* Records read ahead per input */
+  LM_MERGESTREAM **heap;            /* Min-heap of inputs by next record start */
+  int heapcount;                    /* Number of inputs in heap */
+  LM_MERGESTREAM *current;          /* Input of last returned record */
+  int8_t started;                   /* Heap has been populated */
+  const MS3Selections *selections;  /* Data selections */
+  uint32_t flags;                   /* Reading flags */
+  int8_t verbose;                   /* Logging level */
+  LM_MERGESTREAM *queuehead;        /* Queue of inputs to read */
+  LM_MERGESTREAM *queuetail;
+  int workercount;                  /* Number of reading threads */
+#if !defined(LIBMSEED_NO_THREADING)
+  lm_mutex_t lock;                  /* Protects ring counts, queue and flags */
+  lm_cond_t work;                   /* Signaled when queue is added to or shutdown */
+  lm_cond_t ready;                  /* Signaled when records are read */
+  lm_thread_t *workers;             /* Reading threads */
+  int8_t shutdown;                  /* Reading threads should exit */
+#endif
+};
+
+static int lm_merge_read (MS3MergeReader *reader, LM_MERGESTREAM *stream, int slot);
+
+/***************************************************************************
+ * Lock and unlock the reader state when reading with threads.
+ ***************************************************************************/
+static inline void
+lm_merge_lock (MS3MergeReader *reader)
+{
+#if !defined(LIBMSEED_NO_THREADING)
+  if (reader->workercount > 0)
+    lm_mutex_lock (&reader->lock);
+#else
+  (void)reader;
+#endif
+} /* End of lm_merge_lock() */
+
+static inline void
+lm_merge_unlock (MS3MergeReader *reader)
+{
+#if !defined(LIBMSEED_NO_THREADING)
+  if (reader->workercount > 0)
+    lm_mutex_unlock (&reader->lock);
+#else
+  (void)reader;
+#endif
+} /* End of lm_merge_unlock() */
+
+/***************************************************************************
+ * Add an input to the queue of inputs to read if it is not already
+ * queued or being read, has free ring entries and is not finished.
+ *
+ * Must be called with the reader locked.
+ ***************************************************************************/
+static void
+lm_merge_enqueue (MS3MergeReader *reader, LM_MERGESTREAM *stream)
+{
+  if (reader->workercount == 0 || stream->busy || stream->queued ||
+      stream->count >= reader->depth || stream->retcode != MS_NOERROR)
+    return;
+
+  stream->queued = 1;
+  stream->nextqueued = NULL;
+
+  if (reader->queuetail)
+    reader->queuetail->nextqueued = stream;
+  else
+    reader->queuehead = stream;
+
+  reader->queuetail = stream;
+
+#if !defined(LIBMSEED_NO_THREADING)
+  lm_cond_broadcast (&reader->work);
+#endif
+} /* End of lm_merge_enqueue() */
+
+#if !defined(LIBMSEED_NO_THREADING)
+/***************************************************************************
+ * Reading thread: fill the rings of queued inputs until shutdown.
+ *
+ * Each input is read by one thread at a time.  Records are read into
+ * the free ring entries without holding the lock, the ring entries
+ * between the head and the ready count are never touched.
+ ***************************************************************************/
+static void
+lm_merge_worker (void *arg)
+{
+  MS3MergeReader *reader = (MS3MergeReader *)arg;
+  LM_MERGESTREAM *stream;
+  int retcode;
+  int slot;
+
+  lm_mutex_lock (&reader->lock);
+
+  while (!reader->shutdown)
+  {
+    if ((stream = reader->queuehead) == NULL)
+    {
+      lm_cond_wait (&reader->work, &reader->lock);
+      continue;
+    }
+
+    if ((reader->queuehead = stream->nextqueued) == NULL)
+      reader->queuetail = NULL;
+
+    stream->queued = 0;
+    stream->busy = 1;
+
+    while (!reader->shutdown && stream->count < reader->depth && stream->retcode == MS_NOERROR)
+    {
+      slot = (stream->head + stream->count) % reader->depth;
+
+      lm_mutex_unlock (&reader->lock);
+      retcode = lm_merge_read (reader, stream, slot);
+      lm_mutex_lock (&reader->lock);
+
+      if (retcode == MS_NOERROR)
+        stream->count++;
+      else
+        stream->retcode = retcode;
+
+      lm_cond_broadcast (&reader->ready);
+    }
+
+    stream->busy = 0;
+  }
+
+  lm_mutex_unlock (&reader->lock);
+} /* End of lm_merge_worker() */
+#endif /* !LIBMSEED_NO_THREADING */
+
+/***************************************************************************
+ * Read the next record of an input into a free ring entry, closing the
+ * input when there are no more records.
+ *
+ * The raw record is copied into a buffer of the ring entry, as the read
+ * buffer it references is reused when later records are read ahead.
+ *
+ * @returns Return value from ms3_readmsr_selection() or MS_GENERROR if
+ * the raw record cannot be copied
+ ***************************************************************************/
+static int
+lm_merge_read (MS3MergeReader *reader, LM_MERGESTREAM *stream, int slot)
+{
+  MS3Record *msr = NULL;
+  char *record;
+  int retcode;
+
+  retcode = ms3_readmsr_selection (&stream->msfp, &stream->ring[slot], stream->path,
+                                   reader->flags, reader->selections, reader->verbose);
+
+  if (retcode == MS_NOERROR && (msr = stream->ring[slot])->record && msr->reclen > 0)
+  {
+    if (msr->reclen > stream->recordsizes[slot])
+    {
+      if ((record = (char *)libmseed_memory.realloc (stream->records[slot], msr->reclen)) == NULL)
+      {
+        ms_log (2, "%s: Cannot allocate memory\n", stream->path);
+        retcode = MS_GENERROR;
+      }
+      else
+      {
+        stream->records[slot] = record;
+        stream->recordsizes[slot] = msr->reclen;
+      }
+    }
+
+    if (retcode == MS_NOERROR)
+    {
+      memcpy (stream->records[slot], msr->record, msr->reclen);
+      msr->record = stream->records[slot];
+    }
+  }
+
+  if (retcode != MS_NOERROR && stream->msfp)
+  {
+    msr = NULL;
+    ms3_readmsr_r (&stream->msfp, &msr, NULL, 0, 0);
+  }
+
+  return retcode;
+} /* End of lm_merge_read() */
+
+/***************************************************************************
+ * Wait until an input has a record ready or is finished, reading
+ * directly if there are no reading threads.
+ *
+ * Must be called with the reader locked.
+ ***************************************************************************/
+static void
+lm_merge_wait (MS3MergeReader *reader, LM_MERGESTREAM *stream)
+{
+  int retcode;
+
+  while (stream->count == 0 && stream->retcode == MS_NOERROR)
+  {
+#if !defined(LIBMSEED_NO_THREADING)
+    if (reader->workercount > 0)
+    {
+      lm_merge_enqueue (reader, stream);
+      lm_cond_wait (&reader->ready, &reader->lock);
+      continue;
+    }
+#endif
+
+    retcode = lm_merge_read (reader, stream, (stream->head + stream->count) % reader->depth);
+
+    if (retcode == MS_NOERROR)
+      stream->count++;
+    else
+      stream->retcode = retcode;
+  }
+} /* End of lm_merge_wait() */
+
+/***************************************************************************
+ * Compare the next records of two inputs, ordered by start time and
+ * then input index for a stable order.
+ *
+ * @returns true if input @p a sorts before input @p b
+ ***************************************************************************/
+static inline int
+lm_merge_before (const LM_MERGESTREAM *a, const LM_MERGESTREAM *b)
+{
+  nstime_t starta = a->ring[a->head]->starttime;
+  nstime_t startb = b->ring[b->head]->starttime;
+
+  if (starta != startb)
+    return (starta < startb);
+
+  return (a->index < b->index);
+} /* End of lm_merge_before() */
+
+/***************************************************************************
+ * Sift the input at a heap position up to restore heap order.
+ ***************************************************************************/
+static void
+lm_merge_heapup (MS3MergeReader *reader, int position)
+{
+  LM_MERGESTREAM *stream = reader->heap[position];
+  int parent;
+
+  while (position > 0)
+  {
+    parent = (position - 1) / 2;
+
+    if (!lm_merge_before (stream, reader->heap[parent]))
+      break;
+
+    reader->heap[position] = reader->heap[parent];
+    position = parent;
+  }
+
+  reader->heap[position] = stream;
+} /* End of lm_merge_heapup() */
+
+/***************************************************************************
+ * Sift the input at a heap position down to restore heap order.
+ ***************************************************************************/
+static void
+lm_merge_heapdown (MS3MergeReader *reader, int position)
+{
+  LM_MERGESTREAM *stream = reader->heap[position];
+  int child;
+
+  while ((child = 2 * position + 1) < reader->heapcount)
+  {
+    if (child + 1 < reader->heapcount &&
+        lm_merge_before (reader->heap[child + 1], reader->heap[child]))
+      child++;
+
+    if (!lm_merge_before (reader->heap[child], stream))
+      break;
+
+    reader->heap[position] = reader->heap[child];
+    position = child;
+  }
+
+  reader->heap[position] = stream;
+} /* End of lm_merge_heapdown() */
+
+/** ************************************************************************
+ * @brief Initialize a reader returning records from multiple inputs in
+ * time order
+ *
+ * Records are read from each of the @p paths, which may be files or
+ * URLs as supported by ms3_readmsr_selection(), and returned by
+ * ms3_mergereader_next() in order of start time across all inputs.
+ * Records with the same start time are returned in the order of the
+ * inputs.  This is a merge of the inputs: the records of each input
+ * must already be in time order for the result to be in time order.
+ *
+ * Up to @p depth records of each input are read ahead, with @p threads
+ * reading threads.  Memory use is bounded by the number of inputs and
+ * @p depth, regardless of the size of the inputs.  Without threading
+ * support, or if threads cannot be started, records are read by
+ * ms3_mergereader_next() when needed.
+ *
+ * @param[in] paths Array of input file names or URLs
+ * @param[in] pathcount Number of entries in @p paths
+ * @param[in] selections Specify limits to which data should be returned, see @ref data-selections
+ * @param[in] flags Flags used to control parsing, see ms3_readmsr_selection()
+ * @param[in] depth Number of records read ahead per input, 0 for the default of 4
+ * @param[in] threads Number of reading threads, 0 for the number of processors
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns pointer to ::MS3MergeReader on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_mergereader_next()
+ * @see ms3_mergereader_free()
+ ***************************************************************************/
+MS3MergeReader *
+ms3_mergereader_init (const char **paths, int pathcount, const MS3Selections *selections,
+                      uint32_t flags, int depth, int threads, int8_t verbose)
+{
+  MS3MergeReader *reader = NULL;
+  LM_MERGESTREAM *stream;
+  size_t length;
+  int idx;
+
+  if (!paths || pathcount <= 0 || depth < 0)
+  {
+    ms_log (2, "%s(): Required input not defined or invalid: 'paths', 'pathcount' or 'depth'\n",
+            __func__);
+    return NULL;
+  }
+
+  if ((reader = (MS3MergeReader *)libmseed_memory.malloc (sizeof (MS3MergeReader))) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    return NULL;
+  }
+
+  memset (reader, 0, sizeof (MS3MergeReader));
+  reader->depth = (depth > 0) ? depth : LM_MERGE_DEFAULTDEPTH;
+  reader->selections = selections;
+  reader->flags = flags;
+  reader->verbose = verbose;
+
+  reader->streams = (LM_MERGESTREAM *)libmseed_memory.malloc (pathcount * sizeof (LM_MERGESTREAM));
+  reader->heap = (LM_MERGESTREAM **)libmseed_memory.malloc (pathcount * sizeof (LM_MERGESTREAM *));
+
+  if (!reader->streams || !reader->heap)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    libmseed_memory.free (reader->streams);
+    libmseed_memory.free (reader->heap);
+    libmseed_memory.free (reader);
+    return NULL;
+  }
+
+  memset (reader->streams, 0, pathcount * sizeof (LM_MERGESTREAM));
+  reader->streamcount = pathcount;
+
+  for (idx = 0; idx < pathcount; idx++)
+  {
+    stream = &reader->streams[idx];
+    stream->index = idx;
+    stream->retcode = MS_NOERROR;
+
+    if (!paths[idx])
+    {
+      ms_log (2, "%s(): Input path %d is not defined\n", __func__, idx);
+      ms3_mergereader_free (&reader);
+      return NULL;
+    }
+
+    length = strlen (paths[idx]) + 1;
+
+    if ((stream->path = (char *)libmseed_memory.malloc (length)) == NULL ||
+        (stream->ring = (MS3Record **)libmseed_memory.malloc (reader->depth *
+                                                              sizeof (MS3Record *))) == NULL ||
+        (stream->records = (char **)libmseed_memory.malloc (reader->depth * sizeof (char *))) ==
+            NULL ||
+        (stream->recordsizes = (int32_t *)libmseed_memory.malloc (reader->depth *
+                                                                  sizeof (int32_t))) == NULL)
+    {
+      ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+      ms3_mergereader_free (&reader);
+      return NULL;
+    }
+
+    memcpy (stream->path, paths[idx], length);
+    memset (stream->ring, 0, reader->depth * sizeof (MS3Record *));
+    memset (stream->records, 0, reader->depth * sizeof (char *));
+    memset (stream->recordsizes, 0, reader->depth * sizeof (int32_t));
+  }
+
+#if !defined(LIBMSEED_NO_THREADING)
+  if (threads <= 0)
+    threads = lm_cpucount ();
+  if (threads > pathcount)
+    threads = pathcount;
+
+  if (lm_mutex_init (&reader->lock) == 0)
+  {
+    if (lm_cond_init (&reader->work) == 0)
+    {
+      if (lm_cond_init (&reader->ready) == 0)
+      {
+        if ((reader->workers = (lm_thread_t *)libmseed_memory.malloc (threads *
+                                                                      sizeof (lm_thread_t))) != NULL)
+        {
+          /* Queue all inputs, then start threads, which take the lock once running */
+          reader->workercount = threads;
+
+          for (idx = 0; idx < pathcount; idx++)
+            lm_merge_enqueue (reader, &reader->streams[idx]);
+
+          for (idx = 0; idx < threads; idx++)
+          {
+            if (lm_thread_create (&reader->workers[idx], lm_merge_worker, reader))
+              break;
+          }
+
+          reader->workercount = idx;
+
+          if (reader->workercount == 0)
+          {
+            libmseed_memory.free (reader->workers);
+            reader->workers = NULL;
+            reader->queuehead = NULL;
+            reader->queuetail = NULL;
+            for (idx = 0; idx < pathcount; idx++)
+              reader->streams[idx].queued = 0;
+          }
+        }
+
+        if (reader->workercount == 0)
+          lm_cond_destroy (&reader->ready);
+      }
+
+      if (reader->workercount == 0)
+        lm_cond_destroy (&reader->work);
+    }
+
+    if (reader->workercount == 0)
+      lm_mutex_destroy (&reader->lock);
+  }
+
+  if (verbose && reader->workercount == 0)
+    ms_log (0, "%s(): Reading threads not available, reading on demand\n", __func__);
+#else
+  (void)threads;
+#endif
+
+  return reader;
+} /* End of ms3_mergereader_init() */
+
+/** ************************************************************************
+ * @brief Return the next record in time order from a merge reader
+ *
+ * The returned record, including the raw record at @c msr->record, is
+ * owned by the reader and is valid until the next call to this function
+ * or ms3_mergereader_free(), it must not be freed by the caller.
+ *
+ * If reading an input fails, the error is returned and the input is no
+ * longer read, subsequent calls continue with the remaining inputs.
+ *
+ * @param[in] reader ::MS3MergeReader to read from
+ * @param[out] ppmsr Pointer to set to the next record
+ * @param[out] pathindex If not NULL, set to the index of the input of the record
+ *
+ * @returns ::MS_NOERROR and populates @p ppmsr with the next record,
+ * ::MS_ENDOFFILE when all inputs have been read, or a negative libmseed
+ * error code as returned by ms3_readmsr_selection().
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_mergereader_next (MS3MergeReader *reader, MS3Record **ppmsr, int *pathindex)
+{
+  LM_MERGESTREAM *stream;
+  int retcode = MS_NOERROR;
+  int idx;
+
+  if (!reader || !ppmsr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'reader' or 'ppmsr'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  *ppmsr = NULL;
+
+  lm_merge_lock (reader);
+
+  /* Populate heap with the first record of each input */
+  if (!reader->started)
+  {
+    reader->started = 1;
+
+    for (idx = 0; idx < reader->streamcount; idx++)
+    {
+      stream = &reader->streams[idx];
+      lm_merge_wait (reader, stream);
+
+      if (stream->count > 0)
+      {
+        reader->heap[reader->heapcount] = stream;
+        lm_merge_heapup (reader, reader->heapcount++);
+      }
+      else if (stream->retcode != MS_ENDOFFILE)
+      {
+        ms_log (2, "%s: Cannot read input: %s\n", stream->path, ms_errorstr (stream->retcode));
+
+        /* Report the first error after populating the heap */
+        if (retcode == MS_NOERROR)
+          retcode = stream->retcode;
+
+        stream->retcode = MS_ENDOFFILE;
+      }
+    }
+
+    if (retcode != MS_NOERROR)
+    {
+      lm_merge_unlock (reader);
+      return retcode;
+    }
+  }
+  /* Release the last returned record and update its input in the heap */
+  else if ((stream = reader->current) != NULL)
+  {
+    reader->current = NULL;
+    stream->head = (stream->head + 1) % reader->depth;
+    stream->count--;
+
+    lm_merge_enqueue (reader, stream);
+    lm_merge_wait (reader, stream);
+
+    if (stream->count == 0)
+    {
+      reader->heap[0] = reader->heap[--reader->heapcount];
+
+      if (reader->heapcount > 0)
+        lm_merge_heapdown (reader, 0);
+
+      if (stream->retcode != MS_ENDOFFILE)
+      {
+        ms_log (2, "%s: Cannot read input: %s\n", stream->path, ms_errorstr (stream->retcode));
+        retcode = stream->retcode;
+        stream->retcode = MS_ENDOFFILE;
+        lm_merge_unlock (reader);
+        return retcode;
+      }
+    }
+    else
+    {
+      lm_merge_heapdown (reader, 0);
+    }
+  }
+
+  lm_merge_unlock (reader);
+
+  if (reader->heapcount == 0)
+    return MS_ENDOFFILE;
+
+  stream = reader->heap[0];
+  reader->current = stream;
+
+  *ppmsr = stream->ring[stream->head];
+
+  if (pathindex)
+    *pathindex = stream->index;
+
+  return MS_NOERROR;
+} /* End of ms3_mergereader_next() */
+
+/** ************************************************************************
+ * @brief Free a merge reader, stopping reading threads and closing inputs
+ *
+ * @param[in,out] ppreader Pointer to the ::MS3MergeReader to free, set to NULL
+ ***************************************************************************/
+void
+ms3_mergereader_free (MS3MergeReader **ppreader)
+{
+  MS3MergeReader *reader;
+  LM_MERGESTREAM *stream;
+  MS3Record *msr;
+  int idx;
+  int slot;
+
+  if (!ppreader || !*ppreader)
+    return;
+
+  reader = *ppreader;
+
+#if !defined(LIBMSEED_NO_THREADING)
+  if (reader->workercount > 0)
+  {
+    lm_mutex_lock (&reader->lock);
+    reader->shutdown = 1;
+    lm_cond_broadcast (&reader->work);
+    lm_mutex_unlock (&reader->lock);
+
+    for (idx = 0; idx < reader->workercount; idx++)
+      lm_thread_join (reader->workers[idx]);
+
+    lm_cond_destroy (&reader->ready);
+    lm_cond_destroy (&reader->work);
+    lm_mutex_destroy (&reader->lock);
+    libmseed_memory.free (reader->workers);
+  }
+#endif
+
+  for (idx = 0; idx < reader->streamcount; idx++)
+  {
+    stream = &reader->streams[idx];
+
+    /* Close input and free reading state */
+    if (stream->msfp)
+    {
+      msr = NULL;
+      ms3_readmsr_r (&stream->msfp, &msr, NULL, 0, 0);
+    }
+
+    if (stream->ring)
+    {
+      for (slot = 0; slot < reader->depth; slot++)
+        msr3_free (&stream->ring[slot]);
+
+      libmseed_memory.free (stream->ring);
+    }
+
+    if (stream->records)
+    {
+      for (slot = 0; slot < reader->depth; slot++)
+        libmseed_memory.free (stream->records[slot]);
+
+      libmseed_memory.free (stream->records);
+    }
+
+    libmseed_memory.free (stream->recordsizes);
+
+    libmseed_memory.free (stream->path);
+  }
+
+  libmseed_memory.free (reader->streams);
+  libmseed_memory.free (reader->heap);
+  libmseed_memory.free (reader);
+
+  *ppreader = NULL;
+} /* End of ms3_mergereader_free() */
@@ -0,0 +1,317 @@
+/***************************************************************************
+ * Optional performance counters and timers.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2024 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "extraheaders.h"
+#include "libmseed.h"
+#include "internalstate.h"
+
+#if defined(LIBMSEED_METRICS)
+
+/* Metrics accumulated by the current thread */
+#if !defined(LIBMSEED_NO_THREADING)
+lm_thread_local MSMetrics lm_metrics;
+#else
+MSMetrics lm_metrics;
+#endif
+
+/***************************************************************************
+ * Return a monotonic time in nanoseconds, only useful for differences.
+ ***************************************************************************/
+uint64_t
+lm_metrics_now (void)
+{
+#if defined(LMP_WIN)
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+
+  if (frequency.QuadPart == 0)
+    QueryPerformanceFrequency (&frequency);
+
+  QueryPerformanceCounter (&counter);
+
+  return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+         (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL /
+             (uint64_t)frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#else
+  return (uint64_t)lmp_systemtime ();
+#endif
+} /* End of lm_metrics_now() */
+
+/***************************************************************************
+ * Counting wrappers used as the default allocators when metrics are
+ * enabled.  Allocations via a user-supplied allocator are not counted.
+ ***************************************************************************/
+void *
+lm_metrics_malloc (size_t size)
+{
+  lm_metrics.allocations++;
+  lm_metrics.allocatedbytes += size;
+
+  return malloc (size);
+}
+
+void *
+lm_metrics_realloc (void *ptr, size_t size)
+{
+  lm_metrics.allocations++;
+  lm_metrics.allocatedbytes += size;
+
+  return realloc (ptr, size);
+}
+
+/***************************************************************************
+ * Add metrics, e.g. of a finished worker thread, to those of the
+ * current thread.
+ ***************************************************************************/
+static void
+add_metric_timer (MSMetricTimer *timer, const MSMetricTimer *add)
+{
+  timer->count += add->count;
+  timer->nanoseconds += add->nanoseconds;
+}
+
+void
+lm_metrics_merge (const MSMetrics *metrics)
+{
+  int idx;
+
+  add_metric_timer (&lm_metrics.parse, &metrics->parse);
+  add_metric_timer (&lm_metrics.crc, &metrics->crc);
+
+  for (idx = 0; idx < MS_METRICS_ENCODINGS; idx++)
+  {
+    add_metric_timer (&lm_metrics.decode[idx], &metrics->decode[idx]);
+    add_metric_timer (&lm_metrics.encode[idx], &metrics->encode[idx]);
+  }
+
+  add_metric_timer (&lm_metrics.tracelistinsert, &metrics->tracelistinsert);
+  add_metric_timer (&lm_metrics.idlookup, &metrics->idlookup);
+  add_metric_timer (&lm_metrics.segmentsearch, &metrics->segmentsearch);
+
+  lm_metrics.bytesread += metrics->bytesread;
+  lm_metrics.allocations += metrics->allocations;
+  lm_metrics.allocatedbytes += metrics->allocatedbytes;
+} /* End of lm_metrics_merge() */
+
+#endif /* LIBMSEED_METRICS */
+
+/** ************************************************************************
+ * @brief Determine if the library was compiled with metrics support
+ *
+ * @returns 1 if metrics are collected, otherwise 0
+ *
+ * @ingroup metrics
+ ***************************************************************************/
+int
+ms_metrics_enabled (void)
+{
+#if defined(LIBMSEED_METRICS)
+  return 1;
+#else
+  return 0;
+#endif
+} /* End of ms_metrics_enabled() */
+
+/** ************************************************************************
+ * @brief Retrieve a copy of the performance metrics for the calling thread
+ *
+ * Metrics are accumulated per-thread; the values returned only
+ * reflect work done by the calling thread, including work done for it
+ * by internal worker threads that have finished.
+ *
+ * @param[out] metrics Destination for the metrics, zeroed when not enabled
+ * @param[in] reset If non-zero, reset the thread's metrics after copying
+ *
+ * @returns 0 on success, -1 if metrics are not enabled or on error
+ *
+ * @ingroup metrics
+ ***************************************************************************/
+int
+ms_metrics_snapshot (MSMetrics *metrics, int reset)
+{
+  if (!metrics)
+    return -1;
+
+#if defined(LIBMSEED_METRICS)
+  memcpy (metrics, &lm_metrics, sizeof (MSMetrics));
+
+  if (reset)
+    memset (&lm_metrics, 0, sizeof (MSMetrics));
+
+  return 0;
+#else
+  (void)reset;
+  memset (metrics, 0, sizeof (MSMetrics));
+
+  return -1;
+#endif
+} /* End of ms_metrics_snapshot() */
+
+/** ************************************************************************
+ * @brief Reset all performance metrics for the calling thread
+ *
+ * @ingroup metrics
+ ***************************************************************************/
+void
+ms_metrics_reset (void)
+{
+#if defined(LIBMSEED_METRICS)
+  memset (&lm_metrics, 0, sizeof (MSMetrics));
+#endif
+} /* End of ms_metrics_reset() */
+
+/***************************************************************************
+ * Add a timer to a JSON object as {"count":N,"nanoseconds":N}.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+add_timer_int (yyjson_mut_doc *doc, yyjson_mut_val *obj, const char *key,
+               const MSMetricTimer *timer)
+{
+  yyjson_mut_val *tobj;
+
+  if ((tobj = yyjson_mut_obj_add_obj (doc, obj, key)) == NULL)
+    return -1;
+
+  if (!yyjson_mut_obj_add_uint (doc, tobj, "count", timer->count) ||
+      !yyjson_mut_obj_add_uint (doc, tobj, "nanoseconds", timer->nanoseconds))
+    return -1;
+
+  return 0;
+} /* End of add_timer_int() */
+
+/***************************************************************************
+ * Add an object of encoding timers keyed by encoding value, only
+ * encodings with a non-zero count are included.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+add_encoding_timers_int (yyjson_mut_doc *doc, yyjson_mut_val *obj, const char *key,
+                         const MSMetricTimer *timers)
+{
+  yyjson_mut_val *eobj;
+  yyjson_mut_val *keyval;
+  char encoding[8];
+  int idx;
+
+  if ((eobj = yyjson_mut_obj_add_obj (doc, obj, key)) == NULL)
+    return -1;
+
+  for (idx = 0; idx < MS_METRICS_ENCODINGS; idx++)
+  {
+    if (timers[idx].count == 0)
+      continue;
+
+    snprintf (encoding, sizeof (encoding), "%d", idx);
+
+    /* Copy the key as it must remain valid until the document is written */
+    if ((keyval = yyjson_mut_strcpy (doc, encoding)) == NULL ||
+        add_timer_int (doc, eobj, yyjson_mut_get_str (keyval), &timers[idx]))
+      return -1;
+  }
+
+  return 0;
+} /* End of add_encoding_timers_int() */
+
+/** ************************************************************************
+ * @brief Render performance metrics as a JSON document
+ *
+ * The document contains an object for each timer with \c count and
+ * \c nanoseconds members, objects for \c decode and \c encode timers
+ * keyed by encoding value (only encodings used are included), and the
+ * \c bytesread, \c allocations and \c allocatedbytes counters.
+ *
+ * If \a metrics is NULL a snapshot of the calling thread's metrics is used.
+ *
+ * The returned string is allocated with ::libmseed_memory and must be
+ * freed by the caller.
+ *
+ * @param[in] metrics Metrics to render, or NULL for the current thread
+ * @param[out] length Length of the returned string, may be NULL
+ *
+ * @returns Allocated JSON string on success, NULL if metrics are not
+ * enabled or on error
+ *
+ * @ingroup metrics
+ ***************************************************************************/
+char *
+ms_metrics_json (const MSMetrics *metrics, size_t *length)
+{
+  yyjson_alc alc = {_priv_malloc, _priv_realloc, _priv_free, NULL};
+  yyjson_mut_doc *doc;
+  yyjson_mut_val *root;
+  MSMetrics current;
+  char *json = NULL;
+  int rv = 0;
+
+  if (!metrics)
+  {
+    if (ms_metrics_snapshot (&current, 0))
+      return NULL;
+
+    metrics = &current;
+  }
+
+  if ((doc = yyjson_mut_doc_new (&alc)) == NULL)
+  {
+    ms_log (2, "%s(): Cannot create JSON document\n", __func__);
+    return NULL;
+  }
+
+  root = yyjson_mut_obj (doc);
+  yyjson_mut_doc_set_root (doc, root);
+
+  rv |= add_timer_int (doc, root, "parse", &metrics->parse);
+  rv |= add_timer_int (doc, root, "crc", &metrics->crc);
+  rv |= add_encoding_timers_int (doc, root, "decode", metrics->decode);
+  rv |= add_encoding_timers_int (doc, root, "encode", metrics->encode);
+  rv |= add_timer_int (doc, root, "tracelistinsert", &metrics->tracelistinsert);
+  rv |= add_timer_int (doc, root, "idlookup", &metrics->idlookup);
+  rv |= add_timer_int (doc, root, "segmentsearch", &metrics->segmentsearch);
+
+  if (rv || !yyjson_mut_obj_add_uint (doc, root, "bytesread", metrics->bytesread) ||
+      !yyjson_mut_obj_add_uint (doc, root, "allocations", metrics->allocations) ||
+      !yyjson_mut_obj_add_uint (doc, root, "allocatedbytes", metrics->allocatedbytes))
+  {
+    ms_log (2, "%s(): Cannot populate JSON document\n", __func__);
+    yyjson_mut_doc_free (doc);
+    return NULL;
+  }
+
+  if ((json = yyjson_mut_write_opts (doc, YYJSON_WRITE_NOFLAG, &alc, length, NULL)) == NULL)
+    ms_log (2, "%s(): Cannot write JSON document\n", __func__);
+
+  yyjson_mut_doc_free (doc);
+
+  return json;
+} /* End of ms_metrics_json() */
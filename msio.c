@@ -160,6 +160,424 @@ header_callback (char *buffer, size_t size, size_t num, void *userdata)
 
 #endif /* defined(LIBMSEED_URL) */
 
+/* Include io_uring definitions if asynchronous read-ahead is requested */
+#if defined(LIBMSEED_IOURING) && defined(__linux__)
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* Number of reads kept in flight for each stream and the size of each */
+#define URING_DEPTH 8
+#define URING_BLOCKSIZE 131072
+
+/* Availability of io_uring: -1 untested, 0 unavailable, 1 available.
+ * Shared by all threads, only accessed atomically. */
+static int uring_available = -1;
+
+/* A read block of an io_uring stream */
+struct uring_block
+{
+  char *buffer;       /* Block data */
+  struct iovec iov;   /* Vector for read request */
+  int64_t result;     /* Bytes read or negative errno when complete */
+  int64_t consumed;   /* Bytes consumed by the reader */
+  uint8_t inflight;   /* Read request submitted and not completed */
+  uint8_t complete;   /* Read completed */
+};
+
+/* An io_uring read-ahead stream, the LMIO handle for LMIO_URING */
+struct uring_stream
+{
+  int fd;                 /* File descriptor being read */
+  int ringfd;             /* io_uring file descriptor */
+  void *sqring;           /* Mapped submission queue ring */
+  size_t sqringsize;
+  void *cqring;           /* Mapped completion queue ring, may equal sqring */
+  size_t cqringsize;
+  struct io_uring_sqe *sqes;
+  size_t sqessize;
+  unsigned *sqhead;
+  unsigned *sqtail;
+  unsigned *sqmask;
+  unsigned *sqarray;
+  unsigned *cqhead;
+  unsigned *cqtail;
+  unsigned *cqmask;
+  struct io_uring_cqe *cqes;
+  int64_t nextoffset;     /* File offset of next block to request */
+  int inflight;           /* Count of reads in flight */
+  int current;            /* Index of block being consumed */
+  int eof;                /* End of file reached by consumer */
+  int lastblock;          /* A short or empty read has been requested */
+  char *buffers;          /* Allocation for all block buffers */
+  struct uring_block blocks[URING_DEPTH];
+};
+
+static int
+uring_setup (unsigned entries, struct io_uring_params *params)
+{
+  return (int)syscall (__NR_io_uring_setup, entries, params);
+}
+
+static int
+uring_enter (int ringfd, unsigned submit, unsigned wait, unsigned flags)
+{
+  return (int)syscall (__NR_io_uring_enter, ringfd, submit, wait, flags, NULL, 0);
+}
+
+/*********************************************************************
+ * Release all resources of an io_uring stream.  Any reads in flight
+ * are waited for first, as they target the block buffers.
+ *********************************************************************/
+static void
+uring_free (struct uring_stream *stream)
+{
+  unsigned head;
+
+  if (!stream)
+    return;
+
+  while (stream->inflight > 0 && stream->ringfd >= 0)
+  {
+    if (uring_enter (stream->ringfd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+      break;
+
+    head = *stream->cqhead;
+    while (head != __atomic_load_n (stream->cqtail, __ATOMIC_ACQUIRE))
+    {
+      head++;
+      stream->inflight--;
+    }
+    __atomic_store_n (stream->cqhead, head, __ATOMIC_RELEASE);
+  }
+
+  if (stream->sqes)
+    munmap (stream->sqes, stream->sqessize);
+  if (stream->cqring && stream->cqring != stream->sqring)
+    munmap (stream->cqring, stream->cqringsize);
+  if (stream->sqring)
+    munmap (stream->sqring, stream->sqringsize);
+  if (stream->ringfd >= 0)
+    close (stream->ringfd);
+  if (stream->fd >= 0)
+    close (stream->fd);
+
+  libmseed_memory.free (stream->buffers);
+  libmseed_memory.free (stream);
+} /* End of uring_free() */
+
+/*********************************************************************
+ * Create an io_uring and map its submission and completion rings.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+static int
+uring_map (struct uring_stream *stream)
+{
+  struct io_uring_params params;
+
+  memset (&params, 0, sizeof (params));
+
+  if ((stream->ringfd = uring_setup (URING_DEPTH, &params)) < 0)
+    return -1;
+
+  stream->sqringsize = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+  stream->cqringsize = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+
+  /* Kernels with a single mapping for both rings */
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (stream->cqringsize > stream->sqringsize)
+      stream->sqringsize = stream->cqringsize;
+    stream->cqringsize = stream->sqringsize;
+  }
+
+  stream->sqring = mmap (NULL, stream->sqringsize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, stream->ringfd, IORING_OFF_SQ_RING);
+  if (stream->sqring == MAP_FAILED)
+  {
+    stream->sqring = NULL;
+    return -1;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    stream->cqring = stream->sqring;
+  }
+  else
+  {
+    stream->cqring = mmap (NULL, stream->cqringsize, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, stream->ringfd, IORING_OFF_CQ_RING);
+    if (stream->cqring == MAP_FAILED)
+    {
+      stream->cqring = NULL;
+      return -1;
+    }
+  }
+
+  stream->sqessize = params.sq_entries * sizeof (struct io_uring_sqe);
+  stream->sqes = mmap (NULL, stream->sqessize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, stream->ringfd, IORING_OFF_SQES);
+  if (stream->sqes == MAP_FAILED)
+  {
+    stream->sqes = NULL;
+    return -1;
+  }
+
+  stream->sqhead = (unsigned *)((char *)stream->sqring + params.sq_off.head);
+  stream->sqtail = (unsigned *)((char *)stream->sqring + params.sq_off.tail);
+  stream->sqmask = (unsigned *)((char *)stream->sqring + params.sq_off.ring_mask);
+  stream->sqarray = (unsigned *)((char *)stream->sqring + params.sq_off.array);
+  stream->cqhead = (unsigned *)((char *)stream->cqring + params.cq_off.head);
+  stream->cqtail = (unsigned *)((char *)stream->cqring + params.cq_off.tail);
+  stream->cqmask = (unsigned *)((char *)stream->cqring + params.cq_off.ring_mask);
+  stream->cqes = (struct io_uring_cqe *)((char *)stream->cqring + params.cq_off.cqes);
+
+  return 0;
+} /* End of uring_map() */
+
+/*********************************************************************
+ * Submit a read request for the next block of the file into a block.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+static int
+uring_submit (struct uring_stream *stream, int index)
+{
+  struct uring_block *block = &stream->blocks[index];
+  struct io_uring_sqe *sqe;
+  unsigned tail;
+  int rv;
+
+  tail = *stream->sqtail;
+  sqe = &stream->sqes[tail & *stream->sqmask];
+
+  memset (sqe, 0, sizeof (*sqe));
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = stream->fd;
+  sqe->off = (uint64_t)stream->nextoffset;
+  sqe->addr = (uint64_t)(uintptr_t)&block->iov;
+  sqe->len = 1;
+  sqe->user_data = (uint64_t)index;
+
+  block->iov.iov_base = block->buffer;
+  block->iov.iov_len = URING_BLOCKSIZE;
+  block->result = 0;
+  block->consumed = 0;
+  block->inflight = 1;
+  block->complete = 0;
+
+  stream->sqarray[tail & *stream->sqmask] = tail & *stream->sqmask;
+  __atomic_store_n (stream->sqtail, tail + 1, __ATOMIC_RELEASE);
+
+  while ((rv = uring_enter (stream->ringfd, 1, 0, 0)) < 0 && errno == EINTR)
+    ;
+
+  if (rv < 1)
+  {
+    /* Withdraw the unsubmitted entry */
+    __atomic_store_n (stream->sqtail, tail, __ATOMIC_RELEASE);
+    block->inflight = 0;
+    return -1;
+  }
+
+  stream->nextoffset += URING_BLOCKSIZE;
+  stream->inflight++;
+
+  return 0;
+} /* End of uring_submit() */
+
+/*********************************************************************
+ * Collect completed reads, waiting for at least one if requested.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+static int
+uring_reap (struct uring_stream *stream, int wait)
+{
+  struct io_uring_cqe *cqe;
+  struct uring_block *block;
+  unsigned head;
+
+  if (wait && uring_enter (stream->ringfd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+    return -1;
+
+  head = *stream->cqhead;
+  while (head != __atomic_load_n (stream->cqtail, __ATOMIC_ACQUIRE))
+  {
+    cqe = &stream->cqes[head & *stream->cqmask];
+    block = &stream->blocks[cqe->user_data % URING_DEPTH];
+
+    block->result = cqe->res;
+    block->inflight = 0;
+    block->complete = 1;
+    stream->inflight--;
+
+    /* A short read is the end of the file, stop requesting more */
+    if (cqe->res < URING_BLOCKSIZE)
+      stream->lastblock = 1;
+
+    head++;
+  }
+  __atomic_store_n (stream->cqhead, head, __ATOMIC_RELEASE);
+
+  return 0;
+} /* End of uring_reap() */
+
+/*********************************************************************
+ * Test if io_uring can be used by creating a minimal ring.  The
+ * result is cached, environment variable LIBMSEED_IOURING_DISABLE
+ * disables use.
+ *
+ * Threads that race on the first probe each test and store the same
+ * result, so the cache needs no lock.
+ *********************************************************************/
+static int
+uring_probe (void)
+{
+  struct io_uring_params params;
+  int available;
+  int ringfd;
+
+  if ((available = __atomic_load_n (&uring_available, __ATOMIC_ACQUIRE)) >= 0)
+    return available;
+
+  available = 0;
+
+  if (!getenv ("LIBMSEED_IOURING_DISABLE"))
+  {
+    memset (&params, 0, sizeof (params));
+
+    if ((ringfd = uring_setup (1, &params)) >= 0)
+    {
+      available = 1;
+      close (ringfd);
+    }
+  }
+
+  __atomic_store_n (&uring_available, available, __ATOMIC_RELEASE);
+
+  return available;
+} /* End of uring_probe() */
+
+/*********************************************************************
+ * Open a file for reading with io_uring read-ahead, keeping
+ * URING_DEPTH block reads in flight.
+ *
+ * Returns the stream on success and NULL if io_uring cannot be used,
+ * in which case the caller should fall back to stdio.
+ *********************************************************************/
+static struct uring_stream *
+uring_open (const char *path, int64_t startoffset)
+{
+  struct uring_stream *stream;
+  int index;
+
+  if (!uring_probe ())
+    return NULL;
+
+  if ((stream = (struct uring_stream *)libmseed_memory.malloc (sizeof (*stream))) == NULL)
+    return NULL;
+
+  memset (stream, 0, sizeof (*stream));
+  stream->ringfd = -1;
+  stream->nextoffset = (startoffset > 0) ? startoffset : 0;
+
+  if ((stream->fd = open (path, O_RDONLY | O_CLOEXEC)) < 0 ||
+      (stream->buffers = (char *)libmseed_memory.malloc (URING_DEPTH * URING_BLOCKSIZE)) ==
+          NULL ||
+      uring_map (stream))
+  {
+    uring_free (stream);
+    return NULL;
+  }
+
+  for (index = 0; index < URING_DEPTH; index++)
+  {
+    stream->blocks[index].buffer = stream->buffers + (size_t)index * URING_BLOCKSIZE;
+
+    if (uring_submit (stream, index))
+    {
+      uring_free (stream);
+      return NULL;
+    }
+  }
+
+  return stream;
+} /* End of uring_open() */
+
+/*********************************************************************
+ * Read from an io_uring stream, consuming blocks in file order and
+ * requesting the next block as each is consumed.
+ *
+ * Returns the number of bytes read on success and -1 on error.
+ *********************************************************************/
+static int64_t
+uring_read (struct uring_stream *stream, char *buffer, size_t size)
+{
+  struct uring_block *block;
+  size_t read = 0;
+  size_t copy;
+
+  while (read < size && !stream->eof)
+  {
+    block = &stream->blocks[stream->current];
+
+    /* Block was never requested after the end of the file */
+    if (!block->inflight && !block->complete)
+    {
+      stream->eof = 1;
+      break;
+    }
+
+    while (!block->complete)
+    {
+      if (uring_reap (stream, 1))
+        return -1;
+    }
+
+    if (block->result < 0)
+    {
+      errno = (int)-block->result;
+      ms_log (2, "Error reading file (%s)\n", strerror (errno));
+      return -1;
+    }
+
+    copy = (size_t)(block->result - block->consumed);
+    if (copy > size - read)
+      copy = size - read;
+
+    memcpy (buffer + read, block->buffer + block->consumed, copy);
+    block->consumed += copy;
+    read += copy;
+
+    if (block->consumed < block->result)
+      break;
+
+    /* Block consumed, a short block is the end of the file */
+    if (block->result < URING_BLOCKSIZE)
+    {
+      stream->eof = 1;
+      break;
+    }
+
+    block->complete = 0;
+
+    if (!stream->lastblock && uring_submit (stream, stream->current))
+      return -1;
+
+    stream->current = (stream->current + 1) % URING_DEPTH;
+  }
+
+  return (int64_t)read;
+} /* End of uring_read() */
+
+#endif /* defined(LIBMSEED_IOURING) && defined(__linux__) */
+
 /***************************************************************************
  * msio_fopen:
  *
@@ -175,12 +593,18 @@ header_callback (char *buffer, size_t size, size_t num, void *userdata)
  * actual range if reported via HTTP, which may be different than
  * requested.
  *
+ * If MSIO_READAHEAD is set in 'ioflags' and the library was built
+ * with LIBMSEED_IOURING on Linux, files opened in "rb" mode are read
+ * with io_uring, keeping multiple block reads in flight.  When
+ * io_uring is not available the file is opened with stdio.
+ *
  * Return 0 on success and -1 on error.
  *
  * @ref MessageOnError - this function logs a message on error
  ***************************************************************************/
 int
-msio_fopen (LMIO *io, const char *path, const char *mode, int64_t *startoffset, int64_t *endoffset)
+msio_fopen (LMIO *io, const char *path, const char *mode, int64_t *startoffset,
+            int64_t *endoffset, uint32_t ioflags)
 {
   int knownfile = 0;
 
@@ -384,6 +808,17 @@ msio_fopen (LMIO *io, const char *path, const char *mode, int64_t *startoffset,
   }
   else
   {
+#if defined(LIBMSEED_IOURING) && defined(__linux__)
+    if ((ioflags & MSIO_READAHEAD) && strcmp (mode, "rb") == 0 &&
+        (io->handle = uring_open (path, (startoffset) ? *startoffset : 0)) != NULL)
+    {
+      io->type = LMIO_URING;
+      return 0;
+    }
+#else
+    (void)ioflags; /* Unused */
+#endif
+
     io->type = LMIO_FILE;
 
     if ((io->handle = fopen (path, mode)) == NULL)
@@ -439,6 +874,12 @@ msio_fclose (LMIO *io)
       return -1;
     }
   }
+#if defined(LIBMSEED_IOURING) && defined(__linux__)
+  else if (io->type == LMIO_URING)
+  {
+    uring_free ((struct uring_stream *)io->handle);
+  }
+#endif
   else if (io->type == LMIO_URL)
   {
 #if !defined(LIBMSEED_URL)
@@ -498,6 +939,13 @@ msio_fread (LMIO *io, void *buffer, size_t size)
   {
     read = fread (buffer, 1, size, io->handle);
   }
+#if defined(LIBMSEED_IOURING) && defined(__linux__)
+  /* Read from io_uring stream */
+  else if (io->type == LMIO_URING)
+  {
+    return uring_read ((struct uring_stream *)io->handle, buffer, size);
+  }
+#endif
   /* Read from URL stream */
   else if (io->type == LMIO_URL)
   {
@@ -608,6 +1056,13 @@ msio_feof (LMIO *io)
     if (feof ((FILE *)io->handle))
       return 1;
   }
+#if defined(LIBMSEED_IOURING) && defined(__linux__)
+  else if (io->type == LMIO_URING)
+  {
+    if (((struct uring_stream *)io->handle)->eof)
+      return 1;
+  }
+#endif
   else if (io->type == LMIO_URL)
   {
 #if !defined(LIBMSEED_URL)
@@ -625,6 +1080,23 @@ msio_feof (LMIO *io)
   return 0;
 } /* End of msio_feof() */
 
+/*********************************************************************
+ * msio_readahead_support:
+ *
+ * Test if io_uring read-ahead is compiled in and usable.
+ *
+ * Returns 1 if available, otherwise 0.
+ *********************************************************************/
+int
+msio_readahead_support (void)
+{
+#if defined(LIBMSEED_IOURING) && defined(__linux__)
+  return uring_probe ();
+#else
+  return 0;
+#endif
+} /* End of msio_readahead_support() */
+
 /*********************************************************************
  * msio_url_useragent:
  *
@@ -27,11 +27,15 @@ extern "C" {
 
 #include "libmseed.h"
 
+/* Flags for msio_fopen() */
+#define MSIO_READAHEAD 0x0001 /* Use asynchronous read-ahead if available */
+
 extern int msio_fopen (LMIO *io, const char *path, const char *mode,
-                       int64_t *startoffset, int64_t *endoffset);
+                       int64_t *startoffset, int64_t *endoffset, uint32_t ioflags);
 extern int msio_fclose (LMIO *io);
 extern int64_t msio_fread (LMIO *io, void *buffer, size_t size);
 extern int msio_feof (LMIO *io);
+extern int msio_readahead_support (void);
 extern int msio_url_useragent (const char *program, const char *version);
 extern int msio_url_userpassword (const char *userpassword);
 extern int msio_url_addheader (const char *header);
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <time.h>
 
+#include "extraheaders.h"
 #include "libmseed.h"
 
 /** ************************************************************************
@@ -32,7 +33,8 @@
  *
  * If memory for the @c datasamples field has been allocated the pointer
  * will be retained for reuse.  If memory for extra headers has been
- * allocated it will be released.
+ * allocated it will be released.  If an extra header cache has been
+ * enabled with mseh_cache_enable() it will be retained but invalidated.
  *
  * @param[in] msr A ::MS3Record to re-initialize
  *
@@ -44,6 +46,7 @@ MS3Record *
 msr3_init (MS3Record *msr)
 {
   MS3Record msr_initialized = MS3Record_INITIALIZER;
+  LM_PARSED_JSON *extracache = NULL;
   void *datasamples = NULL;
   size_t datasize = 0;
 
@@ -56,8 +59,9 @@ msr3_init (MS3Record *msr)
     datasamples = msr->datasamples;
     datasize = msr->datasize;
 
-    if (msr->extra)
-      libmseed_memory.free (msr->extra);
+    /* Release extra headers and invalidate any cached parsed form */
+    mseh_replace (msr, NULL);
+    extracache = msr->extracache;
   }
 
   if (msr == NULL)
@@ -70,6 +74,7 @@ msr3_init (MS3Record *msr)
 
   msr->datasamples = datasamples;
   msr->datasize = datasize;
+  msr->extracache = extracache;
 
   return msr;
 } /* End of msr3_init() */
@@ -90,6 +95,9 @@ msr3_free (MS3Record **ppmsr)
     if ((*ppmsr)->extra)
       libmseed_memory.free ((*ppmsr)->extra);
 
+    if ((*ppmsr)->extracache)
+      mseh_free_parsestate (&(*ppmsr)->extracache);
+
     if ((*ppmsr)->datasamples)
       libmseed_memory.free ((*ppmsr)->datasamples);
 
@@ -102,7 +110,7 @@ msr3_free (MS3Record **ppmsr)
 /** ************************************************************************
  * @brief Duplicate a ::MS3Record
  *
- * Extra headers are duplicated as well.
+ * Extra headers are duplicated as well, an extra header cache is not.
  *
  * If the @p datadup flag is true (non-zero) and the source
  * ::MS3Record has associated data samples copy them as well.
@@ -118,6 +126,8 @@ MS3Record *
 msr3_duplicate (const MS3Record *msr, int8_t datadup)
 {
   MS3Record *dupmsr = NULL;
+  MS3Record view;
+  int rv;
 
   if (!msr)
   {
@@ -125,6 +135,17 @@ msr3_duplicate (const MS3Record *msr, int8_t datadup)
     return NULL;
   }
 
+  /* Duplicate with pending changes in the extra header cache */
+  if ((rv = mseh_cache_view (msr, &view)) != 0)
+  {
+    if (rv < 0)
+      return NULL;
+
+    dupmsr = msr3_duplicate (&view, datadup);
+    libmseed_memory.free (view.extra);
+    return dupmsr;
+  }
+
   /* Allocate target MS3Record structure */
   if ((dupmsr = msr3_init (NULL)) == NULL)
     return NULL;
@@ -135,6 +156,7 @@ msr3_duplicate (const MS3Record *msr, int8_t datadup)
   /* Disconnect pointers from the source structure and reference values */
   dupmsr->extra = NULL;
   dupmsr->extralength = 0;
+  dupmsr->extracache = NULL;
   dupmsr->datasamples = NULL;
   dupmsr->datasize = 0;
   dupmsr->numsamples = 0;
@@ -224,12 +246,21 @@ msr3_endtime (const MS3Record *msr)
 void
 msr3_print (const MS3Record *msr, int8_t details)
 {
+  MS3Record view;
   char time[40];
   char b;
 
   if (!msr)
     return;
 
+  /* Print pending changes in the extra header cache */
+  if (mseh_cache_view (msr, &view) > 0)
+  {
+    msr3_print (&view, details);
+    libmseed_memory.free (view.extra);
+    return;
+  }
+
   /* Generate a start time string */
   ms_nstime2timestr_n (msr->starttime, time, sizeof (time), ISOMONTHDAY_DOY_Z, NANO_MICRO);
 
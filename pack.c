@@ -19,6 +19,8 @@
  * limitations under the License.
  ***************************************************************************/
 
+#include <float.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,7 +43,15 @@ static int msr3_pack_header2_offsets (const MS3Record *msr, char *record, uint32
 
 static int64_t msr_pack_data (void *dest, void *src, uint64_t maxsamples, uint64_t maxdatabytes,
                               char sampletype, int8_t encoding, int8_t swapflag,
-                              uint32_t *byteswritten, const char *sid, int8_t verbose);
+                              uint32_t *byteswritten, double *minmax, const char *sid,
+                              int8_t verbose);
+
+static int msr3_pack_summary_init (MS3RecordPacker *packer);
+
+static int msr3_pack_summary (MS3RecordPacker *packer, const double *minmax);
+
+static void msr_sample_range (const void *src, int64_t nsamples, char sampletype, double *minmax);
+static float msr_float_step (float value, int up);
 
 static int ms_genfactmult (double samprate, int16_t *factor, int16_t *multiplier);
 
@@ -90,6 +100,17 @@ static nstime_t nstime2fsec_usec_offset (nstime_t nstime, uint16_t *fsec, int8_t
  * To create a header-only record with no data payload (i.e., no samples), set
  * @ref MS3Record.numsamples to 0.
  *
+ * If @p flags has ::MSF_PACKMINMAX set, the minimum and maximum of the
+ * samples in each miniSEED 3 record are added to the extra headers at
+ * @c /LM/Samples/Min and @c /LM/Samples/Max.  The range is determined
+ * while encoding, allowing readers to summarize records without decoding
+ * the data.  Integer ranges are exact, float ranges are stored with single
+ * precision and double ranges are rounded outward to single precision so
+ * that they bound the samples.  NaN samples are ignored and no range is
+ * added for records with infinite values, text or for miniSEED 2.  Space
+ * for the headers is reserved in every record, slightly reducing the
+ * samples per record.
+ *
  * @param[in] msr ::MS3Record containing data to pack
  * @param[in] record_handler() Callback function called for each record
  * @param[in] handlerdata A pointer that will be provided to the @p record_handler()
@@ -98,6 +119,7 @@ static nstime_t nstime2fsec_usec_offset (nstime_t nstime, uint16_t *fsec, int8_t
  * @parblock
  *  - @c ::MSF_FLUSHDATA : Pack all data in the buffer
  *  - @c ::MSF_PACKVER2 : Pack miniSEED version 2 regardless of ::MS3Record.formatversion
+ *  - @c ::MSF_PACKMINMAX : Add the sample range of each record to extra headers
  * @endparblock
  * @param[in] verbose Controls logging verbosity, 0 is no diagnostic output
  *
@@ -166,6 +188,7 @@ msr3_pack (const MS3Record *msr, void (*record_handler) (char *, int, void *), v
  * @parblock
  *  - @c ::MSF_FLUSHDATA : Pack all data in the buffer
  *  - @c ::MSF_PACKVER2 : Pack miniSEED version 2 regardless of ::MS3Record.formatversion
+ *  - @c ::MSF_PACKMINMAX : Add the sample range of each record to extra headers
  * @endparblock
  * @param[in] verbose Controls logging verbosity, 0 is no diagnostic output
  *
@@ -180,6 +203,7 @@ MS3RecordPacker *
 msr3_pack_init (const MS3Record *msr, uint32_t flags, int8_t verbose)
 {
   MS3RecordPacker *packer = NULL;
+  int rv;
 
   if (!msr)
   {
@@ -203,6 +227,17 @@ msr3_pack_init (const MS3Record *msr, uint32_t flags, int8_t verbose)
 
   memset (packer, 0, sizeof (MS3RecordPacker));
 
+  /* Pack a copy with pending changes in the extra header cache serialized */
+  if ((rv = mseh_cache_view (msr, &packer->view)) < 0)
+  {
+    ms_log (2, "%s: Cannot serialize cached extra headers\n", msr->sid);
+    libmseed_memory.free (packer);
+    return NULL;
+  }
+
+  if (rv > 0)
+    msr = &packer->view;
+
   /* Store parameters */
   packer->msr = msr;
   packer->flags = flags;
@@ -236,7 +271,7 @@ msr3_pack_init (const MS3Record *msr, uint32_t flags, int8_t verbose)
               "%s: Record length (%u) is not large enough for header (%u), SID (%" PRIsize_t
               "), and extra (%d)\n",
               msr->sid, packer->maxreclen, MS3FSDH_LENGTH, strlen (msr->sid), msr->extralength);
-      libmseed_memory.free (packer);
+      msr3_pack_free (&packer, NULL);
       return NULL;
     }
   }
@@ -246,7 +281,7 @@ msr3_pack_init (const MS3Record *msr, uint32_t flags, int8_t verbose)
   if (!packer->rawrec)
   {
     ms_log (2, "%s: Cannot allocate memory for record buffer\n", msr->sid);
-    libmseed_memory.free (packer);
+    msr3_pack_free (&packer, NULL);
     return NULL;
   }
 
@@ -259,8 +294,7 @@ msr3_pack_init (const MS3Record *msr, uint32_t flags, int8_t verbose)
     if (!packer->samplesize)
     {
       ms_log (2, "%s: Unknown sample type '%c'\n", msr->sid, msr->sampletype);
-      libmseed_memory.free (packer->rawrec);
-      libmseed_memory.free (packer);
+      msr3_pack_free (&packer, NULL);
       return NULL;
     }
   }
@@ -292,16 +326,26 @@ msr3_pack_init (const MS3Record *msr, uint32_t flags, int8_t verbose)
   if (packer->dataoffset < 0)
   {
     ms_log (2, "%s: Cannot pack miniSEED header\n", msr->sid);
-    libmseed_memory.free (packer->rawrec);
-    libmseed_memory.free (packer);
+    msr3_pack_free (&packer, NULL);
     return NULL;
   }
 
+  /* Set up sample range extra headers if requested */
+  if ((flags & MSF_PACKMINMAX) && packer->formatversion == 3 && msr->numsamples > 0 &&
+      msr->sampletype != 't' && msr->sampletype != 'a')
+  {
+    if (msr3_pack_summary_init (packer))
+    {
+      msr3_pack_free (&packer, NULL);
+      return NULL;
+    }
+  }
+
   /* For records with samples, set up encoding buffers and parameters */
   if (msr->numsamples > 0)
   {
     /* Determine the max data bytes and sample count */
-    packer->maxdatabytes = packer->maxreclen - packer->dataoffset;
+    packer->maxdatabytes = packer->maxreclen - packer->dataoffset - packer->summaryreserve;
 
     if (packer->encoding == DE_STEIM1)
     {
@@ -364,6 +408,7 @@ msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen)
   int64_t samples_packed;
   int64_t packoffset_bytes;
   uint64_t remaining_samples;
+  double minmax[2];
   uint32_t datalength;
   uint32_t reclen_generated;
   uint32_t crc;
@@ -448,10 +493,14 @@ msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen)
   /* Pack data samples */
   packoffset_bytes = packer->packed_samples * packer->samplesize;
 
+  LM_METRIC_START (metricstart);
+
   samples_packed = msr_pack_data (
       packer->encoded, (uint8_t *)packer->msr->datasamples + packoffset_bytes, remaining_samples,
       packer->maxdatabytes, packer->msr->sampletype, packer->encoding, packer->swapflag,
-      &datalength, packer->msr->sid, packer->verbose);
+      &datalength, (packer->summary) ? minmax : NULL, packer->msr->sid, packer->verbose);
+
+  LM_METRIC_STOP (lm_metrics.encode[LM_METRIC_ENCODING (packer->encoding)], metricstart);
 
   if (samples_packed < 0)
   {
@@ -465,6 +514,13 @@ msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen)
     return 0;
   }
 
+  /* Replace extra headers with those including the sample range of this record */
+  if (packer->summary && msr3_pack_summary (packer, minmax))
+  {
+    ms_log (2, "%s: Cannot add sample range to extra headers\n", packer->msr->sid);
+    return -1;
+  }
+
   /* Copy encoded data into record */
   memcpy (packer->rawrec + packer->dataoffset, packer->encoded, datalength);
 
@@ -592,6 +648,15 @@ msr3_pack_free (MS3RecordPacker **packer, int64_t *packedsamples)
   if ((*packer)->encoded)
     libmseed_memory.free ((*packer)->encoded);
 
+  if ((*packer)->summarystate)
+    mseh_free_parsestate (&(*packer)->summarystate);
+
+  if ((*packer)->summary)
+    msr3_free (&(*packer)->summary);
+
+  if ((*packer)->view.extra)
+    libmseed_memory.free ((*packer)->view.extra);
+
   libmseed_memory.free (*packer);
   *packer = NULL;
 } /* End of msr3_pack_free() */
@@ -618,6 +683,7 @@ msr3_pack_free (MS3RecordPacker **packer, int64_t *packedsamples)
 int
 msr3_repack_mseed3 (const MS3Record *msr, char *record, uint32_t recbuflen, int8_t verbose)
 {
+  MS3Record view;
   int dataoffset;
   uint32_t origdataoffset;
   uint32_t origdatasize;
@@ -631,6 +697,20 @@ msr3_repack_mseed3 (const MS3Record *msr, char *record, uint32_t recbuflen, int8
     return -1;
   }
 
+  /* Repack with pending changes in the extra header cache */
+  if ((dataoffset = mseh_cache_view (msr, &view)) != 0)
+  {
+    if (dataoffset < 0)
+    {
+      ms_log (2, "%s: Cannot serialize cached extra headers\n", msr->sid);
+      return -1;
+    }
+
+    dataoffset = msr3_repack_mseed3 (&view, record, recbuflen, verbose);
+    libmseed_memory.free (view.extra);
+    return dataoffset;
+  }
+
   if (recbuflen < (MS3FSDH_LENGTH + strlen (msr->sid) + msr->extralength))
   {
     ms_log (2,
@@ -713,6 +793,7 @@ msr3_repack_mseed3 (const MS3Record *msr, char *record, uint32_t recbuflen, int8
 int
 msr3_pack_header3 (const MS3Record *msr, char *record, uint32_t recbuflen, int8_t verbose)
 {
+  MS3Record view;
   int extraoffset = 0;
   size_t sidlength;
   uint32_t maxreclen;
@@ -732,6 +813,20 @@ msr3_pack_header3 (const MS3Record *msr, char *record, uint32_t recbuflen, int8_
     return -1;
   }
 
+  /* Pack with pending changes in the extra header cache */
+  if ((extraoffset = mseh_cache_view (msr, &view)) != 0)
+  {
+    if (extraoffset < 0)
+    {
+      ms_log (2, "%s: Cannot serialize cached extra headers\n", msr->sid);
+      return -1;
+    }
+
+    extraoffset = msr3_pack_header3 (&view, record, recbuflen, verbose);
+    libmseed_memory.free (view.extra);
+    return extraoffset;
+  }
+
   /* Use default record length and encoding if needed */
   maxreclen = (msr->reclen < 0) ? MS_PACK_DEFAULT_RECLEN : msr->reclen;
   encoding = (msr->encoding < 0) ? MS_PACK_DEFAULT_ENCODING : msr->encoding;
@@ -971,6 +1066,7 @@ msr3_pack_header2_offsets (const MS3Record *msr, char *record, uint32_t recbufle
                            uint16_t *blockette_1000_offset, uint16_t *blockette_1001_offset,
                            int8_t verbose)
 {
+  MS3Record view;
   int written = 0;
   int8_t swapflag;
   uint32_t reclen;
@@ -1017,6 +1113,21 @@ msr3_pack_header2_offsets (const MS3Record *msr, char *record, uint32_t recbufle
     return -1;
   }
 
+  /* Pack with pending changes in the extra header cache */
+  if ((written = mseh_cache_view (msr, &view)) != 0)
+  {
+    if (written < 0)
+    {
+      ms_log (2, "%s: Cannot serialize cached extra headers\n", msr->sid);
+      return -1;
+    }
+
+    written = msr3_pack_header2_offsets (&view, record, recbuflen, blockette_1000_offset,
+                                         blockette_1001_offset, verbose);
+    libmseed_memory.free (view.extra);
+    return written;
+  }
+
   /* Initialize blockette offsets to 0 */
   if (blockette_1000_offset)
     *blockette_1000_offset = 0;
@@ -1768,20 +1879,254 @@ msr3_pack_header2_offsets (const MS3Record *msr, char *record, uint32_t recbufle
   return written;
 } /* End of msr3_pack_header2() */
 
+/************************************************************************
+ *  Set up a scratch record with a copy of the template extra headers
+ *  used to add the sample range to each record and reserve space in
+ *  the record for the largest extra headers that can result.
+ *
+ *  Return 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ************************************************************************/
+static int
+msr3_pack_summary_init (MS3RecordPacker *packer)
+{
+  const MS3Record *msr = packer->msr;
+  int64_t widest = INT32_MIN;
+  int extralength;
+
+  if ((packer->summary = msr3_init (NULL)) == NULL)
+  {
+    ms_log (2, "%s: Cannot allocate memory for sample range headers\n", msr->sid);
+    return -1;
+  }
+
+  if (msr->extralength > 0)
+  {
+    packer->summary->extra = (char *)libmseed_memory.malloc (msr->extralength);
+    if (!packer->summary->extra)
+    {
+      ms_log (2, "%s: Cannot allocate memory for sample range headers\n", msr->sid);
+      return -1;
+    }
+
+    memcpy (packer->summary->extra, msr->extra, msr->extralength);
+    packer->summary->extralength = msr->extralength;
+  }
+
+  /* Serialize the widest integer values to determine the largest headers */
+  if (mseh_set_ptr_r (packer->summary, "/LM/Samples/Min", &widest, 'i', &packer->summarystate) ||
+      mseh_set_ptr_r (packer->summary, "/LM/Samples/Max", &widest, 'i', &packer->summarystate))
+    return -1;
+
+  if ((extralength = mseh_serialize (packer->summary, &packer->summarystate)) < 0)
+    return -1;
+
+  /* Single precision values are serialized in at most 24 characters,
+   * e.g. -100000330000000000000.0, 13 more than the widest integer */
+  if (msr->sampletype != 'i')
+    extralength += 2 * 13;
+
+  if (extralength > UINT16_MAX ||
+      packer->maxreclen <= (uint32_t)(MS3FSDH_LENGTH + strlen (msr->sid) + extralength))
+  {
+    ms_log (2, "%s: Record length (%u) is not large enough for sample range headers\n",
+            msr->sid, packer->maxreclen);
+    return -1;
+  }
+
+  packer->summaryreserve =
+      (extralength > msr->extralength) ? (uint16_t)(extralength - msr->extralength) : 0;
+
+  return 0;
+} /* End of msr3_pack_summary_init() */
+
+/************************************************************************
+ *  Write the extra headers, including the sample range in 'minmax' of
+ *  the packed samples, into the record and update the data offset.
+ *  Records of floating point samples without a finite single precision
+ *  range are written with the original extra headers.
+ *
+ *  Return 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ************************************************************************/
+static int
+msr3_pack_summary (MS3RecordPacker *packer, const double *minmax)
+{
+  const char *extra;
+  uint16_t extralength;
+  int extraoffset;
+  int64_t irange[2];
+  double drange[2];
+  char type;
+
+  type = (packer->msr->sampletype == 'i') ? 'i' : 'n';
+
+  if (type == 'i' || (minmax[0] >= -FLT_MAX && minmax[1] <= FLT_MAX && minmax[0] <= minmax[1]))
+  {
+    irange[0] = (int64_t)minmax[0];
+    irange[1] = (int64_t)minmax[1];
+    drange[0] = minmax[0];
+    drange[1] = minmax[1];
+
+    /* Round a double precision range outward to the single precision
+     * values that are serialized, so that the range bounds the samples */
+    if (packer->msr->sampletype == 'd')
+    {
+      float flo = (float)minmax[0];
+      float fhi = (float)minmax[1];
+
+      if (flo > minmax[0])
+        flo = msr_float_step (flo, 0);
+      if (fhi < minmax[1])
+        fhi = msr_float_step (fhi, 1);
+
+      drange[0] = flo;
+      drange[1] = fhi;
+    }
+
+    if (mseh_set_ptr_r (packer->summary, "/LM/Samples/Min",
+                        (type == 'i') ? (void *)&irange[0] : (void *)&drange[0], type,
+                        &packer->summarystate) ||
+        mseh_set_ptr_r (packer->summary, "/LM/Samples/Max",
+                        (type == 'i') ? (void *)&irange[1] : (void *)&drange[1], type,
+                        &packer->summarystate))
+      return -1;
+
+    if (mseh_serialize (packer->summary, &packer->summarystate) < 0)
+      return -1;
+
+    extra = packer->summary->extra;
+    extralength = packer->summary->extralength;
+  }
+  else
+  {
+    extra = packer->msr->extra;
+    extralength = packer->msr->extralength;
+  }
+
+  extraoffset = MS3FSDH_LENGTH + *pMS3FSDH_SIDLENGTH (packer->rawrec);
+
+  if ((uint32_t)extraoffset + extralength + packer->maxdatabytes > packer->maxreclen)
+  {
+    ms_log (2, "%s: Sample range headers (%u bytes) exceed reserved space\n", packer->msr->sid,
+            (unsigned int)extralength);
+    return -1;
+  }
+
+  if (extralength > 0)
+    memcpy (packer->rawrec + extraoffset, extra, extralength);
+
+  *pMS3FSDH_EXTRALENGTH (packer->rawrec) = HO2u (extralength, packer->swapflag);
+  packer->dataoffset = extraoffset + extralength;
+
+  return 0;
+} /* End of msr3_pack_summary() */
+
+/************************************************************************
+ *  Return the adjacent single precision value above 'value' if 'up' is
+ *  true, otherwise the adjacent value below, as nextafterf() without
+ *  requiring the math library.  'value' must be finite.
+ ************************************************************************/
+static float
+msr_float_step (float value, int up)
+{
+  uint32_t bits;
+
+  if (value == 0.0f)
+    bits = (up) ? 0x00000001 : 0x80000001;
+  else
+  {
+    memcpy (&bits, &value, sizeof (bits));
+
+    /* Magnitude increases when stepping away from zero */
+    if ((value > 0.0f) == (up != 0))
+      bits++;
+    else
+      bits--;
+  }
+
+  memcpy (&value, &bits, sizeof (value));
+
+  return value;
+} /* End of msr_float_step() */
+
+/************************************************************************
+ *  Determine the range of 'nsamples' samples at 'src', ignoring NaN
+ *  values, and return it in minmax[0] and minmax[1].  If no sample is
+ *  a number the minimum is returned larger than the maximum.
+ ************************************************************************/
+static void
+msr_sample_range (const void *src, int64_t nsamples, char sampletype, double *minmax)
+{
+  int64_t idx;
+
+  minmax[0] = INFINITY;
+  minmax[1] = -INFINITY;
+
+  if (sampletype == 'i')
+  {
+    const int32_t *samples = (const int32_t *)src;
+    int32_t lo = samples[0];
+    int32_t hi = samples[0];
+
+    for (idx = 1; idx < nsamples; idx++)
+    {
+      lo = (samples[idx] < lo) ? samples[idx] : lo;
+      hi = (samples[idx] > hi) ? samples[idx] : hi;
+    }
+
+    minmax[0] = lo;
+    minmax[1] = hi;
+  }
+  else if (sampletype == 'f')
+  {
+    const float *samples = (const float *)src;
+    float lo = INFINITY;
+    float hi = -INFINITY;
+
+    for (idx = 0; idx < nsamples; idx++)
+    {
+      lo = (samples[idx] < lo) ? samples[idx] : lo;
+      hi = (samples[idx] > hi) ? samples[idx] : hi;
+    }
+
+    minmax[0] = lo;
+    minmax[1] = hi;
+  }
+  else if (sampletype == 'd')
+  {
+    const double *samples = (const double *)src;
+
+    for (idx = 0; idx < nsamples; idx++)
+    {
+      minmax[0] = (samples[idx] < minmax[0]) ? samples[idx] : minmax[0];
+      minmax[1] = (samples[idx] > minmax[1]) ? samples[idx] : minmax[1];
+    }
+  }
+} /* End of msr_sample_range() */
+
 /************************************************************************
  *  Pack data samples.  The input data samples specified as 'src' will
  *  be packed with 'encoding' format and placed in 'dest'.
  *
+ *  If 'minmax' is not NULL the range of the packed samples is returned
+ *  in minmax[0] and minmax[1], for Steim encodings it is determined
+ *  while encoding.
+ *
  *  Return number of samples packed on success and a negative on error.
  *
  * @ref MessageOnError - this function logs a message on error
  ************************************************************************/
 static int64_t
 msr_pack_data (void *dest, void *src, uint64_t maxsamples, uint64_t maxdatabytes, char sampletype,
-               int8_t encoding, int8_t swapflag, uint32_t *byteswritten, const char *sid,
-               int8_t verbose)
+               int8_t encoding, int8_t swapflag, uint32_t *byteswritten, double *minmax,
+               const char *sid, int8_t verbose)
 {
   int64_t nsamples;
+  int64_t idx;
+  int32_t steimrange[2];
 
   if (byteswritten)
     *byteswritten = 0;
@@ -1941,7 +2286,7 @@ msr_pack_data (void *dest, void *src, uint64_t maxsamples, uint64_t maxdatabytes
     swapflag = (ms_bigendianhost ()) ? 0 : 1;
 
     nsamples = msr_encode_steim1 ((int32_t *)src, maxsamples, (int32_t *)dest, maxdatabytes, 0,
-                                  byteswritten, swapflag);
+                                  byteswritten, (minmax) ? steimrange : NULL, swapflag);
 
     break;
 
@@ -1969,7 +2314,7 @@ msr_pack_data (void *dest, void *src, uint64_t maxsamples, uint64_t maxdatabytes
     swapflag = (ms_bigendianhost ()) ? 0 : 1;
 
     nsamples = msr_encode_steim2 ((int32_t *)src, maxsamples, (int32_t *)dest, maxdatabytes, 0,
-                                  byteswritten, sid, swapflag);
+                                  byteswritten, (minmax) ? steimrange : NULL, sid, swapflag);
 
     break;
 
@@ -1979,6 +2324,31 @@ msr_pack_data (void *dest, void *src, uint64_t maxsamples, uint64_t maxdatabytes
     return -1;
   }
 
+  if (minmax && nsamples > 0)
+  {
+    if (encoding == DE_STEIM1 || encoding == DE_STEIM2)
+    {
+      minmax[0] = steimrange[0];
+      minmax[1] = steimrange[1];
+    }
+    else if (encoding == DE_INT16)
+    {
+      /* Range of the values as encoded, truncated to 16 bits */
+      minmax[0] = minmax[1] = (int16_t)((int32_t *)src)[0];
+
+      for (idx = 1; idx < nsamples; idx++)
+      {
+        int16_t value = (int16_t)((int32_t *)src)[idx];
+        minmax[0] = (value < minmax[0]) ? value : minmax[0];
+        minmax[1] = (value > minmax[1]) ? value : minmax[1];
+      }
+    }
+    else
+    {
+      msr_sample_range (src, nsamples, sampletype, minmax);
+    }
+  }
+
   return nsamples;
 } /* End of msr_pack_data() */
 
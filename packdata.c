@@ -206,6 +206,24 @@ msr_encode_float64 (double *input, uint64_t samplecount, double *output, uint64_
   else                                                \
     RESULT = 32;
 
+/************************************************************************
+ * Update minmax[0] and minmax[1] with the range of the samples packed
+ * into a Steim word.
+ ************************************************************************/
+static inline void
+steim_word_range (const int32_t *samples, int count, int32_t *minmax)
+{
+  int idx;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    if (samples[idx] < minmax[0])
+      minmax[0] = samples[idx];
+    if (samples[idx] > minmax[1])
+      minmax[1] = samples[idx];
+  }
+} /* End of steim_word_range() */
+
 /************************************************************************
  * msr_encode_steim1:
  *
@@ -216,13 +234,17 @@ msr_encode_float64 (double *input, uint64_t samplecount, double *output, uint64_
  * sample to the sample previous to it (not available to this
  * function).  It should be set to 0 if this value is not known.
  *
+ * If minmax is not NULL the minimum and maximum of the encoded samples
+ * are tracked as each word is packed and returned in minmax[0] and
+ * minmax[1].  They are only set when at least one sample is encoded.
+ *
  * Return number of samples in output buffer on success, -1 on failure.
  *
  * @ref MessageOnError - this function logs a message on error
  ************************************************************************/
 int64_t
 msr_encode_steim1 (int32_t *input, uint64_t samplecount, int32_t *output, uint64_t outputlength,
-                   int32_t diff0, uint32_t *byteswritten, int swapflag)
+                   int32_t diff0, uint32_t *byteswritten, int32_t *minmax, int swapflag)
 {
   int32_t *frameptr;   /* Frame pointer in output */
   int32_t *Xnp = NULL; /* Reverse integration constant, aka last sample */
@@ -261,6 +283,9 @@ msr_encode_steim1 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
           samplecount, maxframes, swapflag);
 #endif
 
+  if (minmax)
+    minmax[0] = minmax[1] = input[0];
+
   /* Add first difference to buffers */
   diffs[0] = diff0;
   BITWIDTH (diffs[0], bitwidth[0]);
@@ -384,6 +409,10 @@ msr_encode_steim1 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
         packedsamples = 1;
       }
 
+      /* Track sample range of this word while the samples are in cache */
+      if (minmax)
+        steim_word_range (input + outputsamples, packedsamples, minmax);
+
       diffcount -= packedsamples;
       outputsamples += packedsamples;
     } /* Done with words in frame */
@@ -415,13 +444,18 @@ msr_encode_steim1 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
  * sample to the sample previous to it (not available to this
  * function).  It should be set to 0 if this value is not known.
  *
+ * If minmax is not NULL the minimum and maximum of the encoded samples
+ * are tracked as each word is packed and returned in minmax[0] and
+ * minmax[1].  They are only set when at least one sample is encoded.
+ *
  * Return number of samples in output buffer on success, -1 on failure.
  *
  * @ref MessageOnError - this function logs a message on error
  ************************************************************************/
 int64_t
 msr_encode_steim2 (int32_t *input, uint64_t samplecount, int32_t *output, uint64_t outputlength,
-                   int32_t diff0, uint32_t *byteswritten, const char *sid, int swapflag)
+                   int32_t diff0, uint32_t *byteswritten, int32_t *minmax, const char *sid,
+                   int swapflag)
 {
   uint32_t *frameptr;  /* Frame pointer in output */
   int32_t *Xnp = NULL; /* Reverse integration constant, aka last sample */
@@ -460,6 +494,9 @@ msr_encode_steim2 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
           samplecount, maxframes, swapflag);
 #endif
 
+  if (minmax)
+    minmax[0] = minmax[1] = input[0];
+
   /* Add first difference to buffers */
   diffs[0] = diff0;
   BITWIDTH (diffs[0], bitwidth[0]);
@@ -691,6 +728,10 @@ msr_encode_steim2 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
       if (swapflag && packedsamples != 4)
         ms_gswap4 (&frameptr[widx]);
 
+      /* Track sample range of this word while the samples are in cache */
+      if (minmax)
+        steim_word_range (input + outputsamples, packedsamples, minmax);
+
       diffcount -= packedsamples;
       outputsamples += packedsamples;
     } /* Done with words in frame */
@@ -43,10 +43,10 @@ extern int64_t msr_encode_float64 (double *input, uint64_t samplecount, double *
                                    uint64_t outputlength, int swapflag);
 extern int64_t msr_encode_steim1 (int32_t *input, uint64_t samplecount, int32_t *output,
                                   uint64_t outputlength, int32_t diff0, uint32_t *byteswritten,
-                                  int swapflag);
+                                  int32_t *minmax, int swapflag);
 extern int64_t msr_encode_steim2 (int32_t *input, uint64_t samplecount, int32_t *output,
                                   uint64_t outputlength, int32_t diff0, uint32_t *byteswritten,
-                                  const char *sid, int swapflag);
+                                  int32_t *minmax, const char *sid, int swapflag);
 
 #ifdef __cplusplus
 }
@@ -25,6 +25,7 @@
 #include <time.h>
 
 #include "libmseed.h"
+#include "internalstate.h"
 #include "mseedformat.h"
 #include "unpack.h"
 
@@ -124,6 +125,8 @@ msr3_parse (const char *record, uint64_t recbuflen, MS3Record **ppmsr, uint32_t
     return (need > MAXRECLEN) ? MAXRECLEN : (int)need;
   }
 
+  LM_METRIC_START (metricstart);
+
   /* Unpack record */
   if (formatversion == 3)
   {
@@ -140,6 +143,8 @@ msr3_parse (const char *record, uint64_t recbuflen, MS3Record **ppmsr, uint32_t
     return MS_GENERROR;
   }
 
+  LM_METRIC_STOP (lm_metrics.parse, metricstart);
+
   if (retcode != MS_NOERROR)
   {
     msr3_free (ppmsr);
@@ -324,7 +329,7 @@ ms3_detect (const char *record, uint64_t recbuflen, uint8_t *formatversion)
 int
 ms_parse_raw3 (const char *record, int maxreclen, int8_t details)
 {
-  MS3Record msr;
+  MS3Record msr = MS3Record_INITIALIZER;
   const char *X;
   uint8_t b;
 
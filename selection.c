@@ -25,6 +25,7 @@
 #include <time.h>
 
 #include "libmseed.h"
+#include "internalstate.h"
 
 static int ms_isinteger (const char *string);
 static int ms_globmatch (const char *string, const char *pattern);
@@ -158,6 +159,112 @@ msr3_matchselect (const MS3Selections *selections, const MS3Record *msr,
                           ppselecttime);
 } /* End of msr3_matchselect() */
 
+/***************************************************************************
+ * Test if any selection could match data with partially known
+ * identification and time coverage, used to prune the search of
+ * archive trees before opening files.
+ *
+ * Any of @p net, @p sta, @p loc and @p chan may be NULL if unknown, the
+ * channel may be a SEED channel or an extended channel (B_S_SS).  The
+ * time range may be NSTUNSET if unknown and a pubversion <= 0 is unknown.
+ *
+ * Source identifier patterns are only compared field-by-field when they
+ * are of the form "FDSN:NET_STA_LOC_BAND_SOURCE_SUBSOURCE", and only
+ * up to the first field containing a wildcard, which could match
+ * across field separators.  Otherwise a pattern could match anything.
+ *
+ * Returns 1 if a selection could match, otherwise 0.
+ ***************************************************************************/
+int
+lm_matchselect_partial (const MS3Selections *selections, const char *net, const char *sta,
+                        const char *loc, const char *chan, nstime_t starttime, nstime_t endtime,
+                        int pubversion)
+{
+  const MS3Selections *select;
+  const MS3SelectTime *selecttime;
+  const char *fields[6] = {NULL};
+  char xchan[64];
+  char pattern[sizeof (selections->sidpattern)];
+  char *token;
+  char *next;
+  int mismatch;
+  int idx;
+
+  if (!selections)
+    return 1;
+
+  fields[0] = net;
+  fields[1] = sta;
+  fields[2] = loc;
+
+  /* Split channel into band, source and subsource */
+  if (chan && (strchr (chan, '_') || ms_seedchan2xchan (xchan, chan) == 0))
+  {
+    if (strchr (chan, '_'))
+    {
+      strncpy (xchan, chan, sizeof (xchan) - 1);
+      xchan[sizeof (xchan) - 1] = '\0';
+    }
+
+    fields[3] = xchan;
+    if ((next = strchr (xchan, '_')) != NULL)
+    {
+      *next++   = '\0';
+      fields[4] = next;
+      if ((next = strchr (next, '_')) != NULL)
+      {
+        *next++   = '\0';
+        fields[5] = next;
+      }
+    }
+  }
+
+  for (select = selections; select; select = select->next)
+  {
+    if (select->pubversion > 0 && pubversion > 0 && select->pubversion != pubversion)
+      continue;
+
+    /* Compare fields of FDSN identifier patterns until a wildcard */
+    if (strncmp (select->sidpattern, "FDSN:", 5) == 0)
+    {
+      strcpy (pattern, select->sidpattern + 5);
+
+      mismatch = 0;
+      for (idx = 0, token = pattern; token && idx < 6; idx++, token = next)
+      {
+        if ((next = strchr (token, '_')) != NULL)
+          *next++ = '\0';
+
+        if (strpbrk (token, "*?[\\"))
+          break;
+
+        if (fields[idx] && !ms_globmatch (fields[idx], token))
+        {
+          mismatch = 1;
+          break;
+        }
+      }
+
+      if (mismatch)
+        continue;
+    }
+
+    if (!select->timewindows || starttime == NSTUNSET || endtime == NSTUNSET)
+      return 1;
+
+    for (selecttime = select->timewindows; selecttime; selecttime = selecttime->next)
+    {
+      if ((selecttime->starttime == NSTUNSET || selecttime->starttime == NSTERROR ||
+           selecttime->starttime <= endtime) &&
+          (selecttime->endtime == NSTUNSET || selecttime->endtime == NSTERROR ||
+           selecttime->endtime >= starttime))
+        return 1;
+    }
+  }
+
+  return 0;
+} /* End of lm_matchselect_partial() */
+
 /** ************************************************************************
  * @brief Add selection parameters to selection list.
  *
@@ -0,0 +1,435 @@
+/***************************************************************************
+ * A trace list that can be shared by multiple threads.
+ *
+ * Trace IDs are distributed over shards by a hash of the source
+ * identifier, each shard is a regular MS3TraceList protected by its
+ * own lock.  Threads adding data for different streams rarely contend
+ * for the same lock, so additions scale with the number of threads.
+ *
+ * The data are consumed either by packing each shard in turn, or by
+ * taking all of the data at a single point in time as a regular trace
+ * list.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2024 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmseed.h"
+#include "internalstate.h"
+
+/* Maximum number of shards, and shards per processor by default */
+#define LM_SHARDS_MAX 1024
+#define LM_SHARDS_PER_CPU 4
+
+/* Size of a cache line, each shard occupies its own cache lines */
+#define LM_CACHELINE 64
+
+#if !defined(LIBMSEED_NO_THREADING)
+#define LM_SHARD_LOCK(SHARD) lm_mutex_lock (&(SHARD)->s.lock)
+#define LM_SHARD_UNLOCK(SHARD) lm_mutex_unlock (&(SHARD)->s.lock)
+#else
+#define LM_SHARD_LOCK(SHARD)
+#define LM_SHARD_UNLOCK(SHARD)
+#endif
+
+/* State of a shard of a shared trace list */
+typedef struct LM_SHARDSTATE
+{
+  MS3TraceList *mstl;
+#if !defined(LIBMSEED_NO_THREADING)
+  lm_mutex_t lock;
+#endif
+} LM_SHARDSTATE;
+
+/* A shard padded to whole cache lines to avoid false sharing between shards */
+typedef union LM_SHARD
+{
+  LM_SHARDSTATE s;
+  char padding[(sizeof (LM_SHARDSTATE) + LM_CACHELINE - 1) / LM_CACHELINE * LM_CACHELINE];
+} LM_SHARD;
+
+struct MS3SharedTraceList
+{
+  char *allocated;     /* Allocated shard array, unaligned */
+  LM_SHARD *shards;    /* Shard array aligned to a cache line */
+  uint32_t shardcount; /* Power of 2 */
+};
+
+/* FNV-1a hash of a source identifier */
+static uint32_t
+lm_sid_hash (const char *sid)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*sid)
+  {
+    hash ^= (uint8_t)*sid++;
+    hash *= 16777619u;
+  }
+
+  return hash;
+} /* End of lm_sid_hash() */
+
+/** ************************************************************************
+ * @brief Initialize a ::MS3SharedTraceList for use by multiple threads
+ *
+ * A shared trace list allows any number of threads to add data
+ * concurrently with mstl3_shared_addmsr() while other threads generate
+ * records with mstl3_shared_pack() or take the data with
+ * mstl3_shared_take().
+ *
+ * Trace IDs are assigned to one of @p shards shards by a hash of the
+ * source identifier, each shard with its own lock.  The number of
+ * shards is rounded up to a power of 2.  If @p shards is 0 a default
+ * proportional to the number of processors is used.
+ *
+ * @param[in] shards Number of shards, 0 for the default
+ *
+ * @returns a pointer to a ::MS3SharedTraceList on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see mstl3_shared_free()
+ ***************************************************************************/
+MS3SharedTraceList *
+mstl3_shared_init (int shards)
+{
+  MS3SharedTraceList *shared = NULL;
+  uint32_t shardcount = 1;
+  uint32_t idx;
+
+  if (shards < 0)
+  {
+    ms_log (2, "%s(): Shard count cannot be negative: %d\n", __func__, shards);
+    return NULL;
+  }
+
+  if (shards == 0)
+    shards = lm_cpucount () * LM_SHARDS_PER_CPU;
+
+  if (shards > LM_SHARDS_MAX)
+    shards = LM_SHARDS_MAX;
+
+  while (shardcount < (uint32_t)shards)
+    shardcount <<= 1;
+
+  if (!(shared = (MS3SharedTraceList *)libmseed_memory.malloc (sizeof (MS3SharedTraceList))))
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    return NULL;
+  }
+
+  /* Allocate shards with room to align them to a cache line */
+  if (!(shared->allocated = (char *)libmseed_memory.malloc (sizeof (LM_SHARD) * shardcount +
+                                                            LM_CACHELINE)))
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    libmseed_memory.free (shared);
+    return NULL;
+  }
+
+  shared->shards = (LM_SHARD *)(((uintptr_t)shared->allocated + LM_CACHELINE - 1) &
+                                ~(uintptr_t)(LM_CACHELINE - 1));
+
+  memset (shared->shards, 0, sizeof (LM_SHARD) * shardcount);
+  shared->shardcount = 0;
+
+  for (idx = 0; idx < shardcount; idx++)
+  {
+    if (!(shared->shards[idx].s.mstl = mstl3_init (NULL)))
+    {
+      mstl3_shared_free (&shared, 0);
+      return NULL;
+    }
+
+#if !defined(LIBMSEED_NO_THREADING)
+    if (lm_mutex_init (&shared->shards[idx].s.lock))
+    {
+      ms_log (2, "Cannot initialize shard lock\n");
+      mstl3_free (&shared->shards[idx].s.mstl, 0);
+      mstl3_shared_free (&shared, 0);
+      return NULL;
+    }
+#endif
+
+    shared->shardcount++;
+  }
+
+  return shared;
+} /* End of mstl3_shared_init() */
+
+/** ************************************************************************
+ * @brief Add data coverage from an ::MS3Record to a ::MS3SharedTraceList
+ *
+ * This function may be called by any number of threads concurrently.
+ * Only the shard of the record's source identifier is locked while the
+ * data are added with mstl3_addmsr(), see it for the description of
+ * the parameters.
+ *
+ * As the segment may be modified by other threads as soon as this
+ * function returns, it is not returned.
+ *
+ * @param[in] shared ::MS3SharedTraceList to add data to
+ * @param[in] msr ::MS3Record containing the data to add
+ * @param[in] splitversion Flag to control splitting of version/quality
+ * @param[in] autoheal Flag to control automatic merging of segments
+ * @param[in] flags Flags to control optional functionality, see mstl3_addmsr()
+ * @param[in] tolerance Tolerance function pointers as ::MS3Tolerance
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+mstl3_shared_addmsr (MS3SharedTraceList *shared, const MS3Record *msr, int8_t splitversion,
+                     int8_t autoheal, uint32_t flags, const MS3Tolerance *tolerance)
+{
+  LM_SHARD *shard;
+  MS3TraceSeg *seg;
+
+  if (!shared || !msr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'shared' or 'msr'\n", __func__);
+    return -1;
+  }
+
+  shard = &shared->shards[lm_sid_hash (msr->sid) & (shared->shardcount - 1)];
+
+  LM_SHARD_LOCK (shard);
+  seg = mstl3_addmsr (shard->s.mstl, msr, splitversion, autoheal, flags, tolerance);
+  LM_SHARD_UNLOCK (shard);
+
+  return (seg) ? 0 : -1;
+} /* End of mstl3_shared_addmsr() */
+
+/** ************************************************************************
+ * @brief Pack data in a ::MS3SharedTraceList into miniSEED records
+ *
+ * Each shard is locked in turn and packed with mstl3_pack(), see it for
+ * the description of the parameters.  Threads adding data to other
+ * shards are not blocked, making this suitable for generating records
+ * from a rolling buffer while data are added.
+ *
+ * The @p record_handler() is called while a shard is locked and must
+ * not add data to the shared trace list.
+ *
+ * @param[in] shared ::MS3SharedTraceList containing data to pack
+ * @param[in] record_handler() Callback function called for each record
+ * @param[in] handlerdata A pointer that will be provided to the @p record_handler()
+ * @param[in] reclen Maximum record length to create
+ * @param[in] encoding Encoding for data samples, see msr3_pack()
+ * @param[out] packedsamples The number of samples packed, returned to caller
+ * @param[in] flags Bit flags to control packing, see mstl3_pack()
+ * @param[in] verbose Controls logging verbosity, 0 is no diagnostic output
+ * @param[in] extra If not NULL, add this buffer of extra headers to all records
+ *
+ * @returns the number of records created on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+mstl3_shared_pack (MS3SharedTraceList *shared, void (*record_handler) (char *, int, void *),
+                   void *handlerdata, int reclen, int8_t encoding, int64_t *packedsamples,
+                   uint32_t flags, int8_t verbose, char *extra)
+{
+  LM_SHARD *shard;
+  int64_t totalrecords = 0;
+  int64_t totalsamples = 0;
+  int64_t shardrecords;
+  int64_t shardsamples;
+  uint32_t idx;
+
+  if (!shared)
+  {
+    ms_log (2, "%s(): Required input not defined: 'shared'\n", __func__);
+    return -1;
+  }
+
+  if (packedsamples)
+    *packedsamples = 0;
+
+  for (idx = 0; idx < shared->shardcount; idx++)
+  {
+    shard = &shared->shards[idx];
+
+    LM_SHARD_LOCK (shard);
+    shardrecords = mstl3_pack (shard->s.mstl, record_handler, handlerdata, reclen, encoding,
+                               &shardsamples, flags, verbose, extra);
+    LM_SHARD_UNLOCK (shard);
+
+    if (shardrecords < 0)
+      return -1;
+
+    totalrecords += shardrecords;
+    totalsamples += shardsamples;
+  }
+
+  if (packedsamples)
+    *packedsamples = totalsamples;
+
+  return totalrecords;
+} /* End of mstl3_shared_pack() */
+
+/** ************************************************************************
+ * @brief Take all data from a ::MS3SharedTraceList as a ::MS3TraceList
+ *
+ * All shards are locked together and their trace lists are exchanged
+ * for empty lists, so the returned list is a consistent snapshot: it
+ * contains all data added before this call and none added after.  The
+ * shards are only locked while the lists are exchanged, the returned
+ * list is assembled afterwards.
+ *
+ * The caller owns the returned list and must free it with mstl3_free().
+ *
+ * @param[in] shared ::MS3SharedTraceList to take data from
+ *
+ * @returns a pointer to a ::MS3TraceList on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+MS3TraceList *
+mstl3_shared_take (MS3SharedTraceList *shared)
+{
+  MS3TraceList **lists = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3TraceList *swap;
+  MS3TraceID *prev[MSTRACEID_SKIPLIST_HEIGHT];
+  MS3TraceID *id;
+  MS3TraceID *nextid;
+  uint32_t idx;
+
+  if (!shared)
+  {
+    ms_log (2, "%s(): Required input not defined: 'shared'\n", __func__);
+    return NULL;
+  }
+
+  /* Allocate the replacement lists before locking */
+  if (!(lists = (MS3TraceList **)libmseed_memory.malloc (sizeof (MS3TraceList *) *
+                                                          shared->shardcount)))
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    return NULL;
+  }
+
+  for (idx = 0; idx < shared->shardcount; idx++)
+  {
+    if (!(lists[idx] = mstl3_init (NULL)))
+    {
+      while (idx > 0)
+        mstl3_free (&lists[--idx], 0);
+      libmseed_memory.free (lists);
+      return NULL;
+    }
+  }
+
+  /* Lock all shards in order, producers only hold a single shard lock */
+  for (idx = 0; idx < shared->shardcount; idx++)
+    LM_SHARD_LOCK (&shared->shards[idx]);
+
+  for (idx = 0; idx < shared->shardcount; idx++)
+  {
+    swap = shared->shards[idx].s.mstl;
+    shared->shards[idx].s.mstl = lists[idx];
+    lists[idx] = swap;
+  }
+
+  for (idx = 0; idx < shared->shardcount; idx++)
+    LM_SHARD_UNLOCK (&shared->shards[idx]);
+
+  /* Move the trace IDs of all shards to the first list, source IDs are
+   * unique to a shard so they are only linked into place, after any
+   * lower publication versions */
+  mstl = lists[0];
+
+  for (idx = 1; idx < shared->shardcount; idx++)
+  {
+    id = lists[idx]->traces.next[0];
+
+    while (id)
+    {
+      nextid = id->next[0];
+
+      mstl3_findID (mstl, id->sid, id->pubversion, prev);
+
+      if (!mstl3_addID (mstl, id, prev))
+      {
+        lists[idx]->traces.next[0] = id;
+        mstl = NULL;
+        break;
+      }
+
+      lists[idx]->numtraceids--;
+      id = nextid;
+    }
+
+    if (!mstl)
+      break;
+
+    memset (lists[idx]->traces.next, 0, sizeof (lists[idx]->traces.next));
+    mstl3_free (&lists[idx], 0);
+  }
+
+  /* On error free all remaining lists */
+  if (!mstl)
+  {
+    ms_log (2, "Cannot assemble trace list from shards\n");
+
+    for (idx = 0; idx < shared->shardcount; idx++)
+    {
+      if (lists[idx])
+        mstl3_free (&lists[idx], 1);
+    }
+  }
+
+  libmseed_memory.free (lists);
+
+  return mstl;
+} /* End of mstl3_shared_take() */
+
+/** ************************************************************************
+ * @brief Free all memory associated with a ::MS3SharedTraceList
+ *
+ * No other threads may be using the shared trace list.
+ *
+ * @param[in] ppshared Pointer to ::MS3SharedTraceList to free, set to NULL
+ * @param[in] freeprvtptr If true, also free any data at the @p prvtptr
+ * members, see mstl3_free()
+ ***************************************************************************/
+void
+mstl3_shared_free (MS3SharedTraceList **ppshared, int8_t freeprvtptr)
+{
+  uint32_t idx;
+
+  if (!ppshared || !*ppshared)
+    return;
+
+  for (idx = 0; idx < (*ppshared)->shardcount; idx++)
+  {
+    mstl3_free (&(*ppshared)->shards[idx].s.mstl, freeprvtptr);
+#if !defined(LIBMSEED_NO_THREADING)
+    lm_mutex_destroy (&(*ppshared)->shards[idx].s.lock);
+#endif
+  }
+
+  libmseed_memory.free ((*ppshared)->allocated);
+  libmseed_memory.free (*ppshared);
+  *ppshared = NULL;
+} /* End of mstl3_shared_free() */
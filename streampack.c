@@ -0,0 +1,720 @@
+/***************************************************************************
+ * Real-time packing of many data streams into miniSEED records.
+ *
+ * Data samples are buffered in a trace list and records are generated
+ * as soon as they are full, or when a segment has been idle or its
+ * oldest buffered data has waited longer than a latency limit.
+ *
+ * Segments that have buffered enough samples to fill a record are kept
+ * in a ready queue and flush deadlines are kept in a hashed timer
+ * wheel, so that the work of each packing pass is proportional to the
+ * records generated instead of the number of streams buffered.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2024 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmseed.h"
+#include "internalstate.h"
+#include "mseedformat.h"
+
+/* Timer wheel slot count (power of 2) and resolution */
+#define LM_WHEEL_SLOTS 512
+#define LM_WHEEL_TICK NSTMODULUS
+
+/* Maximum arrival marks tracked per segment, older marks are merged */
+#define LM_STREAM_ARRIVALS 8
+
+/* Packing state for a trace segment, stored at MS3TraceSeg.prvtptr */
+typedef struct LM_STREAMSEG
+{
+  MS3TraceID *id;      /* Trace ID containing the segment */
+  MS3TraceSeg *seg;    /* Trace segment */
+  int64_t threshold;   /* Buffered samples expected to fill a record */
+  int64_t added;       /* Samples added to segment */
+  int64_t packed;      /* Samples packed from segment */
+  nstime_t lastupdate; /* Time of last update */
+  nstime_t deadline;   /* Scheduled flush deadline, NSTUNSET if none */
+  struct
+  {
+    int64_t added;  /* Value of added after the update */
+    nstime_t time;  /* Time of the update */
+  } arrivals[LM_STREAM_ARRIVALS];
+  int arrivalcount;  /* Number of arrival marks */
+  int slot;          /* Timer wheel slot, -1 if not scheduled */
+  uint8_t queued;    /* In ready queue */
+  uint8_t flush;     /* Flush all data when packed */
+  struct LM_STREAMSEG *readynext;
+  struct LM_STREAMSEG *wheelprev;
+  struct LM_STREAMSEG *wheelnext;
+  struct LM_STREAMSEG *prev;
+  struct LM_STREAMSEG *next;
+} LM_STREAMSEG;
+
+struct MS3StreamPacker
+{
+  MS3TraceList *mstl;       /* Buffered data */
+  int reclen;               /* Max record length */
+  int8_t encoding;          /* Data encoding */
+  uint32_t flags;           /* Packing flags */
+  int8_t verbose;           /* Logging level */
+  char *extra;              /* Extra headers */
+  nstime_t flush_idle;      /* Idle flush threshold, 0 if none */
+  nstime_t max_latency;     /* Maximum latency of buffered data, 0 if none */
+
+  LM_STREAMSEG *segments;   /* All tracked segments */
+  LM_STREAMSEG *readyfirst; /* Ready queue of segments to pack */
+  LM_STREAMSEG *readylast;
+  LM_STREAMSEG *wheel[LM_WHEEL_SLOTS]; /* Timer wheel of flush deadlines */
+  int64_t wheeltick;        /* Next timer wheel tick to expire */
+  uint8_t wheelstarted;     /* Timer wheel tick has been set */
+
+  int64_t segmentcount;     /* Number of tracked segments */
+  int64_t bufferedsamples;  /* Samples buffered */
+  int64_t packedsamples;    /* Total samples packed */
+  int64_t segmentspacked;   /* Segment packing passes */
+};
+
+/* Floor of a time in timer wheel ticks */
+static int64_t
+lm_wheel_ticks (nstime_t time)
+{
+  int64_t tick = time / LM_WHEEL_TICK;
+
+  if (time % LM_WHEEL_TICK < 0)
+    tick--;
+
+  return tick;
+} /* End of lm_wheel_ticks() */
+
+/* Add a segment to the end of the ready queue if not already queued */
+static void
+lm_ready_push (MS3StreamPacker *packer, LM_STREAMSEG *sseg)
+{
+  if (sseg->queued)
+    return;
+
+  sseg->queued = 1;
+  sseg->readynext = NULL;
+
+  if (packer->readylast)
+    packer->readylast->readynext = sseg;
+  else
+    packer->readyfirst = sseg;
+
+  packer->readylast = sseg;
+} /* End of lm_ready_push() */
+
+/* Remove and return the first segment of the ready queue */
+static LM_STREAMSEG *
+lm_ready_pop (MS3StreamPacker *packer)
+{
+  LM_STREAMSEG *sseg = packer->readyfirst;
+
+  if (!sseg)
+    return NULL;
+
+  packer->readyfirst = sseg->readynext;
+  if (!packer->readyfirst)
+    packer->readylast = NULL;
+
+  sseg->readynext = NULL;
+  sseg->queued = 0;
+
+  return sseg;
+} /* End of lm_ready_pop() */
+
+/* Remove a segment from the timer wheel if scheduled */
+static void
+lm_wheel_remove (MS3StreamPacker *packer, LM_STREAMSEG *sseg)
+{
+  if (sseg->slot < 0)
+    return;
+
+  if (sseg->wheelprev)
+    sseg->wheelprev->wheelnext = sseg->wheelnext;
+  else
+    packer->wheel[sseg->slot] = sseg->wheelnext;
+
+  if (sseg->wheelnext)
+    sseg->wheelnext->wheelprev = sseg->wheelprev;
+
+  sseg->wheelprev = NULL;
+  sseg->wheelnext = NULL;
+  sseg->slot = -1;
+} /* End of lm_wheel_remove() */
+
+/***************************************************************************
+ * Expire the deadlines in a timer wheel slot that are at or before @p now,
+ * the segments are marked for flushing and added to the ready queue.
+ ***************************************************************************/
+static void
+lm_wheel_expire_slot (MS3StreamPacker *packer, int slot, nstime_t now)
+{
+  LM_STREAMSEG *sseg = packer->wheel[slot];
+  LM_STREAMSEG *next;
+
+  while (sseg)
+  {
+    next = sseg->wheelnext;
+
+    /* Deadlines beyond the span of the wheel remain for a later rotation */
+    if (sseg->deadline <= now)
+    {
+      lm_wheel_remove (packer, sseg);
+      sseg->flush = 1;
+      lm_ready_push (packer, sseg);
+
+      if (packer->verbose > 1)
+        ms_log (0, "%s: Flush deadline reached\n", sseg->id->sid);
+    }
+
+    sseg = next;
+  }
+} /* End of lm_wheel_expire_slot() */
+
+/***************************************************************************
+ * Advance the timer wheel to @p now, expiring all deadlines reached.
+ *
+ * Each slot passed is visited once, the slot of the current tick is
+ * visited on every call as deadlines within it become due.
+ ***************************************************************************/
+static void
+lm_wheel_advance (MS3StreamPacker *packer, nstime_t now)
+{
+  int64_t nowtick = lm_wheel_ticks (now);
+  int slot;
+
+  if (!packer->wheelstarted || nowtick < packer->wheeltick)
+    return;
+
+  /* Visit every slot once if a full rotation has passed */
+  if (nowtick - packer->wheeltick >= LM_WHEEL_SLOTS)
+  {
+    for (slot = 0; slot < LM_WHEEL_SLOTS; slot++)
+      lm_wheel_expire_slot (packer, slot, now);
+
+    packer->wheeltick = nowtick;
+    return;
+  }
+
+  for (;;)
+  {
+    lm_wheel_expire_slot (packer, (int)(packer->wheeltick & (LM_WHEEL_SLOTS - 1)), now);
+
+    if (packer->wheeltick == nowtick)
+      break;
+
+    packer->wheeltick++;
+  }
+} /* End of lm_wheel_advance() */
+
+/***************************************************************************
+ * Determine the flush deadline of a segment from the time of the last
+ * update and the arrival of the oldest buffered samples, and schedule
+ * it in the timer wheel.  Segments already past the deadline are added
+ * to the ready queue directly.
+ ***************************************************************************/
+static void
+lm_schedule (MS3StreamPacker *packer, LM_STREAMSEG *sseg, nstime_t now)
+{
+  nstime_t deadline = NSTUNSET;
+  int64_t tick;
+
+  lm_wheel_remove (packer, sseg);
+
+  if (packer->flush_idle > 0)
+    deadline = sseg->lastupdate + packer->flush_idle;
+
+  if (packer->max_latency > 0 && sseg->arrivalcount > 0)
+  {
+    nstime_t latency_deadline = sseg->arrivals[0].time + packer->max_latency;
+
+    if (deadline == NSTUNSET || latency_deadline < deadline)
+      deadline = latency_deadline;
+  }
+
+  sseg->deadline = deadline;
+
+  if (deadline == NSTUNSET)
+    return;
+
+  if (deadline <= now)
+  {
+    sseg->flush = 1;
+    lm_ready_push (packer, sseg);
+    return;
+  }
+
+  if (!packer->wheelstarted)
+  {
+    packer->wheeltick = lm_wheel_ticks (now);
+    packer->wheelstarted = 1;
+  }
+
+  /* Deadlines in passed ticks are placed in the next slot to be visited */
+  tick = lm_wheel_ticks (deadline);
+  if (tick < packer->wheeltick)
+    tick = packer->wheeltick;
+
+  sseg->slot = (int)(tick & (LM_WHEEL_SLOTS - 1));
+  sseg->wheelprev = NULL;
+  sseg->wheelnext = packer->wheel[sseg->slot];
+  if (sseg->wheelnext)
+    sseg->wheelnext->wheelprev = sseg;
+  packer->wheel[sseg->slot] = sseg;
+} /* End of lm_schedule() */
+
+/***************************************************************************
+ * Estimate the fewest samples that can fill a record for a segment,
+ * assuming the worst compression for Steim encodings.  The estimate is
+ * refined from the records actually generated.
+ ***************************************************************************/
+static int64_t
+lm_record_capacity (MS3StreamPacker *packer, MS3TraceID *id, MS3TraceSeg *seg)
+{
+  int reclen = (packer->reclen < 0) ? MS_PACK_DEFAULT_RECLEN : packer->reclen;
+  int8_t encoding = (packer->encoding < 0) ? MS_PACK_DEFAULT_ENCODING : packer->encoding;
+  int64_t databytes;
+  int64_t capacity;
+  size_t headerlength;
+
+  if (packer->flags & MSF_PACKVER2)
+    headerlength = 64;
+  else
+    headerlength = MS3FSDH_LENGTH + strlen (id->sid);
+
+  if (packer->extra)
+    headerlength += strlen (packer->extra);
+
+  databytes = (int64_t)reclen - (int64_t)headerlength;
+
+  switch (seg->sampletype)
+  {
+  case 't':
+  case 'a':
+    capacity = databytes;
+    break;
+  case 'f':
+    capacity = databytes / 4;
+    break;
+  case 'd':
+    capacity = databytes / 8;
+    break;
+  default:
+    if (encoding == DE_INT16)
+      capacity = databytes / 2;
+    else if (encoding == DE_STEIM1 || encoding == DE_STEIM2)
+      capacity = (databytes / 64) * 15 - 2;
+    else
+      capacity = databytes / 4;
+  }
+
+  return (capacity > 0) ? capacity : 1;
+} /* End of lm_record_capacity() */
+
+/* Stop tracking a segment and remove it from the trace list */
+static int
+lm_streamseg_remove (MS3StreamPacker *packer, LM_STREAMSEG *sseg)
+{
+  lm_wheel_remove (packer, sseg);
+
+  if (sseg->prev)
+    sseg->prev->next = sseg->next;
+  else
+    packer->segments = sseg->next;
+
+  if (sseg->next)
+    sseg->next->prev = sseg->prev;
+
+  packer->segmentcount--;
+  packer->bufferedsamples -= sseg->seg->numsamples;
+
+  /* Frees the segment state at MS3TraceSeg.prvtptr */
+  return lm_remove_segment (packer->mstl, sseg->id, sseg->seg, 1);
+} /* End of lm_streamseg_remove() */
+
+/** ************************************************************************
+ * @brief Initialize a real-time, multi-stream packing engine
+ *
+ * Data samples for any number of streams are added with
+ * ms3_streampack_add() and records are generated with
+ * ms3_streampack_pack().  Records are generated when they are full
+ * and, optionally, when a segment has not been updated for @p
+ * flush_idle_seconds or its oldest buffered data have been waiting for
+ * @p max_latency_seconds.  Partial records are generated in the latter
+ * cases.
+ *
+ * This is an alternative to using an ::MS3TraceList as a rolling
+ * buffer with mstl3_pack_next() for a large number of streams: only
+ * segments that can fill a record or have reached a flush deadline are
+ * visited when packing.  Deadlines are tracked with a resolution of
+ * one second.
+ *
+ * The engine should be freed with ms3_streampack_free() when done.
+ *
+ * @param[in] reclen Maximum record length to create
+ * @param[in] encoding Encoding for data samples, see msr3_pack()
+ * @param[in] flags Bit flags to control packing:
+ * @parblock
+ *  - @c ::MSF_PACKVER2 : Pack miniSEED version 2 instead of default 3
+ * @endparblock
+ * @param[in] verbose Controls logging verbosity, 0 is no diagnostic output
+ * @param[in] extra If not NULL, add this buffer of extra headers to all records
+ * @param[in] flush_idle_seconds If > 0, flush segments not updated within
+ *                               this number of seconds
+ * @param[in] max_latency_seconds If > 0, flush segments with data buffered
+ *                                for longer than this number of seconds
+ *
+ * @returns pointer to ::MS3StreamPacker on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_streampack_add()
+ * @see ms3_streampack_pack()
+ * @see ms3_streampack_free()
+ ***************************************************************************/
+MS3StreamPacker *
+ms3_streampack_init (int reclen, int8_t encoding, uint32_t flags, int8_t verbose, char *extra,
+                     uint32_t flush_idle_seconds, uint32_t max_latency_seconds)
+{
+  MS3StreamPacker *packer = NULL;
+
+  if (reclen != -1 && (reclen < MINRECLEN || reclen > MAXRECLEN))
+  {
+    ms_log (2, "%s(): Record length is out of range: %d\n", __func__, reclen);
+    return NULL;
+  }
+
+  if (extra && strlen (extra) > UINT16_MAX)
+  {
+    ms_log (2, "%s(): Extra headers are too long\n", __func__);
+    return NULL;
+  }
+
+  packer = (MS3StreamPacker *)libmseed_memory.malloc (sizeof (MS3StreamPacker));
+  if (!packer)
+  {
+    ms_log (2, "Cannot allocate memory for stream packer\n");
+    return NULL;
+  }
+
+  memset (packer, 0, sizeof (MS3StreamPacker));
+
+  if (!(packer->mstl = mstl3_init (NULL)))
+  {
+    libmseed_memory.free (packer);
+    return NULL;
+  }
+
+  packer->reclen = reclen;
+  packer->encoding = encoding;
+  packer->flags = flags & MSF_PACKVER2;
+  packer->verbose = verbose;
+  packer->extra = extra;
+  packer->flush_idle = (nstime_t)flush_idle_seconds * NSTMODULUS;
+  packer->max_latency = (nstime_t)max_latency_seconds * NSTMODULUS;
+
+  return packer;
+} /* End of ms3_streampack_init() */
+
+/** ************************************************************************
+ * @brief Add data samples to a real-time packing engine
+ *
+ * The data samples of @p msr are added to the buffer of the stream, as
+ * with mstl3_addmsr().  The record must contain data samples, records
+ * without samples are ignored.  If the segment has buffered enough
+ * samples to fill a record it is queued for packing.
+ *
+ * The time of the update, @p now, is used for idle and latency
+ * deadlines.  If @p now is ::NSTUNSET the current system time is used,
+ * otherwise any consistent clock can drive the engine, such as the
+ * data times when replaying an archive.
+ *
+ * @param[in] packer ::MS3StreamPacker engine
+ * @param[in] msr ::MS3Record with data samples to add
+ * @param[in] tolerance Time and sample rate tolerance, see mstl3_addmsr()
+ * @param[in] now Time of the update, or ::NSTUNSET for the system time
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_streampack_add (MS3StreamPacker *packer, const MS3Record *msr, const MS3Tolerance *tolerance,
+                    nstime_t now)
+{
+  LM_STREAMSEG *sseg;
+  MS3TraceSeg *seg;
+  int64_t delta;
+
+  if (!packer || !msr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'packer' or 'msr'\n", __func__);
+    return -1;
+  }
+
+  if (msr->numsamples <= 0 || !msr->datasamples)
+    return 0;
+
+  if (now == NSTUNSET)
+    now = lmp_systemtime ();
+
+  /* Segments are not healed as merging would release segment state */
+  if (!(seg = mstl3_addmsr (packer->mstl, msr, 0, 0, 0, tolerance)))
+  {
+    ms_log (2, "%s: Cannot add data to stream buffer\n", msr->sid);
+    return -1;
+  }
+
+  sseg = (LM_STREAMSEG *)seg->prvtptr;
+
+  /* Start tracking a new segment */
+  if (!sseg)
+  {
+    if (!(sseg = (LM_STREAMSEG *)libmseed_memory.malloc (sizeof (LM_STREAMSEG))))
+    {
+      ms_log (2, "Cannot allocate memory for segment state\n");
+      return -1;
+    }
+
+    memset (sseg, 0, sizeof (LM_STREAMSEG));
+    sseg->seg = seg;
+    sseg->slot = -1;
+    sseg->deadline = NSTUNSET;
+
+    /* Find the trace ID of the segment */
+    sseg->id = mstl3_findID (packer->mstl, msr->sid, 0, NULL);
+    if (!sseg->id)
+    {
+      ms_log (2, "%s: Cannot find trace ID for segment\n", msr->sid);
+      libmseed_memory.free (sseg);
+      return -1;
+    }
+
+    sseg->threshold = lm_record_capacity (packer, sseg->id, seg);
+
+    sseg->next = packer->segments;
+    if (sseg->next)
+      sseg->next->prev = sseg;
+    packer->segments = sseg;
+    packer->segmentcount++;
+
+    seg->prvtptr = sseg;
+  }
+
+  delta = seg->numsamples - (sseg->added - sseg->packed);
+  sseg->added += delta;
+  sseg->lastupdate = now;
+  packer->bufferedsamples += delta;
+
+  /* Record arrival, merging the two oldest marks when full */
+  if (sseg->arrivalcount == LM_STREAM_ARRIVALS)
+  {
+    sseg->arrivals[0].added = sseg->arrivals[1].added;
+    memmove (&sseg->arrivals[1], &sseg->arrivals[2],
+             (LM_STREAM_ARRIVALS - 2) * sizeof (sseg->arrivals[0]));
+    sseg->arrivalcount--;
+  }
+
+  sseg->arrivals[sseg->arrivalcount].added = sseg->added;
+  sseg->arrivals[sseg->arrivalcount].time = now;
+  sseg->arrivalcount++;
+
+  if (seg->numsamples >= sseg->threshold)
+    lm_ready_push (packer, sseg);
+
+  lm_schedule (packer, sseg, now);
+
+  return 0;
+} /* End of ms3_streampack_add() */
+
+/** ************************************************************************
+ * @brief Generate records from a real-time packing engine
+ *
+ * Records are generated for segments that have buffered enough samples
+ * to fill a record and for segments that have reached a flush deadline
+ * at @p now.  Each record is passed to @p record_handler() with @p
+ * handlerdata, see mstl3_pack().
+ *
+ * If ::MSF_FLUSHDATA is set in @p flags all buffered data are packed,
+ * usually done on shutdown.
+ *
+ * @param[in] packer ::MS3StreamPacker engine
+ * @param[in] record_handler() Callback function called for each record
+ * @param[in] handlerdata A pointer that will be provided to the @p record_handler()
+ * @param[out] packedsamples The number of samples packed, returned to caller
+ * @param[in] flags Bit flags to control packing:
+ * @parblock
+ *  - @c ::MSF_FLUSHDATA : Pack all data in the buffer
+ * @endparblock
+ * @param[in] now Current time, or ::NSTUNSET for the system time
+ *
+ * @returns the number of records created on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+ms3_streampack_pack (MS3StreamPacker *packer, void (*record_handler) (char *, int, void *),
+                     void *handlerdata, int64_t *packedsamples, uint32_t flags, nstime_t now)
+{
+  LM_STREAMSEG *sseg;
+  int64_t totalrecords = 0;
+  int64_t totalsamples = 0;
+  int64_t segrecords;
+  int64_t segsamples;
+  uint32_t segflags;
+  int idx;
+
+  if (!packer || !record_handler)
+  {
+    ms_log (2, "%s(): Required input not defined: 'packer' or 'record_handler'\n", __func__);
+    return -1;
+  }
+
+  if (packedsamples)
+    *packedsamples = 0;
+
+  if (now == NSTUNSET)
+    now = lmp_systemtime ();
+
+  lm_wheel_advance (packer, now);
+
+  if (flags & MSF_FLUSHDATA)
+  {
+    for (sseg = packer->segments; sseg; sseg = sseg->next)
+    {
+      sseg->flush = 1;
+      lm_ready_push (packer, sseg);
+    }
+  }
+
+  while ((sseg = lm_ready_pop (packer)))
+  {
+    segflags = packer->flags;
+    if (sseg->flush)
+      segflags |= MSF_FLUSHDATA;
+
+    segrecords = mstl3_pack_segment (packer->mstl, sseg->id, sseg->seg, record_handler,
+                                     handlerdata, packer->reclen, packer->encoding, &segsamples,
+                                     segflags, packer->verbose, packer->extra);
+
+    if (segrecords < 0)
+    {
+      ms_log (2, "%s: Error packing data from segment\n", sseg->id->sid);
+      return -1;
+    }
+
+    packer->segmentspacked++;
+    packer->packedsamples += segsamples;
+    packer->bufferedsamples -= segsamples;
+    totalrecords += segrecords;
+    totalsamples += segsamples;
+
+    if (sseg->seg->numsamples == 0)
+    {
+      if (lm_streamseg_remove (packer, sseg))
+        return -1;
+
+      continue;
+    }
+
+    sseg->packed += segsamples;
+    sseg->flush = 0;
+
+    /* Expect the next record to hold as many samples as the last, or wait
+     * for more samples if none could be filled */
+    if (segrecords > 0)
+      sseg->threshold = segsamples / segrecords;
+    else
+      sseg->threshold = sseg->seg->numsamples + sseg->threshold / 8 + 1;
+
+    /* Drop arrival marks for packed samples */
+    for (idx = 0; idx < sseg->arrivalcount && sseg->arrivals[idx].added <= sseg->packed; idx++)
+      ;
+
+    if (idx > 0)
+    {
+      sseg->arrivalcount -= idx;
+      memmove (&sseg->arrivals[0], &sseg->arrivals[idx],
+               sseg->arrivalcount * sizeof (sseg->arrivals[0]));
+    }
+
+    if (segrecords > 0)
+      lm_schedule (packer, sseg, now);
+  }
+
+  if (packedsamples)
+    *packedsamples = totalsamples;
+
+  return totalrecords;
+} /* End of ms3_streampack_pack() */
+
+/** ************************************************************************
+ * @brief Return statistics of a real-time packing engine
+ *
+ * @param[in] packer ::MS3StreamPacker engine
+ * @param[out] segments Number of segments with buffered data, if not NULL
+ * @param[out] bufferedsamples Number of samples buffered, if not NULL
+ * @param[out] segmentspacked Number of segment packing passes, if not NULL
+ *
+ * @returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+ms3_streampack_stats (const MS3StreamPacker *packer, int64_t *segments, int64_t *bufferedsamples,
+                      int64_t *segmentspacked)
+{
+  if (!packer)
+    return -1;
+
+  if (segments)
+    *segments = packer->segmentcount;
+  if (bufferedsamples)
+    *bufferedsamples = packer->bufferedsamples;
+  if (segmentspacked)
+    *segmentspacked = packer->segmentspacked;
+
+  return 0;
+} /* End of ms3_streampack_stats() */
+
+/** ************************************************************************
+ * @brief Free a real-time packing engine
+ *
+ * Any buffered data are discarded, call ms3_streampack_pack() with
+ * ::MSF_FLUSHDATA first to generate records for them.
+ *
+ * @param[in,out] ppacker Pointer to ::MS3StreamPacker to free, set to NULL
+ * @param[out] packedsamples Total number of samples packed, if not NULL
+ ***************************************************************************/
+void
+ms3_streampack_free (MS3StreamPacker **ppacker, int64_t *packedsamples)
+{
+  if (!ppacker || !*ppacker)
+    return;
+
+  if (packedsamples)
+    *packedsamples = (*ppacker)->packedsamples;
+
+  /* Segment states at MS3TraceSeg.prvtptr are freed with the trace list */
+  mstl3_free (&(*ppacker)->mstl, 1);
+
+  libmseed_memory.free (*ppacker);
+  *ppacker = NULL;
+} /* End of ms3_streampack_free() */
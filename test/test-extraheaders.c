@@ -368,4 +368,233 @@ TEST (extraheaders, internal)
   CHECK (getnum == 123.456, "mseh_get_number() did not return expected value");
 
   msr3_free (&msr);
-}
\ No newline at end of file
+}
+TEST (extraheaders, cache)
+{
+  MS3Record *msr = NULL;
+  MS3Record *dupmsr = NULL;
+  uint64_t getuint;
+  int64_t setint;
+  int64_t getint;
+  char getstr[100];
+  char record[512];
+  char *setstr;
+  char *jsondoc;
+  char *string;
+  int rv;
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  rv = mseh_cache_enable (msr);
+  REQUIRE (rv == 0, "mseh_cache_enable() returned unexpected error");
+  REQUIRE (msr->extracache != NULL, "msr->extracache is unexpectedly NULL");
+
+  /* Populate initial header JSON */
+  msr->extralength = strlen (testheaders);
+  msr->extra = malloc (msr->extralength);
+  REQUIRE (msr->extra != NULL, "Error allocating memory for msr->extra");
+  memcpy (msr->extra, testheaders, msr->extralength);
+
+  /* Get values via cache */
+  rv = mseh_get_uint64 (msr, "/FDSN/Time/Quality", &getuint);
+  CHECK (rv == 0, "mseh_get_uint64() returned unexpected non-match");
+  CHECK (getuint == 100, "/FDSN/Time/Quality is not expected 100");
+
+  rv = mseh_get_string (msr, "/FDSN/Event/Detection/0/Type", getstr, sizeof (getstr));
+  CHECK (rv == 0, "mseh_get_string() returned unexpected non-match");
+  CHECK_STREQ (getstr, "MURDOCK");
+
+  /* Set values via cache, serialization is deferred */
+  setint = -5;
+  rv = mseh_set_int64 (msr, "/FDSN/Time/LeapSecond", &setint);
+  CHECK (rv == 0, "mseh_set_int64() returned unexpected error");
+
+  setstr = "Value";
+  rv = mseh_set_string (msr, "/New/String", setstr);
+  CHECK (rv == 0, "mseh_set_string() returned unexpected error");
+
+  CHECK (msr->extralength == strlen (testheaders), "msr->extra was unexpectedly serialized");
+
+  /* Changes are visible to get operations before serialization */
+  rv = mseh_get_int64 (msr, "/FDSN/Time/LeapSecond", &getint);
+  CHECK (rv == 0, "mseh_get_int64() returned unexpected non-match");
+  CHECK (getint == -5, "/FDSN/Time/LeapSecond is not expected -5");
+
+  rv = mseh_get_string (msr, "/New/String", getstr, sizeof (getstr));
+  CHECK (rv == 0, "mseh_get_string() returned unexpected non-match");
+  CHECK_STREQ (getstr, "Value");
+
+  /* Duplication includes pending changes without modifying the source record */
+  dupmsr = msr3_duplicate (msr, 0);
+  REQUIRE (dupmsr != NULL, "msr3_duplicate() returned unexpected NULL");
+  CHECK (dupmsr->extracache == NULL, "dupmsr->extracache is unexpectedly set");
+  CHECK (strstr (dupmsr->extra, "\"LeapSecond\":-5") != NULL, "Duplicate extra missing change");
+  CHECK (msr->extralength == strlen (testheaders), "msr->extra was unexpectedly serialized");
+
+  /* Flush serializes pending changes */
+  rv = mseh_cache_flush (msr);
+  CHECK (rv == dupmsr->extralength, "mseh_cache_flush() returned unexpected value");
+  CHECK (msr->extralength == dupmsr->extralength, "Flushed extra length does not match");
+  msr3_free (&dupmsr);
+
+  /* Flush with no pending changes returns current length */
+  rv = mseh_cache_flush (msr);
+  CHECK (rv == msr->extralength, "mseh_cache_flush() returned unexpected value");
+
+  /* Replace invalidates the cache */
+  jsondoc = "{\"root\":{\"string\":\"value\"}}";
+  rv = mseh_replace (msr, jsondoc);
+  CHECK (rv == (int)strlen (jsondoc), "mseh_replace() returned unexpected error");
+
+  rv = mseh_get_string (msr, "/New/String", getstr, sizeof (getstr));
+  CHECK (rv == 1, "mseh_get_string() returned unexpected match after replace");
+
+  rv = mseh_get_string (msr, "/root/string", getstr, sizeof (getstr));
+  CHECK (rv == 0, "mseh_get_string() returned unexpected non-match");
+  CHECK_STREQ (getstr, "value");
+
+  /* Re-initialization invalidates the cache but retains it */
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+  REQUIRE (msr->extracache != NULL, "msr->extracache was unexpectedly released");
+  CHECK (msr->extra == NULL, "msr->extra was not released");
+
+  rv = mseh_get_string (msr, "/root/string", getstr, sizeof (getstr));
+  CHECK (rv == 1, "mseh_get_string() returned unexpected match after msr3_init()");
+
+  /* Set on empty headers, included when packed without modifying the record */
+  setstr = "value";
+  rv = mseh_set_string (msr, "/root/string", setstr);
+  CHECK (rv == 0, "mseh_set_string() returned unexpected error");
+  CHECK (msr->extra == NULL, "msr->extra was unexpectedly serialized");
+
+  rv = mseh_get_string (msr, "/root/string", getstr, sizeof (getstr));
+  CHECK (rv == 0, "mseh_get_string() returned unexpected non-match");
+  CHECK_STREQ (getstr, "value");
+
+  strcpy (msr->sid, "FDSN:XX_TEST__B_H_Z");
+  msr->formatversion = 3;
+  msr->starttime = 0;
+  msr->reclen = 512;
+  rv = msr3_pack_header3 (msr, record, sizeof (record), 0);
+  CHECK (msr->extra == NULL, "msr->extra was unexpectedly serialized when packed");
+  string = "{\"root\":{\"string\":\"value\"}}";
+  REQUIRE (rv == (int)(40 + strlen (msr->sid) + strlen (string)),
+           "msr3_pack_header3() returned unexpected header length");
+  CHECK_SUBSTREQ (record + 40 + strlen (msr->sid), string, strlen (string));
+
+  /* Pending changes serialized when disabled */
+  setstr = "value";
+  rv = mseh_set_string (msr, "/root/other", setstr);
+  CHECK (rv == 0, "mseh_set_string() returned unexpected error");
+
+  rv = mseh_cache_disable (msr);
+  CHECK (rv == 0, "mseh_cache_disable() returned unexpected error");
+  CHECK (msr->extracache == NULL, "msr->extracache was not released");
+  REQUIRE (msr->extra != NULL, "msr->extra cannot be NULL");
+  string = "{\"root\":{\"string\":\"value\",\"other\":\"value\"}}";
+  CHECK_SUBSTREQ (msr->extra, string, strlen (string));
+
+  msr3_free (&msr);
+}
+
+TEST (extraheaders, scan)
+{
+  MS3Record *msr = NULL;
+  MSEHScanner *scanner = NULL;
+  MSEHScanValue values[10];
+  char *escaped;
+  int rv;
+
+  const char *pointers[] = {
+      "/FDSN/Time/Quality",                /* 0: unsigned integer */
+      "/FDSN/Time/Correction",             /* 1: number */
+      "/FDSN/Time/LeapSecond",             /* 2: signed integer */
+      "/FDSN/Event/Begin",                 /* 3: boolean */
+      "/FDSN/Event/Detection/0/Type",      /* 4: string in array element */
+      "/FDSN/Event/Detection/0/MEDSNR",    /* 5: array */
+      "/FDSN/Event/Detection/1/Type",      /* 6: missing array element */
+      "/FDSN/Missing",                     /* 7: missing */
+      "/FDSN/Event/Detection/0/MEDSNR/4", /* 8: array element */
+      "/FDSN/Time",                        /* 9: object */
+  };
+
+  /* Suppress error and warning messages by accumulating them */
+  ms_rloginit (NULL, NULL, NULL, NULL, 10);
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  rv = mseh_replace (msr, testheaders);
+  REQUIRE (rv > 0, "mseh_replace() returned unexpected error");
+
+  scanner = mseh_scanner_init (pointers, 10);
+  REQUIRE (scanner != NULL, "mseh_scanner_init() returned unexpected NULL");
+
+  rv = mseh_scan (scanner, msr, values);
+  CHECK (rv == 8, "mseh_scan() returned unexpected value");
+
+  CHECK (values[0].type == 'u', "Unexpected type for /FDSN/Time/Quality");
+  CHECK (values[0].uintvalue == 100, "Unexpected value for /FDSN/Time/Quality");
+  CHECK (values[1].type == 'n', "Unexpected type for /FDSN/Time/Correction");
+  CHECK (values[1].numbervalue == 1.234, "Unexpected value for /FDSN/Time/Correction");
+  CHECK (values[2].type == 'i', "Unexpected type for /FDSN/Time/LeapSecond");
+  CHECK (values[2].intvalue == -1, "Unexpected value for /FDSN/Time/LeapSecond");
+  CHECK (values[3].type == 'b', "Unexpected type for /FDSN/Event/Begin");
+  CHECK (values[3].booleanvalue == 1, "Unexpected value for /FDSN/Event/Begin");
+  CHECK (values[4].type == 's', "Unexpected type for /FDSN/Event/Detection/0/Type");
+  CHECK (values[4].stringlength == 7, "Unexpected string length");
+  CHECK_SUBSTREQ (values[4].string, "MURDOCK", 7);
+  CHECK (values[5].type == 'a', "Unexpected type for /FDSN/Event/Detection/0/MEDSNR");
+  CHECK_SUBSTREQ (values[5].raw, "[1,3,2,1,4,0]", values[5].rawlength);
+  CHECK (values[6].type == 0, "Unexpected match for /FDSN/Event/Detection/1/Type");
+  CHECK (values[7].type == 0, "Unexpected match for /FDSN/Missing");
+  CHECK (values[8].type == 'u', "Unexpected type for /FDSN/Event/Detection/0/MEDSNR/4");
+  CHECK (values[8].uintvalue == 4, "Unexpected value for /FDSN/Event/Detection/0/MEDSNR/4");
+  CHECK (values[9].type == 'o', "Unexpected type for /FDSN/Time");
+  CHECK (values[9].raw[0] == '{' && values[9].raw[values[9].rawlength - 1] == '}',
+         "Unexpected raw JSON for /FDSN/Time");
+
+  /* Types match mseh_get_ptr_type() */
+  for (rv = 0; rv < 10; rv++)
+  {
+    CHECK (values[rv].type == mseh_get_ptr_type (msr, pointers[rv], NULL),
+           "mseh_scan() type does not match mseh_get_ptr_type()");
+  }
+
+  mseh_scanner_free (&scanner);
+  CHECK (scanner == NULL, "mseh_scanner_free() did not set scanner to NULL");
+
+  /* Escaped keys and JSON Pointer tokens */
+  escaped = "{\"a/b\":1,\"m~n\":2,\"k\\u00e9y\":3,\"q\\\"t\":{\"x\":[10,{\"y\":null}]}}";
+  rv = mseh_replace (msr, escaped);
+  REQUIRE (rv > 0, "mseh_replace() returned unexpected error");
+
+  {
+    const char *escpointers[] = {"/a~1b", "/m~0n", "/k\xc3\xa9y", "/q\"t/x/1", "/q\"t/x/1/y"};
+
+    scanner = mseh_scanner_init (escpointers, 5);
+    REQUIRE (scanner != NULL, "mseh_scanner_init() returned unexpected NULL");
+
+    rv = mseh_scan (scanner, msr, values);
+    CHECK (rv == 4, "mseh_scan() returned unexpected value for escaped keys");
+    CHECK (values[0].type == 'u' && values[0].uintvalue == 1, "Unexpected value for /a~1b");
+    CHECK (values[1].type == 'u' && values[1].uintvalue == 2, "Unexpected value for /m~0n");
+    CHECK (values[2].type == 'u' && values[2].uintvalue == 3, "Unexpected value for escaped key");
+    CHECK (values[3].type == 'o', "Unexpected type for /q\"t/x/1");
+    CHECK (values[4].type == 0, "Unexpected type for null value");
+
+    mseh_scanner_free (&scanner);
+  }
+
+  /* Invalid pointer notation */
+  {
+    const char *badpointers[] = {"FDSN/Time"};
+
+    scanner = mseh_scanner_init (badpointers, 1);
+    CHECK (scanner == NULL, "mseh_scanner_init() did not fail on invalid pointer");
+  }
+
+  msr3_free (&msr);
+}
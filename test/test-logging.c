@@ -215,6 +215,9 @@ TEST (logging, logregistry_pop)
   /* Try to pop from empty registry again */
   length = ms_rlog_pop (logp, message, sizeof (message), 0);
   CHECK (length == 0, "Pop from empty registry should return 0");
+
+  /* Clean up */
+  ms_rlog_free (logp);
 }
 
 TEST (logging, logregistry_pop_validation)
@@ -264,3 +267,181 @@ TEST (logging, logregistry_maxmessages)
   /* Clean up */
   ms_rlog_free (logp);
 }
+
+TEST (logging, logregistry_ring)
+{
+  MSLogParam custom_param = MSLogParam_INITIALIZER;
+  MSLogParam *logp;
+  MSLogEntry *entry;
+  MSLogEntry *ring;
+  char message[256];
+  int count;
+  int i;
+
+  logp = ms_rloginit_l (&custom_param, custom_log_print, NULL, custom_diag_print, NULL, 3);
+
+  /* Wrap around the ring, retaining the 3 most recent */
+  for (i = 0; i < 5; i++)
+    ms_log_l (logp, 2, "Error %d", i);
+
+  CHECK (logp->registry.messagecnt == 3, "Should have 3 messages");
+  CHECK (logp->registry.ringsize == 3, "Ring should have 3 entries");
+
+  /* List is linked from most recent to earliest and terminated */
+  count = 0;
+  for (entry = logp->registry.messages; entry; entry = entry->next)
+    count++;
+  CHECK (count == 3, "Registry list should contain 3 entries");
+  CHECK_STREQ (logp->registry.messages->message, "Error: Error 4");
+  CHECK_STREQ (logp->registry.messages->next->next->message, "Error: Error 2");
+
+  ms_rlog_pop (logp, message, sizeof (message), 0);
+  CHECK_STREQ (message, "Error: Error 4");
+
+  /* Emit the most recent remaining message, the earliest is retained */
+  reset_print_counters ();
+  CHECK (ms_rlog_emit (logp, 1, 0) == 1, "Should have emitted 1 message");
+  CHECK_STREQ (last_diag_message, "Error: Error 3");
+
+  ms_log_l (logp, 1, "Warning 5");
+  ms_rlog_pop (logp, message, sizeof (message), 0);
+  CHECK_STREQ (message, "Warning 5");
+  ms_rlog_pop (logp, message, sizeof (message), 0);
+  CHECK_STREQ (message, "Error: Error 2");
+  CHECK (logp->registry.messages == NULL, "messages should be NULL after popping all");
+  CHECK (logp->registry.ring != NULL, "Ring should be retained when empty");
+
+  /* Popping each message as it arrives re-uses the ring */
+  ring = logp->registry.ring;
+  for (i = 0; i < 5; i++)
+  {
+    ms_log_l (logp, 2, "Error %d", i);
+    CHECK (ms_rlog_pop (logp, message, sizeof (message), 0) > 0, "Should have popped a message");
+    CHECK (ms_rlog_emit (logp, 0, 0) == 0, "Should have emitted no messages");
+  }
+  CHECK (logp->registry.ring == ring, "Ring should not be re-allocated");
+  CHECK_STREQ (message, "Error: Error 4");
+
+  /* Shrinking the registry retains the most recent messages */
+  for (i = 0; i < 3; i++)
+    ms_log_l (logp, 2, "Error %d", i);
+
+  ms_rloginit_l (logp, NULL, NULL, NULL, NULL, 2);
+  ms_log_l (logp, 2, "Error 3");
+
+  CHECK (logp->registry.messagecnt == 2, "Should have 2 messages after shrinking");
+  CHECK_STREQ (logp->registry.messages->message, "Error: Error 3");
+  CHECK_STREQ (logp->registry.messages->next->message, "Error: Error 2");
+  CHECK (logp->registry.messages->next->next == NULL, "Earliest entry should terminate list");
+
+  CHECK (ms_rlog_free (logp) == 2, "Should have freed 2 messages");
+  CHECK (logp->registry.ring == NULL, "Ring should be released by free");
+}
+
+TEST (logging, minlevel)
+{
+  MSLogParam custom_param = MSLogParam_INITIALIZER;
+  MSLogParam *logp;
+
+  logp = ms_rloginit_l (&custom_param, custom_log_print, NULL, custom_diag_print, NULL, 0);
+
+  CHECK (ms_rlog_enabled (logp, 0), "Level 0 should be enabled by default");
+  CHECK (ms_rlog_minlevel (logp, 1) == 0, "Previous minimum level should be 0");
+  CHECK (!ms_rlog_enabled (logp, 0), "Level 0 should not be enabled");
+  CHECK (ms_rlog_enabled (logp, 2), "Level 2 should be enabled");
+
+  reset_print_counters ();
+  CHECK (ms_log_l (logp, 0, "Log message") == 0, "Filtered message should not be formatted");
+  ms_log_l (logp, 1, "Warning message");
+
+  CHECK (log_print_called == 0, "Log message should be discarded");
+  CHECK (diag_print_called == 1, "Warning message should be printed");
+}
+
+TEST (logging, ratelimit)
+{
+  MSLogParam custom_param = MSLogParam_INITIALIZER;
+  MSLogParam *logp;
+  int i;
+
+  logp = ms_rloginit_l (&custom_param, custom_log_print, NULL, custom_diag_print, NULL, 100);
+
+  CHECK (ms_rlog_ratelimit (logp, 2, 3600) == 0, "ms_rlog_ratelimit() failed");
+
+  /* A single call site is limited to 2 messages per interval */
+  for (i = 0; i < 10; i++)
+    ms_log_l (logp, 1, "Repeated warning %d", i);
+
+  ms_log_l (logp, 2, "Other error");
+
+  CHECK (logp->registry.messagecnt == 3, "Should have 2 limited and 1 other message");
+  CHECK_STREQ (logp->registry.messages->next->message, "Repeated warning 1");
+  CHECK (ms_rlog_suppressed (logp, 1) == 8, "Should have suppressed 8 messages");
+  CHECK (ms_rlog_suppressed (logp, 0) == 0, "Suppressed count should be reset");
+
+  /* Normal log messages are not limited */
+  reset_print_counters ();
+  for (i = 0; i < 5; i++)
+    ms_log_l (logp, 0, "Log message %d", i);
+  CHECK (log_print_called == 5, "Log messages should not be limited");
+
+  CHECK (ms_rlog_ratelimit (logp, 0, 0) == 0, "Disabling rate limiting failed");
+  CHECK (logp->ratelimit == NULL, "Rate limiting state should be released");
+
+  ms_rlog_free (logp);
+}
+
+/* Diagnostic sink that retains the last event and its message */
+static int diag_events = 0;
+static MSDiagEvent last_event;
+static char last_event_message[256];
+
+static void
+custom_diag_sink (const MSDiagEvent *event, void *data)
+{
+  (void)data;
+  diag_events++;
+  last_event = *event;
+  ms_diagevent_format (event, last_event_message, sizeof (last_event_message));
+}
+
+TEST (logging, diagsink)
+{
+  uint8_t frame[64] = {0};
+  int32_t output[1];
+  char sampletype;
+  char message[256];
+  int64_t decoded;
+  int8_t swapflag = ms_bigendianhost () ? 0 : 1;
+
+  /* Single Steim1 frame of 1 sample, X0 = 5 and Xn = 7 failing the integrity check */
+  frame[7] = 5;
+  frame[11] = 7;
+
+  ms_rloginit (NULL, NULL, NULL, NULL, 10);
+  ms_rlog_free (NULL);
+  ms_rlog_diagsink (NULL, custom_diag_sink, NULL);
+
+  decoded = ms_decode_data (frame, sizeof (frame), DE_STEIM1, 1, output, sizeof (output),
+                            &sampletype, swapflag, "FDSN:XX_TEST__B_H_Z", 0);
+  CHECK (decoded == 1, "Should have decoded 1 sample");
+  CHECK (diag_events == 1, "Diagnostic sink should receive 1 event");
+  CHECK (last_event.code == MSDIAG_STEIM1_INTEGRITY, "Event code should be Steim1 integrity");
+  CHECK (last_event.level == 1, "Event level should be 1");
+  CHECK (last_event.value[0] == 5 && last_event.value[1] == 7, "Event values incorrect");
+  CHECK (last_event.offset == -1, "Event offset should be unknown");
+  CHECK_STREQ (last_event_message, "FDSN:XX_TEST__B_H_Z: Warning: Data integrity check for Steim1 "
+                                   "failed, Last sample=5, Xn=7");
+  CHECK (ms_rlog_pop (NULL, message, sizeof (message), 0) == 0,
+         "Event should not be logged when a sink is set");
+
+  /* Without a sink the event is logged */
+  ms_rlog_diagsink (NULL, NULL, NULL);
+  ms_decode_data (frame, sizeof (frame), DE_STEIM1, 1, output, sizeof (output), &sampletype,
+                  swapflag, "FDSN:XX_TEST__B_H_Z", 0);
+  CHECK (diag_events == 1, "Diagnostic sink should not receive events when unset");
+  CHECK (ms_rlog_pop (NULL, message, sizeof (message), 0) > 0, "Event should be logged");
+  CHECK (strstr (message, last_event_message) != NULL, "Logged message should match event message");
+
+  ms_rloginit (NULL, NULL, NULL, NULL, 0);
+}
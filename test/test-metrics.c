@@ -0,0 +1,65 @@
+#include <string.h>
+
+#include <tau/tau.h>
+#include <libmseed.h>
+
+TEST (metrics, snapshot)
+{
+  MS3TraceList *mstl = NULL;
+  MSMetrics metrics;
+  char *json;
+  size_t length = 0;
+  int rv;
+
+  char *path = "data/testdata-3channel-signal.mseed3";
+  uint32_t flags = MSF_VALIDATECRC | MSF_UNPACKDATA;
+
+  ms_metrics_reset ();
+
+  rv = ms3_readtracelist (&mstl, path, NULL, 0, flags, 0);
+  CHECK (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+  mstl3_free (&mstl, 0);
+
+  rv = ms_metrics_snapshot (&metrics, 1);
+
+  if (!ms_metrics_enabled ())
+  {
+    CHECK (rv == -1, "ms_metrics_snapshot() did not return -1 when metrics are not enabled");
+    CHECK (metrics.parse.count == 0, "Metrics not zeroed when not enabled");
+    CHECK (ms_metrics_json (NULL, NULL) == NULL, "ms_metrics_json() did not return NULL");
+    return;
+  }
+
+  CHECK (rv == 0, "ms_metrics_snapshot() did not return 0");
+  CHECK (metrics.parse.count > 0, "No record parsing counted");
+  CHECK (metrics.crc.count > 0, "No CRC calculation counted");
+  CHECK (metrics.decode[DE_STEIM2].count > 0, "No Steim-2 decoding counted");
+  CHECK (metrics.tracelistinsert.count == metrics.parse.count,
+         "Trace list insertions do not match records parsed");
+  CHECK (metrics.idlookup.count == metrics.tracelistinsert.count,
+         "ID lookups do not match trace list insertions");
+  CHECK (metrics.bytesread > 0, "No bytes read counted");
+  CHECK (metrics.allocations > 0, "No allocations counted");
+
+  /* Metrics are reset by the snapshot */
+  rv = ms_metrics_snapshot (&metrics, 0);
+  CHECK (rv == 0, "ms_metrics_snapshot() did not return 0");
+  CHECK (metrics.parse.count == 0, "Metrics not reset by snapshot");
+
+  metrics.parse.count = 3;
+  metrics.parse.nanoseconds = 42;
+  metrics.decode[DE_STEIM2].count = 1;
+  metrics.bytesread = 512;
+
+  json = ms_metrics_json (&metrics, &length);
+  REQUIRE (json != NULL, "ms_metrics_json() did not return a string");
+  CHECK (length == strlen (json), "ms_metrics_json() length does not match");
+  CHECK (strstr (json, "\"parse\":{\"count\":3,\"nanoseconds\":42}") != NULL,
+         "JSON parse timer not as expected");
+  CHECK (strstr (json, "\"decode\":{\"11\":{\"count\":1,") != NULL,
+         "JSON decode timer not as expected");
+  CHECK (strstr (json, "\"encode\":{}") != NULL, "JSON encode timers not as expected");
+  CHECK (strstr (json, "\"bytesread\":512") != NULL, "JSON bytesread not as expected");
+
+  libmseed_memory.free (json);
+}
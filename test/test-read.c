@@ -527,6 +527,294 @@ TEST (read, selection)
   ms3_freeselections (selections);
 }
 
+/* Records rejected by testing the raw header against selections must be
+ * exactly those that would be rejected after a full parse. */
+TEST (read, selection_header)
+{
+  MS3Record *msr = NULL;
+  MS3FileParam *msfp = NULL;
+  MS3Selections *selections = NULL;
+  nstime_t starttime;
+  nstime_t endtime;
+  int64_t expected;
+  int64_t selected;
+  int rv;
+  int idx;
+
+  const char *paths[] = {"data/testdata-3channel-signal.mseed2",
+                         "data/testdata-3channel-signal.mseed3"};
+
+  starttime = ms_timestr2nstime ("2010-02-27T07:00:00Z");
+  endtime = ms_timestr2nstime ("2010-02-27T07:30:00Z");
+
+  rv = ms3_addselect (&selections, "FDSN:IU_*_*_L_H_[Z1]", starttime, endtime, 0);
+  REQUIRE (rv == 0, "ms3_addselect() returned an unexpected error");
+
+  for (idx = 0; idx < (int)(sizeof (paths) / sizeof (paths[0])); idx++)
+  {
+    /* Count matching records after a full parse */
+    expected = 0;
+    while ((rv = ms3_readmsr_r (&msfp, &msr, paths[idx], 0, 0)) == MS_NOERROR)
+    {
+      if (msr3_matchselect (selections, msr, NULL))
+        expected++;
+    }
+    CHECK (rv == MS_ENDOFFILE, "ms3_readmsr_r() did not return expected MS_ENDOFFILE");
+    ms3_readmsr_r (&msfp, &msr, NULL, 0, 0);
+
+    /* Count records returned by the selection reader */
+    selected = 0;
+    while ((rv = ms3_readmsr_selection (&msfp, &msr, paths[idx], MSF_UNPACKDATA, selections, 0)) ==
+           MS_NOERROR)
+    {
+      CHECK (msr->numsamples == msr->samplecnt, "Selected record data samples not decoded");
+      selected++;
+    }
+    CHECK (rv == MS_ENDOFFILE, "ms3_readmsr_selection() did not return expected MS_ENDOFFILE");
+    ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+    CHECK (expected > 0, "No records matched selection, test data changed?");
+    CHECK (selected == expected, "Selection read returned unexpected number of records");
+  }
+
+  ms3_freeselections (selections);
+}
+
+/* Seeking to a selected time range in a time-ordered, fixed record length file
+ * must return the same data as reading the whole file. */
+TEST (read, seekselection)
+{
+  MS3Record *msr = NULL;
+  MS3FileParam *msfp = NULL;
+  MS3Selections *selections = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3TraceList *seekmstl = NULL;
+  FILE *ofp = NULL;
+  nstime_t starttime;
+  nstime_t endtime;
+  int64_t records = 0;
+  int rv;
+
+  char *path = "testdata-seekselection.mseed2";
+
+  /* Create a single channel, time-ordered file from the 3-channel test data */
+  rv = ms3_addselect (&selections, "FDSN:IU_COLA_00_L_H_Z", NSTUNSET, NSTUNSET, 0);
+  REQUIRE (rv == 0, "ms3_addselect() returned an unexpected error");
+
+  ofp = fopen (path, "wb");
+  REQUIRE (ofp != NULL, "Cannot open output file");
+
+  while ((rv = ms3_readmsr_selection (&msfp, &msr, "data/testdata-3channel-signal.mseed2", 0,
+                                      selections, 0)) == MS_NOERROR)
+  {
+    fwrite (msr->record, msr->reclen, 1, ofp);
+    records++;
+  }
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+  ms3_freeselections (selections);
+  selections = NULL;
+  fclose (ofp);
+
+  REQUIRE (records == 36, "Unexpected number of records for single channel test file");
+
+  starttime = ms_timestr2nstime ("2010-02-27T07:30:00Z");
+  endtime = ms_timestr2nstime ("2010-02-27T07:45:00Z");
+
+  rv = ms3_addselect (&selections, "*", starttime, endtime, 0);
+  REQUIRE (rv == 0, "ms3_addselect() returned an unexpected error");
+
+  /* Stream is positioned within the file for the first selected record */
+  rv = ms3_readmsr_selection (&msfp, &msr, path, MSF_SEEKSELECTION, selections, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readmsr_selection() did not return expected MS_NOERROR");
+  CHECK (msfp->startoffset > 0, "Stream start offset was not set by seeking");
+  CHECK (msfp->endoffset > msfp->startoffset, "Stream end offset was not set by seeking");
+  CHECK (msfp->streampos - msr->reclen == msfp->startoffset,
+         "First record not read from start offset");
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+  /* Trace lists with and without seeking are identical */
+  rv = ms3_readtracelist_selection (&mstl, path, NULL, selections, 0, MSF_UNPACKDATA, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readtracelist_selection() did not return expected MS_NOERROR");
+
+  rv = ms3_readtracelist_selection (&seekmstl, path, NULL, selections, 0,
+                                    MSF_UNPACKDATA | MSF_SEEKSELECTION, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readtracelist_selection() did not return expected MS_NOERROR");
+
+  REQUIRE (mstl->numtraceids == 1 && seekmstl->numtraceids == 1, "Unexpected number of trace IDs");
+  REQUIRE (mstl->traces.next[0]->first != NULL, "Trace segment is unexpected NULL");
+  REQUIRE (seekmstl->traces.next[0]->first != NULL, "Trace segment is unexpected NULL");
+  CHECK (mstl->traces.next[0]->first->starttime == seekmstl->traces.next[0]->first->starttime,
+         "Segment start times differ");
+  CHECK (mstl->traces.next[0]->first->endtime == seekmstl->traces.next[0]->first->endtime,
+         "Segment end times differ");
+  CHECK (mstl->traces.next[0]->first->numsamples == seekmstl->traces.next[0]->first->numsamples,
+         "Segment sample counts differ");
+
+  mstl3_free (&mstl, 0);
+  mstl3_free (&seekmstl, 0);
+
+  /* Time window after all data yields no records */
+  ms3_freeselections (selections);
+  selections = NULL;
+  rv = ms3_addselect (&selections, "*", ms_timestr2nstime ("2011-01-01T00:00:00Z"), NSTUNSET, 0);
+  REQUIRE (rv == 0, "ms3_addselect() returned an unexpected error");
+
+  rv = ms3_readmsr_selection (&msfp, &msr, path, MSF_SEEKSELECTION, selections, 0);
+  CHECK (rv == MS_ENDOFFILE, "ms3_readmsr_selection() did not return expected MS_ENDOFFILE");
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+  ms3_freeselections (selections);
+  remove (path);
+}
+
+/* Single channel files split from the 3-channel test data are read with a merge
+ * reader, which must return all records in time order. */
+TEST (read, mergereader)
+{
+  MS3MergeReader *reader = NULL;
+  MS3Record *msr = NULL;
+  FILE *ofp[3] = {NULL};
+  const char *sids[3] = {"FDSN:IU_COLA_00_L_H_1", "FDSN:IU_COLA_00_L_H_2",
+                         "FDSN:IU_COLA_00_L_H_Z"};
+  const char *paths[3] = {"testdata-merge-1.mseed3", "testdata-merge-2.mseed3",
+                          "testdata-merge-Z.mseed3"};
+  int64_t counts[3] = {0};
+  int64_t records = 0;
+  nstime_t lasttime = NSTERROR;
+  int pathindex = -1;
+  int idx;
+  int rv;
+
+  for (idx = 0; idx < 3; idx++)
+  {
+    ofp[idx] = fopen (paths[idx], "wb");
+    REQUIRE (ofp[idx] != NULL, "Cannot open output file");
+  }
+
+  while ((rv = ms3_readmsr (&msr, "data/testdata-3channel-signal.mseed3", 0, 0)) == MS_NOERROR)
+  {
+    for (idx = 0; idx < 3; idx++)
+    {
+      if (strcmp (msr->sid, sids[idx]) == 0)
+        fwrite (msr->record, msr->reclen, 1, ofp[idx]);
+    }
+  }
+  ms3_readmsr (&msr, NULL, 0, 0);
+
+  for (idx = 0; idx < 3; idx++)
+    fclose (ofp[idx]);
+
+  reader = ms3_mergereader_init (paths, 3, NULL, MSF_UNPACKDATA, 2, 2, 0);
+  REQUIRE (reader != NULL, "ms3_mergereader_init() returned unexpected NULL");
+
+  while ((rv = ms3_mergereader_next (reader, &msr, &pathindex)) == MS_NOERROR)
+  {
+    REQUIRE (pathindex >= 0 && pathindex < 3, "Unexpected path index");
+    CHECK_STREQ (msr->sid, sids[pathindex]);
+    CHECK (msr->starttime >= lasttime, "Records are not in time order");
+    CHECK (msr->numsamples == msr->samplecnt, "Record data samples were not decoded");
+
+    lasttime = msr->starttime;
+    counts[pathindex]++;
+    records++;
+  }
+
+  CHECK (rv == MS_ENDOFFILE, "ms3_mergereader_next() did not return expected MS_ENDOFFILE");
+  CHECK (records == 107, "Unexpected number of records");
+  CHECK (counts[0] == 36 && counts[1] == 35 && counts[2] == 36,
+         "Unexpected number of records per input");
+
+  ms3_mergereader_free (&reader);
+  CHECK (reader == NULL, "ms3_mergereader_free() did not reset pointer");
+
+  for (idx = 0; idx < 3; idx++)
+    remove (paths[idx]);
+}
+
+/* An input larger than twice the read buffer is read with a merge reader and
+ * multiple threads reading ahead.  The raw record of each returned record
+ * must still contain the record after the read buffer of its input has been
+ * refilled by reading ahead.  Records near the end of the first buffer are
+ * held briefly to let the reading threads refill all of it. */
+TEST (read, mergereader_rawrecords)
+{
+  MS3MergeReader *reader = NULL;
+  MS3Record *msr = NULL;
+  MS3Record *parsed = NULL;
+  FILE *ofp[3] = {NULL};
+  const char *sids[3] = {"FDSN:IU_COLA_00_L_H_1", "FDSN:IU_COLA_00_L_H_2",
+                         "FDSN:IU_COLA_00_L_H_Z"};
+  const char *paths[3] = {"testdata-mergeraw-1.mseed3", "testdata-mergeraw-2.mseed3",
+                          "testdata-mergeraw-Z.mseed3"};
+  int64_t offset = 0;
+  int64_t written = 0;
+  int64_t records = 0;
+  int64_t mismatches = 0;
+  int pathindex = -1;
+  int copy;
+  int idx;
+  int rv;
+
+  for (idx = 0; idx < 3; idx++)
+  {
+    ofp[idx] = fopen (paths[idx], "wb");
+    REQUIRE (ofp[idx] != NULL, "Cannot open output file");
+  }
+
+  /* Repeat the records of the first input until it is larger than twice the read buffer */
+  for (copy = 0; ftell (ofp[0]) <= 2 * MAXRECLEN; copy++)
+  {
+    while ((rv = ms3_readmsr (&msr, "data/testdata-3channel-signal.mseed3", 0, 0)) == MS_NOERROR)
+    {
+      for (idx = 0; idx < 3; idx++)
+      {
+        if (strcmp (msr->sid, sids[idx]) == 0 && (idx == 0 || copy == 0))
+        {
+          fwrite (msr->record, msr->reclen, 1, ofp[idx]);
+          written++;
+        }
+      }
+    }
+    ms3_readmsr (&msr, NULL, 0, 0);
+  }
+
+  for (idx = 0; idx < 3; idx++)
+    fclose (ofp[idx]);
+
+  reader = ms3_mergereader_init (paths, 3, NULL, 0, 4, 2, 0);
+  REQUIRE (reader != NULL, "ms3_mergereader_init() returned unexpected NULL");
+
+  while ((rv = ms3_mergereader_next (reader, &msr, &pathindex)) == MS_NOERROR)
+  {
+    REQUIRE (msr->record != NULL, "Raw record is not set");
+
+    if (pathindex == 0)
+    {
+      offset += msr->reclen;
+
+      if (offset > MAXRECLEN - 4096 && offset <= MAXRECLEN)
+        lmp_nanosleep (20000000);
+    }
+
+    if (msr3_parse (msr->record, msr->reclen, &parsed, 0, 0) != MS_NOERROR ||
+        strcmp (parsed->sid, msr->sid) != 0 || parsed->starttime != msr->starttime ||
+        parsed->samplecnt != msr->samplecnt)
+      mismatches++;
+
+    records++;
+  }
+
+  CHECK (rv == MS_ENDOFFILE, "ms3_mergereader_next() did not return expected MS_ENDOFFILE");
+  CHECK (records == written, "Unexpected number of records");
+  CHECK (mismatches == 0, "Raw records do not match returned records");
+
+  msr3_free (&parsed);
+  ms3_mergereader_free (&reader);
+
+  for (idx = 0; idx < 3; idx++)
+    remove (paths[idx]);
+}
+
 TEST (read, oddball)
 {
   MS3Record *msr = NULL;
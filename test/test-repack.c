@@ -96,3 +96,192 @@ TEST (repack, v2)
 
   ms3_readmsr(&msr, NULL, flags, 0);
 }
+
+/* Output collected from converted records */
+typedef struct ConvertOutput
+{
+  char *buffer;
+  size_t length;
+  int64_t records;
+} ConvertOutput;
+
+static void
+collect_record (char *record, int reclen, void *data)
+{
+  ConvertOutput *output = (ConvertOutput *)data;
+
+  memcpy (output->buffer + output->length, record, reclen);
+  output->length += reclen;
+  output->records++;
+}
+
+static char *
+read_file (const char *path, size_t *length)
+{
+  FILE *fp = fopen (path, "rb");
+  char *buffer = NULL;
+
+  if (!fp)
+    return NULL;
+
+  fseek (fp, 0, SEEK_END);
+  *length = (size_t)ftell (fp);
+  fseek (fp, 0, SEEK_SET);
+
+  if ((buffer = (char *)malloc (*length)) != NULL && fread (buffer, 1, *length, fp) != *length)
+  {
+    free (buffer);
+    buffer = NULL;
+  }
+
+  fclose (fp);
+  return buffer;
+}
+
+#define V2INPUT_SIGNAL "data/testdata-3channel-signal.mseed2"
+#define V2INPUT_LE "data/reference-testdata-steim2-LE.mseed2"
+#define V3INPUT_SIGNAL "data/testdata-3channel-signal.mseed3"
+
+/* Test parallel conversion of miniSEED 2 to 3 against repacking records
+ * sequentially, and conversion of a stream in pieces.
+ */
+TEST (repack, ms3_convert_buffer)
+{
+  ConvertOutput output = {NULL, 0, 0};
+  ConvertOutput threaded = {NULL, 0, 0};
+  MS3Record *msr = NULL;
+  MS3Record *converted = NULL;
+  uint64_t record[1024];
+  char *input = NULL;
+  char *reference = NULL;
+  size_t inputlength = 0;
+  size_t referencelength = 0;
+  uint64_t offset;
+  uint64_t consumed;
+  int64_t records;
+  int rv;
+
+  input = read_file (V2INPUT_SIGNAL, &inputlength);
+  REQUIRE (input != NULL, "Cannot read " V2INPUT_SIGNAL);
+
+  reference = (char *)malloc (inputlength * 2);
+  output.buffer = (char *)malloc (inputlength * 2);
+  threaded.buffer = (char *)malloc (inputlength * 2);
+  REQUIRE (reference && output.buffer && threaded.buffer, "Cannot allocate buffers");
+
+  /* Reference: repack each record sequentially into an aligned record */
+  for (offset = 0; offset < inputlength; offset += msr->reclen)
+  {
+    rv = msr3_parse (input + offset, inputlength - offset, &msr, 0, 0);
+    REQUIRE (rv == MS_NOERROR, "msr3_parse() did not return expected MS_NOERROR");
+
+    rv = msr3_repack_mseed3 (msr, (char *)record, sizeof (record), 0);
+    REQUIRE (rv > 0, "msr3_repack_mseed3() returned an error");
+    memcpy (reference + referencelength, record, rv);
+    referencelength += rv;
+  }
+  msr3_free (&msr);
+
+  /* Single thread */
+  records = ms3_convert_buffer (input, inputlength, collect_record, &output, &consumed,
+                                MSF_ATENDOFFILE, 1, 0);
+  CHECK (records == 107, "ms3_convert_buffer() did not return expected 107 records");
+  CHECK (consumed == inputlength, "ms3_convert_buffer() did not consume all input");
+  CHECK (output.length == referencelength, "Converted length does not match reference");
+  CHECK (memcmp (output.buffer, reference, referencelength) == 0,
+         "Converted records do not match reference");
+
+  /* Multiple threads in two pieces, the first ending with an incomplete record */
+  records = ms3_convert_buffer (input, 1000, collect_record, &threaded, &consumed, 0, 4, 0);
+  CHECK (records == 1, "ms3_convert_buffer() did not return expected 1 record");
+  CHECK (consumed == 512, "ms3_convert_buffer() did not consume expected 512 bytes");
+
+  records = ms3_convert_buffer (input + consumed, inputlength - consumed, collect_record, &threaded,
+                                &consumed, MSF_ATENDOFFILE, 4, 0);
+  CHECK (records == 106, "ms3_convert_buffer() did not return expected 106 records");
+  CHECK (threaded.records == 107, "Expected 107 records from two pieces");
+  CHECK (threaded.length == referencelength, "Threaded length does not match reference");
+  CHECK (memcmp (threaded.buffer, reference, referencelength) == 0,
+         "Threaded records do not match reference");
+
+  /* Truncated record at the end of input is an error */
+  records = ms3_convert_buffer (input, 1000, collect_record, &threaded, NULL, MSF_ATENDOFFILE, 1,
+                                0);
+  CHECK (records < 0, "ms3_convert_buffer() did not return error for truncated record");
+
+  free (input);
+
+  /* Little-endian Steim frames are reordered to big-endian */
+  input = read_file (V2INPUT_LE, &inputlength);
+  REQUIRE (input != NULL, "Cannot read " V2INPUT_LE);
+
+  output.length = 0;
+  output.records = 0;
+  records = ms3_convert_buffer (input, inputlength, collect_record, &output, NULL,
+                                MSF_ATENDOFFILE, 0, 0);
+  REQUIRE (records > 0, "ms3_convert_buffer() did not return any records");
+
+  rv = msr3_parse (input, inputlength, &msr, MSF_UNPACKDATA, 0);
+  REQUIRE (rv == MS_NOERROR, "msr3_parse() of input did not return expected MS_NOERROR");
+  rv = msr3_parse (output.buffer, output.length, &converted, MSF_UNPACKDATA | MSF_VALIDATECRC, 0);
+  REQUIRE (rv == MS_NOERROR, "msr3_parse() of output did not return expected MS_NOERROR");
+
+  CHECK (converted->formatversion == 3, "Converted record is not version 3");
+  CHECK (converted->numsamples == msr->numsamples, "Converted sample count mismatch");
+  CHECK (memcmp (converted->datasamples, msr->datasamples, msr->numsamples * sizeof (int32_t)) == 0,
+         "Converted samples do not match input");
+
+  msr3_free (&msr);
+  msr3_free (&converted);
+  free (input);
+  free (reference);
+  free (output.buffer);
+  free (threaded.buffer);
+}
+
+/* Test that errors logged by conversion threads are added to the log
+ * registry of the calling thread.
+ */
+TEST (repack, ms3_convert_buffer_logging)
+{
+  ConvertOutput output = {NULL, 0, 0};
+  char message[MAX_LOG_MSG_LENGTH] = {0};
+  char *input = NULL;
+  size_t inputlength = 0;
+  uint64_t offset;
+  int64_t records;
+  uint8_t formatversion;
+  int reclen;
+  int count;
+
+  input = read_file (V3INPUT_SIGNAL, &inputlength);
+  REQUIRE (input != NULL, "Cannot read " V3INPUT_SIGNAL);
+
+  output.buffer = (char *)malloc (inputlength);
+  REQUIRE (output.buffer != NULL, "Cannot allocate buffer");
+
+  /* Corrupt the CRC of a record near the end, converted by a worker thread */
+  for (offset = 0, count = 0; count < 100; count++, offset += reclen)
+  {
+    reclen = (int)ms3_detect (input + offset, inputlength - offset, &formatversion);
+    REQUIRE (reclen > 0, "ms3_detect() did not return a record length");
+  }
+  input[offset + 28] ^= 0xFF;
+
+  ms_rloginit (NULL, NULL, NULL, NULL, 10);
+
+  records = ms3_convert_buffer (input, inputlength, collect_record, &output, NULL,
+                                MSF_ATENDOFFILE | MSF_VALIDATECRC, 4, 0);
+  CHECK (records < 0, "ms3_convert_buffer() did not return error for invalid CRC");
+
+  CHECK (ms_rlog_pop (NULL, message, sizeof (message), 0) > 0,
+         "Error from conversion thread not in log registry");
+  CHECK (strstr (message, "Cannot validate record") != NULL,
+         "Unexpected message in log registry");
+
+  ms_rlog_free (NULL);
+  ms_rloginit (NULL, NULL, NULL, NULL, 0);
+
+  free (input);
+  free (output.buffer);
+}
@@ -125,6 +125,125 @@ TEST (time, timestr2nstime)
   CHECK (nstime == NSTERROR, "Failed to produce error for time string: '20040512T000000'");
 }
 
+TEST (time, civildate)
+{
+  char isostr[50];
+  char seedstr[50];
+  char small[11];
+  nstime_t nstime;
+  nstime_t day;
+  uint16_t year, yday;
+  uint8_t hour, min, sec;
+  uint32_t nsec;
+  int failures = 0;
+
+  /* Pre-epoch time with fractional seconds */
+  nstime = -14182939012345679;
+  ms_nstime2timestr_n (nstime, isostr, sizeof(isostr), ISOMONTHDAY_DOY_Z, NANO);
+  CHECK_STREQ (isostr, "1969-07-20T20:17:40.987654321Z (201)");
+
+  ms_nstime2timestr_n (nstime, isostr, sizeof(isostr), UNIXEPOCH, MICRO);
+  CHECK_STREQ (isostr, "-14182939.012345");
+
+  ms_nstime2time (nstime, &year, &yday, &hour, &min, &sec, &nsec);
+  CHECK (year == 1969 && yday == 201 && hour == 20 && min == 17 && sec == 40 && nsec == 987654321,
+         "ms_nstime2time() returned unexpected values for 1969-07-20T20:17:40.987654321");
+
+  /* Leap day and the last day of a leap year */
+  nstime = ms_timestr2nstime ("2000-02-29T23:59:59.999999999Z");
+  ms_nstime2timestr_n (nstime, isostr, sizeof(isostr), SEEDORDINAL, NANO_MICRO_NONE);
+  CHECK_STREQ (isostr, "2000,060,23:59:59.999999999");
+
+  nstime = ms_timestr2nstime ("2000-12-31 12:00:00");
+  ms_nstime2timestr_n (nstime, isostr, sizeof(isostr), ISOMONTHDAY_DOY, NONE);
+  CHECK_STREQ (isostr, "2000-12-31T12:00:00 (366)");
+
+  /* Earliest and latest representable times */
+  ms_nstime2timestr_n (INT64_MIN + 1, isostr, sizeof(isostr), ISOMONTHDAY_Z, NANO);
+  CHECK_STREQ (isostr, "1677-09-21T00:12:43.145224193Z");
+
+  ms_nstime2timestr_n (INT64_MAX, isostr, sizeof(isostr), ISOMONTHDAY_Z, NANO);
+  CHECK_STREQ (isostr, "2262-04-11T23:47:16.854775807Z");
+
+  ms_nstime2timestr_n (INT64_MIN + 1, isostr, sizeof(isostr), NANOSECONDEPOCH, NANO);
+  CHECK_STREQ (isostr, "-9223372036854775807");
+
+  /* Truncation to the buffer size */
+  ms_nstime2timestr_n (1084345689123456788, small, sizeof(small), ISOMONTHDAY_Z, NANO);
+  CHECK_STREQ (small, "2004-05-12");
+
+  /* Every day from 1678 through 2262-04-11 converts to and from both string formats */
+  for (day = -106650; day <= 106751 && failures < 5; day++)
+  {
+    nstime = (day * 86400 + 3723) * NSTMODULUS + 5000;
+
+    ms_nstime2timestr_n (nstime, isostr, sizeof(isostr), ISOMONTHDAY_Z, NANO);
+    ms_nstime2timestr_n (nstime, seedstr, sizeof(seedstr), SEEDORDINAL, NANO);
+
+    if (ms_timestr2nstime (isostr) != nstime || ms_seedtimestr2nstime (seedstr) != nstime)
+    {
+      printf ("Round trip failed for day %" PRId64 ": '%s', '%s'\n", day, isostr, seedstr);
+      failures++;
+    }
+  }
+
+  CHECK (failures == 0, "Time string round trip failed");
+}
+
+TEST (time, sampletime_leapsecond)
+{
+  const char *leapfile = "testdata-leapseconds.list";
+  nstime_t start;
+  LeapSecond *ls;
+  FILE *fp;
+  int count;
+
+  /* Embedded list, 1000 samples at 1 Hz over the 2016-12-31 leap second */
+  start = ms_timestr2nstime ("2016-12-31T23:50:00Z");
+  CHECK (ms_sampletime (start, 1000, 1.0) == start + MS_EPOCH2NSTIME (999),
+         "Sample time not adjusted for leap second");
+
+  /* Range ending before, starting after or outside of the list span is not adjusted */
+  CHECK (ms_sampletime (start, 100, 1.0) == start + MS_EPOCH2NSTIME (100),
+         "Sample time adjusted for range ending before leap second");
+
+  start = ms_timestr2nstime ("2017-01-01T00:00:00Z");
+  CHECK (ms_sampletime (start, 1000, 1.0) == start + MS_EPOCH2NSTIME (1000),
+         "Sample time adjusted for range starting at leap second");
+
+  start = ms_timestr2nstime ("1960-01-01T00:00:00Z");
+  CHECK (ms_sampletime (start, 10, -0.5) == start + MS_EPOCH2NSTIME (5),
+         "Sample time adjusted for range before first leap second");
+
+  /* Load a list with entries out of order, it is sorted when loaded */
+  fp = fopen (leapfile, "w");
+  REQUIRE (fp != NULL, "Cannot open temporary leap second file");
+  fprintf (fp, "# Leap second list\n");
+  fprintf (fp, "3692217600 37\n");
+  fprintf (fp, "3550089600 35\n");
+  fprintf (fp, "3644697600 36\n");
+  fclose (fp);
+
+  count = ms_readleapsecondfile (leapfile);
+  remove (leapfile);
+  REQUIRE (count == 3, "ms_readleapsecondfile() did not return 3 entries");
+
+  ls = leapsecondlist;
+  REQUIRE (ls != NULL && ls->next != NULL && ls->next->next != NULL, "Leap second list not linked");
+  CHECK (ls->TAIdelta == 35 && ls->next->TAIdelta == 36 && ls->next->next->TAIdelta == 37,
+         "Leap second list not sorted");
+  CHECK (ls->next->next->next == NULL, "Leap second list not terminated");
+
+  start = ms_timestr2nstime ("2012-06-30T23:59:00Z");
+  CHECK (ms_sampletime (start, 120, 1.0) == start + MS_EPOCH2NSTIME (119),
+         "Sample time not adjusted for loaded leap second");
+
+  /* 2008-12-31 leap second is not in the loaded list */
+  start = ms_timestr2nstime ("2008-12-31T23:59:00Z");
+  CHECK (ms_sampletime (start, 120, 1.0) == start + MS_EPOCH2NSTIME (120),
+         "Sample time adjusted for leap second not in the loaded list");
+}
+
 TEST (time, systemtime)
 {
   time_t timeval;
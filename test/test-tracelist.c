@@ -2,6 +2,10 @@
 #include <libmseed.h>
 #include <time.h>
 
+#if !defined(LIBMSEED_NO_THREADING) && !defined(_WIN32)
+#include <pthread.h>
+#endif
+
 /* This test reads a miniSEED file directly into a MS3TraceList and verifies the
  * contents of the trace list against expected values.
  *
@@ -277,3 +281,898 @@ TEST (tracelist, ms3_readtracelist_splitisversion)
 
   mstl3_free (&mstl, 1);
 }
+
+/* This test reads a miniSEED file into a MS3TraceList with record lists and
+ * shared extra headers, and verifies that identical extra headers are stored
+ * once and referenced by each record list entry.
+ */
+TEST (tracelist, ms3_readtracelist_internextra)
+{
+  MS3TraceList *mstl = NULL;
+  MS3TraceList *reference = NULL;
+  MS3TraceID *id = NULL;
+  MS3TraceID *refid = NULL;
+  MS3RecordPtr *recptr = NULL;
+  MS3RecordPtr *refrecptr = NULL;
+  MS3Record *dupmsr = NULL;
+  uint64_t withextra = 0;
+  uint64_t shared = 0;
+  int rv;
+
+  char *path = "data/testdata-3channel-signal.mseed2";
+
+  rv = ms3_readtracelist (&reference, path, NULL, 0, MSF_RECORDLIST, 0);
+  CHECK (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+  REQUIRE (reference != NULL, "ms3_readtracelist() did not populate 'reference'");
+
+  rv = ms3_readtracelist (&mstl, path, NULL, 0, MSF_RECORDLIST | MSF_INTERNEXTRA, 0);
+  CHECK (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+  REQUIRE (mstl != NULL, "ms3_readtracelist() did not populate 'mstl'");
+  CHECK (mstl->numtraceids == reference->numtraceids, "mstl->numtraceids does not match reference");
+
+  /* Compare extra headers of each record list entry with reference */
+  id = mstl->traces.next[0];
+  refid = reference->traces.next[0];
+  while (id && refid)
+  {
+    REQUIRE (id->first && id->first->recordlist, "Record list is not populated");
+    REQUIRE (refid->first && refid->first->recordlist, "Reference record list is not populated");
+
+    recptr = id->first->recordlist->first;
+    refrecptr = refid->first->recordlist->first;
+    while (recptr && refrecptr)
+    {
+      CHECK (recptr->msr->extralength == refrecptr->msr->extralength,
+             "Extra header length does not match reference");
+
+      if (refrecptr->msr->extralength > 0)
+      {
+        withextra++;
+        CHECK_SUBSTREQ (recptr->msr->extra, refrecptr->msr->extra, refrecptr->msr->extralength);
+
+        if (recptr != id->first->recordlist->first &&
+            recptr->msr->extra == id->first->recordlist->first->msr->extra)
+          shared++;
+      }
+
+      recptr = recptr->next;
+      refrecptr = refrecptr->next;
+    }
+
+    id = id->next[0];
+    refid = refid->next[0];
+  }
+
+  CHECK (withextra > 0, "No records with extra headers in test data");
+  CHECK (shared > 0, "No shared extra headers detected");
+
+  /* Duplicated records own their extra headers */
+  recptr = mstl->traces.next[0]->first->recordlist->first;
+  dupmsr = msr3_duplicate (recptr->msr, 0);
+  REQUIRE (dupmsr != NULL, "msr3_duplicate() returned unexpected NULL");
+  CHECK (dupmsr->extra != recptr->msr->extra, "Duplicate extra headers are unexpectedly shared");
+  msr3_free (&dupmsr);
+
+  mstl3_free (&mstl, 1);
+  mstl3_free (&reference, 1);
+}
+
+/* This test adds the records of a 3-channel file, in two publication versions,
+ * to a shared trace list with multiple shards and to a regular trace list.
+ * The list taken from the shared trace list is verified to match the regular
+ * list and the shared trace list is verified to be empty afterwards.
+ */
+TEST (tracelist, mstl3_shared)
+{
+  MS3SharedTraceList *shared = NULL;
+  MS3TraceList *reference = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3TraceID *id = NULL;
+  MS3TraceID *refid = NULL;
+  MS3Record *msr = NULL;
+  uint32_t flags = MSF_UNPACKDATA;
+  uint8_t version;
+  int rv;
+
+  char *path = "data/testdata-3channel-signal.mseed3";
+
+  shared = mstl3_shared_init (4);
+  REQUIRE (shared != NULL, "mstl3_shared_init() returned unexpected NULL");
+
+  reference = mstl3_init (NULL);
+  REQUIRE (reference != NULL, "mstl3_init() returned unexpected NULL");
+
+  for (version = 1; version <= 2; version++)
+  {
+    while ((rv = ms3_readmsr (&msr, path, flags, 0)) == MS_NOERROR)
+    {
+      msr->pubversion = version;
+
+      CHECK (mstl3_shared_addmsr (shared, msr, 1, 1, 0, NULL) == 0,
+             "mstl3_shared_addmsr() returned unexpected error");
+      CHECK (mstl3_addmsr (reference, msr, 1, 1, 0, NULL) != NULL,
+             "mstl3_addmsr() returned unexpected NULL");
+    }
+
+    CHECK (rv == MS_ENDOFFILE, "ms3_readmsr() did not return expected MS_ENDOFFILE");
+    ms3_readmsr (&msr, NULL, flags, 0);
+  }
+
+  mstl = mstl3_shared_take (shared);
+  REQUIRE (mstl != NULL, "mstl3_shared_take() returned unexpected NULL");
+  CHECK (mstl->numtraceids == 6, "mstl->numtraceids is not expected 6");
+  CHECK (mstl->numtraceids == reference->numtraceids, "Trace ID count mismatch");
+
+  id = mstl->traces.next[0];
+  refid = reference->traces.next[0];
+  while (id && refid)
+  {
+    CHECK_STREQ (id->sid, refid->sid);
+    CHECK (id->pubversion == refid->pubversion, "Publication version mismatch");
+    CHECK (id->numsegments == refid->numsegments, "Segment count mismatch");
+    CHECK (id->first->numsamples == refid->first->numsamples, "Sample count mismatch");
+    CHECK (mstl3_findID (mstl, id->sid, id->pubversion, NULL) == id,
+           "mstl3_findID() did not find trace ID in taken list");
+
+    id = id->next[0];
+    refid = refid->next[0];
+  }
+  CHECK (id == NULL && refid == NULL, "Trace ID list length mismatch");
+
+  mstl3_free (&mstl, 0);
+
+  /* Nothing remains after taking the data */
+  mstl = mstl3_shared_take (shared);
+  REQUIRE (mstl != NULL, "mstl3_shared_take() returned unexpected NULL");
+  CHECK (mstl->numtraceids == 0, "mstl->numtraceids is not expected 0");
+
+  mstl3_free (&mstl, 0);
+  mstl3_free (&reference, 0);
+  mstl3_shared_free (&shared, 0);
+  CHECK (shared == NULL, "mstl3_shared_free() did not reset pointer");
+}
+
+#if !defined(LIBMSEED_NO_THREADING) && !defined(_WIN32)
+#define SHARED_THREADS 8
+#define SHARED_SIDS 16
+#define SHARED_RECORDS 20
+#define SHARED_SAMPLES 100
+
+typedef struct SharedProducer
+{
+  MS3SharedTraceList *shared;
+  int thread;
+  int errors;
+} SharedProducer;
+
+/* Add a contiguous block of records for every source ID, the blocks of
+ * all threads together form a continuous series with sample values equal
+ * to the sample index. */
+static void *
+shared_producer (void *arg)
+{
+  SharedProducer *producer = (SharedProducer *)arg;
+  MS3Record msr = MS3Record_INITIALIZER;
+  int32_t samples[SHARED_SAMPLES];
+  int64_t first;
+  int record;
+  int sid;
+  int idx;
+
+  msr.samprate   = 1.0;
+  msr.sampletype = 'i';
+  msr.numsamples = SHARED_SAMPLES;
+  msr.samplecnt  = SHARED_SAMPLES;
+  msr.datasamples = samples;
+
+  for (record = 0; record < SHARED_RECORDS; record++)
+  {
+    first = ((int64_t)producer->thread * SHARED_RECORDS + record) * SHARED_SAMPLES;
+
+    for (idx = 0; idx < SHARED_SAMPLES; idx++)
+      samples[idx] = (int32_t)(first + idx);
+
+    for (sid = 0; sid < SHARED_SIDS; sid++)
+    {
+      snprintf (msr.sid, sizeof (msr.sid), "FDSN:XX_S%d__B_H_Z", sid);
+      msr.starttime = MS_EPOCH2NSTIME (1577836800 + first);
+
+      if (mstl3_shared_addmsr (producer->shared, &msr, 1, 1, 0, NULL))
+        producer->errors++;
+    }
+  }
+
+  msr.datasamples = NULL;
+
+  return NULL;
+}
+
+/* This test adds records from multiple threads concurrently to a shared
+ * trace list, each thread adding a different time range for all source IDs,
+ * and verifies that each source ID is a single, complete series.
+ */
+TEST (tracelist, mstl3_shared_threads)
+{
+  SharedProducer producers[SHARED_THREADS];
+  pthread_t threads[SHARED_THREADS];
+  MS3SharedTraceList *shared = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3TraceID *id = NULL;
+  int64_t total = (int64_t)SHARED_THREADS * SHARED_RECORDS * SHARED_SAMPLES;
+  int64_t idx;
+  int errors = 0;
+  int ids = 0;
+  int thread;
+
+  shared = mstl3_shared_init (4);
+  REQUIRE (shared != NULL, "mstl3_shared_init() returned unexpected NULL");
+
+  for (thread = 0; thread < SHARED_THREADS; thread++)
+  {
+    producers[thread].shared = shared;
+    producers[thread].thread = thread;
+    producers[thread].errors = 0;
+    REQUIRE (pthread_create (&threads[thread], NULL, shared_producer, &producers[thread]) == 0,
+             "pthread_create() failed");
+  }
+
+  for (thread = 0; thread < SHARED_THREADS; thread++)
+  {
+    pthread_join (threads[thread], NULL);
+    errors += producers[thread].errors;
+  }
+
+  CHECK (errors == 0, "mstl3_shared_addmsr() returned errors");
+
+  mstl = mstl3_shared_take (shared);
+  REQUIRE (mstl != NULL, "mstl3_shared_take() returned unexpected NULL");
+  CHECK (mstl->numtraceids == SHARED_SIDS, "mstl->numtraceids is not expected count");
+
+  for (id = mstl->traces.next[0]; id; id = id->next[0], ids++)
+  {
+    CHECK (id->numsegments == 1, "Trace ID does not have a single segment");
+    CHECK (id->first->samplecnt == total, "Segment sample count is not expected total");
+    REQUIRE (id->first->numsamples == total, "Segment number of samples is not expected total");
+
+    for (idx = 0; idx < total; idx++)
+    {
+      if (((int32_t *)id->first->datasamples)[idx] != idx)
+        break;
+    }
+    CHECK (idx == total, "Segment samples are not in order");
+  }
+  CHECK (ids == SHARED_SIDS, "Trace ID list length is not expected count");
+
+  mstl3_free (&mstl, 0);
+  mstl3_shared_free (&shared, 0);
+}
+#endif /* !LIBMSEED_NO_THREADING && !_WIN32 */
+
+/* This test adds alternating records of a file with mixed record lengths and
+ * mixed time order to two trace lists, each with gaps, and merges them.  The
+ * merged list is verified to contain the continuous series and the records
+ * of both lists.  A list with other trace IDs is then merged, which moves the
+ * trace IDs, and merged again to free the private pointers of merged entries.
+ */
+TEST (tracelist, mstl3_merge)
+{
+  MS3TraceList *mstl = NULL;
+  MS3TraceList *other = NULL;
+  MS3TraceID *id = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3Record *msr = NULL;
+  MS3RecordPtr *recptr = NULL;
+  uint32_t flags = MSF_UNPACKDATA;
+  uint64_t recordcnt = 0;
+  int rv;
+
+  char *path = "data/testdata-oneseries-mixedlengths-mixedorder.mseed2";
+
+  mstl = mstl3_init (NULL);
+  other = mstl3_init (NULL);
+  REQUIRE (mstl != NULL && other != NULL, "mstl3_init() returned unexpected NULL");
+
+  while ((rv = ms3_readmsr (&msr, path, flags, 0)) == MS_NOERROR)
+  {
+    CHECK (mstl3_addmsr_recordptr ((recordcnt % 2) ? other : mstl, msr, &recptr, 0, 1, 0, NULL) !=
+               NULL,
+           "mstl3_addmsr_recordptr() returned unexpected NULL");
+
+    /* Record pointers are populated as if read from the file */
+    recptr->bufferptr = NULL;
+    recptr->fileptr = NULL;
+    recptr->filename = path;
+    recptr->fileoffset = 0;
+    recptr->dataoffset = 0;
+    recptr->prvtptr = NULL;
+
+    recordcnt++;
+  }
+  CHECK (rv == MS_ENDOFFILE, "ms3_readmsr() did not return expected MS_ENDOFFILE");
+  ms3_readmsr (&msr, NULL, flags, 0);
+
+  REQUIRE (mstl->traces.next[0] != NULL, "mstl->traces.next[0] is not populated");
+  CHECK (mstl->traces.next[0]->numsegments > 1, "Partial list is unexpectedly continuous");
+
+  /* Private pointers of the caller are not freed when merged */
+  REQUIRE (other->traces.next[0] != NULL, "other->traces.next[0] is not populated");
+  other->traces.next[0]->prvtptr = &recordcnt;
+  for (seg = other->traces.next[0]->first; seg; seg = seg->next)
+    seg->prvtptr = &recordcnt;
+
+  rv = mstl3_merge (mstl, &other, 0, 1, NULL, 0);
+  CHECK (rv == 0, "mstl3_merge() returned unexpected error");
+  CHECK (other == NULL, "mstl3_merge() did not reset source pointer");
+  CHECK (mstl->numtraceids == 1, "mstl->numtraceids is not expected 1");
+
+  id = mstl->traces.next[0];
+  REQUIRE (id != NULL && id->first != NULL, "Merged trace ID is not populated");
+  CHECK (id->numsegments == 1, "id->numsegments is not expected 1");
+  CHECK (id->first == id->last, "id->first is not equal to id->last as expected");
+  CHECK (id->earliest == ms_timestr2nstime ("2010-02-27T06:50:00.069539Z"),
+         "Earliest time is not expected '2010-02-27T06:50:00.069539Z'");
+  CHECK (id->latest == ms_timestr2nstime ("2010-02-27T07:55:51.069539Z"),
+         "Latest time is not expected '2010-02-27T07:55:51.069539Z'");
+  CHECK (id->first->samplecnt == 3952, "id->first->samplecnt is not expected 3952");
+  CHECK (id->first->numsamples == 3952, "id->first->numsamples is not expected 3952");
+  REQUIRE (id->first->recordlist != NULL, "id->first->recordlist is not populated");
+  CHECK (id->first->recordlist->recordcnt == recordcnt, "Record count mismatch");
+
+  /* Record list is in time order */
+  for (recptr = id->first->recordlist->first; recptr && recptr->next; recptr = recptr->next)
+    CHECK (recptr->msr->starttime < recptr->next->msr->starttime, "Record list is not in time order");
+
+  /* Retained entries are freed with their private pointers below */
+  id->prvtptr = NULL;
+  id->first->prvtptr = NULL;
+
+  /* Merge a list of other trace IDs */
+  other = NULL;
+  rv = ms3_readtracelist (&other, "data/testdata-3channel-signal.mseed3", NULL, 0, flags, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+
+  rv = mstl3_merge (mstl, &other, 0, 1, NULL, 0);
+  CHECK (rv == 0, "mstl3_merge() returned unexpected error");
+  CHECK (mstl->numtraceids == 4, "mstl->numtraceids is not expected 4");
+  CHECK (mstl3_findID (mstl, "FDSN:XX_TEST_00_L_H_Z", 0, NULL) == id,
+         "mstl3_findID() did not find merged trace ID");
+
+  for (id = mstl->traces.next[0]; id && id->next[0]; id = id->next[0])
+    CHECK (strcmp (id->sid, id->next[0]->sid) < 0, "Trace IDs are not in order");
+
+  /* Private pointers of merged trace IDs and segments are freed if requested */
+  other = NULL;
+  rv = ms3_readtracelist (&other, "data/testdata-3channel-signal.mseed3", NULL, 0, flags, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+
+  for (id = other->traces.next[0]; id; id = id->next[0])
+  {
+    id->prvtptr = libmseed_memory.malloc (1);
+    for (seg = id->first; seg; seg = seg->next)
+      seg->prvtptr = libmseed_memory.malloc (1);
+  }
+
+  rv = mstl3_merge (mstl, &other, 0, 1, NULL, 1);
+  CHECK (rv == 0, "mstl3_merge() returned unexpected error");
+  CHECK (mstl->numtraceids == 4, "mstl->numtraceids is not expected 4");
+
+  CHECK (mstl3_merge (mstl, &mstl, 0, 1, NULL, 0) == -1,
+         "mstl3_merge() did not reject same list");
+
+  mstl3_free (&mstl, 1);
+}
+
+/* This test reads a file with record lists and shared extra headers into two
+ * trace lists and merges them, and verifies that identical extra headers of
+ * all records in the merged list are still stored once.
+ */
+TEST (tracelist, mstl3_merge_internextra)
+{
+  MS3TraceList *mstl = NULL;
+  MS3TraceList *other = NULL;
+  MS3TraceID *id = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3RecordPtr *recptr = NULL;
+  MS3Record *records[512];
+  uint32_t flags = MSF_RECORDLIST | MSF_INTERNEXTRA;
+  int recordcnt = 0;
+  int mismatches = 0;
+  int idx;
+  int cmp;
+  int rv;
+
+  char *path = "data/testdata-3channel-signal.mseed2";
+
+  rv = ms3_readtracelist (&mstl, path, NULL, 0, flags, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+  rv = ms3_readtracelist (&other, path, NULL, 0, flags, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+
+  rv = mstl3_merge (mstl, &other, 0, 1, NULL, 0);
+  CHECK (rv == 0, "mstl3_merge() returned unexpected error");
+
+  for (id = mstl->traces.next[0]; id; id = id->next[0])
+    for (seg = id->first; seg; seg = seg->next)
+      for (recptr = seg->recordlist->first; recptr && recordcnt < 512; recptr = recptr->next)
+        records[recordcnt++] = recptr->msr;
+
+  CHECK (recordcnt == 214, "Merged record count is not expected 214");
+
+  /* Identical extra headers are the same pointer */
+  for (idx = 0; idx < recordcnt; idx++)
+  {
+    REQUIRE (records[idx]->extralength > 0, "Record without extra headers in test data");
+
+    for (cmp = idx + 1; cmp < recordcnt; cmp++)
+    {
+      if (records[idx]->extralength == records[cmp]->extralength &&
+          !memcmp (records[idx]->extra, records[cmp]->extra, records[idx]->extralength) &&
+          records[idx]->extra != records[cmp]->extra)
+        mismatches++;
+    }
+  }
+  CHECK (mismatches == 0, "Identical extra headers are not shared after merge");
+
+  mstl3_free (&mstl, 0);
+}
+
+/* This test reads files of one series twice into a trace list and from a buffer
+ * containing two copies of a file, with the MSF_SKIPDUPLICATES flag.  Duplicate
+ * records, which are not adjacent, are skipped and the series is reconstructed
+ * as if read once.
+ */
+TEST (tracelist, skipduplicates)
+{
+  MS3TraceList *mstl = NULL;
+  MS3TraceID *id = NULL;
+  FILE *fp = NULL;
+  char *buffer = NULL;
+  long filesize;
+  int64_t records;
+  int copy;
+  int idx;
+  int rv;
+
+  const char *paths[2] = {"data/testdata-oneseries-mixedlengths-mixedorder.mseed2",
+                          "data/testdata-oneseries-mixedlengths-mixedorder.mseed3"};
+
+  for (idx = 0; idx < 2; idx++)
+  {
+    for (copy = 0; copy < 2; copy++)
+    {
+      rv = ms3_readtracelist (&mstl, paths[idx], NULL, 0, MSF_UNPACKDATA | MSF_SKIPDUPLICATES, 0);
+      CHECK (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+    }
+
+    REQUIRE (mstl != NULL, "ms3_readtracelist() did not populate 'mstl'");
+    CHECK (mstl->numtraceids == 1, "mstl->numtraceids is not expected 1");
+
+    id = mstl->traces.next[0];
+    REQUIRE (id != NULL && id->first != NULL, "Trace ID is not populated");
+    CHECK (id->numsegments == 1, "id->numsegments is not expected 1");
+    CHECK (id->first->samplecnt == 3952, "id->first->samplecnt is not expected 3952");
+    CHECK (id->first->numsamples == 3952, "id->first->numsamples is not expected 3952");
+
+    mstl3_free (&mstl, 0);
+  }
+
+  /* Without skipping duplicates the second copy overlaps */
+  for (copy = 0; copy < 2; copy++)
+    ms3_readtracelist (&mstl, paths[1], NULL, 0, MSF_UNPACKDATA, 0);
+  REQUIRE (mstl != NULL, "ms3_readtracelist() did not populate 'mstl'");
+  CHECK (mstl->traces.next[0]->numsegments > 1, "Duplicate data was not added");
+  mstl3_free (&mstl, 0);
+
+  /* Buffer of two copies of a file */
+  fp = fopen (paths[1], "rb");
+  REQUIRE (fp != NULL, "Cannot open test file");
+  fseek (fp, 0, SEEK_END);
+  filesize = ftell (fp);
+  fseek (fp, 0, SEEK_SET);
+
+  buffer = (char *)malloc (filesize * 2);
+  REQUIRE (buffer != NULL, "Cannot allocate buffer");
+  CHECK (fread (buffer, 1, filesize, fp) == (size_t)filesize, "Cannot read test file");
+  memcpy (buffer + filesize, buffer, filesize);
+  fclose (fp);
+
+  records = mstl3_readbuffer (&mstl, buffer, filesize * 2, 0, MSF_UNPACKDATA | MSF_SKIPDUPLICATES,
+                              NULL, 0);
+  CHECK (records == 7, "mstl3_readbuffer() did not return expected 7 records");
+  REQUIRE (mstl != NULL && mstl->traces.next[0] != NULL, "mstl3_readbuffer() did not populate 'mstl'");
+  CHECK (mstl->traces.next[0]->first->numsamples == 3952, "Sample count is not expected 3952");
+
+  mstl3_free (&mstl, 0);
+  free (buffer);
+}
+
+/* Add the records of a file of one series as publication version 1 and the
+ * records in a time window as version 2, with samples modified, in both
+ * orders, with MSF_BESTVERSION.  Version 2 data must supersede version 1 data in
+ * the window and the total coverage must be the series.
+ */
+static void
+add_versions (MS3TraceList *mstl, nstime_t winstart, nstime_t winend, int highfirst)
+{
+  MS3Record *msr = NULL;
+  uint32_t flags = MSF_UNPACKDATA;
+  int64_t idx;
+  int pass;
+
+  for (pass = 0; pass < 2; pass++)
+  {
+    int high = (pass == 0) ? highfirst : !highfirst;
+
+    while (ms3_readmsr (&msr, "data/testdata-oneseries-mixedlengths-mixedorder.mseed3", flags, 0) ==
+           MS_NOERROR)
+    {
+      if (high && (msr->starttime < winstart || msr3_endtime (msr) > winend))
+        continue;
+
+      msr->pubversion = (high) ? 2 : 1;
+
+      if (high)
+        for (idx = 0; idx < msr->numsamples; idx++)
+          ((int32_t *)msr->datasamples)[idx] = 1000000000;
+
+      mstl3_addmsr (mstl, msr, 0, 1, MSF_BESTVERSION, NULL);
+    }
+    ms3_readmsr (&msr, NULL, flags, 0);
+  }
+}
+
+TEST (tracelist, bestversion)
+{
+  MS3TraceList *mstl = NULL;
+  MS3TraceID *id = NULL;
+  MS3TraceSeg *seg = NULL;
+  nstime_t winstart = ms_timestr2nstime ("2010-02-27T07:00:00Z");
+  nstime_t winend = ms_timestr2nstime ("2010-02-27T07:30:00Z");
+  int64_t samples;
+  int64_t marked;
+  int64_t idx;
+  int order;
+
+  for (order = 0; order < 2; order++)
+  {
+    mstl = mstl3_init (NULL);
+    REQUIRE (mstl != NULL, "mstl3_init() returned unexpected NULL");
+
+    add_versions (mstl, winstart, winend, order);
+
+    CHECK (mstl->numtraceids == 2, "mstl->numtraceids is not expected 2");
+
+    samples = 0;
+    for (id = mstl->traces.next[0]; id; id = id->next[0])
+    {
+      for (seg = id->first; seg; seg = seg->next)
+      {
+        REQUIRE (seg->numsamples == seg->samplecnt, "Segment samples are not decoded");
+
+        marked = 0;
+        for (idx = 0; idx < seg->numsamples; idx++)
+          if (((int32_t *)seg->datasamples)[idx] == 1000000000)
+            marked++;
+
+        if (id->pubversion == 2)
+        {
+          CHECK (marked == seg->numsamples, "Version 2 segment contains version 1 samples");
+          CHECK (seg->starttime >= winstart && seg->endtime <= winend,
+                 "Version 2 segment is outside of window");
+        }
+        else
+        {
+          CHECK (marked == 0, "Version 1 segment contains version 2 samples");
+          CHECK (seg->endtime < mstl->traces.next[0]->next[0]->earliest ||
+                     seg->starttime > mstl->traces.next[0]->next[0]->latest,
+                 "Version 1 segment overlaps version 2");
+        }
+
+        samples += seg->samplecnt;
+      }
+    }
+
+    REQUIRE (mstl->traces.next[0] != NULL, "mstl->traces.next[0] is not populated");
+    CHECK (mstl->traces.next[0]->pubversion == 1, "First trace ID is not expected version 1");
+    CHECK (mstl->traces.next[0]->numsegments == 2, "Version 1 is not split in two segments");
+    CHECK (samples == 3952, "Total sample count is not expected 3952");
+
+    mstl3_free (&mstl, 0);
+  }
+}
+
+TEST (tracelist, bestversion_recordlist)
+{
+  MS3TraceList *mstl = NULL;
+  MS3Record *msr = NULL;
+  MS3RecordPtr *recptr = NULL;
+  char *path = "data/testdata-oneseries-mixedlengths-mixedorder.mseed3";
+  int64_t records;
+
+  /* Reading with both flags is rejected */
+  records = ms3_readtracelist (&mstl, path, NULL, 0, MSF_BESTVERSION | MSF_RECORDLIST, 0);
+  CHECK (records < 0, "ms3_readtracelist() accepted MSF_BESTVERSION with MSF_RECORDLIST");
+  mstl3_free (&mstl, 0);
+
+  /* Adding with a record pointer is rejected */
+  mstl = mstl3_init (NULL);
+  REQUIRE (mstl != NULL, "mstl3_init() returned unexpected NULL");
+  REQUIRE (ms3_readmsr (&msr, path, 0, 0) == MS_NOERROR,
+           "ms3_readmsr() did not return expected MS_NOERROR");
+
+  CHECK (mstl3_addmsr_recordptr (mstl, msr, &recptr, 0, 1, MSF_BESTVERSION, NULL) == NULL,
+         "mstl3_addmsr_recordptr() accepted MSF_BESTVERSION");
+  CHECK (mstl->numtraceids == 0, "Trace list was modified");
+
+  /* Adding any version to a series with record lists is rejected */
+  REQUIRE (mstl3_addmsr_recordptr (mstl, msr, &recptr, 0, 1, 0, NULL) != NULL,
+           "mstl3_addmsr_recordptr() returned unexpected NULL");
+  msr->pubversion++;
+  CHECK (mstl3_addmsr (mstl, msr, 0, 1, MSF_BESTVERSION, NULL) == NULL,
+         "mstl3_addmsr() accepted MSF_BESTVERSION with existing record lists");
+  CHECK (mstl->numtraceids == 1, "Trace list was modified");
+  CHECK (mstl->traces.next[0]->first->recordlist->recordcnt == 1,
+         "Record list is not expected 1 entry");
+
+  ms3_readmsr (&msr, NULL, 0, 0);
+  mstl3_free (&mstl, 0);
+}
+
+/* Compare the running statistics of a segment to statistics calculated from
+ * all of its data samples.
+ */
+static int
+segstats_match (const MS3TraceSeg *seg)
+{
+  MS3SampleStats full = {0};
+
+  if (!seg->stats || ms_samplestats (&full, seg->datasamples, seg->numsamples, seg->sampletype))
+    return 0;
+
+  return (seg->stats->count == seg->numsamples && seg->stats->min == full.min &&
+          seg->stats->max == full.max && seg->stats->sum == full.sum &&
+          seg->stats->sumsquares == full.sumsquares && seg->stats->mean == full.mean);
+}
+
+static void
+discard_record (char *record, int reclen, void *handlerdata)
+{
+  (void)record;
+  (void)reclen;
+  (void)handlerdata;
+}
+
+/* Statistics of sample counts spanning groups of four samples with
+ * remainders must match a simple accumulation of the same values.
+ */
+TEST (tracelist, samplestats_lengths)
+{
+  MS3SampleStats stats;
+  int32_t ivalues[13];
+  float fvalues[13];
+  double dvalues[13];
+  double min;
+  double max;
+  double sum;
+  double sumsquares;
+  int count;
+  int idx;
+
+  for (count = 1; count <= 13; count++)
+  {
+    min = max = sum = sumsquares = 0.0;
+
+    /* Minimum last and maximum in the middle */
+    for (idx = 0; idx < count; idx++)
+    {
+      ivalues[idx] = (idx == count - 1) ? -1000 : (idx == count / 2) ? 1000 : idx * 3 - 7;
+      fvalues[idx] = (float)ivalues[idx] / 2;
+      dvalues[idx] = (double)ivalues[idx] / 4;
+
+      min = (idx == 0 || ivalues[idx] < min) ? ivalues[idx] : min;
+      max = (idx == 0 || ivalues[idx] > max) ? ivalues[idx] : max;
+      sum += ivalues[idx];
+      sumsquares += (double)ivalues[idx] * ivalues[idx];
+    }
+
+    memset (&stats, 0, sizeof (stats));
+    CHECK (ms_samplestats (&stats, ivalues, count, 'i') == 0, "ms_samplestats() returned an error");
+    CHECK (stats.min == min && stats.max == max, "Integer range is not expected");
+    CHECK (stats.sum == sum && stats.sumsquares == sumsquares, "Integer sums are not expected");
+
+    memset (&stats, 0, sizeof (stats));
+    CHECK (ms_samplestats (&stats, fvalues, count, 'f') == 0, "ms_samplestats() returned an error");
+    CHECK (stats.min == min / 2 && stats.max == max / 2, "Float range is not expected");
+    CHECK (stats.sum == sum / 2 && stats.sumsquares == sumsquares / 4, "Float sums are not expected");
+
+    memset (&stats, 0, sizeof (stats));
+    CHECK (ms_samplestats (&stats, dvalues, count, 'd') == 0, "ms_samplestats() returned an error");
+    CHECK (stats.min == min / 4 && stats.max == max / 4, "Double range is not expected");
+    CHECK (stats.sum == sum / 4 && stats.sumsquares == sumsquares / 16,
+           "Double sums are not expected");
+  }
+
+  /* Integer sums beyond 32 bits are exact */
+  for (idx = 0; idx < 13; idx++)
+    ivalues[idx] = INT32_MIN;
+
+  memset (&stats, 0, sizeof (stats));
+  CHECK (ms_samplestats (&stats, ivalues, 13, 'i') == 0, "ms_samplestats() returned an error");
+  CHECK (stats.min == INT32_MIN && stats.max == INT32_MIN, "Integer range is not expected");
+  CHECK (stats.sum == 13.0 * INT32_MIN, "Integer sum is not expected");
+}
+
+TEST (tracelist, segmentstats)
+{
+  MS3TraceList *mstl = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3SampleStats stats = {0};
+  int32_t samples[4] = {3, -2, 7, 0};
+  int64_t packedsamples = 0;
+  int rv;
+
+  /* Accumulate statistics over multiple calls */
+  CHECK (ms_samplestats (&stats, samples, 2, 'i') == 0, "ms_samplestats() returned an error");
+  CHECK (ms_samplestats (&stats, samples + 2, 2, 'i') == 0, "ms_samplestats() returned an error");
+  CHECK (stats.count == 4, "stats.count is not expected 4");
+  CHECK (stats.min == -2.0, "stats.min is not expected -2");
+  CHECK (stats.max == 7.0, "stats.max is not expected 7");
+  CHECK (stats.sum == 8.0, "stats.sum is not expected 8");
+  CHECK (stats.sumsquares == 62.0, "stats.sumsquares is not expected 62");
+  CHECK (stats.mean == 2.0, "stats.mean is not expected 2");
+  CHECK (ms_samplestats (&stats, "text", 4, 't') == -1, "ms_samplestats() accepted text samples");
+
+  /* Records in mixed order are appended, prepended and segments merged */
+  rv = ms3_readtracelist (&mstl, "data/testdata-oneseries-mixedlengths-mixedorder.mseed3", NULL, 0,
+                          MSF_UNPACKDATA | MSF_SEGMENTSTATS, 0);
+  CHECK (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+  REQUIRE (mstl != NULL && mstl->traces.next[0] != NULL, "ms3_readtracelist() did not populate 'mstl'");
+
+  seg = mstl->traces.next[0]->first;
+  REQUIRE (seg->stats != NULL, "seg->stats is not populated");
+  CHECK (seg->stats->count == 3952, "seg->stats->count is not expected 3952");
+  CHECK (segstats_match (seg), "Segment statistics do not match all samples");
+
+  /* Packing without flushing removes packed samples from the segment */
+  rv = (int)mstl3_pack (mstl, discard_record, NULL, 512, DE_STEIM2, &packedsamples, 0, 0, NULL);
+  CHECK (rv > 0, "mstl3_pack() did not pack records");
+  REQUIRE (mstl->traces.next[0] != NULL, "Trace ID was removed by packing");
+
+  seg = mstl->traces.next[0]->first;
+  CHECK (seg->numsamples == 3952 - packedsamples, "Packed samples were not removed");
+  CHECK (segstats_match (seg), "Segment statistics do not match samples after packing");
+
+  CHECK (mstl3_convertsamples (seg, 'd', 0) == 0, "mstl3_convertsamples() returned an error");
+  CHECK (segstats_match (seg), "Segment statistics do not match samples after conversion");
+
+  mstl3_free (&mstl, 0);
+
+  /* Without the flag no statistics are maintained */
+  rv = ms3_readtracelist (&mstl, "data/testdata-oneseries-mixedlengths-mixedorder.mseed3", NULL, 0,
+                          MSF_UNPACKDATA, 0);
+  REQUIRE (rv == MS_NOERROR && mstl != NULL, "ms3_readtracelist() did not populate 'mstl'");
+  CHECK (mstl->traces.next[0]->first->stats == NULL, "seg->stats is unexpectedly populated");
+  mstl3_free (&mstl, 0);
+}
+
+TEST (tracelist, envelope)
+{
+  MS3TraceList *mstl = NULL;
+  MS3TraceList *recmstl = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3Envelope *env = NULL;
+  MS3Envelope *partenv = NULL;
+  MS3Envelope *recenv = NULL;
+  MS3Envelope *fileenv = NULL;
+  MS3SampleStats stats = {0};
+  const double *min = NULL;
+  const double *max = NULL;
+  const double *partmin = NULL;
+  const double *partmax = NULL;
+  double pixelmin[100];
+  double pixelmax[100];
+  int64_t bucketsamples;
+  int64_t buckets;
+  int64_t idx;
+  int level;
+  int rv;
+
+  const char *path = "data/testdata-oneseries-mixedlengths-mixedorder.mseed3";
+  const char *envpath = "testdata-envelope.msev";
+
+  rv = ms3_readtracelist (&mstl, path, NULL, 0, MSF_UNPACKDATA, 0);
+  REQUIRE (rv == MS_NOERROR && mstl != NULL, "ms3_readtracelist() did not populate 'mstl'");
+  seg = mstl->traces.next[0]->first;
+  ms_samplestats (&stats, seg->datasamples, seg->numsamples, seg->sampletype);
+
+  /* Envelope of all samples, 3952 samples in buckets of 16 need 9 levels */
+  CHECK (mstl3_envelope_update (&env, mstl->traces.next[0], seg, 16, 0) == 3952,
+         "mstl3_envelope_update() did not add 3952 samples");
+  REQUIRE (env != NULL, "mstl3_envelope_update() did not allocate envelope");
+  CHECK (ms3_envelope_level (env, 0, &bucketsamples, NULL, NULL) == 247,
+         "Level 0 does not have 247 buckets");
+  CHECK (bucketsamples == 16, "Level 0 buckets do not have 16 samples");
+  CHECK (ms3_envelope_level (env, 8, &bucketsamples, &min, &max) == 1,
+         "Level 8 does not have a single bucket");
+  CHECK (bucketsamples == 4096, "Level 8 buckets do not have 4096 samples");
+  CHECK (min[0] == stats.min && max[0] == stats.max, "Top level does not match sample range");
+  CHECK (ms3_envelope_level (env, 9, NULL, NULL, NULL) == -1, "Level 9 is unexpectedly populated");
+
+  /* Appending in parts produces the same envelope at all levels */
+  partenv = ms3_envelope_init (seg->starttime, seg->samprate, seg->sampletype, 16);
+  REQUIRE (partenv != NULL, "ms3_envelope_init() did not allocate envelope");
+  CHECK (ms3_envelope_append (partenv, seg->datasamples, 5, 'i') == 0, "Append returned error");
+  CHECK (ms3_envelope_append (partenv, (int32_t *)seg->datasamples + 5, 1000, 'i') == 0,
+         "Append returned error");
+  CHECK (ms3_envelope_append (partenv, (int32_t *)seg->datasamples + 1005, 2947, 'i') == 0,
+         "Append returned error");
+  CHECK (ms3_envelope_append (partenv, seg->datasamples, 1, 'f') == -1,
+         "Append of mismatched sample type did not fail");
+
+  for (level = 0; (buckets = ms3_envelope_level (env, level, NULL, &min, &max)) > 0; level++)
+  {
+    CHECK (ms3_envelope_level (partenv, level, NULL, &partmin, &partmax) == buckets,
+           "Incremental envelope bucket count does not match");
+    for (idx = 0; idx < buckets; idx++)
+      CHECK (partmin[idx] == min[idx] && partmax[idx] == max[idx],
+             "Incremental envelope buckets do not match");
+  }
+
+  /* An envelope from a record list matches one from the data samples */
+  rv = ms3_readtracelist (&recmstl, path, NULL, 0, MSF_RECORDLIST, 0);
+  REQUIRE (rv == MS_NOERROR && recmstl != NULL, "ms3_readtracelist() did not populate 'recmstl'");
+  CHECK (mstl3_envelope_update (&recenv, recmstl->traces.next[0], recmstl->traces.next[0]->first,
+                                16, 0) == 3952,
+         "mstl3_envelope_update() from a record list did not add 3952 samples");
+  CHECK (mstl3_envelope_update (&recenv, recmstl->traces.next[0], recmstl->traces.next[0]->first,
+                                16, 0) == 0,
+         "mstl3_envelope_update() of an unchanged segment added samples");
+  buckets = ms3_envelope_level (env, 0, NULL, &min, &max);
+  CHECK (ms3_envelope_level (recenv, 0, NULL, &partmin, &partmax) == buckets,
+         "Record list envelope bucket count does not match");
+  for (idx = 0; idx < buckets; idx++)
+    CHECK (partmin[idx] == min[idx] && partmax[idx] == max[idx],
+           "Record list envelope buckets do not match");
+
+  /* Query of the full time span covers the range of samples */
+  rv = ms3_envelope_query (env, seg->starttime, seg->endtime + (nstime_t)(NSTMODULUS / seg->samprate), 100,
+                           pixelmin, pixelmax);
+  CHECK (rv == 100, "ms3_envelope_query() did not fill 100 pixels");
+  for (idx = 1; idx < 100; idx++)
+  {
+    if (pixelmin[idx] < pixelmin[0])
+      pixelmin[0] = pixelmin[idx];
+    if (pixelmax[idx] > pixelmax[0])
+      pixelmax[0] = pixelmax[idx];
+  }
+  CHECK (pixelmin[0] == stats.min && pixelmax[0] == stats.max,
+         "Query does not cover the sample range");
+
+  /* Query before the data has no coverage */
+  rv = ms3_envelope_query (env, seg->starttime - (nstime_t)100 * NSTMODULUS, seg->starttime - NSTMODULUS,
+                           10, pixelmin, pixelmax);
+  CHECK (rv == 0, "ms3_envelope_query() before the data filled pixels");
+  CHECK (pixelmin[0] != pixelmin[0], "Pixel without coverage is not NAN");
+
+  /* Round trip through a file */
+  CHECK (ms3_envelope_write (env, envpath) == 0, "ms3_envelope_write() returned an error");
+  fileenv = ms3_envelope_read (envpath);
+  REQUIRE (fileenv != NULL, "ms3_envelope_read() did not return an envelope");
+  for (level = 0; (buckets = ms3_envelope_level (env, level, NULL, &min, &max)) > 0; level++)
+  {
+    CHECK (ms3_envelope_level (fileenv, level, NULL, &partmin, &partmax) == buckets,
+           "Envelope read from file bucket count does not match");
+    for (idx = 0; idx < buckets; idx++)
+      CHECK (partmin[idx] == min[idx] && partmax[idx] == max[idx],
+             "Envelope read from file buckets do not match");
+  }
+  remove (envpath);
+
+  ms3_envelope_free (&env);
+  ms3_envelope_free (&partenv);
+  ms3_envelope_free (&recenv);
+  ms3_envelope_free (&fileenv);
+  CHECK (env == NULL, "ms3_envelope_free() did not reset pointer");
+  mstl3_free (&mstl, 0);
+  mstl3_free (&recmstl, 0);
+}
@@ -593,6 +593,330 @@ TEST (write, mstl3_writemseed)
   msr3_free (&msr);
 }
 
+/* Test writing a trace list with a buffered writer, with a buffer smaller than
+ * the output to exercise flushing, and appending with a second writer.
+ */
+TEST (write, ms3_writer)
+{
+  MS3Record *msr = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3Writer *writer = NULL;
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  int64_t records;
+  int64_t bytes;
+  int64_t rv;
+  FILE *fp;
+  long filesize;
+  int idx;
+
+  for (idx = 0; idx < SINE_DATA_SAMPLES; idx++)
+  {
+    isinedata[idx] = (int32_t)(dsinedata[idx]);
+  }
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  mstl = mstl3_init (mstl);
+  REQUIRE (mstl != NULL, "mstl3_init() returned unexpected NULL");
+
+  msr->reclen = 512;
+  msr->pubversion = 1;
+  msr->starttime = ms_timestr2nstime ("2012-05-12T00:00:00");
+
+  strcpy (msr->sid, "FDSN:XX_TEST__B_H_Z");
+  msr->samprate    = 40.0;
+  msr->numsamples  = SINE_DATA_SAMPLES - 1;
+  msr->datasamples = isinedata;
+  msr->sampletype  = 'i';
+
+  seg = mstl3_addmsr (mstl, msr, 0, 1, 0, NULL);
+  REQUIRE (seg != NULL, "mstl3_addmsr() returned unexpected NULL");
+
+  writer = ms3_writer_open (TESTFILE_STEIM2_V3 ".writer", 1, 1000);
+  REQUIRE (writer != NULL, "ms3_writer_open() returned unexpected NULL");
+  CHECK (ms3_writer_syncpolicy (writer, MSW_SYNC_FLUSH, 0) == 0,
+         "ms3_writer_syncpolicy() returned unexpected value");
+  CHECK (ms3_writer_syncpolicy (writer, MSW_SYNC_BYTES, 0) == -1,
+         "ms3_writer_syncpolicy() accepted a zero interval");
+
+  rv = ms3_writer_writemstl (writer, mstl, 512, DE_STEIM2, 0, 0);
+  REQUIRE (rv == 4, "ms3_writer_writemstl() return unexpected value");
+
+  CHECK (ms3_writer_stats (writer, &records, &bytes) == 0, "ms3_writer_stats() failed");
+  CHECK (records == 4, "ms3_writer_stats() records not 4");
+
+  CHECK (ms3_writer_close (&writer) == 0, "ms3_writer_close() returned unexpected value");
+  CHECK (writer == NULL, "ms3_writer_close() did not reset writer");
+
+  CHECK (!cmpfiles (TESTFILE_STEIM2_V3 ".writer", "data/reference-" TESTFILE_STEIM2_V3),
+         "Steim2 encoding buffered writer mismatch");
+
+  /* Append the same records with a default buffer */
+  writer = ms3_writer_open (TESTFILE_STEIM2_V3 ".writer", 0, 0);
+  REQUIRE (writer != NULL, "ms3_writer_open() returned unexpected NULL");
+
+  rv = ms3_writer_writemsr (writer, msr, MSF_FLUSHDATA, 0);
+  CHECK (rv == 4, "ms3_writer_writemsr() return unexpected value");
+
+  CHECK (ms3_writer_stats (writer, &records, &bytes) == 0, "ms3_writer_stats() failed");
+  CHECK (bytes == 0, "Records written before flush");
+  CHECK (ms3_writer_flush (writer) == 0, "ms3_writer_flush() returned unexpected value");
+  CHECK (ms3_writer_stats (writer, &records, &bytes) == 0, "ms3_writer_stats() failed");
+  CHECK (records == 4, "ms3_writer_stats() records not 4");
+  CHECK (ms3_writer_close (&writer) == 0, "ms3_writer_close() returned unexpected value");
+
+  fp = fopen (TESTFILE_STEIM2_V3 ".writer", "rb");
+  REQUIRE (fp != NULL, "Cannot open written file");
+  fseek (fp, 0, SEEK_END);
+  filesize = ftell (fp);
+  fclose (fp);
+
+  CHECK (filesize == 2 * bytes, "Appended file size is not twice the records written");
+
+  mstl3_free (&mstl, 0);
+
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+}
+
+/* Test writing to an SDS archive, splitting data at a day boundary and
+ * closing files when more than the limit of open files are needed.
+ */
+TEST (write, ms3_archive)
+{
+  MS3Record *msr = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3Archive *archive = NULL;
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  char path[512];
+  const char *day1 = "testdata-archive/2012/XX/TEST/BHZ.D/XX.TEST..BHZ.D.2012.133";
+  const char *day2 = "testdata-archive/2012/XX/TEST/BHZ.D/XX.TEST..BHZ.D.2012.134";
+  nstime_t midnight;
+  int64_t fileopens;
+  int64_t rv;
+  int openfiles;
+  int idx;
+
+  for (idx = 0; idx < SINE_DATA_SAMPLES; idx++)
+  {
+    isinedata[idx] = (int32_t)(dsinedata[idx]);
+  }
+
+  midnight = ms_timestr2nstime ("2012-05-13T00:00:00");
+
+  rv = ms3_archive_expandpath ("testdata-archive/" MS_SDS_PATHFORMAT, "FDSN:XX_TEST__B_H_Z", 1,
+                               midnight - 1, path, sizeof (path));
+  CHECK (rv == (int64_t)strlen (day1), "ms3_archive_expandpath() returned unexpected length");
+  CHECK_STREQ (path, day1);
+
+  rv = ms3_archive_expandpath ("%n.%s.%l.%c %Y-%m-%dT%H:%M:%S %y %v %q %%",
+                               "FDSN:XX_TEST_00_L_H_Z", 3, midnight, path, sizeof (path));
+  CHECK (rv > 0, "ms3_archive_expandpath() returned unexpected value");
+  CHECK_STREQ (path, "XX.TEST.00.LHZ 2012-05-13T00:00:00 12 3 Q %");
+
+  rv = ms3_archive_expandpath ("%Y/%n/%s/%c.D/%n.%s.%l.%c.D.%Y.%j", "FDSN:XX_TEST__B_H_Z", 1,
+                               midnight, path, 10);
+  CHECK (rv == -1, "ms3_archive_expandpath() did not fail for a short buffer");
+
+  /* Codes must not escape the path layout */
+  rv = ms3_archive_expandpath ("%n/%s/%c", "FDSN:XX_../.._00_B_H_Z", 1, midnight, path,
+                               sizeof (path));
+  CHECK (rv == -1, "ms3_archive_expandpath() did not fail for a separator in a code");
+
+  rv = ms3_archive_expandpath ("%n/%s/%c", "FDSN:XX_.._00_B_H_Z", 1, midnight, path, sizeof (path));
+  CHECK (rv == -1, "ms3_archive_expandpath() did not fail for a '..' component");
+
+  rv = ms3_archive_expandpath ("%n/%l./%c", "FDSN:XX_TEST_._B_H_Z", 1, midnight, path,
+                               sizeof (path));
+  CHECK (rv == -1, "ms3_archive_expandpath() did not fail for a '..' component from a code");
+
+  rv = ms3_archive_expandpath ("../%n/%s.%l", "FDSN:XX_..A_._B_H_Z", 1, midnight, path,
+                               sizeof (path));
+  CHECK (rv > 0, "ms3_archive_expandpath() returned unexpected value");
+  CHECK_STREQ (path, "../XX/..A..");
+
+  /* Remove output of any previous run, files are appended to */
+  remove (day1);
+  remove (day2);
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  msr->reclen      = 512;
+  msr->pubversion  = 1;
+  msr->encoding    = DE_STEIM2;
+  msr->starttime   = midnight - MS_EPOCH2NSTIME (5);
+  strcpy (msr->sid, "FDSN:XX_TEST__B_H_Z");
+  msr->samprate    = 40.0;
+  msr->numsamples  = SINE_DATA_SAMPLES - 1;
+  msr->datasamples = isinedata;
+  msr->sampletype  = 'i';
+
+  /* Extra headers with unserialized changes in the cache */
+  REQUIRE (mseh_cache_enable (msr) == 0, "mseh_cache_enable() returned unexpected error");
+  REQUIRE (mseh_set_string (msr, "/Test/Archive", "cached") == 0,
+           "mseh_set_string() returned unexpected error");
+
+  /* Limit to a single open file, the second day must close the first */
+  archive = ms3_archive_init ("testdata-archive/" MS_SDS_PATHFORMAT, 1, 0);
+  REQUIRE (archive != NULL, "ms3_archive_init() returned unexpected NULL");
+
+  rv = ms3_archive_writemsr (archive, msr, 0, 0);
+  CHECK (rv == 5, "ms3_archive_writemsr() returned unexpected value");
+
+  /* Pending changes of the caller remain in the cache after the write */
+  CHECK (mseh_get_string (msr, "/Test/Archive", path, sizeof (path)) == 0,
+         "mseh_get_string() returned unexpected error");
+  CHECK_STREQ (path, "cached");
+
+  CHECK (ms3_archive_stats (archive, &openfiles, &fileopens) == 0, "ms3_archive_stats() failed");
+  CHECK (openfiles == 1, "ms3_archive_stats() open files not 1");
+  CHECK (fileopens == 2, "ms3_archive_stats() file opens not 2");
+
+  CHECK (ms3_archive_flush (archive) == 0, "ms3_archive_flush() returned unexpected value");
+  CHECK (ms3_archive_close (&archive) == 0, "ms3_archive_close() returned unexpected value");
+  CHECK (archive == NULL, "ms3_archive_close() did not reset archive");
+
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+
+  /* Verify the data were split at midnight */
+  rv = ms3_readtracelist (&mstl, day1, NULL, 0, MSF_UNPACKDATA, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+  REQUIRE (mstl->numtraceids == 1, "Unexpected number of trace IDs");
+  CHECK (mstl->traces.next[0]->first->samplecnt == 200, "First day sample count not 200");
+  CHECK (mstl->traces.next[0]->latest < midnight, "First day data extends past midnight");
+  mstl3_free (&mstl, 0);
+
+  /* Extra headers were written to the records of both days */
+  rv = ms3_readmsr (&msr, day2, 0, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readmsr() did not return expected MS_NOERROR");
+  CHECK (mseh_get_string (msr, "/Test/Archive", path, sizeof (path)) == 0,
+         "mseh_get_string() returned unexpected error");
+  CHECK_STREQ (path, "cached");
+  ms3_readmsr (&msr, NULL, 0, 0);
+
+  rv = ms3_readtracelist (&mstl, day2, NULL, 0, MSF_UNPACKDATA, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readtracelist() did not return expected MS_NOERROR");
+  REQUIRE (mstl->numtraceids == 1, "Unexpected number of trace IDs");
+  CHECK (mstl->traces.next[0]->first->samplecnt == 299, "Second day sample count not 299");
+  CHECK (mstl->traces.next[0]->earliest == midnight, "Second day does not start at midnight");
+  CHECK (((int32_t *)mstl->traces.next[0]->first->datasamples)[0] == isinedata[200],
+         "Second day first sample mismatch");
+  mstl3_free (&mstl, 0);
+}
+
+/* Test reading selected data from an SDS archive, files that would fail to
+ * parse are placed where they must be pruned by name.
+ */
+TEST (write, ms3_readarchive)
+{
+  MS3Record *msr = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3Archive *archive = NULL;
+  MS3Selections *selections = NULL;
+  MS3TraceSeg *seg = NULL;
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  const char *junk[] = {"testdata-sdsread/2012/XX/JUNK/BHZ.D/XX.JUNK..BHZ.D.2012.133",
+                        "testdata-sdsread/2012/XX/TEST/BHZ.D/XX.TEST..BHZ.D.2012.131",
+                        "testdata-sdsread/2012/XX/TEST/BHN.D/XX.TEST..BHN.D.2012.133",
+                        "testdata-sdsread/2012/XX/TEST/BHZ.D/notarchive"};
+  const char *files[] = {"testdata-sdsread/2012/XX/TEST/BHZ.D/XX.TEST..BHZ.D.2012.133",
+                         "testdata-sdsread/2012/XX/TEST/BHZ.D/XX.TEST..BHZ.D.2012.134",
+                         "testdata-sdsread/2012/XX/JUNK/BHZ.D/XX.JUNK..BHZ.D.2012.134",
+                         "testdata-sdsread/2012/XX/TEST/BHN.D/XX.TEST..BHN.D.2012.134"};
+  nstime_t midnight;
+  FILE *fp;
+  int64_t rv;
+  int idx;
+
+  for (idx = 0; idx < SINE_DATA_SAMPLES; idx++)
+  {
+    isinedata[idx] = (int32_t)(dsinedata[idx]);
+  }
+
+  midnight = ms_timestr2nstime ("2012-05-13T00:00:00");
+
+  /* Remove output of any previous run, files are appended to and the
+   * junk files are replaced after writing */
+  for (idx = 0; idx < (int)(sizeof (files) / sizeof (files[0])); idx++)
+    remove (files[idx]);
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  msr->reclen      = 512;
+  msr->pubversion  = 1;
+  msr->encoding    = DE_STEIM2;
+  msr->starttime   = midnight - MS_EPOCH2NSTIME (5);
+  strcpy (msr->sid, "FDSN:XX_TEST__B_H_Z");
+  msr->samprate    = 40.0;
+  msr->numsamples  = SINE_DATA_SAMPLES - 1;
+  msr->datasamples = isinedata;
+  msr->sampletype  = 'i';
+
+  /* Write the selected channel and others that are replaced with junk below */
+  archive = ms3_archive_init ("testdata-sdsread/" MS_SDS_PATHFORMAT, 4, 0);
+  REQUIRE (archive != NULL, "ms3_archive_init() returned unexpected NULL");
+  rv = ms3_archive_writemsr (archive, msr, 0, 0);
+  CHECK (rv == 4, "ms3_archive_writemsr() returned unexpected value");
+  strcpy (msr->sid, "FDSN:XX_JUNK__B_H_Z");
+  CHECK (ms3_archive_writemsr (archive, msr, 0, 0) == 4, "ms3_archive_writemsr() failed");
+  strcpy (msr->sid, "FDSN:XX_TEST__B_H_N");
+  CHECK (ms3_archive_writemsr (archive, msr, 0, 0) == 4, "ms3_archive_writemsr() failed");
+  CHECK (ms3_archive_close (&archive) == 0, "ms3_archive_close() returned unexpected value");
+
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+
+  /* Files that are not miniSEED for other stations, channels, days and names */
+  for (idx = 0; idx < (int)(sizeof (junk) / sizeof (junk[0])); idx++)
+  {
+    fp = fopen (junk[idx], "wb");
+    REQUIRE (fp != NULL, "Cannot create junk file");
+    fputs ("This is not miniSEED\n", fp);
+    fclose (fp);
+  }
+
+  rv = ms3_addselect (&selections, "FDSN:XX_TEST__B_H_Z", midnight - MS_EPOCH2NSTIME (60),
+                      midnight + MS_EPOCH2NSTIME (60), 0);
+  REQUIRE (rv == 0, "ms3_addselect() returned unexpected value");
+
+  rv = ms3_readarchive_selection (&mstl, "testdata-sdsread", MS_SDS_PATHFORMAT, NULL, selections,
+                                  0, MSF_UNPACKDATA | MSF_RECORDLIST, 2, 0);
+  REQUIRE (rv == MS_NOERROR, "ms3_readarchive_selection() did not return MS_NOERROR");
+  REQUIRE (mstl->numtraceids == 1, "Unexpected number of trace IDs");
+  CHECK_STREQ (mstl->traces.next[0]->sid, "FDSN:XX_TEST__B_H_Z");
+
+  /* Segments from both day files are healed into one */
+  seg = mstl->traces.next[0]->first;
+  CHECK (mstl->traces.next[0]->numsegments == 1, "Unexpected number of segments");
+  CHECK (seg->samplecnt == SINE_DATA_SAMPLES - 1, "Unexpected sample count");
+  CHECK (seg->starttime == midnight - MS_EPOCH2NSTIME (5), "Unexpected segment start time");
+  CHECK (((int32_t *)seg->datasamples)[0] == isinedata[0], "First sample mismatch");
+  REQUIRE (seg->recordlist != NULL, "Record list not built");
+  CHECK (seg->recordlist->recordcnt == 4, "Record list count not 4");
+  CHECK (strstr (seg->recordlist->first->filename, "XX.TEST..BHZ.D.2012.133") != NULL,
+         "Unexpected record list file name");
+
+  mstl3_free (&mstl, 0);
+
+  /* No pruning by pattern with a leading wildcard, junk files are read and fail */
+  ms3_freeselections (selections);
+  selections = NULL;
+  rv = ms3_addselect (&selections, "*", NSTUNSET, NSTUNSET, 0);
+  REQUIRE (rv == 0, "ms3_addselect() returned unexpected value");
+
+  rv = ms3_readarchive_selection (&mstl, "testdata-sdsread", MS_SDS_PATHFORMAT, NULL, selections,
+                                  0, 0, 1, 0);
+  CHECK (rv != MS_NOERROR, "ms3_readarchive_selection() did not fail on junk files");
+
+  mstl3_free (&mstl, 0);
+  ms3_freeselections (selections);
+}
+
 /***************************************************************************
  *
  * Internal record handler.  The handler data should be a pointer to
@@ -1523,3 +1847,310 @@ TEST (pack, mstl3_pack_next_rollingbuffer)
 
   mstl3_free (&mstl, 0);
 }
+
+/* Record handler that counts records, the handler data is a pointer to an int64_t */
+static void
+record_handler_count (char *record, int reclen, void *count)
+{
+  (void)record;
+  (void)reclen;
+
+  (*(int64_t *)count)++;
+}
+
+/* Test the real-time packing engine: full records are generated as soon as
+ * they can be filled, streams without enough data are not visited, and partial
+ * records are generated for idle segments and when the oldest buffered data
+ * reach the maximum latency.  Time is driven explicitly.
+ */
+TEST (pack, ms3_streampack)
+{
+  MS3Record msr = MS3Record_INITIALIZER;
+  MS3StreamPacker *packer = NULL;
+  int64_t records = 0;
+  int64_t packedsamples = 0;
+  int64_t segments = 0;
+  int64_t bufferedsamples = 0;
+  int64_t segmentspacked = 0;
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  nstime_t starttime = ms_timestr2nstime ("2012-05-12T00:00:00.123456789Z");
+  nstime_t now = ms_timestr2nstime ("2024-01-01T00:00:00Z");
+  int64_t rv;
+
+  for (int idx = 0; idx < SINE_DATA_SAMPLES; idx++)
+  {
+    isinedata[idx] = (int32_t)(dsinedata[idx]);
+  }
+
+  packer = ms3_streampack_init (512, DE_INT32, 0, 0, NULL, 30, 60);
+  REQUIRE (packer != NULL, "ms3_streampack_init() returned unexpected NULL");
+
+  msr.pubversion = 1;
+  msr.datasamples = isinedata;
+  msr.sampletype = 'i';
+
+  /* Add first half of two traces, full records are generated */
+  strcpy (msr.sid, "FDSN:XX_TEST__H_H_Z");
+  msr.samprate = 100.0;
+  msr.starttime = starttime;
+  msr.numsamples = SINE_DATA_SAMPLES / 2;
+  msr.samplecnt = msr.numsamples;
+  REQUIRE (ms3_streampack_add (packer, &msr, NULL, now) == 0, "ms3_streampack_add() failed");
+
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_Z");
+  msr.samprate = 40.0;
+  REQUIRE (ms3_streampack_add (packer, &msr, NULL, now) == 0, "ms3_streampack_add() failed");
+
+  rv = ms3_streampack_pack (packer, record_handler_count, &records, &packedsamples, 0, now);
+  CHECK (rv == 4, "ms3_streampack_pack() expected 4 records");
+  CHECK (records == 4, "Record handler expected 4 records");
+
+  /* Add second half of the traces and flush all data */
+  strcpy (msr.sid, "FDSN:XX_TEST__H_H_Z");
+  msr.samprate = 100.0;
+  msr.starttime = ms_sampletime (starttime, SINE_DATA_SAMPLES / 2, msr.samprate);
+  msr.datasamples = isinedata + SINE_DATA_SAMPLES / 2;
+  REQUIRE (ms3_streampack_add (packer, &msr, NULL, now) == 0, "ms3_streampack_add() failed");
+
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_Z");
+  msr.samprate = 40.0;
+  msr.starttime = ms_sampletime (starttime, SINE_DATA_SAMPLES / 2, msr.samprate);
+  REQUIRE (ms3_streampack_add (packer, &msr, NULL, now) == 0, "ms3_streampack_add() failed");
+
+  records = 0;
+  rv = ms3_streampack_pack (packer, record_handler_count, &records, &packedsamples, MSF_FLUSHDATA,
+                            now);
+  CHECK (rv == 6, "ms3_streampack_pack() expected 6 records");
+  CHECK (packedsamples == 2 * (SINE_DATA_SAMPLES / 2 + 24), "Flushed samples mismatch");
+
+  ms3_streampack_stats (packer, &segments, &bufferedsamples, &segmentspacked);
+  CHECK (segments == 0, "Expected no buffered segments after flush");
+  CHECK (bufferedsamples == 0, "Expected no buffered samples after flush");
+  CHECK (segmentspacked == 4, "Expected 4 segment packing passes");
+
+  /* Add a few samples to many streams, none are visited when packing */
+  msr.datasamples = isinedata;
+  msr.samprate = 1.0;
+  msr.starttime = starttime;
+  msr.numsamples = 10;
+  msr.samplecnt = msr.numsamples;
+  for (int idx = 0; idx < 200; idx++)
+  {
+    snprintf (msr.sid, sizeof (msr.sid), "FDSN:XX_S%03d__B_H_Z", idx);
+    REQUIRE (ms3_streampack_add (packer, &msr, NULL, now) == 0, "ms3_streampack_add() failed");
+  }
+
+  records = 0;
+  rv = ms3_streampack_pack (packer, record_handler_count, &records, NULL, 0,
+                            now + MS_EPOCH2NSTIME (29));
+  CHECK (rv == 0, "ms3_streampack_pack() expected no records before idle deadline");
+
+  ms3_streampack_stats (packer, &segments, &bufferedsamples, &segmentspacked);
+  CHECK (segments == 200, "Expected 200 buffered segments");
+  CHECK (bufferedsamples == 2000, "Expected 2000 buffered samples");
+  CHECK (segmentspacked == 4, "Expected no segment packing passes for partial records");
+
+  /* Idle segments are flushed */
+  rv = ms3_streampack_pack (packer, record_handler_count, &records, NULL, 0,
+                            now + MS_EPOCH2NSTIME (31));
+  CHECK (rv == 200, "ms3_streampack_pack() expected 200 records for idle segments");
+
+  ms3_streampack_stats (packer, &segments, &bufferedsamples, NULL);
+  CHECK (segments == 0, "Expected no buffered segments after idle flush");
+
+  /* Trickle one sample every 10 seconds, flushed when the first reaches 60 seconds */
+  strcpy (msr.sid, "FDSN:XX_TEST__L_H_Z");
+  msr.samprate = 0.1;
+  msr.numsamples = 1;
+  msr.samplecnt = 1;
+  records = 0;
+  for (int idx = 0; idx <= 6; idx++)
+  {
+    nstime_t updatetime = now + MS_EPOCH2NSTIME (100 + idx * 10);
+
+    msr.starttime = ms_sampletime (starttime, idx, msr.samprate);
+    REQUIRE (ms3_streampack_add (packer, &msr, NULL, updatetime) == 0,
+             "ms3_streampack_add() failed");
+
+    rv = ms3_streampack_pack (packer, record_handler_count, &records, &packedsamples, 0,
+                              updatetime);
+    CHECK (rv == ((idx == 6) ? 1 : 0), "Unexpected records for latency flush");
+  }
+  CHECK (packedsamples == 7, "Expected 7 samples flushed for maximum latency");
+
+  ms3_streampack_free (&packer, &packedsamples);
+  CHECK (packer == NULL, "ms3_streampack_free() did not reset pointer");
+  CHECK (packedsamples == 2 * SINE_DATA_SAMPLES + 2000 + 7, "Total packed samples mismatch");
+}
+
+/* Check that each record of @p buffer has a sample range in the extra headers
+ * matching its decoded samples, and that the original extra headers are retained.
+ * Ranges of double samples, stored with single precision, must bound the samples.
+ * Returns the number of records with a matching range. */
+static int
+check_minmax_records (char *buffer, int64_t length)
+{
+  MS3Record *msr = NULL;
+  int64_t offset = 0;
+  int64_t quality;
+  int64_t imin, imax;
+  double dmin, dmax;
+  double lo = 0.0;
+  double hi = 0.0;
+  int matched = 0;
+
+  while (offset < length &&
+         msr3_parse (buffer + offset, length - offset, &msr, MSF_UNPACKDATA | MSF_VALIDATECRC,
+                     0) == 0)
+  {
+    offset += msr->reclen;
+
+    if (mseh_get_int64 (msr, "/FDSN/Time/Quality", &quality) || quality != 80)
+      break;
+
+    for (int64_t idx = 0; idx < msr->numsamples; idx++)
+    {
+      double value;
+
+      if (msr->sampletype == 'i')
+        value = ((int32_t *)msr->datasamples)[idx];
+      else if (msr->sampletype == 'd')
+        value = ((double *)msr->datasamples)[idx];
+      else
+        value = ((float *)msr->datasamples)[idx];
+
+      lo = (idx == 0 || value < lo) ? value : lo;
+      hi = (idx == 0 || value > hi) ? value : hi;
+    }
+
+    if (msr->sampletype == 'i')
+    {
+      if (mseh_get_int64 (msr, "/LM/Samples/Min", &imin) ||
+          mseh_get_int64 (msr, "/LM/Samples/Max", &imax) || imin != lo || imax != hi)
+        break;
+    }
+    else if (mseh_get_number (msr, "/LM/Samples/Min", &dmin) ||
+             mseh_get_number (msr, "/LM/Samples/Max", &dmax))
+    {
+      break;
+    }
+    else if (msr->sampletype == 'd')
+    {
+      if ((float)dmin > lo || (float)dmax < hi)
+        break;
+    }
+    else if ((float)dmin != (float)lo || (float)dmax != (float)hi)
+    {
+      break;
+    }
+
+    matched++;
+  }
+
+  msr3_free (&msr);
+
+  return matched;
+}
+
+/* Test adding the sample range of each record to extra headers while packing
+ * miniSEED 3, fused into the encoder for Steim and determined from the samples
+ * for other encodings.
+ */
+TEST (pack, msr3_pack_minmax)
+{
+  MS3Record msr = MS3Record_INITIALIZER;
+  MS3RecordPacker *packer = NULL;
+  char extra[] = "{\"FDSN\":{\"Time\":{\"Quality\":80}}}";
+  char *buffer = NULL;
+  char *record = NULL;
+  int32_t reclen;
+  int64_t length;
+  int64_t packedsamples;
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  float fsinedata[SINE_DATA_SAMPLES];
+  double drangedata[] = {0.7, 0.1, 0.3, 0.5};
+  int8_t encodings[] = {DE_STEIM1, DE_STEIM2, DE_INT16, DE_INT32, DE_FLOAT32, DE_FLOAT64};
+  int records;
+  int rv;
+
+  for (int idx = 0; idx < SINE_DATA_SAMPLES; idx++)
+  {
+    isinedata[idx] = (int32_t)(dsinedata[idx] / 100); /* Differences within Steim2 range */
+    fsinedata[idx] = (float)dsinedata[idx];
+  }
+
+  buffer = (char *)malloc (SINE_DATA_SAMPLES * 16 + 10000);
+  REQUIRE (buffer != NULL, "Cannot allocate buffer");
+
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_Z");
+  msr.reclen = 256;
+  msr.pubversion = 1;
+  msr.starttime = ms_timestr2nstime ("2012-05-12T00:00:00Z");
+  msr.samprate = 40.0;
+  msr.numsamples = SINE_DATA_SAMPLES;
+  msr.extra = extra;
+  msr.extralength = (uint16_t)strlen (extra);
+
+  for (size_t idx = 0; idx < sizeof (encodings) / sizeof (encodings[0]); idx++)
+  {
+    msr.encoding = encodings[idx];
+    msr.sampletype = (msr.encoding == DE_FLOAT32) ? 'f' : (msr.encoding == DE_FLOAT64) ? 'd' : 'i';
+    msr.datasamples = (msr.encoding == DE_FLOAT32)   ? (void *)fsinedata
+                      : (msr.encoding == DE_FLOAT64) ? (void *)dsinedata
+                                                     : (void *)isinedata;
+
+    packer = msr3_pack_init (&msr, MSF_FLUSHDATA | MSF_PACKMINMAX, 0);
+    REQUIRE (packer != NULL, "msr3_pack_init() returned unexpected NULL");
+
+    length = 0;
+    records = 0;
+    while ((rv = msr3_pack_next (packer, &record, &reclen)) == 1)
+    {
+      CHECK (reclen <= 256, "Record exceeds maximum record length");
+      memcpy (buffer + length, record, reclen);
+      length += reclen;
+      records++;
+    }
+    CHECK (rv == 0, "msr3_pack_next() returned an error");
+
+    msr3_pack_free (&packer, &packedsamples);
+    CHECK (packedsamples == SINE_DATA_SAMPLES, "Packed sample count mismatch");
+    CHECK (records > 1, "Expected multiple records");
+    CHECK (check_minmax_records (buffer, length) == records,
+           "Sample range extra headers do not match record samples");
+  }
+
+  /* The double range bounds samples whose nearest single precision values do not,
+   * (float)0.1 is above 0.1 and (float)0.7 is below 0.7 */
+  msr.encoding = DE_FLOAT64;
+  msr.sampletype = 'd';
+  msr.datasamples = drangedata;
+  msr.numsamples = 4;
+
+  packer = msr3_pack_init (&msr, MSF_FLUSHDATA | MSF_PACKMINMAX, 0);
+  REQUIRE (packer != NULL, "msr3_pack_init() returned unexpected NULL");
+  REQUIRE (msr3_pack_next (packer, &record, &reclen) == 1, "msr3_pack_next() expected a record");
+  CHECK (check_minmax_records (record, reclen) == 1, "Double sample range does not bound samples");
+  msr3_pack_free (&packer, NULL);
+
+  /* Records of non-finite samples have no range and keep the original extra headers */
+  fsinedata[0] = 1.0f / 0.0f;
+  msr.encoding = DE_FLOAT32;
+  msr.sampletype = 'f';
+  msr.datasamples = fsinedata;
+  msr.numsamples = 10;
+
+  packer = msr3_pack_init (&msr, MSF_FLUSHDATA | MSF_PACKMINMAX, 0);
+  REQUIRE (packer != NULL, "msr3_pack_init() returned unexpected NULL");
+  REQUIRE (msr3_pack_next (packer, &record, &reclen) == 1, "msr3_pack_next() expected a record");
+  CHECK (check_minmax_records (record, reclen) == 0, "Expected no sample range for infinite value");
+
+  MS3Record *parsed = NULL;
+  REQUIRE (msr3_parse (record, reclen, &parsed, 0, 0) == 0, "msr3_parse() failed");
+  CHECK (parsed->extralength == msr.extralength, "Expected original extra headers");
+  CHECK (parsed->samplecnt == 10, "Expected 10 samples");
+  msr3_free (&parsed);
+  msr3_pack_free (&packer, NULL);
+
+  free (buffer);
+}
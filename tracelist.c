@@ -24,19 +24,77 @@
 #include <string.h>
 #include <time.h>
 
+#include "extraheaders.h"
 #include "libmseed.h"
 #include "internalstate.h"
+#include "unpack.h"
+
+/* Shared extra headers entry, extra headers stored inline */
+typedef struct LM_EXTRAENTRY_s
+{
+  struct LM_EXTRAENTRY_s *next; /* Next entry in hash bucket */
+  uint32_t hash;                /* CRC-32C of extra headers */
+  uint64_t refcount;            /* Number of records referencing entry */
+  uint16_t length;              /* Length of extra headers */
+  char extra[];                 /* Extra headers, NULL terminated */
+} LM_EXTRAENTRY;
+
+/* Pool of shared extra headers for a trace list, see MSF_INTERNEXTRA */
+struct LM_EXTRAPOOL_s
+{
+  LM_EXTRAENTRY **buckets; /* Hash buckets */
+  uint32_t bucketcount;    /* Number of buckets, a power of 2 */
+  uint32_t entrycount;     /* Number of entries */
+};
+
+/* Initial number of hash buckets in an extra headers pool */
+#define LM_EXTRAPOOL_BUCKETS 64
+
+/* Key identifying a record added to a trace list, see MSF_SKIPDUPLICATES */
+typedef struct LM_DUPKEY_s
+{
+  uint64_t sidhash;   /* FNV-1a hash of source identifier, 0 for an empty slot */
+  nstime_t starttime; /* Record start time */
+  int64_t samplecnt;  /* Record sample count */
+  uint32_t payload;   /* Version 3 record CRC or CRC-32C of data payload */
+  uint8_t pubversion; /* Publication version when split by version */
+} LM_DUPKEY;
+
+/* Set of record keys for a trace list, open addressing with linear probing */
+struct LM_DUPSET_s
+{
+  LM_DUPKEY *keys;    /* Key slots */
+  uint32_t slotcount; /* Number of slots, a power of 2 */
+  uint32_t keycount;  /* Number of keys */
+};
+
+/* Initial number of slots in a duplicate record set */
+#define LM_DUPSET_SLOTS 1024
 
 static MS3TraceSeg *lm_msr2seg (const MS3Record *msr, nstime_t endtime);
 static MS3TraceSeg *lm_addmsrtoseg (MS3TraceSeg *seg, const MS3Record *msr, nstime_t endtime,
                                     int8_t whence);
 static MS3TraceSeg *lm_addsegtoseg (MS3TraceSeg *seg1, MS3TraceSeg *seg2);
+static void lm_sort_segment (MS3TraceID *id, MS3TraceSeg *seg);
+static MS3TraceSeg *lm_addmsr_bestversion (MS3TraceList *mstl, const MS3Record *msr,
+                                           int8_t autoheal, uint32_t flags,
+                                           const MS3Tolerance *tolerance);
+static int lm_merge_segment (MS3TraceList *mstl, MS3TraceID *id, MS3TraceSeg *seg,
+                             int8_t autoheal, const MS3Tolerance *tolerance,
+                             int8_t freeprvtptr);
 static MS3RecordPtr *lm_add_recordptr (MS3TraceSeg *seg, const MS3Record *msr, nstime_t endtime,
-                                       int8_t whence);
-
-static void lm_free_segment_memory (MS3TraceSeg *seg, int8_t freeprvtptr);
-static int lm_remove_segment (MS3TraceList *mstl, MS3TraceID *id, MS3TraceSeg *seg,
-                              int8_t freeprvtptr);
+                                       int8_t whence, struct LM_EXTRAPOOL_s *extrapool);
+
+static char *lm_extrapool_intern (struct LM_EXTRAPOOL_s *extrapool, const char *extra,
+                                  uint16_t length);
+static void lm_extrapool_release (struct LM_EXTRAPOOL_s *extrapool, MS3Record *msr);
+static int lm_extrapool_rehash (struct LM_EXTRAPOOL_s *extrapool, uint32_t newcount);
+static void lm_extrapool_absorb (MS3TraceList *mstl, MS3TraceList *src);
+static int lm_dupset_init (MS3TraceList *mstl);
+static int lm_dupset_insert (struct LM_DUPSET_s *dupset, const LM_DUPKEY *key);
+static int lm_segstats_reset (MS3TraceSeg *seg);
+static int lm_segstats_add (MS3TraceSeg *seg, int64_t offset, int64_t count);
+static void lm_free_segment_memory (MS3TraceList *mstl, MS3TraceSeg *seg, int8_t freeprvtptr);
 static uint32_t lm_lcg_r (uint64_t *state);
 static uint8_t lm_random_height (uint8_t maximum, uint64_t *state);
 
@@ -122,7 +180,7 @@ mstl3_free (MS3TraceList **ppmstl, int8_t freeprvtptr)
       nextseg = seg->next;
 
       /* Free all memory associated with the segment */
-      lm_free_segment_memory (seg, freeprvtptr);
+      lm_free_segment_memory (*ppmstl, seg, freeprvtptr);
 
       seg = nextseg;
     }
@@ -136,6 +194,29 @@ mstl3_free (MS3TraceList **ppmstl, int8_t freeprvtptr)
     id = nextid;
   }
 
+  /* Free shared extra headers pool, all entries have been released */
+  if ((*ppmstl)->extrapool)
+  {
+    libmseed_memory.free ((*ppmstl)->extrapool->buckets);
+    libmseed_memory.free ((*ppmstl)->extrapool);
+  }
+
+  /* Free set of records added */
+  if ((*ppmstl)->dupset)
+  {
+    libmseed_memory.free ((*ppmstl)->dupset->keys);
+    libmseed_memory.free ((*ppmstl)->dupset);
+  }
+
+  /* Free file names referenced by record lists */
+  while ((*ppmstl)->filenames)
+  {
+    struct LM_FILENAMES_s *next = (*ppmstl)->filenames->next;
+
+    libmseed_memory.free ((*ppmstl)->filenames);
+    (*ppmstl)->filenames = next;
+  }
+
   libmseed_memory.free (*ppmstl);
 
   *ppmstl = NULL;
@@ -309,12 +390,57 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
   double sampratehz;
   double sampratetol = -1.0;
 
+  struct LM_EXTRAPOOL_s *extrapool = NULL;
+
   if (!mstl || !msr)
   {
     ms_log (2, "%s(): Required input not defined: 'mstl' or 'msr'\n", __func__);
     return NULL;
   }
 
+  /* Keep only the highest publication version of overlapping data */
+  if (flags & MSF_BESTVERSION)
+  {
+    if (pprecptr)
+    {
+      ms_log (2, "%s(): MSF_BESTVERSION cannot be combined with record lists\n", __func__);
+      return NULL;
+    }
+
+    return lm_addmsr_bestversion (mstl, msr, autoheal, flags, tolerance);
+  }
+
+  /* Allocate shared extra headers pool if requested for record lists */
+  if (pprecptr && (flags & MSF_INTERNEXTRA))
+  {
+    if (!mstl->extrapool)
+    {
+      if (!(mstl->extrapool = (struct LM_EXTRAPOOL_s *)libmseed_memory.malloc (
+                sizeof (struct LM_EXTRAPOOL_s))))
+      {
+        ms_log (2, "Error allocating memory\n");
+        return NULL;
+      }
+
+      mstl->extrapool->bucketcount = LM_EXTRAPOOL_BUCKETS;
+      mstl->extrapool->entrycount = 0;
+      mstl->extrapool->buckets = (LM_EXTRAENTRY **)libmseed_memory.malloc (
+          sizeof (LM_EXTRAENTRY *) * LM_EXTRAPOOL_BUCKETS);
+
+      if (!mstl->extrapool->buckets)
+      {
+        ms_log (2, "Error allocating memory\n");
+        libmseed_memory.free (mstl->extrapool);
+        mstl->extrapool = NULL;
+        return NULL;
+      }
+
+      memset (mstl->extrapool->buckets, 0, sizeof (LM_EXTRAENTRY *) * LM_EXTRAPOOL_BUCKETS);
+    }
+
+    extrapool = mstl->extrapool;
+  }
+
   /* Calculate end time for MS3Record */
   if ((endtime = msr3_endtime (msr)) == NSTERROR)
   {
@@ -327,7 +453,9 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
   int8_t pubversion = (flags & MSF_SPLITISVERSION) ? splitversion : msr->pubversion;
 
   /* Search for matching trace ID */
+  LM_METRIC_START (idstart);
   id = mstl3_findID (mstl, msr->sid, (splitversion) ? pubversion : 0, previd);
+  LM_METRIC_STOP (lm_metrics.idlookup, idstart);
 
   /* If no matching ID was found create new MS3TraceID and MS3TraceSeg entries */
   if (!id)
@@ -353,7 +481,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
     id->first = id->last = seg;
 
     /* Add MS3RecordPtr if requested */
-    if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 1)))
+    if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 1, extrapool)))
     {
       return NULL;
     }
@@ -417,7 +545,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
         id->latest = endtime;
 
       /* Add MS3RecordPtr if requested */
-      if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 1)))
+      if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 1, extrapool)))
         return NULL;
     }
     /* Record coverage is after all other coverage */
@@ -436,7 +564,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
         id->latest = endtime;
 
       /* Add MS3RecordPtr if requested */
-      if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 0)))
+      if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 0, extrapool)))
         return NULL;
     }
     /* Record coverage is before all other coverage */
@@ -455,7 +583,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
         id->earliest = msr->starttime;
 
       /* Add MS3RecordPtr if requested */
-      if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 0)))
+      if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 0, extrapool)))
         return NULL;
     }
     /* Record coverage fits at beginning of first segment */
@@ -472,7 +600,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
         id->earliest = msr->starttime;
 
       /* Add MS3RecordPtr if requested */
-      if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 2)))
+      if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 2, extrapool)))
         return NULL;
     }
     /* Search complete segment list for matches */
@@ -483,6 +611,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
       segafter = NULL;  /* The first segment start that matches the record end (within tolerance) */
       followseg = NULL; /* The segment with latest start time before the record start */
       searchseg = id->first;
+      LM_METRIC_START (searchstart);
       while (searchseg)
       {
         /* Skip segments with no time coverage, these cannot be extended */
@@ -533,6 +662,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
 
         searchseg = searchseg->next;
       } /* Done looping through segments */
+      LM_METRIC_STOP (lm_metrics.segmentsearch, searchstart);
 
       /* Add MS3Record coverage to end of segment before */
       if (segbefore)
@@ -543,7 +673,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
         }
 
         /* Add MS3RecordPtr if requested */
-        if (pprecptr && !(*pprecptr = lm_add_recordptr (segbefore, msr, endtime, 1)))
+        if (pprecptr && !(*pprecptr = lm_add_recordptr (segbefore, msr, endtime, 1, extrapool)))
         {
           return NULL;
         }
@@ -568,7 +698,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
             segafter->next->prev = segafter->prev;
 
           /* Free all memory associated with the segment after that has been merged */
-          lm_free_segment_memory (segafter, 1);
+          lm_free_segment_memory (mstl, segafter, 1);
 
           id->numsegments -= 1;
         }
@@ -584,7 +714,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
         }
 
         /* Add MS3RecordPtr if requested */
-        if (pprecptr && !(*pprecptr = lm_add_recordptr (segafter, msr, endtime, 2)))
+        if (pprecptr && !(*pprecptr = lm_add_recordptr (segafter, msr, endtime, 2, extrapool)))
         {
           return NULL;
         }
@@ -601,7 +731,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
         }
 
         /* Add MS3RecordPtr if requested */
-        if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 0)))
+        if (pprecptr && !(*pprecptr = lm_add_recordptr (seg, msr, endtime, 0, extrapool)))
         {
           return NULL;
         }
@@ -645,75 +775,373 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
   } /* End of adding coverage to matching ID */
 
   /* Sort modified segment into place, logic above should limit these to few shifts if any */
-  while (seg->next &&
-         (seg->starttime > seg->next->starttime ||
-          (seg->starttime == seg->next->starttime && seg->endtime < seg->next->endtime)))
+  lm_sort_segment (id, seg);
+
+  /* Store update time at seg.prvtptr, allocate if needed */
+  if (seg && flags & MSF_PPUPDATETIME)
   {
-    /* Move segment down list, swap seg and seg->next */
-    segafter = seg->next;
+    if (!seg->prvtptr)
+    {
+      if (!(seg->prvtptr = libmseed_memory.malloc (sizeof (nstime_t))))
+      {
+        ms_log (2, "Error allocating memory\n");
+        return NULL;
+      }
+    }
 
-    if (seg->prev)
-      seg->prev->next = segafter;
+    /* Set to current time */
+    *(nstime_t *)seg->prvtptr = lmp_systemtime ();
+  }
 
-    if (segafter->next)
-      segafter->next->prev = seg;
+  /* Start running sample statistics for the segment if requested */
+  if (seg && flags & MSF_SEGMENTSTATS && !seg->stats)
+  {
+    if (lm_segstats_reset (seg))
+      return NULL;
+  }
 
-    segafter->prev = seg->prev;
-    seg->prev = segafter;
-    seg->next = segafter->next;
-    segafter->next = seg;
+  return seg;
+} /* End of _mstl3_addmsr_impl() */
 
-    /* Reset first and last segment pointers if replaced */
-    if (id->first == seg)
-      id->first = segafter;
+/***************************************************************************
+ * Find the first trace ID, the lowest publication version, for a
+ * source identifier.
+ *
+ * @returns the trace ID or NULL if none match.
+ ***************************************************************************/
+static MS3TraceID *
+lm_first_versionID (MS3TraceList *mstl, const char *sid)
+{
+  MS3TraceID *id = &(mstl->traces);
+  int level;
 
-    if (id->last == segafter)
-      id->last = seg;
+  for (level = MSTRACEID_SKIPLIST_HEIGHT - 1; level >= 0; level--)
+  {
+    while (id->next[level] && strcmp (id->next[level]->sid, sid) < 0)
+      id = id->next[level];
   }
-  while (seg->prev &&
-         (seg->starttime < seg->prev->starttime ||
-          (seg->starttime == seg->prev->starttime && seg->endtime > seg->prev->endtime)))
+
+  id = id->next[0];
+
+  return (id && !strcmp (id->sid, sid)) ? id : NULL;
+} /* End of lm_first_versionID() */
+
+/***************************************************************************
+ * Evict data samples in a time range from the segments of a trace ID.
+ *
+ * Samples within half a sample period of the range are removed from
+ * each segment, removing, trimming or splitting the segment.  Segments
+ * that are partially decoded are not modified.
+ *
+ * The trace ID is removed from the list and freed when no segments
+ * remain.
+ *
+ * @returns 1 if the trace ID was removed, 0 if not and -1 on error.
+ ***************************************************************************/
+static int
+lm_evict_span (MS3TraceList *mstl, MS3TraceID *id, nstime_t starttime, nstime_t endtime)
+{
+  MS3TraceSeg *seg = NULL;
+  MS3TraceSeg *nextseg = NULL;
+  MS3TraceSeg *newseg = NULL;
+  nstime_t nsperiod;
+  nstime_t low;
+  nstime_t high;
+  int64_t first;
+  int64_t last;
+  int samplesize = 0;
+
+  for (seg = id->first; seg; seg = nextseg)
   {
-    /* Move segment up list, swap seg and seg->prev */
-    segbefore = seg->prev;
+    nextseg = seg->next;
 
-    if (seg->next)
-      seg->next->prev = segbefore;
+    if (!SEGMENT_HAS_TIME_COVERAGE (seg) || seg->samprate < 0.0 ||
+        (seg->numsamples > 0 && seg->numsamples != seg->samplecnt))
+      continue;
 
-    if (segbefore->prev)
-      segbefore->prev->next = seg;
+    nsperiod = (nstime_t)(NSTMODULUS / seg->samprate + 0.5);
 
-    segbefore->next = seg->next;
-    seg->next = segbefore;
-    seg->prev = segbefore->prev;
-    segbefore->prev = seg;
+    /* Evicted range, exclusive, and index range of samples within it */
+    low = starttime - nsperiod / 2;
+    high = endtime + nsperiod / 2;
 
-    /* Reset first and last segment pointers if replaced */
-    if (id->first == segbefore)
-      id->first = seg;
+    if (seg->starttime >= high || seg->endtime <= low)
+      continue;
 
-    if (id->last == seg)
-      id->last = segbefore;
+    first = (low < seg->starttime) ? 0 : (low - seg->starttime) / nsperiod + 1;
+    last = (high - seg->starttime + nsperiod - 1) / nsperiod;
+
+    if (last > seg->samplecnt)
+      last = seg->samplecnt;
+
+    if (first >= last)
+      continue;
+
+    if (seg->numsamples > 0 && !(samplesize = ms_samplesize (seg->sampletype)))
+    {
+      ms_log (2, "Unknown sample size for sample type: %c\n", seg->sampletype);
+      return -1;
+    }
+
+    /* Remove segment entirely */
+    if (first == 0 && last == seg->samplecnt)
+    {
+      if (id->numsegments == 1)
+        return (lm_remove_segment (mstl, id, seg, 1)) ? -1 : 1;
+
+      if (lm_remove_segment (mstl, id, seg, 1))
+        return -1;
+
+      continue;
+    }
+
+    newseg = NULL;
+
+    /* Split segment, moving samples after the range to a new segment */
+    if (first > 0 && last < seg->samplecnt)
+    {
+      if ((newseg = (MS3TraceSeg *)libmseed_memory.malloc (sizeof (MS3TraceSeg))) == NULL)
+      {
+        ms_log (2, "Error allocating memory\n");
+        return -1;
+      }
+
+      memset (newseg, 0, sizeof (MS3TraceSeg));
+      newseg->starttime = ms_sampletime (seg->starttime, last, seg->samprate);
+      newseg->endtime = seg->endtime;
+      newseg->samprate = seg->samprate;
+      newseg->samplecnt = seg->samplecnt - last;
+      newseg->sampletype = seg->sampletype;
+
+      if (seg->numsamples > 0)
+      {
+        newseg->datasize = (size_t)newseg->samplecnt * samplesize;
+
+        if ((newseg->datasamples = libmseed_memory.malloc (newseg->datasize)) == NULL)
+        {
+          ms_log (2, "Error allocating memory\n");
+          libmseed_memory.free (newseg);
+          return -1;
+        }
+
+        memcpy (newseg->datasamples, (char *)seg->datasamples + (last * samplesize),
+                newseg->datasize);
+        newseg->numsamples = newseg->samplecnt;
+      }
+
+      if (seg->stats && lm_segstats_reset (newseg))
+      {
+        lm_free_segment_memory (mstl, newseg, 0);
+        return -1;
+      }
+
+      newseg->prev = seg;
+      newseg->next = seg->next;
+      if (seg->next)
+        seg->next->prev = newseg;
+      else
+        id->last = newseg;
+      seg->next = newseg;
+      id->numsegments++;
+
+      last = seg->samplecnt;
+    }
+
+    /* Trim end of segment */
+    if (last == seg->samplecnt)
+    {
+      seg->endtime = ms_sampletime (seg->starttime, first - 1, seg->samprate);
+      seg->samplecnt = first;
+
+      if (seg->numsamples > 0)
+        seg->numsamples = first;
+    }
+    /* Trim start of segment */
+    else
+    {
+      if (seg->numsamples > 0)
+      {
+        memmove (seg->datasamples, (char *)seg->datasamples + (last * samplesize),
+                 (size_t)(seg->samplecnt - last) * samplesize);
+        seg->numsamples -= last;
+      }
+
+      seg->starttime = ms_sampletime (seg->starttime, last, seg->samprate);
+      seg->samplecnt -= last;
+
+      lm_sort_segment (id, seg);
+    }
+
+    if (seg->stats && lm_segstats_reset (seg))
+      return -1;
   }
 
-  /* Store update time at seg.prvtptr, allocate if needed */
-  if (seg && flags & MSF_PPUPDATETIME)
+  if (id->first)
   {
-    if (!seg->prvtptr)
+    id->earliest = id->first->starttime;
+    id->latest = id->first->endtime;
+
+    for (seg = id->first->next; seg; seg = seg->next)
     {
-      if (!(seg->prvtptr = libmseed_memory.malloc (sizeof (nstime_t))))
+      if (seg->starttime < id->earliest)
+        id->earliest = seg->starttime;
+      if (seg->endtime > id->latest)
+        id->latest = seg->endtime;
+    }
+  }
+
+  return 0;
+} /* End of lm_evict_span() */
+
+/***************************************************************************
+ * Add a record to a trace list keeping only the highest publication
+ * version of data for each time span, see ::MSF_BESTVERSION.
+ *
+ * Each publication version of a source identifier is kept in its own
+ * trace ID.  A record that is entirely covered by a higher version is
+ * not added.  Otherwise the record is added and the samples it covers
+ * are evicted from lower versions, and samples of the record covered
+ * by higher versions are evicted from the record's version.
+ *
+ * Record lists cannot be maintained through eviction, the record is
+ * rejected if any version of its source identifier has a record list.
+ *
+ * @returns the segment containing the record's data, or a segment of
+ * a higher version that supersedes it, or NULL on error.
+ ***************************************************************************/
+static MS3TraceSeg *
+lm_addmsr_bestversion (MS3TraceList *mstl, const MS3Record *msr, int8_t autoheal,
+                       uint32_t flags, const MS3Tolerance *tolerance)
+{
+  MS3TraceID *id = NULL;
+  MS3TraceID *nextid = NULL;
+  MS3TraceID *recordid = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3TraceSeg *higherseg = NULL;
+  MS3TraceSeg *superseding = NULL;
+  int8_t overlapping = 0;
+  nstime_t endtime;
+  nstime_t nsperiod;
+  nstime_t overlapstart;
+  nstime_t overlapend;
+  uint8_t pubversion;
+
+  if ((endtime = msr3_endtime (msr)) == NSTERROR)
+  {
+    ms_log (2, "Error calculating record end time\n");
+    return NULL;
+  }
+
+  nsperiod = msr3_nsperiod (msr);
+
+  /* Records with no time coverage are added as for any version */
+  if (msr->samplecnt <= 0 || nsperiod <= 0)
+    return _mstl3_addmsr_impl (mstl, msr, NULL, 1, autoheal,
+                               flags & ~(MSF_BESTVERSION | MSF_SPLITISVERSION), tolerance);
+
+  /* Skip record if entirely covered by a single segment of a higher version */
+  for (id = lm_first_versionID (mstl, msr->sid); id && !strcmp (id->sid, msr->sid);
+       id = id->next[0])
+  {
+    if (id->pubversion <= msr->pubversion || id->earliest > msr->starttime ||
+        id->latest < endtime)
+      continue;
+
+    for (seg = id->first; seg; seg = seg->next)
+    {
+      if (SEGMENT_HAS_TIME_COVERAGE (seg) && seg->starttime - nsperiod / 2 <= msr->starttime &&
+          seg->endtime + nsperiod / 2 >= endtime)
+        return seg;
+    }
+  }
+
+  /* Eviction cannot maintain record lists */
+  for (id = lm_first_versionID (mstl, msr->sid); id && !strcmp (id->sid, msr->sid);
+       id = id->next[0])
+  {
+    for (seg = id->first; seg; seg = seg->next)
+    {
+      if (seg->recordlist)
       {
-        ms_log (2, "Error allocating memory\n");
+        ms_log (2, "%s: Cannot keep best version of data with record lists\n", msr->sid);
         return NULL;
       }
     }
+  }
 
-    /* Set to current time */
-    *(nstime_t *)seg->prvtptr = lmp_systemtime ();
+  seg = _mstl3_addmsr_impl (mstl, msr, NULL, 1, autoheal,
+                            flags & ~(MSF_BESTVERSION | MSF_SPLITISVERSION), tolerance);
+
+  if (!seg)
+    return NULL;
+
+  pubversion = msr->pubversion;
+
+  /* Evict coverage of the record from lower versions, note overlap with higher versions */
+  for (id = lm_first_versionID (mstl, msr->sid); id && !strcmp (id->sid, msr->sid); id = nextid)
+  {
+    nextid = id->next[0];
+
+    if (id->earliest > endtime || id->latest < msr->starttime)
+      continue;
+
+    if (id->pubversion < pubversion)
+    {
+      if (lm_evict_span (mstl, id, msr->starttime, endtime) < 0)
+        return NULL;
+    }
+    else if (id->pubversion > pubversion)
+    {
+      overlapping = 1;
+    }
   }
 
-  return seg;
-} /* End of _mstl3_addmsr_impl() */
+  if (!overlapping)
+    return seg;
+
+  /* Evict coverage of higher versions from the record's version, higher
+   * version trace IDs follow the record's version and are not modified */
+  for (id = lm_first_versionID (mstl, msr->sid); id && !strcmp (id->sid, msr->sid);
+       id = id->next[0])
+  {
+    if (id->pubversion <= pubversion)
+      continue;
+
+    for (higherseg = id->first; higherseg; higherseg = higherseg->next)
+    {
+      if (!SEGMENT_HAS_TIME_COVERAGE (higherseg) || higherseg->starttime > endtime ||
+          higherseg->endtime < msr->starttime)
+        continue;
+
+      overlapstart = (higherseg->starttime > msr->starttime) ? higherseg->starttime
+                                                               : msr->starttime;
+      overlapend = (higherseg->endtime < endtime) ? higherseg->endtime : endtime;
+
+      superseding = higherseg;
+
+      if ((recordid = mstl3_findID (mstl, msr->sid, pubversion, NULL)) == NULL)
+        break;
+
+      if (lm_evict_span (mstl, recordid, overlapstart, overlapend) < 0)
+        return NULL;
+    }
+  }
+
+  if (!superseding)
+    return seg;
+
+  /* Return a segment with remaining data of the record or the superseding segment */
+  if ((recordid = mstl3_findID (mstl, msr->sid, pubversion, NULL)) != NULL)
+  {
+    for (seg = recordid->first; seg; seg = seg->next)
+    {
+      if (seg->starttime <= endtime && seg->endtime >= msr->starttime)
+        return seg;
+    }
+  }
+
+  return superseding;
+} /* End of lm_addmsr_bestversion() */
 
 /** ************************************************************************
  * @brief Add data coverage from an ::MS3Record to a ::MS3TraceList
@@ -747,6 +1175,28 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
  * trace list they will be represented as empty segments with no time coverage
  * for informational purposes.
  *
+ * If the ::MSF_BESTVERSION flag is set in @p flags, only the highest
+ * publication version of data is kept for any time span.  Each version is kept
+ * in its own ::MS3TraceID as if @p splitversion were set (and
+ * ::MSF_SPLITISVERSION is ignored).  A record entirely covered by a higher
+ * version is not added and the superseding segment is returned.  Otherwise the
+ * samples covered by the record are evicted from lower versions, and samples
+ * of the record covered by higher versions are evicted from its version, as
+ * data are added, trimming or splitting segments.  Segments and trace IDs with
+ * no remaining data are removed and their private pointers freed.  Eviction
+ * requires either all or no data samples of a segment to be decoded.  Record
+ * lists are not maintained through eviction, so ::MSF_BESTVERSION is an error
+ * with a record list pointer, e.g. with ::MSF_RECORDLIST when reading, or
+ * when any version of the record's source identifier has a record list.
+ *
+ * If the ::MSF_SEGMENTSTATS flag is set in @p flags, running statistics of
+ * the data samples of each modified segment are maintained at
+ * ::MS3TraceSeg.stats, see ::MS3SampleStats.  Statistics are accumulated over
+ * only the samples added to a segment and combined when segments are merged.
+ * They are recalculated when samples are removed, e.g. by packing with
+ * mstl3_pack() or eviction with ::MSF_BESTVERSION, and are freed by
+ * mstl3_free().
+ *
  * If the ::MSF_PPUPDATETIME flag is set in @p flags, the update time of the
  * segment will be stored at ::MS3TraceSeg.prvtptr.  This update time is used to
  * determine if the segment is idle and should be flushed by
@@ -761,6 +1211,8 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
  * @parblock
  *  - @c ::MSF_PPUPDATETIME : Store update time (as nstime_t) at ::MS3TraceSeg.prvtptr
  *  - @c ::MSF_SPLITISVERSION : Use @p splitversion as the version, otherwise use msr->pubversion
+ *  - @c ::MSF_BESTVERSION : Keep only the highest publication version of overlapping data
+ *  - @c ::MSF_SEGMENTSTATS : Maintain running sample statistics at ::MS3TraceSeg.stats
  * @endparblock
  * @param[in] tolerance Tolerance function pointers as ::MS3Tolerance
  *
@@ -776,7 +1228,13 @@ MS3TraceSeg *
 mstl3_addmsr (MS3TraceList *mstl, const MS3Record *msr, int8_t splitversion, int8_t autoheal,
               uint32_t flags, const MS3Tolerance *tolerance)
 {
-  return _mstl3_addmsr_impl (mstl, msr, NULL, splitversion, autoheal, flags, tolerance);
+  MS3TraceSeg *seg;
+  LM_METRIC_START (metricstart);
+
+  seg = _mstl3_addmsr_impl (mstl, msr, NULL, splitversion, autoheal, flags, tolerance);
+
+  LM_METRIC_STOP (lm_metrics.tracelistinsert, metricstart);
+  return seg;
 }
 
 /** ************************************************************************
@@ -793,15 +1251,377 @@ mstl3_addmsr (MS3TraceList *mstl, const MS3Record *msr, int8_t splitversion, int
  * ::MS3RecordPtr will be added to the appropriate record list and the values of
  * ::MS3RecordPtr.msr and ::MS3RecordPtr.endtime will be set, all other fields
  * should be set by the caller.
+ *
+ * If ::MSF_INTERNEXTRA is set in @p flags, the extra headers of
+ * ::MS3RecordPtr.msr are shared with all other entries in the trace list
+ * with byte-identical extra headers and must be treated as read-only.
  ***************************************************************************/
 MS3TraceSeg *
 mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **pprecptr,
                         int8_t splitversion, int8_t autoheal, uint32_t flags,
                         const MS3Tolerance *tolerance)
 {
-  return _mstl3_addmsr_impl (mstl, msr, pprecptr, splitversion, autoheal, flags, tolerance);
+  MS3TraceSeg *seg;
+  LM_METRIC_START (metricstart);
+
+  seg = _mstl3_addmsr_impl (mstl, msr, pprecptr, splitversion, autoheal, flags, tolerance);
+
+  LM_METRIC_STOP (lm_metrics.tracelistinsert, metricstart);
+  return seg;
 }
 
+/* Test if the data of two segments can be combined, either both or neither
+ * with data samples of the same type */
+#define SEGMENTS_JOINABLE(seg1, seg2)                                \
+  (((seg1)->numsamples == 0 && (seg2)->numsamples == 0) ||           \
+   ((seg1)->numsamples > 0 && (seg2)->numsamples > 0 &&              \
+    (seg1)->sampletype == (seg2)->sampletype))
+
+/***************************************************************************
+ * Merge a segment into the segment list of a trace ID.
+ *
+ * The segment is joined to the end of a segment it follows, or the
+ * beginning of a segment it precedes, within the time and sample rate
+ * tolerances as done by mstl3_addmsr(), otherwise it is inserted into
+ * the list.  Existing segments are retained when joined, with the
+ * joined segment freed.
+ *
+ * The segment is always consumed, on error it is freed.  Private
+ * pointers of freed segments are only freed if @p freeprvtptr is true.
+ *
+ * @returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_merge_segment (MS3TraceList *mstl, MS3TraceID *id, MS3TraceSeg *seg, int8_t autoheal,
+                  const MS3Tolerance *tolerance, int8_t freeprvtptr)
+{
+  MS3Record msr = MS3Record_INITIALIZER;
+  MS3TraceSeg *segbefore = NULL;
+  MS3TraceSeg *segafter = NULL;
+  MS3TraceSeg *followseg = NULL;
+  MS3TraceSeg *searchseg = NULL;
+
+  nstime_t pregap;
+  nstime_t postgap;
+  nstime_t nsperiod;
+  nstime_t nstimetol = 0;
+  nstime_t nnstimetol = 0;
+
+  double sampratehz;
+  double sampratetol = -1.0;
+
+  if (seg->starttime < id->earliest)
+    id->earliest = seg->starttime;
+
+  if (seg->endtime > id->latest)
+    id->latest = seg->endtime;
+
+  /* Describe the segment as a record for tolerances */
+  memcpy (msr.sid, id->sid, sizeof (msr.sid));
+  msr.pubversion = id->pubversion;
+  msr.starttime = seg->starttime;
+  msr.samprate = seg->samprate;
+  msr.samplecnt = seg->samplecnt;
+
+  nsperiod = msr3_nsperiod (&msr);
+
+  if (tolerance && tolerance->time)
+    nstimetol = (nstime_t)(NSTMODULUS * tolerance->time (&msr));
+  else
+    nstimetol = (nstime_t)(0.5 * nsperiod); /* Default time tolerance is 1/2 sample period */
+
+  nnstimetol = (nstimetol) ? -nstimetol : 0;
+
+  if (tolerance && tolerance->samprate)
+    sampratetol = tolerance->samprate (&msr);
+
+  sampratehz = msr3_sampratehz (&msr);
+
+  /* Search for segments that this segment follows and precedes, as for records */
+  searchseg = id->first;
+  while (searchseg)
+  {
+    if (!SEGMENT_HAS_TIME_COVERAGE (seg) || !SEGMENT_HAS_TIME_COVERAGE (searchseg) ||
+        !SEGMENTS_JOINABLE (searchseg, seg))
+    {
+      if (seg->starttime > searchseg->starttime)
+        followseg = searchseg;
+
+      searchseg = searchseg->next;
+      continue;
+    }
+
+    if (seg->starttime > searchseg->starttime)
+      followseg = searchseg;
+
+    if (!segbefore)
+    {
+      postgap = seg->starttime - searchseg->endtime - nsperiod;
+
+      if (postgap <= nstimetol && postgap >= nnstimetol &&
+          IS_SAMPRATE_SIMILAR (sampratehz, searchseg->samprate, sampratetol))
+        segbefore = searchseg;
+    }
+
+    if (!segafter)
+    {
+      pregap = searchseg->starttime - seg->endtime - nsperiod;
+
+      if (pregap <= nstimetol && pregap >= nnstimetol &&
+          IS_SAMPRATE_SIMILAR (sampratehz, searchseg->samprate, sampratetol))
+        segafter = searchseg;
+    }
+
+    /* Done searching if both before and after segments are found */
+    if (segbefore && segafter)
+      break;
+    /* Done searching if not autohealing and one match found */
+    else if (!autoheal && (segbefore || segafter))
+      break;
+
+    searchseg = searchseg->next;
+  }
+
+  /* Add segment coverage to end of segment before */
+  if (segbefore)
+  {
+    if (!lm_addsegtoseg (segbefore, seg))
+    {
+      lm_free_segment_memory (mstl, seg, freeprvtptr);
+      return -1;
+    }
+
+    lm_free_segment_memory (mstl, seg, freeprvtptr);
+    seg = segbefore;
+
+    /* Merge two segments that now fit if autohealing */
+    if (autoheal && segafter && segbefore != segafter)
+    {
+      if (!lm_addsegtoseg (segbefore, segafter))
+        return -1;
+
+      if (segafter == id->last)
+        id->last = segafter->prev;
+
+      if (segafter->prev)
+        segafter->prev->next = segafter->next;
+      if (segafter->next)
+        segafter->next->prev = segafter->prev;
+
+      lm_free_segment_memory (mstl, segafter, freeprvtptr);
+      id->numsegments -= 1;
+    }
+  }
+  /* Add segment coverage to beginning of segment after */
+  else if (segafter)
+  {
+    if (!lm_addsegtoseg (seg, segafter))
+    {
+      lm_free_segment_memory (mstl, seg, freeprvtptr);
+      return -1;
+    }
+
+    /* Retain the existing segment with the combined coverage */
+    libmseed_memory.free (segafter->datasamples);
+    segafter->starttime = seg->starttime;
+    segafter->samplecnt = seg->samplecnt;
+    segafter->datasamples = seg->datasamples;
+    segafter->datasize = seg->datasize;
+    segafter->numsamples = seg->numsamples;
+    segafter->sampletype = seg->sampletype;
+    segafter->recordlist = seg->recordlist;
+    libmseed_memory.free (segafter->stats);
+    segafter->stats = seg->stats;
+
+    seg->datasamples = NULL;
+    seg->recordlist = NULL;
+    seg->stats = NULL;
+    lm_free_segment_memory (mstl, seg, freeprvtptr);
+    seg = segafter;
+  }
+  /* Insert segment after the segment with the latest earlier start */
+  else
+  {
+    if (!followseg)
+    {
+      seg->next = id->first;
+      if (id->first)
+        id->first->prev = seg;
+      id->first = seg;
+
+      if (!id->last)
+        id->last = seg;
+    }
+    else
+    {
+      seg->next = followseg->next;
+      seg->prev = followseg;
+      if (followseg->next)
+        followseg->next->prev = seg;
+      followseg->next = seg;
+
+      if (followseg == id->last)
+        id->last = seg;
+    }
+
+    id->numsegments++;
+  }
+
+  lm_sort_segment (id, seg);
+
+  return 0;
+} /* End of lm_merge_segment() */
+
+/** ************************************************************************
+ * @brief Merge all data from one ::MS3TraceList into another
+ *
+ * Trace IDs of @p ppsrc that do not exist in @p mstl are moved into the
+ * list.  Segments of trace IDs that exist in both are merged using the
+ * same time and sample rate tolerance logic as mstl3_addmsr(): a segment
+ * that fits the end or beginning of an existing segment is joined to
+ * it, otherwise it is inserted as a new segment.
+ *
+ * Data sample buffers and record lists are moved rather than copied,
+ * except that samples are copied when segments are joined.  Shared
+ * extra headers (::MSF_INTERNEXTRA) and file names referenced by record
+ * lists are moved to @p mstl.
+ *
+ * The source list is consumed and freed, and @p *ppsrc is set to NULL,
+ * on success or error.  Private pointers (@c prvtptr) of moved trace
+ * IDs, segments and records are retained.  Private pointers of source
+ * trace IDs and segments that are merged into existing entries, and of
+ * existing segments joined with them, are only freed if @p freeprvtptr
+ * is true.  Otherwise the caller must retain references to free them.
+ *
+ * This allows combining trace lists built independently, e.g. by
+ * multiple threads or from cached partial results, without repacking.
+ *
+ * @param[in] mstl ::MS3TraceList to merge data into
+ * @param[in,out] ppsrc Pointer to the ::MS3TraceList to merge, freed
+ * @param[in] splitversion Flag to control splitting of version/quality
+ * @param[in] autoheal Flag to control automatic merging of segments
+ * @param[in] tolerance Tolerance function pointers as ::MS3Tolerance
+ * @param[in] freeprvtptr If true, free the private pointer data of
+ * trace IDs and segments that are merged and no longer in a list
+ *
+ * @returns 0 on success and -1 on error, in which case some data may not
+ * have been merged.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see mstl3_addmsr()
+ ***************************************************************************/
+int
+mstl3_merge (MS3TraceList *mstl, MS3TraceList **ppsrc, int8_t splitversion, int8_t autoheal,
+             const MS3Tolerance *tolerance, int8_t freeprvtptr)
+{
+  MS3TraceID *previd[MSTRACEID_SKIPLIST_HEIGHT] = {NULL};
+  MS3TraceList *src = NULL;
+  MS3TraceID *srcid = NULL;
+  MS3TraceID *nextsrcid = NULL;
+  MS3TraceID *id = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3TraceSeg *nextseg = NULL;
+  struct LM_FILENAMES_s *filenames = NULL;
+  uint32_t idx;
+  int retval = 0;
+
+  if (!mstl || !ppsrc || !*ppsrc || *ppsrc == mstl)
+  {
+    ms_log (2, "%s(): Required input not defined or invalid: 'mstl' or 'ppsrc'\n", __func__);
+    return -1;
+  }
+
+  src = *ppsrc;
+
+  /* Move storage referenced by record lists */
+  lm_extrapool_absorb (mstl, src);
+
+  if (src->filenames)
+  {
+    for (filenames = src->filenames; filenames->next;)
+      filenames = filenames->next;
+
+    filenames->next = mstl->filenames;
+    mstl->filenames = src->filenames;
+    src->filenames = NULL;
+  }
+
+  /* Move keys of records added to the source list */
+  if (src->dupset)
+  {
+    if (!mstl->dupset)
+    {
+      mstl->dupset = src->dupset;
+      src->dupset = NULL;
+    }
+    else
+    {
+      for (idx = 0; idx < src->dupset->slotcount && !retval; idx++)
+      {
+        if (src->dupset->keys[idx].sidhash &&
+            lm_dupset_insert (mstl->dupset, &src->dupset->keys[idx]) < 0)
+          retval = -1;
+      }
+    }
+  }
+
+  /* Detach all trace IDs from the source list */
+  srcid = src->traces.next[0];
+  memset (src->traces.next, 0, sizeof (src->traces.next));
+  src->numtraceids = 0;
+
+  for (; srcid; srcid = nextsrcid)
+  {
+    nextsrcid = srcid->next[0];
+
+    id = mstl3_findID (mstl, srcid->sid, (splitversion) ? srcid->pubversion : 0, previd);
+
+    /* Move trace ID not in the list */
+    if (!id && !retval)
+    {
+      if (mstl3_addID (mstl, srcid, previd))
+        continue;
+
+      ms_log (2, "%s: Cannot add trace ID to trace list\n", srcid->sid);
+      retval = -1;
+    }
+
+    /* Merge segments into the existing trace ID, free them after an error */
+    for (seg = srcid->first; seg; seg = nextseg)
+    {
+      nextseg = seg->next;
+
+      if (!retval)
+      {
+        seg->prev = NULL;
+        seg->next = NULL;
+
+        if (lm_merge_segment (mstl, id, seg, autoheal, tolerance, freeprvtptr))
+        {
+          ms_log (2, "%s: Cannot merge trace segment\n", srcid->sid);
+          retval = -1;
+        }
+      }
+      else
+      {
+        lm_free_segment_memory (mstl, seg, freeprvtptr);
+      }
+    }
+
+    if (id && srcid->pubversion > id->pubversion)
+      id->pubversion = srcid->pubversion;
+
+    if (freeprvtptr)
+      libmseed_memory.free (srcid->prvtptr);
+    libmseed_memory.free (srcid);
+  }
+
+  mstl3_free (ppsrc, 0);
+
+  return retval;
+} /* End of mstl3_merge() */
+
 /** ************************************************************************
  * @brief Parse miniSEED from a buffer and populate a ::MS3TraceList
  *
@@ -823,6 +1643,8 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
  * @param[in] flags Flags to control parsing and optional functionality:
  * @parblock
  *  - @c ::MSF_RECORDLIST : Build a ::MS3RecordList for each ::MS3TraceSeg
+ *  - @c ::MSF_INTERNEXTRA : Share identical extra headers of ::MS3RecordList entries
+ *  - @c ::MSF_SKIPDUPLICATES : Skip records duplicating any already in the trace list
  *  - Flags supported by msr3_parse()
  *  - Flags supported by mstl3_addmsr()
  * @endparblock
@@ -870,6 +1692,8 @@ mstl3_readbuffer (MS3TraceList **ppmstl, const char *buffer, uint64_t bufferleng
  * @param[in] flags Flags to control parsing and optional functionality:
  * @parblock
  *  - @c ::MSF_RECORDLIST : Build a ::MS3RecordList for each ::MS3TraceSeg
+ *  - @c ::MSF_INTERNEXTRA : Share identical extra headers of ::MS3RecordList entries
+ *  - @c ::MSF_SKIPDUPLICATES : Skip records duplicating any already in the trace list
  *  - Flags supported by msr3_parse()
  *  - Flags supported by mstl3_addmsr()
  * @endparblock
@@ -897,6 +1721,8 @@ mstl3_readbuffer_selection (MS3TraceList **ppmstl, const char *buffer, uint64_t
   uint64_t offset = 0;
   uint32_t pflags = flags;
   int64_t reccount = 0;
+  int64_t detectlen;
+  uint8_t formatversion;
   int parsevalue;
 
   if (!ppmstl)
@@ -920,6 +1746,23 @@ mstl3_readbuffer_selection (MS3TraceList **ppmstl, const char *buffer, uint64_t
 
   while ((bufferlength - offset) > MINRECLEN)
   {
+    /* Test selections against the raw header, skipping non-matching records without parsing */
+    if (selections &&
+        (detectlen = ms3_detect (buffer + offset, bufferlength - offset, &formatversion)) >=
+            MINRECLEN &&
+        detectlen <= MAXRECLEN && (uint64_t)detectlen <= (bufferlength - offset) &&
+        !ms3_matchselect_header (selections, buffer + offset, (int)detectlen, formatversion))
+    {
+      if (verbose > 1)
+      {
+        ms_log (0, "Skipping (selection) record of %" PRId64 " bytes starting at offset %" PRIu64 "\n",
+                detectlen, offset);
+      }
+
+      offset += detectlen;
+      continue;
+    }
+
     parsevalue = msr3_parse (buffer + offset, bufferlength - offset, &msr, pflags, verbose);
 
     if (parsevalue < 0)
@@ -963,6 +1806,22 @@ mstl3_readbuffer_selection (MS3TraceList **ppmstl, const char *buffer, uint64_t
       }
     }
 
+    /* Skip records already added to the trace list */
+    if (flags & MSF_SKIPDUPLICATES)
+    {
+      if ((parsevalue = lm_skip_duplicate (*ppmstl, msr, splitversion, flags)) < 0)
+      {
+        msr3_free (&msr);
+        return MS_GENERROR;
+      }
+
+      if (parsevalue)
+      {
+        offset += msr->reclen;
+        continue;
+      }
+    }
+
     /* Add record to trace list */
     seg = mstl3_addmsr_recordptr (*ppmstl, msr, (flags & MSF_RECORDLIST) ? &recordptr : NULL,
                                   splitversion, 1, flags, tolerance);
@@ -1136,6 +1995,9 @@ lm_addmsrtoseg (MS3TraceSeg *seg, const MS3Record *msr, nstime_t endtime, int8_t
       memcpy ((char *)seg->datasamples + (seg->numsamples * samplesize), msr->datasamples,
               (size_t)(msr->numsamples * samplesize));
 
+      if (lm_segstats_add (seg, seg->numsamples, msr->numsamples))
+        return NULL;
+
       seg->numsamples += msr->numsamples;
     }
   }
@@ -1152,6 +2014,9 @@ lm_addmsrtoseg (MS3TraceSeg *seg, const MS3Record *msr, nstime_t endtime, int8_t
 
       memcpy (seg->datasamples, msr->datasamples, (size_t)(msr->numsamples * samplesize));
 
+      if (lm_segstats_add (seg, 0, msr->numsamples))
+        return NULL;
+
       seg->numsamples += msr->numsamples;
     }
   }
@@ -1174,6 +2039,7 @@ lm_addmsrtoseg (MS3TraceSeg *seg, const MS3Record *msr, nstime_t endtime, int8_t
 static MS3TraceSeg *
 lm_addsegtoseg (MS3TraceSeg *seg1, MS3TraceSeg *seg2)
 {
+  int64_t seg1samples;
   int samplesize = 0;
   void *newdatasamples = NULL;
   size_t newdatasize = 0;
@@ -1225,6 +2091,7 @@ lm_addsegtoseg (MS3TraceSeg *seg1, MS3TraceSeg *seg2)
   }
 
   /* Add seg2 coverage to end of seg1 */
+  seg1samples = seg1->numsamples;
   seg1->endtime = seg2->endtime;
   seg1->samplecnt += seg2->samplecnt;
 
@@ -1236,6 +2103,32 @@ lm_addsegtoseg (MS3TraceSeg *seg1, MS3TraceSeg *seg2)
     seg1->numsamples += seg2->numsamples;
   }
 
+  /* Combine running sample statistics, adopting those of seg2 if seg1 has none */
+  if (seg2->stats && !seg1->stats)
+  {
+    seg1->stats = seg2->stats;
+    seg2->stats = NULL;
+
+    if (lm_segstats_add (seg1, 0, seg1samples))
+      return NULL;
+  }
+  else if (seg2->stats && seg2->stats->count > 0)
+  {
+    if (seg1->stats->count == 0 || seg2->stats->min < seg1->stats->min)
+      seg1->stats->min = seg2->stats->min;
+    if (seg1->stats->count == 0 || seg2->stats->max > seg1->stats->max)
+      seg1->stats->max = seg2->stats->max;
+
+    seg1->stats->count += seg2->stats->count;
+    seg1->stats->sum += seg2->stats->sum;
+    seg1->stats->sumsquares += seg2->stats->sumsquares;
+    seg1->stats->mean = seg1->stats->sum / (double)seg1->stats->count;
+  }
+  else if (!seg2->stats && lm_segstats_add (seg1, seg1samples, seg1->numsamples - seg1samples))
+  {
+    return NULL;
+  }
+
   /* Add seg2 record list to end of seg1 record list */
   if (seg2->recordlist)
   {
@@ -1249,15 +2142,77 @@ lm_addsegtoseg (MS3TraceSeg *seg1, MS3TraceSeg *seg2)
       seg1->recordlist->last = seg2->recordlist->last;
       seg1->recordlist->recordcnt += seg2->recordlist->recordcnt;
 
-      /* Free record list container */
-      libmseed_memory.free (seg2->recordlist);
-    }
+      /* Free record list container */
+      libmseed_memory.free (seg2->recordlist);
+    }
+
+    seg2->recordlist = NULL;
+  }
+
+  return seg1;
+} /* End of lm_addsegtoseg() */
+
+/***************************************************************************
+ * Move a segment within the segment list of a trace ID to keep the list
+ * sorted by start time, and by descending end time for equal start times.
+ ***************************************************************************/
+static void
+lm_sort_segment (MS3TraceID *id, MS3TraceSeg *seg)
+{
+  MS3TraceSeg *segbefore;
+  MS3TraceSeg *segafter;
+
+  while (seg->next &&
+         (seg->starttime > seg->next->starttime ||
+          (seg->starttime == seg->next->starttime && seg->endtime < seg->next->endtime)))
+  {
+    /* Move segment down list, swap seg and seg->next */
+    segafter = seg->next;
+
+    if (seg->prev)
+      seg->prev->next = segafter;
+
+    if (segafter->next)
+      segafter->next->prev = seg;
+
+    segafter->prev = seg->prev;
+    seg->prev = segafter;
+    seg->next = segafter->next;
+    segafter->next = seg;
+
+    /* Reset first and last segment pointers if replaced */
+    if (id->first == seg)
+      id->first = segafter;
+
+    if (id->last == segafter)
+      id->last = seg;
+  }
+  while (seg->prev &&
+         (seg->starttime < seg->prev->starttime ||
+          (seg->starttime == seg->prev->starttime && seg->endtime > seg->prev->endtime)))
+  {
+    /* Move segment up list, swap seg and seg->prev */
+    segbefore = seg->prev;
+
+    if (seg->next)
+      seg->next->prev = segbefore;
+
+    if (segbefore->prev)
+      segbefore->prev->next = seg;
+
+    segbefore->next = seg->next;
+    seg->next = segbefore;
+    seg->prev = segbefore->prev;
+    segbefore->prev = seg;
 
-    seg2->recordlist = NULL;
-  }
+    /* Reset first and last segment pointers if replaced */
+    if (id->first == segbefore)
+      id->first = seg;
 
-  return seg1;
-} /* End of lm_addsegtoseg() */
+    if (id->last == seg)
+      id->last = segbefore;
+  }
+} /* End of lm_sort_segment() */
 
 /** ************************************************************************
  * @brief Add a ::MS3RecordPtr to the ::MS3RecordList of a ::MS3TraceSeg
@@ -1285,9 +2240,14 @@ lm_addsegtoseg (MS3TraceSeg *seg1, MS3TraceSeg *seg2)
  * @see mstl3_addmsr()
  ***************************************************************************/
 static MS3RecordPtr *
-lm_add_recordptr (MS3TraceSeg *seg, const MS3Record *msr, nstime_t endtime, int8_t whence)
+lm_add_recordptr (MS3TraceSeg *seg, const MS3Record *msr, nstime_t endtime, int8_t whence,
+                  struct LM_EXTRAPOOL_s *extrapool)
 {
   MS3RecordPtr *recordptr = NULL;
+  MS3Record msrnoextra;
+  MS3Record view;
+  char *extra = NULL;
+  int viewed = 0;
 
   if (!seg || !msr)
   {
@@ -1310,7 +2270,52 @@ lm_add_recordptr (MS3TraceSeg *seg, const MS3Record *msr, nstime_t endtime, int8
   }
 
   memset (recordptr, 0, sizeof (MS3RecordPtr));
-  recordptr->msr = msr3_duplicate (msr, 0);
+
+  /* Use pending changes in the extra header cache */
+  if (extrapool && (viewed = mseh_cache_view (msr, &view)) != 0)
+  {
+    if (viewed < 0)
+    {
+      libmseed_memory.free (recordptr);
+      return NULL;
+    }
+
+    msr = &view;
+  }
+
+  /* Duplicate without extra headers and reference shared extra headers */
+  if (extrapool && msr->extralength > 0 && msr->extra)
+  {
+    if ((extra = lm_extrapool_intern (extrapool, msr->extra, msr->extralength)) == NULL)
+    {
+      libmseed_memory.free (recordptr);
+      return NULL;
+    }
+
+    msrnoextra = *msr;
+    msrnoextra.extra = NULL;
+    msrnoextra.extralength = 0;
+    msrnoextra.extracache = NULL;
+
+    if ((recordptr->msr = msr3_duplicate (&msrnoextra, 0)) != NULL)
+    {
+      recordptr->msr->extra = extra;
+      recordptr->msr->extralength = msr->extralength;
+    }
+    else
+    {
+      msrnoextra.extra = extra;
+      lm_extrapool_release (extrapool, &msrnoextra);
+    }
+  }
+  else
+  {
+    recordptr->msr = msr3_duplicate (msr, 0);
+  }
+
+  if (viewed > 0)
+    libmseed_memory.free (view.extra);
+
   recordptr->endtime = endtime;
 
   if (recordptr->msr == NULL)
@@ -1528,6 +2533,10 @@ mstl3_convertsamples (MS3TraceSeg *seg, char type, int8_t truncate)
     seg->sampletype = 'd';
   } /* Done converting to 64-bit doubles */
 
+  /* Conversion may truncate values, recalculate running sample statistics */
+  if (seg->stats && lm_segstats_reset (seg))
+    return -1;
+
   return 0;
 } /* End of mstl3_convertsamples() */
 
@@ -1894,8 +2903,14 @@ mstl3_unpack_recordlist (MS3TraceID *id, MS3TraceSeg *seg, void *output, uint64_
   }
 
   if (totalunpackedsamples > 0)
+  {
     seg->sampletype = sampletype;
 
+    /* Update running sample statistics for samples unpacked into the segment */
+    if (output == seg->datasamples && seg->stats && lm_segstats_reset (seg))
+      return -1;
+  }
+
   return totalunpackedsamples;
 } /* End of mstl3_unpack_recordlist() */
 
@@ -2276,6 +3291,9 @@ mstl3_pack_next (MS3TraceListPacker *packer, uint32_t flags, char **record, int3
 
             packer->current_seg->datasize = (uint64_t)bufsize;
           }
+
+          if (packer->current_seg->stats && lm_segstats_reset (packer->current_seg))
+            return -1;
         }
         else
         {
@@ -2688,6 +3706,9 @@ mstl3_pack_segment (MS3TraceList *mstl, MS3TraceID *id, MS3TraceSeg *seg,
 
         seg->datasize = (uint64_t)bufsize;
       }
+
+      if (seg->stats && lm_segstats_reset (seg))
+        return -1;
     }
   }
 
@@ -3047,6 +4068,51 @@ mstl3_printgaplist (const MS3TraceList *mstl, ms_timeformat_t timeformat, double
   return;
 } /* End of mstl3_printgaplist() */
 
+/***************************************************************************
+ * Recalculate the running sample statistics of a segment from all of its
+ * data samples, allocating the statistics container if needed.
+ *
+ * Statistics are only accumulated for integer, float and double samples.
+ *
+ * Return 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+static int
+lm_segstats_reset (MS3TraceSeg *seg)
+{
+  if (!seg->stats &&
+      !(seg->stats = (MS3SampleStats *)libmseed_memory.malloc (sizeof (MS3SampleStats))))
+  {
+    ms_log (2, "Error allocating memory\n");
+    return -1;
+  }
+
+  memset (seg->stats, 0, sizeof (MS3SampleStats));
+
+  return lm_segstats_add (seg, 0, seg->numsamples);
+} /* End of lm_segstats_reset() */
+
+/***************************************************************************
+ * Add a range of data samples of a segment to its running sample
+ * statistics, if the segment has statistics.
+ *
+ * Return 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+static int
+lm_segstats_add (MS3TraceSeg *seg, int64_t offset, int64_t count)
+{
+  if (!seg->stats || !seg->datasamples || count <= 0 ||
+      (seg->sampletype != 'i' && seg->sampletype != 'f' && seg->sampletype != 'd'))
+    return 0;
+
+  return ms_samplestats (seg->stats,
+                         (char *)seg->datasamples + (offset * ms_samplesize (seg->sampletype)),
+                         count, seg->sampletype);
+} /* End of lm_segstats_add() */
+
 /***************************************************************************
  * Free all memory associated with an MS3TraceSeg structure.
  *
@@ -3056,7 +4122,7 @@ mstl3_printgaplist (const MS3TraceList *mstl, ms_timeformat_t timeformat, double
  * @ref MessageOnError - this function logs a message on error
  ***************************************************************************/
 static void
-lm_free_segment_memory (MS3TraceSeg *seg, int8_t freeprvtptr)
+lm_free_segment_memory (MS3TraceList *mstl, MS3TraceSeg *seg, int8_t freeprvtptr)
 {
   MS3RecordPtr *recordptr;
   MS3RecordPtr *nextrecordptr;
@@ -3070,6 +4136,7 @@ lm_free_segment_memory (MS3TraceSeg *seg, int8_t freeprvtptr)
 
   /* Free data samples */
   libmseed_memory.free (seg->datasamples);
+  libmseed_memory.free (seg->stats);
 
   /* Free associated record list and related private pointers */
   if (seg->recordlist)
@@ -3079,6 +4146,10 @@ lm_free_segment_memory (MS3TraceSeg *seg, int8_t freeprvtptr)
     {
       nextrecordptr = recordptr->next;
 
+      /* Release shared extra headers before freeing the record */
+      if (mstl && mstl->extrapool && recordptr->msr)
+        lm_extrapool_release (mstl->extrapool, recordptr->msr);
+
       msr3_free (&recordptr->msr);
 
       /* Free private pointer data if requested */
@@ -3113,7 +4184,7 @@ lm_free_segment_memory (MS3TraceSeg *seg, int8_t freeprvtptr)
  *
  * @see mstl3_free()
  ***************************************************************************/
-static int
+int
 lm_remove_segment (MS3TraceList *mstl, MS3TraceID *id, MS3TraceSeg *seg, int8_t freeprvtptr)
 {
   MS3TraceID *searchid = NULL;
@@ -3141,7 +4212,7 @@ lm_remove_segment (MS3TraceList *mstl, MS3TraceID *id, MS3TraceSeg *seg, int8_t
   id->numsegments -= 1;
 
   /* Free all memory associated with the segment */
-  lm_free_segment_memory (seg, freeprvtptr);
+  lm_free_segment_memory (mstl, seg, freeprvtptr);
 
   /* If this was the last segment, remove the TraceID from the trace list */
   if (id->numsegments == 0)
@@ -3229,3 +4300,401 @@ lm_random_height (uint8_t maximum, uint64_t *state)
 
   return height;
 }
+
+/***************************************************************************
+ * Redistribute the entries of an extra headers pool over @p newcount
+ * hash buckets, a power of 2.
+ *
+ * @returns 0 on success and -1 on error, leaving the pool unchanged.
+ ***************************************************************************/
+static int
+lm_extrapool_rehash (struct LM_EXTRAPOOL_s *extrapool, uint32_t newcount)
+{
+  LM_EXTRAENTRY **newbuckets = NULL;
+  LM_EXTRAENTRY *entry = NULL;
+  LM_EXTRAENTRY *nextentry = NULL;
+  uint32_t idx;
+
+  if ((newbuckets = (LM_EXTRAENTRY **)libmseed_memory.malloc (sizeof (LM_EXTRAENTRY *) *
+                                                               newcount)) == NULL)
+    return -1;
+
+  memset (newbuckets, 0, sizeof (LM_EXTRAENTRY *) * newcount);
+
+  for (idx = 0; idx < extrapool->bucketcount; idx++)
+  {
+    for (entry = extrapool->buckets[idx]; entry; entry = nextentry)
+    {
+      nextentry = entry->next;
+      entry->next = newbuckets[entry->hash & (newcount - 1)];
+      newbuckets[entry->hash & (newcount - 1)] = entry;
+    }
+  }
+
+  libmseed_memory.free (extrapool->buckets);
+  extrapool->buckets = newbuckets;
+  extrapool->bucketcount = newcount;
+
+  return 0;
+} /* End of lm_extrapool_rehash() */
+
+/***************************************************************************
+ * Combine the extra headers pool of @p src with the pool of @p mstl,
+ * leaving @p src without a pool.
+ *
+ * The extra headers of each record of @p src shared from its pool are
+ * interned in the pool of @p mstl and the record repointed, so that
+ * identical extra headers remain a single entry.  Any entries that
+ * cannot be combined, e.g. on allocation failure, are moved as they
+ * are, records reference them by address and releasing works for either.
+ ***************************************************************************/
+static void
+lm_extrapool_absorb (MS3TraceList *mstl, MS3TraceList *src)
+{
+  struct LM_EXTRAPOOL_s *pool = mstl->extrapool;
+  LM_EXTRAENTRY *entry = NULL;
+  LM_EXTRAENTRY *nextentry = NULL;
+  MS3TraceID *id = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3RecordPtr *recptr = NULL;
+  MS3Record unshared;
+  char *extra = NULL;
+  uint16_t length;
+  uint32_t newcount;
+  uint32_t idx;
+
+  if (!src->extrapool)
+    return;
+
+  if (!pool)
+  {
+    mstl->extrapool = src->extrapool;
+    src->extrapool = NULL;
+    return;
+  }
+
+  /* Intern the extra headers of each record in the destination pool */
+  for (id = src->traces.next[0]; id && src->extrapool->entrycount; id = id->next[0])
+  {
+    for (seg = id->first; seg; seg = seg->next)
+    {
+      for (recptr = (seg->recordlist) ? seg->recordlist->first : NULL; recptr;
+           recptr = recptr->next)
+      {
+        if (!recptr->msr || !recptr->msr->extra || !recptr->msr->extralength)
+          continue;
+
+        length = recptr->msr->extralength;
+
+        if ((extra = lm_extrapool_intern (pool, recptr->msr->extra, length)) == NULL)
+          goto move;
+
+        lm_extrapool_release (src->extrapool, recptr->msr);
+
+        /* Extra headers not shared from the source pool are left as they are */
+        if (recptr->msr->extra)
+        {
+          unshared.extra = extra;
+          unshared.extralength = length;
+          lm_extrapool_release (pool, &unshared);
+          continue;
+        }
+
+        recptr->msr->extra = extra;
+        recptr->msr->extralength = length;
+      }
+    }
+  }
+
+move:
+  /* Grow hash table for the combined entries, continue with longer chains on failure */
+  for (newcount = pool->bucketcount; newcount < pool->entrycount + src->extrapool->entrycount;)
+    newcount *= 2;
+
+  if (newcount > pool->bucketcount)
+    lm_extrapool_rehash (pool, newcount);
+
+  for (idx = 0; idx < src->extrapool->bucketcount; idx++)
+  {
+    for (entry = src->extrapool->buckets[idx]; entry; entry = nextentry)
+    {
+      nextentry = entry->next;
+      entry->next = pool->buckets[entry->hash & (pool->bucketcount - 1)];
+      pool->buckets[entry->hash & (pool->bucketcount - 1)] = entry;
+      pool->entrycount++;
+    }
+  }
+
+  libmseed_memory.free (src->extrapool->buckets);
+  libmseed_memory.free (src->extrapool);
+  src->extrapool = NULL;
+} /* End of lm_extrapool_absorb() */
+
+/***************************************************************************
+ * Return shared extra headers from a pool matching the specified
+ * extra headers, adding a new entry to the pool if needed.
+ *
+ * The reference count of the returned entry is incremented, each
+ * reference must be released with lm_extrapool_release().
+ *
+ * @returns pointer to shared extra headers on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+static char *
+lm_extrapool_intern (struct LM_EXTRAPOOL_s *extrapool, const char *extra, uint16_t length)
+{
+  LM_EXTRAENTRY *entry = NULL;
+  uint32_t hash;
+
+  hash = ms_crc32c ((const uint8_t *)extra, length, 0);
+
+  /* Search for existing entry */
+  for (entry = extrapool->buckets[hash & (extrapool->bucketcount - 1)]; entry; entry = entry->next)
+  {
+    if (entry->hash == hash && entry->length == length && !memcmp (entry->extra, extra, length))
+    {
+      entry->refcount++;
+      return entry->extra;
+    }
+  }
+
+  /* Grow hash table to keep chains short, continue with longer chains on failure */
+  if (extrapool->entrycount >= extrapool->bucketcount)
+    lm_extrapool_rehash (extrapool, extrapool->bucketcount * 2);
+
+  /* Add new entry */
+  if ((entry = (LM_EXTRAENTRY *)libmseed_memory.malloc (sizeof (LM_EXTRAENTRY) + length + 1)) ==
+      NULL)
+  {
+    ms_log (2, "Cannot allocate memory for shared extra headers\n");
+    return NULL;
+  }
+
+  entry->hash = hash;
+  entry->refcount = 1;
+  entry->length = length;
+  memcpy (entry->extra, extra, length);
+  entry->extra[length] = '\0';
+
+  entry->next = extrapool->buckets[hash & (extrapool->bucketcount - 1)];
+  extrapool->buckets[hash & (extrapool->bucketcount - 1)] = entry;
+  extrapool->entrycount++;
+
+  return entry->extra;
+}
+
+/***************************************************************************
+ * Release the shared extra headers referenced by a record.
+ *
+ * If the extra headers of @p msr are shared from the pool the reference
+ * is released, and the entry freed when no references remain, and the
+ * extra headers of @p msr are cleared.  Extra headers that are not
+ * shared are not modified.
+ ***************************************************************************/
+static void
+lm_extrapool_release (struct LM_EXTRAPOOL_s *extrapool, MS3Record *msr)
+{
+  LM_EXTRAENTRY **pentry;
+  LM_EXTRAENTRY *entry;
+  uint32_t hash;
+
+  if (!msr->extra || !msr->extralength)
+    return;
+
+  hash = ms_crc32c ((const uint8_t *)msr->extra, msr->extralength, 0);
+
+  /* Identify shared extra headers by address */
+  for (pentry = &extrapool->buckets[hash & (extrapool->bucketcount - 1)]; *pentry;
+       pentry = &(*pentry)->next)
+  {
+    entry = *pentry;
+
+    if (entry->extra == msr->extra)
+    {
+      if (--entry->refcount == 0)
+      {
+        *pentry = entry->next;
+        libmseed_memory.free (entry);
+        extrapool->entrycount--;
+      }
+
+      msr->extra = NULL;
+      msr->extralength = 0;
+      return;
+    }
+  }
+}
+
+/***************************************************************************
+ * Test if a record duplicates one already added to a trace list,
+ * otherwise remember the record as added.
+ *
+ * Records are identified by trace ID, start time, sample count and a
+ * hash of the record content: the CRC stored in version 3 records,
+ * which covers the whole record, or a CRC-32C of the data payload of
+ * version 2 records, which have no CRC and whose headers may differ in
+ * sequence number and quality between copies.  The publication
+ * version is part of the trace ID when @p splitversion is set, see
+ * mstl3_addmsr().
+ *
+ * The keys are kept in a hash set owned by the trace list, so each
+ * test is O(1) regardless of where an earlier copy was read.
+ *
+ * @returns 1 if the record is a duplicate, 0 if not and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+lm_skip_duplicate (MS3TraceList *mstl, const MS3Record *msr, int8_t splitversion,
+                   uint32_t flags)
+{
+  LM_DUPKEY key;
+  uint32_t dataoffset;
+  uint32_t datasize;
+  const char *cp;
+
+  if (!mstl || !msr || !msr->record)
+  {
+    ms_log (2, "%s(): Required input not defined: 'mstl', 'msr' or 'msr->record'\n", __func__);
+    return -1;
+  }
+
+  if (!mstl->dupset && lm_dupset_init (mstl))
+    return -1;
+
+  memset (&key, 0, sizeof (key));
+
+  /* FNV-1a hash of source identifier, never 0 which marks empty slots */
+  key.sidhash = 14695981039346656037ULL;
+  for (cp = msr->sid; *cp; cp++)
+    key.sidhash = (key.sidhash ^ (uint8_t)*cp) * 1099511628211ULL;
+  if (key.sidhash == 0)
+    key.sidhash = 1;
+
+  key.starttime = msr->starttime;
+  key.samplecnt = msr->samplecnt;
+
+  if (splitversion)
+    key.pubversion = (flags & MSF_SPLITISVERSION) ? (uint8_t)splitversion : msr->pubversion;
+
+  /* Use stored CRC of version 3 records, otherwise CRC of data payload */
+  if (msr->formatversion == 3 && msr->crc)
+  {
+    key.payload = msr->crc;
+  }
+  else
+  {
+    if (msr3_data_bounds (msr, &dataoffset, &datasize))
+      return -1;
+
+    key.payload = ms_crc32c ((const uint8_t *)msr->record + dataoffset, (int)datasize, 0);
+  }
+
+  return lm_dupset_insert (mstl->dupset, &key);
+} /* End of lm_skip_duplicate() */
+
+/***************************************************************************
+ * Allocate an empty duplicate record set for a trace list.
+ *
+ * @returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_dupset_init (MS3TraceList *mstl)
+{
+  if ((mstl->dupset = (struct LM_DUPSET_s *)libmseed_memory.malloc (
+           sizeof (struct LM_DUPSET_s))) == NULL ||
+      (mstl->dupset->keys = (LM_DUPKEY *)libmseed_memory.malloc (sizeof (LM_DUPKEY) *
+                                                                 LM_DUPSET_SLOTS)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for duplicate record set\n");
+    libmseed_memory.free (mstl->dupset);
+    mstl->dupset = NULL;
+    return -1;
+  }
+
+  memset (mstl->dupset->keys, 0, sizeof (LM_DUPKEY) * LM_DUPSET_SLOTS);
+  mstl->dupset->slotcount = LM_DUPSET_SLOTS;
+  mstl->dupset->keycount = 0;
+
+  return 0;
+} /* End of lm_dupset_init() */
+
+/***************************************************************************
+ * Hash a duplicate record key for a slot index.
+ ***************************************************************************/
+static inline uint32_t
+lm_dupkey_hash (const LM_DUPKEY *key)
+{
+  uint64_t hash;
+
+  hash = key->sidhash ^ (uint64_t)key->starttime ^ ((uint64_t)key->samplecnt << 32) ^
+         key->payload ^ ((uint64_t)key->pubversion << 56);
+  hash = (hash ^ (hash >> 31)) * 0x9E3779B97F4A7C15ULL;
+
+  return (uint32_t)(hash >> 32);
+} /* End of lm_dupkey_hash() */
+
+/***************************************************************************
+ * Insert a key into a duplicate record set, growing it as needed.
+ *
+ * @returns 1 if the key was already in the set, 0 if inserted and -1 on error.
+ ***************************************************************************/
+static int
+lm_dupset_insert (struct LM_DUPSET_s *dupset, const LM_DUPKEY *key)
+{
+  LM_DUPKEY *keys;
+  uint32_t slotcount;
+  uint32_t mask;
+  uint32_t slot;
+  uint32_t idx;
+
+  /* Grow to keep the load factor at or below 1/2 */
+  if ((dupset->keycount + 1) * 2 > dupset->slotcount)
+  {
+    slotcount = dupset->slotcount * 2;
+
+    if (slotcount < dupset->slotcount ||
+        (keys = (LM_DUPKEY *)libmseed_memory.malloc (sizeof (LM_DUPKEY) * slotcount)) == NULL)
+    {
+      ms_log (2, "Cannot allocate memory for duplicate record set\n");
+      return -1;
+    }
+
+    memset (keys, 0, sizeof (LM_DUPKEY) * slotcount);
+    mask = slotcount - 1;
+
+    for (idx = 0; idx < dupset->slotcount; idx++)
+    {
+      if (!dupset->keys[idx].sidhash)
+        continue;
+
+      for (slot = lm_dupkey_hash (&dupset->keys[idx]) & mask; keys[slot].sidhash;
+           slot = (slot + 1) & mask)
+        ;
+
+      keys[slot] = dupset->keys[idx];
+    }
+
+    libmseed_memory.free (dupset->keys);
+    dupset->keys = keys;
+    dupset->slotcount = slotcount;
+  }
+
+  mask = dupset->slotcount - 1;
+
+  for (slot = lm_dupkey_hash (key) & mask; dupset->keys[slot].sidhash; slot = (slot + 1) & mask)
+  {
+    if (dupset->keys[slot].sidhash == key->sidhash &&
+        dupset->keys[slot].starttime == key->starttime &&
+        dupset->keys[slot].samplecnt == key->samplecnt &&
+        dupset->keys[slot].payload == key->payload &&
+        dupset->keys[slot].pubversion == key->pubversion)
+      return 1;
+  }
+
+  dupset->keys[slot] = *key;
+  dupset->keycount++;
+
+  return 0;
+} /* End of lm_dupset_insert() */
@@ -30,6 +30,7 @@
 #include <time.h>
 
 #include "libmseed.h"
+#include "internalstate.h"
 #include "mseedformat.h"
 #include "unpack.h"
 #include "unpackdata.h"
@@ -1354,6 +1355,8 @@ ms_decode_data (const void *input, uint64_t inputsize, uint8_t encoding, uint64_
     return MS_GENERROR;
   }
 
+  LM_METRIC_START (metricstart);
+
   /* Decode data samples according to encoding */
   switch (encoding)
   {
@@ -1485,6 +1488,8 @@ ms_decode_data (const void *input, uint64_t inputsize, uint8_t encoding, uint64_
     break;
   }
 
+  LM_METRIC_STOP (lm_metrics.decode[LM_METRIC_ENCODING (encoding)], metricstart);
+
   if (nsamples >= 0 && (uint64_t)nsamples != samplecount)
   {
     ms_log (2, "%s: only decoded %" PRId64 " samples of %" PRIu64 " expected\n", (sid) ? sid : "",
@@ -1554,6 +1559,195 @@ ms2_recordsid (const char *record, char *sid, int sidlen)
   return sid;
 } /* End of ms2_recordsid() */
 
+/***************************************************************************
+ * ms3_header_summary:
+ *
+ * Determine the source identifier, start time, end time and
+ * publication version of a raw miniSEED 2.x or 3.x data record
+ * without constructing an MS3Record.
+ *
+ * The values are determined directly from the fixed header (and, for
+ * version 2, Blockettes 100 and 1001 and the time correction) in the
+ * same way as msr3_unpack_mseed3() and msr3_unpack_mseed2().  The
+ * record is not validated, e.g. the CRC of a version 3 record is not
+ * checked.
+ *
+ * The record is expected to be complete, i.e. the record length as
+ * determined by ms3_detect() must be available in the buffer.
+ *
+ * The sid buffer must be at least LM_SIDLEN bytes.
+ *
+ * Returns 0 on success and -1 when the values cannot be determined
+ * from the header.
+ ***************************************************************************/
+int
+ms3_header_summary (const char *record, int reclen, uint8_t formatversion, char *sid,
+                    nstime_t *starttime, nstime_t *endtime, uint8_t *pubversion)
+{
+  double samprate;
+  int64_t samplecnt;
+  int8_t swapflag = 0;
+
+  if (!record || !sid || !starttime || !endtime || !pubversion || reclen < MINRECLEN)
+    return -1;
+
+  if (formatversion == 3)
+  {
+    uint8_t sidlength;
+    uint32_t nanoseconds;
+    uint32_t numsamples;
+
+    /* miniSEED 3 is little endian */
+    swapflag = (ms_bigendianhost ()) ? 1 : 0;
+
+    sidlength = *pMS3FSDH_SIDLENGTH (record);
+
+    if (sidlength >= LM_SIDLEN || (MS3FSDH_LENGTH + sidlength) > reclen)
+      return -1;
+
+    memcpy (sid, pMS3FSDH_SID (record), sidlength);
+    sid[sidlength] = '\0';
+
+    memcpy (&nanoseconds, pMS3FSDH_NSEC (record), sizeof (uint32_t));
+    *starttime = ms_time2nstime (HO2u (*pMS3FSDH_YEAR (record), swapflag),
+                                 HO2u (*pMS3FSDH_DAY (record), swapflag), *pMS3FSDH_HOUR (record),
+                                 *pMS3FSDH_MIN (record), *pMS3FSDH_SEC (record),
+                                 HO4u (nanoseconds, swapflag));
+
+    memcpy (&samprate, pMS3FSDH_SAMPLERATE (record), sizeof (double));
+    samprate = HO8f (samprate, swapflag);
+
+    memcpy (&numsamples, pMS3FSDH_NUMSAMPLES (record), sizeof (uint32_t));
+    samplecnt = HO4u (numsamples, swapflag);
+
+    *pubversion = *pMS3FSDH_PUBVERSION (record);
+  }
+  else if (formatversion == 2)
+  {
+    int blkt_offset;
+    int blkt_count = 0;
+    int B1001offset = 0;
+    uint16_t blkt_type;
+    uint16_t next_blkt;
+
+    if (!MS2_ISVALIDHEADER (record))
+      return -1;
+
+    if (!MS_ISVALIDYEARDAY (*pMS2FSDH_YEAR (record), *pMS2FSDH_DAY (record)))
+      swapflag = 1;
+
+    if (!ms2_recordsid (record, sid, LM_SIDLEN))
+      return -1;
+
+    *starttime = ms_btime2nstime ((uint8_t *)pMS2FSDH_YEAR (record), swapflag);
+
+    if (*starttime == NSTERROR || *starttime == NSTUNSET)
+      return -1;
+
+    /* Apply time correction if it has not been applied, bit 1 of activity flags */
+    if (HO4d (*pMS2FSDH_TIMECORRECT (record), swapflag) != 0 &&
+        !(*pMS2FSDH_ACTFLAGS (record) & 0x02))
+    {
+      *starttime += (nstime_t)HO4d (*pMS2FSDH_TIMECORRECT (record), swapflag) * (NSTMODULUS / 10000);
+    }
+
+    samprate = ms_nomsamprate (HO2d (*pMS2FSDH_SAMPLERATEFACT (record), swapflag),
+                               HO2d (*pMS2FSDH_SAMPLERATEMULT (record), swapflag));
+    samplecnt = HO2u (*pMS2FSDH_NUMSAMPLES (record), swapflag);
+
+    /* Search blockettes for actual sample rate (100) and microseconds (1001) */
+    blkt_offset = HO2u (*pMS2FSDH_BLOCKETTEOFFSET (record), swapflag);
+
+    while (blkt_offset != 0 && (blkt_offset + 4) <= reclen && blkt_count < 64)
+    {
+      memcpy (&blkt_type, record + blkt_offset, 2);
+      memcpy (&next_blkt, record + blkt_offset + 2, 2);
+      blkt_type = HO2u (blkt_type, swapflag);
+      next_blkt = HO2u (next_blkt, swapflag);
+
+      if (blkt_type == 100 && (blkt_offset + 12) <= reclen)
+      {
+        samprate = HO4f (*pMS2B100_SAMPRATE (record + blkt_offset), swapflag);
+      }
+      else if (blkt_type == 1001 && (blkt_offset + 8) <= reclen)
+      {
+        B1001offset = blkt_offset;
+      }
+
+      /* Stop at a broken chain, the full parse will report it */
+      if (next_blkt && next_blkt <= blkt_offset)
+        break;
+
+      blkt_offset = next_blkt;
+      blkt_count++;
+    }
+
+    /* Apply microsecond precision if Blockette 1001 is present */
+    if (B1001offset)
+    {
+      *starttime +=
+          (nstime_t)*pMS2B1001_MICROSECOND (record + B1001offset) * (NSTMODULUS / 1000000);
+    }
+
+    /* Map data quality indicator to publication version */
+    switch (*pMS2FSDH_DATAQUALITY (record))
+    {
+    case 'M':
+      *pubversion = 4;
+      break;
+    case 'Q':
+      *pubversion = 3;
+      break;
+    case 'D':
+      *pubversion = 2;
+      break;
+    case 'R':
+      *pubversion = 1;
+      break;
+    default:
+      *pubversion = 0;
+    }
+  }
+  else
+  {
+    return -1;
+  }
+
+  if (*starttime == NSTERROR)
+    return -1;
+
+  *endtime = ms_sampletime (*starttime, (samplecnt > 0) ? samplecnt - 1 : 0, samprate);
+
+  return 0;
+} /* End of ms3_header_summary() */
+
+/***************************************************************************
+ * ms3_matchselect_header:
+ *
+ * Test the header of a raw miniSEED 2.x or 3.x data record against
+ * selections without constructing an MS3Record, see
+ * ms3_header_summary() for details.
+ *
+ * Returns 0 when the record definitely does not match the selections
+ * and 1 when it matches or a match cannot be determined from the header,
+ * in which case the record should be fully parsed and tested.
+ ***************************************************************************/
+int
+ms3_matchselect_header (const MS3Selections *selections, const char *record, int reclen,
+                        uint8_t formatversion)
+{
+  char sid[LM_SIDLEN];
+  nstime_t starttime;
+  nstime_t endtime;
+  uint8_t pubversion;
+
+  if (!selections ||
+      ms3_header_summary (record, reclen, formatversion, sid, &starttime, &endtime, &pubversion))
+    return 1;
+
+  return (ms3_matchselect (selections, sid, starttime, endtime, pubversion, NULL)) ? 1 : 0;
+} /* End of ms3_matchselect_header() */
+
 /***************************************************************************
  * ms2_blktdesc():
  *
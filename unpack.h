@@ -34,6 +34,10 @@ extern int64_t msr3_unpack_mseed2 (const char *record, int reclen, MS3Record **p
 
 extern double ms_nomsamprate (int factor, int multiplier);
 extern char *ms2_recordsid (const char *record, char *sid, int sidlen);
+extern int ms3_header_summary (const char *record, int reclen, uint8_t formatversion, char *sid,
+                               nstime_t *starttime, nstime_t *endtime, uint8_t *pubversion);
+extern int ms3_matchselect_header (const MS3Selections *selections, const char *record, int reclen,
+                                   uint8_t formatversion);
 extern const char *ms2_blktdesc (uint16_t blkttype);
 uint16_t ms2_blktlen (uint16_t blkttype, const char *blkt, int8_t swapflag);
 
@@ -25,6 +25,7 @@
 #include <stdlib.h>
 
 #include "libmseed.h"
+#include "internalstate.h"
 #include "unpackdata.h"
 
 /* Extract bit range.  Byte order agnostic & defined when used with unsigned values */
@@ -337,8 +338,15 @@ msr_decode_steim1 (int32_t *input, uint64_t inputlength, uint64_t samplecount, i
   /* Check data integrity by comparing last sample to Xn (reverse integration constant) */
   if (outputidx == samplecount && output[outputidx - 1] != Xn)
   {
-    ms_log (1, "%s: Warning: Data integrity check for Steim1 failed, Last sample=%d, Xn=%d\n",
-            srcname, output[outputidx - 1], Xn);
+    MSDiagEvent event = {.code = MSDIAG_STEIM1_INTEGRITY,
+                         .level = 1,
+                         .errorcode = MS_NOERROR,
+                         .function = __func__,
+                         .sid = (srcname && srcname[0]) ? srcname : NULL,
+                         .offset = -1,
+                         .value = {output[outputidx - 1], Xn}};
+
+    lm_diag_event (&event, 1);
   }
 
   return outputidx;
@@ -599,8 +607,15 @@ msr_decode_steim2 (int32_t *input, uint64_t inputlength, uint64_t samplecount, i
   /* Check data integrity by comparing last sample to Xn (reverse integration constant) */
   if (outputidx == samplecount && output[outputidx - 1] != Xn)
   {
-    ms_log (1, "%s: Warning: Data integrity check for Steim2 failed, Last sample=%d, Xn=%d\n",
-            srcname, output[outputidx - 1], Xn);
+    MSDiagEvent event = {.code = MSDIAG_STEIM2_INTEGRITY,
+                         .level = 1,
+                         .errorcode = MS_NOERROR,
+                         .function = __func__,
+                         .sid = (srcname && srcname[0]) ? srcname : NULL,
+                         .offset = -1,
+                         .value = {output[outputidx - 1], Xn}};
+
+    lm_diag_event (&event, 1);
   }
 
   return outputidx;
@@ -0,0 +1,662 @@
+/***************************************************************************
+ * Buffered, persistent miniSEED record writer.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2024 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "libmseed.h"
+#include "internalstate.h"
+
+#if !defined(LMP_WIN)
+#include <sys/uio.h>
+#endif
+
+/* Alignment of the write buffer, a common page and file system block size */
+#define LM_WRITER_ALIGNMENT 4096
+
+/* Default write buffer size */
+#define LM_WRITER_BUFFERSIZE 1048576
+
+/* Buffered record writer (opaque in public header) */
+struct MS3Writer
+{
+  char path[512];        /* Output path, "-" for stdout */
+  int fd;                /* Output file descriptor */
+  int8_t closefd;        /* Close descriptor when done */
+  int8_t error;          /* Latched write error */
+  int syncpolicy;        /* Synchronization policy, MSW_SYNC_* */
+  uint64_t syncinterval; /* Bytes between fsync for MSW_SYNC_BYTES */
+  uint64_t unsynced;     /* Bytes written since last fsync */
+  char *allocated;       /* Allocated buffer, unaligned */
+  char *buffer;          /* Aligned write buffer */
+  size_t size;           /* Size of write buffer */
+  size_t length;         /* Length of data in write buffer */
+  int64_t records;       /* Records accepted */
+  int64_t bytes;         /* Bytes written */
+};
+
+/***************************************************************************
+ * Write all data from up to two buffers to a descriptor, as a single
+ * gathered write when supported, retrying partial and interrupted writes.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+write_all_int (int fd, const char *data1, size_t length1, const char *data2, size_t length2)
+{
+#if defined(LMP_WIN)
+  const char *data[2] = {data1, data2};
+  size_t length[2] = {length1, length2};
+  int idx;
+  int written;
+
+  for (idx = 0; idx < 2; idx++)
+  {
+    while (length[idx] > 0)
+    {
+      written = _write (fd, data[idx],
+                        (length[idx] > INT32_MAX) ? INT32_MAX : (unsigned int)length[idx]);
+
+      if (written < 0)
+      {
+        if (errno == EINTR)
+          continue;
+
+        return -1;
+      }
+
+      data[idx] += written;
+      length[idx] -= written;
+    }
+  }
+
+  return 0;
+#else
+  struct iovec iov[2];
+  struct iovec *iovp = iov;
+  int iovcnt = 0;
+  ssize_t written;
+
+  if (length1 > 0)
+  {
+    iov[iovcnt].iov_base = (void *)data1;
+    iov[iovcnt].iov_len = length1;
+    iovcnt++;
+  }
+  if (length2 > 0)
+  {
+    iov[iovcnt].iov_base = (void *)data2;
+    iov[iovcnt].iov_len = length2;
+    iovcnt++;
+  }
+
+  while (iovcnt > 0)
+  {
+    written = writev (fd, iovp, iovcnt);
+
+    if (written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      return -1;
+    }
+
+    /* Advance past written data */
+    while (iovcnt > 0 && (size_t)written >= iovp->iov_len)
+    {
+      written -= iovp->iov_len;
+      iovp++;
+      iovcnt--;
+    }
+
+    if (iovcnt > 0)
+    {
+      iovp->iov_base = (char *)iovp->iov_base + written;
+      iovp->iov_len -= written;
+    }
+  }
+
+  return 0;
+#endif
+} /* End of write_all_int() */
+
+/***************************************************************************
+ * Synchronize file data to storage.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+sync_int (MS3Writer *writer)
+{
+  int rv;
+
+#if defined(LMP_WIN)
+  rv = _commit (writer->fd);
+#else
+  rv = fsync (writer->fd);
+
+  /* Pipes, terminals and sockets cannot be synchronized */
+  if (rv && errno == EINVAL)
+    rv = 0;
+#endif
+
+  if (rv)
+  {
+    ms_log (2, "%s: Cannot synchronize output: %s\n", writer->path, strerror (errno));
+    writer->error = 1;
+    return -1;
+  }
+
+  writer->unsynced = 0;
+
+  return 0;
+} /* End of sync_int() */
+
+/***************************************************************************
+ * Write buffered data, optionally followed by an additional record,
+ * and apply the synchronization policy.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+flush_int (MS3Writer *writer, const char *record, size_t reclen)
+{
+  size_t total = writer->length + reclen;
+
+  if (total == 0)
+    return 0;
+
+  if (write_all_int (writer->fd, writer->buffer, writer->length, record, reclen))
+  {
+    ms_log (2, "%s: Error writing to output: %s\n", writer->path, strerror (errno));
+    writer->error = 1;
+    return -1;
+  }
+
+  writer->length = 0;
+  writer->bytes += total;
+  writer->unsynced += total;
+
+  if (writer->syncpolicy == MSW_SYNC_FLUSH ||
+      (writer->syncpolicy == MSW_SYNC_BYTES && writer->unsynced >= writer->syncinterval))
+    return sync_int (writer);
+
+  return 0;
+} /* End of flush_int() */
+
+/***************************************************************************
+ * Allocate and initialize a writer for an open descriptor.
+ ***************************************************************************/
+static MS3Writer *
+writer_init_int (const char *path, int fd, int8_t closefd, size_t buffersize)
+{
+  MS3Writer *writer;
+  uintptr_t aligned;
+
+  if (buffersize == 0)
+    buffersize = LM_WRITER_BUFFERSIZE;
+
+  if ((writer = (MS3Writer *)libmseed_memory.malloc (sizeof (MS3Writer))) == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    return NULL;
+  }
+
+  memset (writer, 0, sizeof (MS3Writer));
+
+  /* Allocate buffer with room to align it */
+  writer->allocated = (char *)libmseed_memory.malloc (buffersize + LM_WRITER_ALIGNMENT);
+
+  if (writer->allocated == NULL)
+  {
+    ms_log (2, "%s(): Cannot allocate memory\n", __func__);
+    libmseed_memory.free (writer);
+    return NULL;
+  }
+
+  aligned = ((uintptr_t)writer->allocated + LM_WRITER_ALIGNMENT - 1) &
+            ~(uintptr_t)(LM_WRITER_ALIGNMENT - 1);
+
+  strncpy (writer->path, path, sizeof (writer->path) - 1);
+  writer->fd = fd;
+  writer->closefd = closefd;
+  writer->syncpolicy = MSW_SYNC_NONE;
+  writer->buffer = (char *)aligned;
+  writer->size = buffersize;
+
+  return writer;
+} /* End of writer_init_int() */
+
+/** ************************************************************************
+ * @brief Open a buffered miniSEED record writer for a file
+ *
+ * Open a file for writing miniSEED records that are accumulated in a
+ * single, page-aligned buffer and written in large blocks.  The writer
+ * remains open for any number of writes until ms3_writer_close().
+ *
+ * The @p overwrite flag controls whether a existing file is
+ * overwritten or not.  If true (non-zero) any existing file will be
+ * replaced.  If false (zero) new records will be appended to an
+ * existing file.  In either case, new files will be created if they
+ * do not yet exist.
+ *
+ * If @p mspath is "-" records are written to standard output.
+ *
+ * By default no explicit synchronization to storage is performed, see
+ * ms3_writer_syncpolicy().
+ *
+ * @param[in] mspath File for output records
+ * @param[in] overwrite Flag to control overwriting versus appending
+ * @param[in] buffersize Size of the write buffer in bytes, 0 for the default of 1 MiB
+ *
+ * @returns Allocated ::MS3Writer on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_writer_write()
+ * @see ms3_writer_close()
+ ***************************************************************************/
+MS3Writer *
+ms3_writer_open (const char *mspath, int8_t overwrite, size_t buffersize)
+{
+  MS3Writer *writer;
+  int fd;
+
+  if (!mspath)
+  {
+    ms_log (2, "%s(): Required input not defined: 'mspath'\n", __func__);
+    return NULL;
+  }
+
+  if (strcmp (mspath, "-") == 0)
+  {
+    /* Flush any pending stdio output before writing directly to the descriptor */
+    fflush (stdout);
+
+    return writer_init_int (mspath, fileno (stdout), 0, buffersize);
+  }
+
+#if defined(LMP_WIN)
+  fd = _open (mspath, _O_WRONLY | _O_CREAT | _O_BINARY | ((overwrite) ? _O_TRUNC : _O_APPEND),
+              _S_IREAD | _S_IWRITE);
+#else
+  fd = open (mspath, O_WRONLY | O_CREAT | ((overwrite) ? O_TRUNC : O_APPEND), 0666);
+#endif
+
+  if (fd < 0)
+  {
+    ms_log (2, "Cannot open output file %s: %s\n", mspath, strerror (errno));
+    return NULL;
+  }
+
+  if ((writer = writer_init_int (mspath, fd, 1, buffersize)) == NULL)
+    close (fd);
+
+  return writer;
+} /* End of ms3_writer_open() */
+
+/** ************************************************************************
+ * @brief Open a buffered miniSEED record writer for a file descriptor
+ *
+ * Records are written to the current position of @p fd.
+ *
+ * Note: the specified file descriptor will _not_ be closed by
+ * ms3_writer_close().  The caller is responsible for closing the file
+ * descriptor when it is no longer needed.
+ *
+ * @param[in] fd File descriptor for output records
+ * @param[in] buffersize Size of the write buffer in bytes, 0 for the default of 1 MiB
+ *
+ * @returns Allocated ::MS3Writer on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+MS3Writer *
+ms3_writer_open_fd (int fd, size_t buffersize)
+{
+  char path[32];
+
+  if (fd < 0)
+  {
+    ms_log (2, "%s(): Invalid file descriptor: %d\n", __func__, fd);
+    return NULL;
+  }
+
+  snprintf (path, sizeof (path), "fd %d", fd);
+
+  return writer_init_int (path, fd, 0, buffersize);
+} /* End of ms3_writer_open_fd() */
+
+/** ************************************************************************
+ * @brief Set the storage synchronization policy of a writer
+ *
+ * The policy determines when written data is explicitly synchronized
+ * to storage with fsync() (or _commit() on Windows):
+ *  - @c ::MSW_SYNC_NONE : Never, leave it to the operating system (default)
+ *  - @c ::MSW_SYNC_CLOSE : When the writer is closed
+ *  - @c ::MSW_SYNC_FLUSH : After every buffer flush
+ *  - @c ::MSW_SYNC_BYTES : After at least @p interval bytes have been written
+ *
+ * @param[in] writer ::MS3Writer to configure
+ * @param[in] policy Synchronization policy, one of the MSW_SYNC_* values
+ * @param[in] interval Bytes between synchronizations for ::MSW_SYNC_BYTES
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_writer_syncpolicy (MS3Writer *writer, int policy, uint64_t interval)
+{
+  if (!writer)
+  {
+    ms_log (2, "%s(): Required input not defined: 'writer'\n", __func__);
+    return -1;
+  }
+
+  if (policy < MSW_SYNC_NONE || policy > MSW_SYNC_BYTES ||
+      (policy == MSW_SYNC_BYTES && interval == 0))
+  {
+    ms_log (2, "%s(): Invalid synchronization policy (%d) or interval\n", __func__, policy);
+    return -1;
+  }
+
+  writer->syncpolicy = policy;
+  writer->syncinterval = interval;
+
+  return 0;
+} /* End of ms3_writer_syncpolicy() */
+
+/** ************************************************************************
+ * @brief Write a miniSEED record with a buffered writer
+ *
+ * The record is copied into the write buffer, which is written when
+ * full.  A record that does not fit in the remaining buffer space is
+ * written directly together with the buffered data, without copying.
+ *
+ * Records returned by msr3_pack_next() and mstl3_pack_next() may be
+ * passed directly, the record need not remain valid after this call.
+ *
+ * After a write error the writer is in an error state and all further
+ * writes fail.
+ *
+ * @param[in] writer ::MS3Writer to write to
+ * @param[in] record miniSEED record
+ * @param[in] reclen Length of record in bytes
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_writer_write (MS3Writer *writer, const char *record, int32_t reclen)
+{
+  if (!writer || !record)
+  {
+    ms_log (2, "%s(): Required input not defined: 'writer' or 'record'\n", __func__);
+    return -1;
+  }
+
+  if (writer->error)
+    return -1;
+
+  if (reclen <= 0)
+    return 0;
+
+  /* Write buffered data and this record in a single call */
+  if ((size_t)reclen > writer->size - writer->length)
+  {
+    if (flush_int (writer, record, reclen))
+      return -1;
+  }
+  else
+  {
+    memcpy (writer->buffer + writer->length, record, reclen);
+    writer->length += reclen;
+
+    if (writer->length == writer->size && flush_int (writer, NULL, 0))
+      return -1;
+  }
+
+  writer->records++;
+
+  return 0;
+} /* End of ms3_writer_write() */
+
+/** ************************************************************************
+ * @brief Record handler for msr3_pack() and mstl3_pack() to a writer
+ *
+ * A record handler suitable for the packing functions, the handler
+ * data must be an ::MS3Writer.  Errors are retained by the writer and
+ * reported by subsequent writes, ms3_writer_flush() and ms3_writer_close().
+ *
+ * @param[in] record miniSEED record
+ * @param[in] reclen Length of record in bytes
+ * @param[in] writer ::MS3Writer to write to
+ ***************************************************************************/
+void
+ms3_writer_handler (char *record, int reclen, void *writer)
+{
+  ms3_writer_write ((MS3Writer *)writer, record, reclen);
+} /* End of ms3_writer_handler() */
+
+/** ************************************************************************
+ * @brief Pack an ::MS3Record and write the records to a writer
+ *
+ * Equivalent to msr3_writemseed() for a persistent writer.
+ *
+ * @param[in] writer ::MS3Writer to write to
+ * @param[in] msr ::MS3Record containing data to write
+ * @param[in] flags Flags controlling data packing, see msr3_pack()
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns the number of records written on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+ms3_writer_writemsr (MS3Writer *writer, const MS3Record *msr, uint32_t flags, int8_t verbose)
+{
+  MS3RecordPacker *packer;
+  char *record = NULL;
+  int32_t reclen = 0;
+  int64_t packedrecords = 0;
+  int result;
+
+  if (!writer || !msr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'writer' or 'msr'\n", __func__);
+    return -1;
+  }
+
+  if ((packer = msr3_pack_init (msr, flags, verbose)) == NULL)
+    return -1;
+
+  while ((result = msr3_pack_next (packer, &record, &reclen)) == 1)
+  {
+    if (ms3_writer_write (writer, record, reclen))
+    {
+      result = -1;
+      break;
+    }
+
+    packedrecords++;
+  }
+
+  msr3_pack_free (&packer, NULL);
+
+  return (result < 0) ? -1 : packedrecords;
+} /* End of ms3_writer_writemsr() */
+
+/** ************************************************************************
+ * @brief Pack an ::MS3TraceList and write the records to a writer
+ *
+ * Equivalent to mstl3_writemseed() for a persistent writer, all data
+ * is packed and the trace list is not modified.
+ *
+ * @param[in] writer ::MS3Writer to write to
+ * @param[in] mstl ::MS3TraceList containing data to write
+ * @param[in] maxreclen The maximum record length to create
+ * @param[in] encoding Encoding for data samples, see msr3_pack()
+ * @param[in] flags Flags controlling data packing, see mstl3_pack() and msr3_pack()
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns the number of records written on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+ms3_writer_writemstl (MS3Writer *writer, MS3TraceList *mstl, int maxreclen, int8_t encoding,
+                      uint32_t flags, int8_t verbose)
+{
+  MS3TraceListPacker *packer;
+  char *record = NULL;
+  int32_t reclen = 0;
+  int64_t packedrecords = 0;
+  int result;
+
+  if (!writer || !mstl)
+  {
+    ms_log (2, "%s(): Required input not defined: 'writer' or 'mstl'\n", __func__);
+    return -1;
+  }
+
+  flags |= MSF_MAINTAINMSTL | MSF_FLUSHDATA;
+
+  if ((packer = mstl3_pack_init (mstl, maxreclen, encoding, flags, verbose, NULL, 0)) == NULL)
+    return -1;
+
+  while ((result = mstl3_pack_next (packer, flags, &record, &reclen)) == 1)
+  {
+    if (ms3_writer_write (writer, record, reclen))
+    {
+      result = -1;
+      break;
+    }
+
+    packedrecords++;
+  }
+
+  mstl3_pack_free (&packer, NULL);
+
+  return (result < 0) ? -1 : packedrecords;
+} /* End of ms3_writer_writemstl() */
+
+/** ************************************************************************
+ * @brief Write all buffered records of a writer
+ *
+ * Buffered data is written and, if the policy is ::MSW_SYNC_FLUSH,
+ * synchronized to storage.
+ *
+ * @param[in] writer ::MS3Writer to flush
+ *
+ * @returns 0 on success and -1 on error, including any earlier write error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_writer_flush (MS3Writer *writer)
+{
+  if (!writer)
+  {
+    ms_log (2, "%s(): Required input not defined: 'writer'\n", __func__);
+    return -1;
+  }
+
+  if (writer->error)
+    return -1;
+
+  return flush_int (writer, NULL, 0);
+} /* End of ms3_writer_flush() */
+
+/** ************************************************************************
+ * @brief Return the counts of records and bytes written by a writer
+ *
+ * Buffered records are included in @p records but not in @p bytes
+ * until they are written.
+ *
+ * @param[in] writer ::MS3Writer
+ * @param[out] records Number of records accepted, may be NULL
+ * @param[out] bytes Number of bytes written to the output, may be NULL
+ *
+ * @returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+ms3_writer_stats (const MS3Writer *writer, int64_t *records, int64_t *bytes)
+{
+  if (!writer)
+    return -1;
+
+  if (records)
+    *records = writer->records;
+  if (bytes)
+    *bytes = writer->bytes;
+
+  return 0;
+} /* End of ms3_writer_stats() */
+
+/** ************************************************************************
+ * @brief Flush, close and free a writer
+ *
+ * Buffered data is written, synchronized to storage if the policy is
+ * not ::MSW_SYNC_NONE, and the file is closed.  Descriptors not opened
+ * by the writer, including standard output, are not closed.
+ *
+ * @param[in,out] ppwriter Pointer to ::MS3Writer to close, set to NULL
+ *
+ * @returns 0 on success and -1 on error, including any earlier write error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_writer_close (MS3Writer **ppwriter)
+{
+  MS3Writer *writer;
+  int rv = 0;
+
+  if (!ppwriter || !*ppwriter)
+    return -1;
+
+  writer = *ppwriter;
+
+  if (writer->error || flush_int (writer, NULL, 0))
+    rv = -1;
+
+  if (rv == 0 && writer->syncpolicy != MSW_SYNC_NONE && writer->unsynced > 0)
+    rv = sync_int (writer);
+
+  if (writer->closefd && close (writer->fd))
+  {
+    ms_log (2, "%s: Error closing output: %s\n", writer->path, strerror (errno));
+    rv = -1;
+  }
+
+  libmseed_memory.free (writer->allocated);
+  libmseed_memory.free (writer);
+  *ppwriter = NULL;
+
+  return rv;
+} /* End of ms3_writer_close() */